@@ -0,0 +1,633 @@
+//
+// Copyright 2017, Quantum Immortality Software and Jon Davis
+//
+// BC1, BC3 and BC7 (mode 6) encoders and decoders. Blocks are little endian throughout.
+//
+
+#include "basictypes.h"
+
+#include "bcn.h"
+#include "debug.h"
+#include "util.h"
+
+#include <math.h>
+#include <string.h>
+
+static const u32 kBc7Weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+static inline u32 Bc_Channel(u32 pixel, u32 ch)
+{
+	return (pixel >> (ch * 8)) & 0xFF;
+}
+
+static inline u32 Bc_Pixel(u32 r, u32 g, u32 b, u32 a)
+{
+	return r | g << 8 | b << 16 | a << 24;
+}
+
+static inline r32 Bc_Clamp255(r32 v)
+{
+	return v < 0.0f ? 0.0f : v > 255.0f ? 255.0f : v;
+}
+
+// Squared distance over the first numChannels channels
+static inline u32 Bc_Distance(u32 a, u32 b, u32 numChannels)
+{
+	u32 dist = 0;
+	for (u32 ch = 0; ch < numChannels; ch++)
+	{
+		const i32 d = (i32)Bc_Channel(a, ch) - (i32)Bc_Channel(b, ch);
+		dist += (u32)(d * d);
+	}
+	return dist;
+}
+
+// The 16 pixels of the block at bx, by; ones past the edge repeat the last column or row
+static void Bc_GatherBlock(u32 block[16], const u32 *pixels, u32 width, u32 height, u32 pitch, u32 bx, u32 by)
+{
+	for (u32 y = 0; y < 4; y++)
+	{
+		const u32  py  = by * 4 + y < height ? by * 4 + y : height - 1;
+		const u32 *row = pixels + (size_t)py * pitch;
+		for (u32 x = 0; x < 4; x++)
+			block[y * 4 + x] = row[bx * 4 + x < width ? bx * 4 + x : width - 1];
+	}
+}
+
+static void Bc_ScatterBlock(const u32 block[16], u32 *pixels, u32 width, u32 height, u32 pitch, u32 bx, u32 by)
+{
+	for (u32 y = 0; y < 4 && by * 4 + y < height; y++)
+	{
+		u32 *row = pixels + (size_t)(by * 4 + y) * pitch;
+		for (u32 x = 0; x < 4 && bx * 4 + x < width; x++)
+			row[bx * 4 + x] = block[y * 4 + x];
+	}
+}
+
+// Ends of the line through the pixels along their principal axis, found by power iteration on the covariance and
+// stretched to the furthest projections. hi is the end the axis points to.
+static void Bc_FitLine(const u32 *pixels, u32 numPixels, u32 numChannels, r32 lo[4], r32 hi[4])
+{
+	r32 mean[4] = {}, minC[4], maxC[4];
+	for (u32 ch = 0; ch < 4; ch++)
+	{
+		minC[ch] = 255.0f;
+		maxC[ch] = 0.0f;
+		lo[ch] = hi[ch] = 0.0f;
+	}
+	for (u32 pi = 0; pi < numPixels; pi++)
+		for (u32 ch = 0; ch < numChannels; ch++)
+		{
+			const r32 c = (r32)Bc_Channel(pixels[pi], ch);
+			mean[ch] += c;
+			minC[ch] = c < minC[ch] ? c : minC[ch];
+			maxC[ch] = c > maxC[ch] ? c : maxC[ch];
+		}
+	for (u32 ch = 0; ch < numChannels; ch++)
+		mean[ch] /= (r32)numPixels;
+
+	r32 cov[4][4] = {};
+	for (u32 pi = 0; pi < numPixels; pi++)
+	{
+		r32 d[4];
+		for (u32 ch = 0; ch < numChannels; ch++)
+			d[ch] = (r32)Bc_Channel(pixels[pi], ch) - mean[ch];
+		for (u32 i = 0; i < numChannels; i++)
+			for (u32 j = 0; j < numChannels; j++)
+				cov[i][j] += d[i] * d[j];
+	}
+
+	// The bounding box diagonal is usually close already
+	r32 axis[4] = {};
+	for (u32 ch = 0; ch < numChannels; ch++)
+		axis[ch] = maxC[ch] - minC[ch];
+	for (u32 iter = 0; iter < 8; iter++)
+	{
+		r32 next[4] = {};
+		r32 len     = 0.0f;
+		for (u32 i = 0; i < numChannels; i++)
+		{
+			for (u32 j = 0; j < numChannels; j++)
+				next[i] += cov[i][j] * axis[j];
+			len += next[i] * next[i];
+		}
+		if (len < 1e-12f)
+			break;
+		len = 1.0f / sqrtf(len);
+		for (u32 ch = 0; ch < numChannels; ch++)
+			axis[ch] = next[ch] * len;
+	}
+
+	r32 len = 0.0f;
+	for (u32 ch = 0; ch < numChannels; ch++)
+		len += axis[ch] * axis[ch];
+	if (len < 1e-12f)
+	{
+		// All one color
+		for (u32 ch = 0; ch < numChannels; ch++)
+			lo[ch] = hi[ch] = mean[ch];
+		return;
+	}
+	len = 1.0f / sqrtf(len);
+	for (u32 ch = 0; ch < numChannels; ch++)
+		axis[ch] *= len;
+
+	r32 tMin = 1e30f, tMax = -1e30f;
+	for (u32 pi = 0; pi < numPixels; pi++)
+	{
+		r32 t = 0.0f;
+		for (u32 ch = 0; ch < numChannels; ch++)
+			t += ((r32)Bc_Channel(pixels[pi], ch) - mean[ch]) * axis[ch];
+		tMin = t < tMin ? t : tMin;
+		tMax = t > tMax ? t : tMax;
+	}
+	for (u32 ch = 0; ch < numChannels; ch++)
+	{
+		lo[ch] = Bc_Clamp255(mean[ch] + axis[ch] * tMin);
+		hi[ch] = Bc_Clamp255(mean[ch] + axis[ch] * tMax);
+	}
+}
+
+//
+// BC1 color blocks, also the color half of BC3
+//
+
+static u16 Bc_Pack565(const r32 c[4])
+{
+	const u32 r = (u32)(c[0] * 31.0f / 255.0f + 0.5f);
+	const u32 g = (u32)(c[1] * 63.0f / 255.0f + 0.5f);
+	const u32 b = (u32)(c[2] * 31.0f / 255.0f + 0.5f);
+	return (u16)(r << 11 | g << 5 | b);
+}
+
+static u32 Bc_Unpack565(u16 c)
+{
+	const u32 r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+	return Bc_Pixel(r << 3 | r >> 2, g << 2 | g >> 4, b << 3 | b >> 2, 255);
+}
+
+// What a decoder makes of the endpoints. BC3 color is always the 4 color ramp, BC1 only when c0 > c1.
+static bool Bc_ColorPalette(u16 c0, u16 c1, bool alwaysFourColor, u32 palette[4])
+{
+	const u32 p0 = Bc_Unpack565(c0), p1 = Bc_Unpack565(c1);
+	palette[0]   = p0;
+	palette[1]   = p1;
+	if (alwaysFourColor || c0 > c1)
+	{
+		u32 c2 = 0xFF000000, c3 = 0xFF000000;
+		for (u32 ch = 0; ch < 3; ch++)
+		{
+			c2 |= ((2 * Bc_Channel(p0, ch) + Bc_Channel(p1, ch)) / 3) << (ch * 8);
+			c3 |= ((Bc_Channel(p0, ch) + 2 * Bc_Channel(p1, ch)) / 3) << (ch * 8);
+		}
+		palette[2] = c2;
+		palette[3] = c3;
+		return true;
+	}
+
+	u32 c2 = 0xFF000000;
+	for (u32 ch = 0; ch < 3; ch++)
+		c2 |= ((Bc_Channel(p0, ch) + Bc_Channel(p1, ch)) / 2) << (ch * 8);
+	palette[2] = c2;
+	palette[3] = 0;
+	return false;
+}
+
+// Nearest palette entry for each pixel, index 3 for the transparent ones. Returns the total error.
+static u32 Bc_PickColorIndices(const u32 block[16], u32 transparent, const u32 palette[4], bool fourColor, u8 indices[16])
+{
+	u32 error = 0;
+	for (u32 pi = 0; pi < 16; pi++)
+	{
+		if (transparent & (1 << pi))
+		{
+			indices[pi] = 3;
+			continue;
+		}
+
+		u32 best = 0, bestDist = ~0u;
+		for (u32 ii = 0; ii < (fourColor ? 4u : 3u); ii++)
+		{
+			const u32 dist = Bc_Distance(block[pi], palette[ii], 3);
+			if (dist < bestDist)
+			{
+				best     = ii;
+				bestDist = dist;
+			}
+		}
+		indices[pi] = (u8)best;
+		error += bestDist;
+	}
+	return error;
+}
+
+struct BcColorFit
+{
+	u16 c0, c1;
+	u8  indices[16];
+	u32 error;
+};
+
+// Orders the endpoints for the mode wanted, 4 colors unless there are transparent pixels, then picks indices
+static void Bc_FitColorEndpoints(const u32 block[16], u32 transparent, bool alwaysFourColor, const r32 e0[4], const r32 e1[4], BcColorFit *fit)
+{
+	u16 c0 = Bc_Pack565(e0), c1 = Bc_Pack565(e1);
+	if (!alwaysFourColor && ((transparent == 0 && c0 < c1) || (transparent != 0 && c0 > c1)))
+	{
+		const u16 t = c0;
+		c0          = c1;
+		c1          = t;
+	}
+
+	u32        palette[4];
+	const bool fourColor = Bc_ColorPalette(c0, c1, alwaysFourColor, palette);
+	fit->c0              = c0;
+	fit->c1              = c1;
+	fit->error           = Bc_PickColorIndices(block, transparent, palette, fourColor, fit->indices);
+}
+
+static void Bc_EncodeColorBlock(u8 out[8], const u32 block[16], bool allowTransparent)
+{
+	u32 transparent = 0;
+	u32 opaque[16], numOpaque = 0;
+	for (u32 pi = 0; pi < 16; pi++)
+	{
+		if (allowTransparent && Bc_Channel(block[pi], 3) < 128)
+			transparent |= 1 << pi;
+		else
+			opaque[numOpaque++] = block[pi];
+	}
+
+	BcColorFit fit = {};
+	if (numOpaque == 0)
+	{
+		// 3 color mode with every index transparent
+		fit.c0 = fit.c1 = 0;
+		memset(fit.indices, 3, sizeof(fit.indices));
+	}
+	else
+	{
+		r32 lo[4], hi[4];
+		Bc_FitLine(opaque, numOpaque, 3, lo, hi);
+		Bc_FitColorEndpoints(block, transparent, !allowTransparent, hi, lo, &fit);
+
+		// One least squares pass: the endpoints that best reproduce the pixels given the indices just picked
+		u32        palette[4];
+		const bool fourColor = Bc_ColorPalette(fit.c0, fit.c1, !allowTransparent, palette);
+		r32        aa = 0.0f, ab = 0.0f, bb = 0.0f, ax[3] = {}, bx[3] = {};
+		for (u32 pi = 0; pi < 16; pi++)
+		{
+			if (transparent & (1 << pi))
+				continue;
+			static const r32 kFour[4]  = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+			static const r32 kThree[4] = {1.0f, 0.0f, 0.5f, 0.0f};
+			const r32        a         = fourColor ? kFour[fit.indices[pi]] : kThree[fit.indices[pi]];
+			const r32        b         = 1.0f - a;
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			for (u32 ch = 0; ch < 3; ch++)
+			{
+				ax[ch] += a * (r32)Bc_Channel(block[pi], ch);
+				bx[ch] += b * (r32)Bc_Channel(block[pi], ch);
+			}
+		}
+
+		const r32 det = aa * bb - ab * ab;
+		if (fabsf(det) > 1e-6f)
+		{
+			r32 e0[4] = {}, e1[4] = {};
+			for (u32 ch = 0; ch < 3; ch++)
+			{
+				e0[ch] = Bc_Clamp255((ax[ch] * bb - bx[ch] * ab) / det);
+				e1[ch] = Bc_Clamp255((bx[ch] * aa - ax[ch] * ab) / det);
+			}
+
+			BcColorFit refined;
+			Bc_FitColorEndpoints(block, transparent, !allowTransparent, e0, e1, &refined);
+			if (refined.error < fit.error)
+				fit = refined;
+		}
+	}
+
+	u32 bits = 0;
+	for (u32 pi = 0; pi < 16; pi++)
+		bits |= (u32)fit.indices[pi] << (pi * 2);
+	out[0] = (u8)fit.c0;
+	out[1] = (u8)(fit.c0 >> 8);
+	out[2] = (u8)fit.c1;
+	out[3] = (u8)(fit.c1 >> 8);
+	memcpy(out + 4, &bits, sizeof(bits));
+}
+
+static void Bc_DecodeColorBlock(u32 block[16], const u8 in[8], bool alwaysFourColor)
+{
+	const u16 c0 = (u16)(in[0] | in[1] << 8);
+	const u16 c1 = (u16)(in[2] | in[3] << 8);
+	u32       palette[4];
+	Bc_ColorPalette(c0, c1, alwaysFourColor, palette);
+
+	u32 bits;
+	memcpy(&bits, in + 4, sizeof(bits));
+	for (u32 pi = 0; pi < 16; pi++)
+		block[pi] = palette[(bits >> (pi * 2)) & 3];
+}
+
+//
+// BC3 alpha blocks
+//
+
+static void Bc_AlphaPalette(u32 a0, u32 a1, u32 palette[8])
+{
+	palette[0] = a0;
+	palette[1] = a1;
+	if (a0 > a1)
+	{
+		for (u32 i = 2; i < 8; i++)
+			palette[i] = ((8 - i) * a0 + (i - 1) * a1) / 7;
+	}
+	else
+	{
+		for (u32 i = 2; i < 6; i++)
+			palette[i] = ((6 - i) * a0 + (i - 1) * a1) / 5;
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+}
+
+// The 8 step ramp from the block's most to least opaque, or a single value
+static void Bc_EncodeAlphaBlock(u8 out[8], const u32 block[16])
+{
+	u32 aMin = 255, aMax = 0;
+	for (u32 pi = 0; pi < 16; pi++)
+	{
+		const u32 a = Bc_Channel(block[pi], 3);
+		aMin        = a < aMin ? a : aMin;
+		aMax        = a > aMax ? a : aMax;
+	}
+
+	u32 palette[8];
+	Bc_AlphaPalette(aMax, aMin, palette);
+
+	u64 bits = 0;
+	for (u32 pi = 0; pi < 16 && aMax > aMin; pi++)
+	{
+		const u32 a    = Bc_Channel(block[pi], 3);
+		u32       best = 0, bestDist = ~0u;
+		for (u32 ii = 0; ii < 8; ii++)
+		{
+			const u32 dist = a > palette[ii] ? a - palette[ii] : palette[ii] - a;
+			if (dist < bestDist)
+			{
+				best     = ii;
+				bestDist = dist;
+			}
+		}
+		bits |= (u64)best << (pi * 3);
+	}
+
+	out[0] = (u8)aMax;
+	out[1] = (u8)aMin;
+	for (u32 bi = 0; bi < 6; bi++)
+		out[2 + bi] = (u8)(bits >> (bi * 8));
+}
+
+static void Bc_DecodeAlphaBlock(u32 block[16], const u8 in[8])
+{
+	u32 palette[8];
+	Bc_AlphaPalette(in[0], in[1], palette);
+
+	u64 bits = 0;
+	for (u32 bi = 0; bi < 6; bi++)
+		bits |= (u64)in[2 + bi] << (bi * 8);
+	for (u32 pi = 0; pi < 16; pi++)
+		block[pi] = (block[pi] & 0x00FFFFFF) | palette[(bits >> (pi * 3)) & 7] << 24;
+}
+
+//
+// BC7 mode 6
+//
+
+struct BcBits
+{
+	u8  bytes[16];
+	u32 pos;
+};
+
+static void Bc_PutBits(BcBits *bits, u32 value, u32 count)
+{
+	for (u32 bi = 0; bi < count; bi++, bits->pos++)
+		if (value & (1u << bi))
+			bits->bytes[bits->pos / 8] |= (u8)(1u << (bits->pos % 8));
+}
+
+static u32 Bc_GetBits(BcBits *bits, u32 count)
+{
+	u32 value = 0;
+	for (u32 bi = 0; bi < count; bi++, bits->pos++)
+		value |= (u32)((bits->bytes[bits->pos / 8] >> (bits->pos % 8)) & 1) << bi;
+	return value;
+}
+
+static void Bc7_Palette(const u32 q0[4], const u32 q1[4], u32 p0, u32 p1, u32 palette[16])
+{
+	for (u32 ii = 0; ii < 16; ii++)
+	{
+		u32 pixel = 0;
+		for (u32 ch = 0; ch < 4; ch++)
+		{
+			const u32 v0 = q0[ch] << 1 | p0, v1 = q1[ch] << 1 | p1;
+			pixel |= (((64 - kBc7Weights[ii]) * v0 + kBc7Weights[ii] * v1 + 32) >> 6) << (ch * 8);
+		}
+		palette[ii] = pixel;
+	}
+}
+
+static void Bc7_EncodeBlock(u8 out[16], const u32 block[16])
+{
+	// Color under fully transparent pixels never shows, so it's moved to the middle of the rest to keep it from
+	// pulling the line about, and only their alpha counts when picking indices
+	u32 fitBlock[16], colorSum[3] = {}, numVisible = 0;
+	for (u32 pi = 0; pi < 16; pi++)
+		if (Bc_Channel(block[pi], 3) != 0)
+		{
+			for (u32 ch = 0; ch < 3; ch++)
+				colorSum[ch] += Bc_Channel(block[pi], ch);
+			numVisible++;
+		}
+	const u32 meanColor = numVisible ? Bc_Pixel(colorSum[0] / numVisible, colorSum[1] / numVisible, colorSum[2] / numVisible, 0) : 0;
+	for (u32 pi = 0; pi < 16; pi++)
+		fitBlock[pi] = Bc_Channel(block[pi], 3) != 0 ? block[pi] : meanColor;
+
+	r32 lo[4], hi[4];
+	Bc_FitLine(fitBlock, 16, 4, lo, hi);
+
+	// Each pair of low bits quantizes the endpoints differently, keep whichever fits best
+	u32 bestQ0[4] = {}, bestQ1[4] = {}, bestP0 = 0, bestP1 = 0, bestError = ~0u;
+	u8  bestIndices[16] = {};
+	for (u32 pbits = 0; pbits < 4; pbits++)
+	{
+		const u32 p0 = pbits & 1, p1 = pbits >> 1;
+		u32       q0[4], q1[4];
+		for (u32 ch = 0; ch < 4; ch++)
+		{
+			const r32 v0 = (lo[ch] - (r32)p0) * 0.5f + 0.5f;
+			const r32 v1 = (hi[ch] - (r32)p1) * 0.5f + 0.5f;
+			q0[ch]       = v0 < 0.0f ? 0 : v0 > 127.0f ? 127 : (u32)v0;
+			q1[ch]       = v1 < 0.0f ? 0 : v1 > 127.0f ? 127 : (u32)v1;
+		}
+
+		u32 palette[16];
+		Bc7_Palette(q0, q1, p0, p1, palette);
+
+		u32 error = 0;
+		u8  indices[16];
+		for (u32 pi = 0; pi < 16; pi++)
+		{
+			u32 best = 0, bestDist = ~0u;
+			for (u32 ii = 0; ii < 16; ii++)
+			{
+				const u32 dist = fitBlock[pi] == meanColor ? Bc_Distance(block[pi] >> 24, palette[ii] >> 24, 1)
+				                                           : Bc_Distance(block[pi], palette[ii], 4);
+				if (dist < bestDist)
+				{
+					best     = ii;
+					bestDist = dist;
+				}
+			}
+			indices[pi] = (u8)best;
+			error += bestDist;
+		}
+
+		if (error < bestError)
+		{
+			bestError = error;
+			bestP0    = p0;
+			bestP1    = p1;
+			memcpy(bestQ0, q0, sizeof(q0));
+			memcpy(bestQ1, q1, sizeof(q1));
+			memcpy(bestIndices, indices, sizeof(indices));
+		}
+	}
+
+	// The first pixel's index has no top bit stored, so it has to sit in the lower half of the ramp
+	if (bestIndices[0] >= 8)
+	{
+		for (u32 ch = 0; ch < 4; ch++)
+		{
+			const u32 t = bestQ0[ch];
+			bestQ0[ch]  = bestQ1[ch];
+			bestQ1[ch]  = t;
+		}
+		const u32 t = bestP0;
+		bestP0      = bestP1;
+		bestP1      = t;
+		for (u32 pi = 0; pi < 16; pi++)
+			bestIndices[pi] = (u8)(15 - bestIndices[pi]);
+	}
+
+	BcBits bits = {};
+	Bc_PutBits(&bits, 1 << 6, 7);
+	for (u32 ch = 0; ch < 4; ch++)
+	{
+		Bc_PutBits(&bits, bestQ0[ch], 7);
+		Bc_PutBits(&bits, bestQ1[ch], 7);
+	}
+	Bc_PutBits(&bits, bestP0, 1);
+	Bc_PutBits(&bits, bestP1, 1);
+	for (u32 pi = 0; pi < 16; pi++)
+		Bc_PutBits(&bits, bestIndices[pi], pi == 0 ? 3 : 4);
+	Assert(bits.pos == 128);
+	memcpy(out, bits.bytes, sizeof(bits.bytes));
+}
+
+static void Bc7_DecodeBlock(u32 block[16], const u8 in[16])
+{
+	BcBits bits = {};
+	memcpy(bits.bytes, in, sizeof(bits.bytes));
+	const u32 mode = Bc_GetBits(&bits, 7);
+	Assert(mode == 1 << 6); // Only mode 6 is ever written
+	if (mode != 1 << 6)
+	{
+		memset(block, 0, 16 * sizeof(u32));
+		return;
+	}
+
+	u32 q0[4], q1[4];
+	for (u32 ch = 0; ch < 4; ch++)
+	{
+		q0[ch] = Bc_GetBits(&bits, 7);
+		q1[ch] = Bc_GetBits(&bits, 7);
+	}
+	const u32 p0 = Bc_GetBits(&bits, 1);
+	const u32 p1 = Bc_GetBits(&bits, 1);
+
+	u32 palette[16];
+	Bc7_Palette(q0, q1, p0, p1, palette);
+	for (u32 pi = 0; pi < 16; pi++)
+		block[pi] = palette[Bc_GetBits(&bits, pi == 0 ? 3 : 4)];
+}
+
+//
+// Images
+//
+
+void Bc_Encode(Bitmap::Format format, void *blocks, const u32 *pixels, u32 width, u32 height, u32 pitch)
+{
+	Assert(Bm_IsCompressed(format) && width > 0 && height > 0);
+	const u32 blockBytes = Bm_BlockBytes(format);
+	u8 *      out        = (u8 *)blocks;
+	for (u32 by = 0; by < (height + 3) / 4; by++)
+	{
+		for (u32 bx = 0; bx < (width + 3) / 4; bx++, out += blockBytes)
+		{
+			u32 block[16];
+			Bc_GatherBlock(block, pixels, width, height, pitch, bx, by);
+			switch (format)
+			{
+			case Bitmap::BC1:
+				Bc_EncodeColorBlock(out, block, true);
+				break;
+			case Bitmap::BC3:
+				Bc_EncodeAlphaBlock(out, block);
+				Bc_EncodeColorBlock(out + 8, block, false);
+				break;
+			case Bitmap::BC7:
+				Bc7_EncodeBlock(out, block);
+				break;
+			default:
+				break;
+			}
+		}
+	}
+}
+
+void Bc_Decode(Bitmap::Format format, u32 *pixels, u32 pitch, const void *blocks, u32 width, u32 height)
+{
+	Assert(Bm_IsCompressed(format));
+	const u32 blockBytes = Bm_BlockBytes(format);
+	const u8 *in         = (const u8 *)blocks;
+	for (u32 by = 0; by < (height + 3) / 4; by++)
+	{
+		for (u32 bx = 0; bx < (width + 3) / 4; bx++, in += blockBytes)
+		{
+			u32 block[16];
+			switch (format)
+			{
+			case Bitmap::BC1:
+				Bc_DecodeColorBlock(block, in, false);
+				break;
+			case Bitmap::BC3:
+				Bc_DecodeColorBlock(block, in + 8, true);
+				Bc_DecodeAlphaBlock(block, in);
+				break;
+			case Bitmap::BC7:
+				Bc7_DecodeBlock(block, in);
+				break;
+			default:
+				break;
+			}
+			Bc_ScatterBlock(block, pixels, width, height, pitch, bx, by);
+		}
+	}
+}
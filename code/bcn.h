@@ -0,0 +1,27 @@
+#ifndef __QI_BCN_H
+
+//
+// Copyright 2017, Quantum Immortality Software and Jon Davis
+//
+// Block compression to and from the engine pixel layout. The encoders are meant for qi_pack, not for use at runtime:
+// they fit each 4x4 block along its principal axis and refine once, which is slow next to the GPU decoding it but a
+// good deal better than min / max endpoints. The decoders are for whatever can't sample blocks directly, the software
+// rasterizer and GL drivers without the format.
+//
+// BC1 uses its 3 color mode for blocks with any pixel under half alpha, which come out fully transparent; the rest
+// are opaque. BC3 is BC1 color plus an 8 bit alpha ramp. BC7 blocks are all mode 6, one RGBA ramp of 16 steps with
+// 7 bits and a shared low bit per endpoint, and that's the only mode the decoder reads.
+//
+
+#include "basictypes.h"
+#include "bitmap.h"
+
+// Encodes a width x height image into rows of blocks, Bm_LevelBytes of them. Blocks hanging off the right or bottom
+// edge repeat the last column or row. pitch is in pixels.
+void Bc_Encode(Bitmap::Format format, void *blocks, const u32 *pixels, u32 width, u32 height, u32 pitch);
+
+// Back to width x height pixels, pitch in pixels
+void Bc_Decode(Bitmap::Format format, u32 *pixels, u32 pitch, const void *blocks, u32 width, u32 height);
+
+#define __QI_BCN_H
+#endif // #ifndef __QI_BCN_H
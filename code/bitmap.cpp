@@ -6,19 +6,97 @@
 #include "util.h"
 #include "debug.h"
 #include "hwi.h"
+#include "pixelops.h"
+#include "bcn.h"
+#include "pack.h"
 
 #define STBI_ASSERT Assert
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
+#include <atomic>
+
+#define BM_MAX_PENDING_LOADS 256
+#define BM_MAX_PATH          256
+#define BM_MAX_SOURCES       512
+
+enum BitmapLoadState_e
+{
+	BM_LOAD_FREE,
+	BM_LOAD_READING,
+	BM_LOAD_DECODING,
+	BM_LOAD_DECODED,
+};
+
+// Slots stay put while their read and decode run, both hold a pointer to one
+struct BitmapLoad_s
+{
+	Bitmap *         bitmap;
+	char             fileName[BM_MAX_PATH];
+	bool             forceOpaque;
+	bool             isReload;
+	bool             failed; // Reloads only: the file changed under it, the bitmap keeps what it had
+	IoRead_t         read;
+	u8 *             fileData; // The whole file, freed once decoded
+	u64              fileSize;
+	u32 *            pixels; // Decoded into, the bitmap's own unless it's a reload over pixels still being drawn
+	std::atomic<u32> state;  // Written last by the decode job
+};
+
+// Where a bitmap was read from, so it can be read again when the file changes
+struct BitmapSource_s
+{
+	Bitmap *     bitmap; // nullptr for a free slot
+	MemoryArena *memArena;
+	char         fileName[BM_MAX_PATH];
+	bool         forceOpaque;
+	bool         ownsPixels; // Not while they're the pack's, which are read only
+};
+
+struct BitmapGlobals_s
+{
+	BitmapLoad_s loads[BM_MAX_PENDING_LOADS];
+#if !HAS(RELEASE_BUILD)
+	BitmapSource_s sources[BM_MAX_SOURCES];
+#endif
+};
+
+static BitmapGlobals_s *g_bitmaps = nullptr;
+
+static void Bm_InitSubsystem(const SubSystem *sys, bool isReinit)
+{
+	g_bitmaps = (BitmapGlobals_s *)sys->globalPtr;
+	if (!isReinit)
+		memset(g_bitmaps, 0, sys->globalSize);
+}
+
+SubSystem BitmapSubSystem = {"Bitmap", Bm_InitSubsystem, sizeof(BitmapGlobals_s), nullptr};
+
+// stb's RGBA bytes to the engine's layout
 void Bm_CreateBitmapFromBuffer(void *buffer, Bitmap *result, const u32 width, const u32 height, Bitmap::Format format, u32 flags)
 {
-	Assert(buffer && result);
+	Assert(buffer && result && !Bm_IsCompressed(format));
 	result->width    = width;
 	result->height   = height;
 	result->pitch    = width;
 	result->byteSize = width * height * sizeof(u32);
 	result->pixels   = (u32 *)buffer;
+	result->format   = Bitmap::RGBA8;
+	result->numMips  = 1;
+	result->sampling = Bitmap::SampleNearest;
+}
+
+void Bm_CreateCompressedBitmap(const void *blocks, Bitmap *result, const u32 width, const u32 height, Bitmap::Format format, u32 numMips)
+{
+	Assert(blocks && result && Bm_IsCompressed(format) && numMips >= 1 && numMips <= Bm_NumMips(width, height));
+	result->width    = width;
+	result->height   = height;
+	result->pitch    = width;
+	result->byteSize = Bm_ChainBytes(format, width, height, numMips);
+	result->pixels   = (u32 *)blocks;
+	result->format   = format;
+	result->numMips  = numMips;
+	result->sampling = Bitmap::SampleNearest;
 }
 
 void Bm_CreateBitmap(MemoryArena *arena, Bitmap *result, const u32 width, const u32 height, Bitmap::Format format, u32 flags)
@@ -28,33 +106,318 @@ void Bm_CreateBitmap(MemoryArena *arena, Bitmap *result, const u32 width, const
 	Bm_CreateBitmapFromBuffer(MA_Alloc(arena, byteSize), result, width, height, format, flags);
 }
 
+void Bm_SetSampling(Bitmap *bitmap, Bitmap::Sampling sampling)
+{
+	Assert(bitmap);
+	if (bitmap->sampling == sampling)
+		return;
+	bitmap->sampling = sampling;
+	if (bitmap->hardwareId)
+		gHwi->UpdateBitmapSampling(bitmap);
+}
+
+// Bitmaps baked into the pack are already in the engine layout, or blocks: point straight at the mapped pixels,
+// unless they have to be made opaque, and they're ready to upload without decoding. Opaque ones made from blocks
+// lose their mips, a fallback for data that shouldn't have been compressed with alpha in the first place.
+static bool Bm_ReadPackedBitmap(MemoryArena *memArena, Bitmap *result, const char *filename, bool forceOpaque)
+{
+	const PackEntry_s *packed = Pack_Find(filename, PACK_BITMAP);
+	if (packed == nullptr)
+		return false;
+
+	const u32 *          pixels = (const u32 *)Pack_Data(packed);
+	const Bitmap::Format format = (Bitmap::Format)packed->format;
+	if (Bm_IsCompressed(format) && !forceOpaque)
+	{
+		Bm_CreateCompressedBitmap(pixels, result, packed->width, packed->height, format, packed->numMips);
+	}
+	else if (Bm_IsCompressed(format))
+	{
+		Bm_CreateBitmap(memArena, result, packed->width, packed->height);
+		Bc_Decode(format, result->pixels, result->pitch, pixels, packed->width, packed->height);
+		Px_ConvertToRGBA8(result->pixels, result->pixels, packed->width * packed->height, Bitmap::RGBA8, true);
+	}
+	else if (forceOpaque)
+	{
+		Bm_CreateBitmap(memArena, result, packed->width, packed->height);
+		Px_ConvertToRGBA8(result->pixels, pixels, packed->width * packed->height, Bitmap::RGBA8, true);
+	}
+	else
+	{
+		Bm_CreateBitmapFromBuffer((void *)pixels, result, packed->width, packed->height);
+	}
+
+	gHwi->RegisterBitmap(result, false);
+	gHwi->UploadBitmap(result);
+	return true;
+}
+
+#if !HAS(RELEASE_BUILD)
+static BitmapSource_s *Bm_FindSource(const Bitmap *bitmap)
+{
+	for (u32 si = 0; si < BM_MAX_SOURCES; si++)
+		if (g_bitmaps->sources[si].bitmap == bitmap)
+			return &g_bitmaps->sources[si];
+	return nullptr;
+}
+#endif
+
+// Remembers the file and watches it for changes, see Bm_ReloadFile
+static void Bm_TrackSource(MemoryArena *memArena, Bitmap *bitmap, const char *filename, bool forceOpaque, bool ownsPixels)
+{
+#if !HAS(RELEASE_BUILD)
+	BitmapSource_s *src = Bm_FindSource(bitmap);
+	if (src == nullptr)
+		src = Bm_FindSource(nullptr);
+	if (src == nullptr || strlen(filename) >= BM_MAX_PATH)
+		return;
+
+	src->bitmap      = bitmap;
+	src->memArena    = memArena;
+	src->forceOpaque = forceOpaque;
+	src->ownsPixels  = ownsPixels;
+	strcpy(src->fileName, filename);
+	plat->WatchFile(filename);
+#endif
+}
+
+void Bm_ForgetFile(Bitmap *bitmap)
+{
+#if !HAS(RELEASE_BUILD)
+	BitmapSource_s *src = Bm_FindSource(bitmap);
+	if (src != nullptr)
+		src->bitmap = nullptr;
+#endif
+}
+
 void Bm_ReadBitmap(ThreadContext *thread, MemoryArena *memArena, Bitmap *result, const char *filename, bool forceOpaque)
 {
+	// Made opaque from the pack is a copy in the arena, otherwise it's the mapped pixels
+	if (Bm_ReadPackedBitmap(memArena, result, filename, forceOpaque))
+	{
+		Bm_TrackSource(memArena, result, filename, forceOpaque, forceOpaque);
+		return;
+	}
+
 	int wid, hgt, components;
 	// stbi_set_flip_vertically_on_load(true);
 	u8* data = stbi_load(filename, &wid, &hgt, &components, 4);
 	AssertMsg(data, "Couldn't load image: %s", filename);
 
 	Bm_CreateBitmap(memArena, result, wid, hgt);
-	u8* srcXels = (u8 *)data;
-	u32* dstXels = result->pixels;
+	Px_ConvertToRGBA8(result->pixels, data, result->byteSize / sizeof(u32), Bitmap::RGBA8, forceOpaque);
+
+	printf("Read %s: %d x %d\n", filename, result->width, result->height);
+	gHwi->RegisterBitmap(result, false);
+	gHwi->UploadBitmap(result);
+	Bm_TrackSource(memArena, result, filename, forceOpaque, true);
+
+	free(data);
+}
+
+static void Bm_DecodeJob(void *userData, u32)
+{
+	BitmapLoad_s *load   = (BitmapLoad_s *)userData;
+	Bitmap *      bitmap = load->bitmap;
+
+	// A reload can find the file mid save or a different size from the header it read first
+	int        wid, hgt, components;
+	u8 *       data    = stbi_load_from_memory(load->fileData, (int)load->fileSize, &wid, &hgt, &components, 4);
+	const bool decoded = data && (u32)wid == bitmap->width && (u32)hgt == bitmap->height;
+	AssertMsg(decoded || load->isReload, "Couldn't load image: %s", load->fileName);
+
+	if (decoded)
+		Px_ConvertToRGBA8(load->pixels, data, bitmap->byteSize / sizeof(u32), Bitmap::RGBA8, load->forceOpaque);
+	load->failed = !decoded;
+	free(data);
+	free(load->fileData);
+	load->fileData = nullptr;
+
+	load->state.store(BM_LOAD_DECODED, std::memory_order_release);
+}
 
-	for (u32 idx = 0; idx < result->byteSize / sizeof(u32); idx++)
+// On the main thread, once the file is in memory
+static void Bm_ReadDone(void *userData, IoStatus_e status, u64 bytesRead)
+{
+	BitmapLoad_s *load = (BitmapLoad_s *)userData;
+	load->read         = 0;
+	if (status != IO_DONE || bytesRead != load->fileSize)
 	{
-		u32 r   = srcXels[0];
-		u32 g   = srcXels[1];
-		u32 b   = srcXels[2];
-		u32 a   = forceOpaque ? 0xFF : srcXels[3];
+		AssertMsg(load->isReload, "Couldn't read image: %s", load->fileName);
+		free(load->fileData);
+		load->fileData = nullptr;
+		load->failed   = true;
+		load->state.store(BM_LOAD_DECODED, std::memory_order_release);
+		return;
+	}
+
+	load->state.store(BM_LOAD_DECODING, std::memory_order_relaxed);
+	plat->RunAsync(Bm_DecodeJob, load);
+}
+
+// Reads the file into pixels, which are the bitmap's size, then decodes it on a job for Bm_UpdateLoads to upload
+static void Bm_StartLoad(Bitmap *bitmap, const char *filename, u64 fileSize, u32 *pixels, bool forceOpaque, bool isReload)
+{
+	BitmapLoad_s *load = nullptr;
+	for (u32 li = 0; li < BM_MAX_PENDING_LOADS && load == nullptr; li++)
+		if (g_bitmaps->loads[li].state.load(std::memory_order_acquire) == BM_LOAD_FREE)
+			load = &g_bitmaps->loads[li];
+	AssertMsg(load, "Too many bitmap loads in flight: %s", filename);
+
+	load->bitmap      = bitmap;
+	load->forceOpaque = forceOpaque;
+	load->isReload    = isReload;
+	load->failed      = false;
+	strncpy(load->fileName, filename, sizeof(load->fileName) - 1);
+	load->fileName[sizeof(load->fileName) - 1] = 0;
+	load->pixels   = pixels;
+	load->fileSize = fileSize;
+	load->fileData = (u8 *)malloc(load->fileSize);
+	Assert(load->fileData);
+	load->state.store(BM_LOAD_READING, std::memory_order_relaxed);
 
-		dstXels[idx] = (a << 24) | (b << 16) | (g << 8) | r;
-		srcXels += 4;
+	load->read = plat->ReadFileAsync(load->fileName, load->fileData, 0, load->fileSize, Bm_ReadDone, load);
+}
+
+void Bm_ReadBitmapAsync(ThreadContext *thread, MemoryArena *memArena, Bitmap *result, const char *filename, bool forceOpaque)
+{
+	if (Bm_ReadPackedBitmap(memArena, result, filename, forceOpaque))
+	{
+		Bm_TrackSource(memArena, result, filename, forceOpaque, forceOpaque);
+		return;
 	}
 
-	printf("Read %s: %d x %d\n", filename, result->width, result->height);
+	// Only the header is read here, for the size to allocate; the rest of the file comes in while frames go on
+	int wid, hgt, components;
+	const int haveInfo = stbi_info(filename, &wid, &hgt, &components);
+	AssertMsg(haveInfo, "Couldn't load image: %s", filename);
+
+	const i64 fileSize = plat->FileSize(filename);
+	AssertMsg(fileSize > 0, "Couldn't load image: %s", filename);
+
+	Bm_CreateBitmap(memArena, result, wid, hgt);
 	gHwi->RegisterBitmap(result, false);
-	gHwi->UploadBitmap(result);
 
-	free(data);
+	printf("Reading %s: %d x %d\n", filename, result->width, result->height);
+	Bm_StartLoad(result, filename, (u64)fileSize, result->pixels, forceOpaque, false);
+	Bm_TrackSource(memArena, result, filename, forceOpaque, true);
+}
+
+void Bm_UpdateLoads()
+{
+	bool renderSynced = false;
+	for (u32 li = 0; li < BM_MAX_PENDING_LOADS; li++)
+	{
+		BitmapLoad_s *load = &g_bitmaps->loads[li];
+		if (load->state.load(std::memory_order_acquire) != BM_LOAD_DECODED)
+			continue;
+
+		Bitmap *bitmap = load->bitmap;
+		if (load->failed)
+		{
+			fprintf(stderr, "Couldn't reload image: %s\n", load->fileName);
+		}
+		else
+		{
+			if (load->pixels != bitmap->pixels)
+			{
+				// The frame being drawn may still be streaming the old pixels out of this buffer
+				if (!renderSynced)
+				{
+					plat->SyncRender();
+					renderSynced = true;
+				}
+				memcpy(bitmap->pixels, load->pixels, bitmap->byteSize);
+			}
+			gHwi->UploadBitmap(bitmap);
+		}
+
+		if (load->pixels != bitmap->pixels)
+			free(load->pixels);
+		load->pixels = nullptr;
+		load->bitmap = nullptr;
+		load->state.store(BM_LOAD_FREE, std::memory_order_relaxed);
+	}
+}
+
+void Bm_FinishLoads()
+{
+	// Finished reads queue their decodes, so wait on those first
+	for (u32 li = 0; li < BM_MAX_PENDING_LOADS; li++)
+		if (g_bitmaps->loads[li].state.load(std::memory_order_acquire) == BM_LOAD_READING)
+			plat->WaitFileRead(g_bitmaps->loads[li].read, nullptr);
+	plat->WaitAsync();
+	Bm_UpdateLoads();
+}
+
+#if !HAS(RELEASE_BUILD)
+// Hands over a load still in flight for the bitmap before another starts, so they can't finish out of order
+static void Bm_FinishLoad(const Bitmap *bitmap)
+{
+	for (u32 li = 0; li < BM_MAX_PENDING_LOADS; li++)
+	{
+		BitmapLoad_s *load = &g_bitmaps->loads[li];
+		if (load->bitmap != bitmap || load->state.load(std::memory_order_acquire) == BM_LOAD_FREE)
+			continue;
+		if (load->state.load(std::memory_order_acquire) == BM_LOAD_READING)
+			plat->WaitFileRead(load->read, nullptr);
+		plat->WaitAsync();
+		Bm_UpdateLoads();
+	}
+}
+
+// Same size over pixels of its own, the file is decoded to the side and copied in once done so draws go on from the
+// old pixels meanwhile. Anything else makes the bitmap again in its arena, leaving the old pixels there until it's
+// reset, and it doesn't draw until the new ones are up.
+static bool Bm_StartReload(BitmapSource_s *src)
+{
+	Bitmap *bitmap = src->bitmap;
+	Bm_FinishLoad(bitmap);
+
+	int       wid, hgt, components;
+	const i64 fileSize = plat->FileSize(src->fileName);
+	if (fileSize <= 0 || !stbi_info(src->fileName, &wid, &hgt, &components))
+	{
+		fprintf(stderr, "Couldn't reload image: %s\n", src->fileName);
+		return false;
+	}
+
+	const bool remade = !src->ownsPixels || bitmap->format != Bitmap::RGBA8 || (u32)wid != bitmap->width || (u32)hgt != bitmap->height;
+	u32 *      pixels;
+	if (remade)
+	{
+		const Bitmap::Sampling sampling = bitmap->sampling;
+		gHwi->UnregisterBitmap(bitmap);
+		Bm_CreateBitmap(src->memArena, bitmap, wid, hgt);
+		bitmap->sampling = sampling;
+		gHwi->RegisterBitmap(bitmap, false);
+		src->ownsPixels = true;
+		pixels          = bitmap->pixels;
+	}
+	else
+	{
+		pixels = (u32 *)malloc(bitmap->byteSize);
+		Assert(pixels);
+	}
+
+	printf("Reloading %s: %d x %d\n", src->fileName, wid, hgt);
+	Bm_StartLoad(bitmap, src->fileName, (u64)fileSize, pixels, src->forceOpaque, true);
+	return remade;
+}
+#endif
+
+bool Bm_ReloadFile(const char *fileName)
+{
+	bool remade = false;
+#if !HAS(RELEASE_BUILD)
+	for (u32 si = 0; si < BM_MAX_SOURCES; si++)
+	{
+		BitmapSource_s *src = &g_bitmaps->sources[si];
+		if (src->bitmap != nullptr && strcmp(src->fileName, fileName) == 0)
+			remade |= Bm_StartReload(src);
+	}
+#endif
+	return remade;
 }
 
 Bitmap* Bm_MakeBitmapFromFile(ThreadContext *thread, MemoryArena *memArena, const char *filename, bool forceOpaque)
@@ -25,6 +25,19 @@ struct Bitmap
 		R8,
 		RG8,
 		RGB8,
+
+		// Block compressed, 4x4 pixels a block, see bcn.h
+		BC1, // RGB plus 1 bit alpha, 8 bytes a block
+		BC3, // RGBA, 16 bytes a block
+		BC7, // RGBA, 16 bytes a block
+	};
+
+	// How draws filter it, see Bm_SetSampling
+	enum Sampling
+	{
+		SampleNearest = 0, // Texel for texel, for pixel art drawn at whole scales
+		SampleLinear,      // Bilinear from the full size
+		SampleMipmapped,   // Trilinear between mip levels, for drawing scaled down
 	};
 
 	enum FormatPixelBytes
@@ -36,16 +49,19 @@ struct Bitmap
 		PS_RGB8   = 3,
 	};
 
-	// Always 32 bit, xel order is BB GG RR 00 (LE)
+	// Always 32 bit, xel order is BB GG RR 00 (LE). Compressed bitmaps point at their blocks instead: each mip level's
+	// rows of blocks, largest level first.
 	u32 *pixels;
 
 	// Dimensions are in pixels, not bytes
-	u32    width;
-	u32    height;
-	u32    pitch;
-	u32    byteSize;
-	u32    flags;
-	Format format;
+	u32      width;
+	u32      height;
+	u32      pitch;
+	u32      byteSize;
+	u32      flags;
+	Format   format;
+	u32      numMips; // Levels in pixels, 1 for just the full size
+	Sampling sampling;
 
 	void *hardwareId;
 };
@@ -53,9 +69,81 @@ struct Bitmap
 struct ThreadContext;
 struct MemoryArena;
 
+// Bytes in each 4x4 block, 0 for formats that aren't block compressed
+static inline u32 Bm_BlockBytes(Bitmap::Format format)
+{
+	return format == Bitmap::BC1 ? 8 : (format == Bitmap::BC3 || format == Bitmap::BC7) ? 16 : 0;
+}
+
+static inline bool Bm_IsCompressed(Bitmap::Format format)
+{
+	return Bm_BlockBytes(format) != 0;
+}
+
+// Size of a dimension at a mip level, never below 1
+static inline u32 Bm_MipSize(u32 size, u32 level)
+{
+	return (size >> level) > 0 ? size >> level : 1;
+}
+
+// Levels down to 1 x 1
+static inline u32 Bm_NumMips(u32 width, u32 height)
+{
+	u32 numMips = 1;
+	while ((width | height) >> numMips)
+		numMips++;
+	return numMips;
+}
+
+// One level as it sits in pixels: whole blocks for compressed formats, otherwise the engine layout
+static inline u32 Bm_LevelBytes(Bitmap::Format format, u32 width, u32 height)
+{
+	const u32 blockBytes = Bm_BlockBytes(format);
+	if (blockBytes == 0)
+		return width * height * sizeof(u32);
+	return ((width + 3) / 4) * ((height + 3) / 4) * blockBytes;
+}
+
+static inline u32 Bm_ChainBytes(Bitmap::Format format, u32 width, u32 height, u32 numMips)
+{
+	u32 bytes = 0;
+	for (u32 level = 0; level < numMips; level++)
+		bytes += Bm_LevelBytes(format, Bm_MipSize(width, level), Bm_MipSize(height, level));
+	return bytes;
+}
+
 void Bm_ReadBitmap(ThreadContext *thread, MemoryArena *memArena, Bitmap *result, const char *filename, bool forceOpaque = false);
+
+// Only reads the image header before returning: the size is known and the bitmap registered straight away, while the
+// file is read asynchronously, decoded on the background thread and uploaded once Bm_UpdateLoads sees it finished. Draws of it do
+// nothing until gHwi->IsBitmapReady says otherwise. The bitmap and its arena have to outlive the load. Bitmaps found
+// in the pack have nothing to decode and are uploaded before it returns.
+void Bm_ReadBitmapAsync(ThreadContext *thread, MemoryArena *memArena, Bitmap *result, const char *filename, bool forceOpaque = false);
+
+// Once a frame, hands finished decodes to the hardware layer
+void Bm_UpdateLoads();
+
+// Waits for every read and decode in flight and hands them all over, for before memory they write into goes away
+void Bm_FinishLoads();
+
+// Bitmaps read from files are read again when the file changes, outside release builds. This starts that for every
+// bitmap read from the file, loose even if it came from the pack, going the same way as Bm_ReadBitmapAsync. true if
+// any had to be made again, for a new size or to stop pointing into the pack: registered anew and not drawn until
+// it's read.
+bool Bm_ReloadFile(const char *fileName);
+
+// Stops reloading the bitmap when its file changes, for before it goes away
+void Bm_ForgetFile(Bitmap *bitmap);
 Bitmap* Bm_MakeBitmapFromFile(ThreadContext *thread, MemoryArena *memArena, const char *filename, bool forceOpaque = false);
 void Bm_CreateBitmap(MemoryArena *arena, Bitmap *result, const u32 width, const u32 height, Bitmap::Format format = Bitmap::Format::RGBA8, u32 flags = 0);
 void Bm_CreateBitmapFromBuffer(void *buffer, Bitmap *result, const u32 width, const u32 height, Bitmap::Format format = Bitmap::Format::RGBA8, u32 flags = 0);
 
+// Nearest unless set otherwise, any time after the bitmap is created. Anything else takes it out of the shared texture
+// pages. Mipmapped makes the levels from the pixels on upload unless the bitmap came with them, and uploads it whole
+// rather than streaming it.
+void Bm_SetSampling(Bitmap *bitmap, Bitmap::Sampling sampling);
+
+// A bitmap over numMips levels of blocks, which stay where they are. Can't be drawn to or blitted on the CPU.
+void Bm_CreateCompressedBitmap(const void *blocks, Bitmap *result, const u32 width, const u32 height, Bitmap::Format format, u32 numMips);
+
 #endif // QI_BITMAP_H
@@ -0,0 +1,369 @@
+//
+// Copyright 2017, Quantum Immortality Software and Jon Davis
+//
+// Collision broadphase implementation
+//
+
+#include "basictypes.h"
+
+#include "game.h"
+#include "tile.h"
+#include "collision.h"
+#include "util.h"
+
+#define COL_MAX_GATHER_RECTS 256
+
+internal void
+BoundsToTileRange(const Aabb_s* bounds, TileRect_s* range)
+{
+	// Tile centers sit on integer multiples of the tile size
+	range->minX = (i32)floorf(bounds->min.x / TILE_SIZE_METERS_X + 0.5f);
+	range->minY = (i32)floorf(bounds->min.y / TILE_SIZE_METERS_Y + 0.5f);
+	range->maxX = (i32)floorf(bounds->max.x / TILE_SIZE_METERS_X + 0.5f);
+	range->maxY = (i32)floorf(bounds->max.y / TILE_SIZE_METERS_Y + 0.5f);
+}
+
+void
+Col_PrepareWorldBoxes(MemoryArena* tileArena, World_s* world, const Aabb_s* bounds)
+{
+	TileRect_s range;
+	BoundsToTileRange(bounds, &range);
+	PrepareSolidTileRects(tileArena, world, range.minX, range.minY, range.maxX, range.maxY);
+}
+
+u32
+Col_GatherWorldBoxes(MemoryArena* tileArena, World_s* world, const Aabb_s* bounds, Aabb_s* boxes, u32 maxBoxes, u32 firstBox)
+{
+	TileRect_s range;
+	BoundsToTileRange(bounds, &range);
+
+	u32 numBoxes = 0;
+	while (numBoxes < maxBoxes)
+	{
+		TileRect_s rects[COL_MAX_GATHER_RECTS];
+		const u32  wanted   = Min<u32>(maxBoxes - numBoxes, countof(rects));
+		const u32  numRects = GetSolidTileRects(tileArena, world, range.minX, range.minY, range.maxX, range.maxY, rects, wanted, firstBox + numBoxes);
+
+		for (u32 ri = 0; ri < numRects; ri++)
+		{
+			const TileRect_s* rect = &rects[ri];
+			Aabb_s*           out  = &boxes[numBoxes + ri];
+			out->min               = V2(((r32)rect->minX - 0.5f) * TILE_SIZE_METERS_X, ((r32)rect->minY - 0.5f) * TILE_SIZE_METERS_Y);
+			out->max               = V2(((r32)rect->maxX + 0.5f) * TILE_SIZE_METERS_X, ((r32)rect->maxY + 0.5f) * TILE_SIZE_METERS_Y);
+		}
+
+		numBoxes += numRects;
+		if (numRects < wanted)
+			break;
+	}
+
+	return numBoxes;
+}
+
+void
+Col_MoveBounds(const Aabb_s* box, const v2& move, Aabb_s* bounds)
+{
+	bounds->min = V2(box->min.x + Min(move.x, 0.0f), box->min.y + Min(move.y, 0.0f));
+	bounds->max = V2(box->max.x + Max(move.x, 0.0f), box->max.y + Max(move.y, 0.0f));
+}
+
+// Where the static boxes for a sweep come from: a list the caller gathered, or the world, a batch at a time
+struct ColBoxSource_s
+{
+	const Aabb_s* boxes;
+	u32           numBoxes;
+	bool          complete; // boxes is all of them, otherwise the rest come from the world after it
+
+	MemoryArena*  tileArena;
+	World_s*      world;
+	const Aabb_s* bounds;
+};
+
+internal void
+FirstHitInBoxes(GjkToiResult_s* firstHit, const Aabb_s* sweepBox, const v2& move, const Aabb_s* boxes, u32 numBoxes)
+{
+	for (u32 bi = 0; bi < numBoxes; bi++)
+	{
+		GjkToiResult_s toi;
+		if (Qi_AabbSweep(&toi, sweepBox, move, &boxes[bi]) && (!firstHit->hit || toi.time < firstHit->time))
+			*firstHit = toi;
+	}
+}
+
+internal void
+FirstHit(GjkToiResult_s* firstHit, const ColBoxSource_s* source, const Aabb_s* sweepBox, const v2& move)
+{
+	FirstHitInBoxes(firstHit, sweepBox, move, source->boxes, source->numBoxes);
+	if (source->complete)
+		return;
+
+	Aabb_s boxes[COL_WORLD_BATCH];
+	for (u32 firstBox = source->numBoxes;; firstBox += COL_WORLD_BATCH)
+	{
+		const u32 numBoxes = Col_GatherWorldBoxes(source->tileArena, source->world, source->bounds, boxes, COL_WORLD_BATCH, firstBox);
+		FirstHitInBoxes(firstHit, sweepBox, move, boxes, numBoxes);
+		if (numBoxes < COL_WORLD_BATCH)
+			break;
+	}
+}
+
+internal v2
+SweepAndSlide(const Aabb_s* box, const v2& move, const ColBoxSource_s* source, v2* velocity, u32 maxSlides)
+{
+	Aabb_s sweepBox      = *box;
+	v2     remainingMove = move;
+
+	for (u32 slide = 0; slide < maxSlides; slide++)
+	{
+		GjkToiResult_s firstHit = {};
+		firstHit.time           = 1.0f;
+		FirstHit(&firstHit, source, &sweepBox, remainingMove);
+
+		if (!firstHit.hit)
+		{
+			sweepBox.min += remainingMove;
+			sweepBox.max += remainingMove;
+			break;
+		}
+
+		const v2 step = remainingMove * firstHit.time;
+		sweepBox.min += step;
+		sweepBox.max += step;
+		remainingMove *= 1.0f - firstHit.time;
+
+		const r32 moveIntoHit = remainingMove.dot(firstHit.normal);
+		if (moveIntoHit < 0.0f)
+			remainingMove += firstHit.normal * -moveIntoHit;
+
+		if (velocity)
+		{
+			const r32 velIntoHit = velocity->dot(firstHit.normal);
+			if (velIntoHit < 0.0f)
+				*velocity += firstHit.normal * -velIntoHit;
+		}
+	}
+
+	return sweepBox.min - box->min;
+}
+
+v2
+Col_SweepAndSlide(const Aabb_s* box, const v2& move, const Aabb_s* worldBoxes, u32 numWorldBoxes, v2* velocity, u32 maxSlides)
+{
+	ColBoxSource_s source = {};
+	source.boxes          = worldBoxes;
+	source.numBoxes       = numWorldBoxes;
+	source.complete       = true;
+	return SweepAndSlide(box, move, &source, velocity, maxSlides);
+}
+
+v2
+Col_SweepAndSlideWorld(MemoryArena* tileArena, World_s* world, const Aabb_s* box, const v2& move, v2* velocity, u32 maxSlides)
+{
+	// Slides only ever take away from the move, so every box they can reach is under the bounds of the whole of it.
+	// The first batch is kept for every slide; a busy patch of world reads the rest again each time.
+	Aabb_s bounds;
+	Col_MoveBounds(box, move, &bounds);
+
+	Aabb_s         boxes[COL_WORLD_BATCH];
+	ColBoxSource_s source = {};
+	source.boxes          = boxes;
+	source.numBoxes       = Col_GatherWorldBoxes(tileArena, world, &bounds, boxes, COL_WORLD_BATCH, 0);
+	source.complete       = source.numBoxes < COL_WORLD_BATCH;
+	source.tileArena      = tileArena;
+	source.world          = world;
+	source.bounds         = &bounds;
+	return SweepAndSlide(box, move, &source, velocity, maxSlides);
+}
+
+void
+Col_InitSweepOrder(u32* order, u32 count)
+{
+	for (u32 i = 0; i < count; i++)
+		order[i] = i;
+}
+
+u32
+Col_FindOverlapPairs(const Aabb_s* boxes, u32 count, u32* order, ColPair_s* pairs, u32 maxPairs, u32 firstPair)
+{
+	// Insertion sort by min x, cheap when the order is nearly right from last frame
+	for (u32 i = 1; i < count; i++)
+	{
+		const u32 cur  = order[i];
+		const r32 curX = boxes[cur].min.x;
+		u32       j    = i;
+		while (j > 0 && boxes[order[j - 1]].min.x > curX)
+		{
+			order[j] = order[j - 1];
+			j--;
+		}
+		order[j] = cur;
+	}
+
+	u32 numPairs   = 0;
+	u32 numSkipped = 0;
+	for (u32 i = 0; i < count; i++)
+	{
+		const Aabb_s* a = &boxes[order[i]];
+		for (u32 j = i + 1; j < count; j++)
+		{
+			const Aabb_s* b = &boxes[order[j]];
+			if (b->min.x >= a->max.x)
+				break;
+
+			if (!Col_AabbsTouch(a, b))
+				continue;
+
+			if (numSkipped < firstPair)
+			{
+				numSkipped++;
+				continue;
+			}
+
+			if (numPairs == maxPairs)
+				return numPairs;
+
+			pairs[numPairs].a = Min(order[i], order[j]);
+			pairs[numPairs].b = Max(order[i], order[j]);
+			numPairs++;
+		}
+	}
+
+	return numPairs;
+}
+
+#define COL_MAX_CONTACT_PLANES 32
+#define COL_PARALLEL_DOT       0.999f
+#define COL_RESOLVE_SLOP       1.0e-5f
+
+struct ContactPlane_s
+{
+	v2  normal;
+	r32 depth;
+};
+
+// Deterministic ordering for planes of equal depth so ties do not depend on the input order
+internal bool
+PlaneIsDeeper(const ContactPlane_s* a, const ContactPlane_s* b)
+{
+	if (a->depth != b->depth)
+		return a->depth > b->depth;
+	if (a->normal.x != b->normal.x)
+		return a->normal.x > b->normal.x;
+	return a->normal.y > b->normal.y;
+}
+
+v2
+Col_ResolveContacts(const GjkResult_s* results, u32 numResults, v2* velocity)
+{
+	// Collapse pairs into one plane per normal direction, keeping the deepest. Neighbouring tiles along a wall
+	// all report the same normal so this is usually one or two planes.
+	ContactPlane_s planes[COL_MAX_CONTACT_PLANES];
+	u32            numPlanes = 0;
+
+	for (u32 ri = 0; ri < numResults; ri++)
+	{
+		const GjkResult_s* result = &results[ri];
+		if (!result->intersected || result->penetrationDepth <= 0.0f)
+			continue;
+
+		u32 pi = 0;
+		for (; pi < numPlanes; pi++)
+		{
+			if (planes[pi].normal.dot(result->penetrationNormal) > COL_PARALLEL_DOT)
+				break;
+		}
+
+		if (pi < numPlanes)
+		{
+			planes[pi].depth = Max(planes[pi].depth, result->penetrationDepth);
+		}
+		else if (numPlanes < COL_MAX_CONTACT_PLANES)
+		{
+			planes[numPlanes].normal = result->penetrationNormal;
+			planes[numPlanes].depth  = result->penetrationDepth;
+			numPlanes++;
+		}
+	}
+
+	if (numPlanes == 0)
+		return V2(0.0f, 0.0f);
+
+	u32 deepest = 0;
+	for (u32 pi = 1; pi < numPlanes; pi++)
+	{
+		if (PlaneIsDeeper(&planes[pi], &planes[deepest]))
+			deepest = pi;
+	}
+
+	const ContactPlane_s* first      = &planes[deepest];
+	v2                    correction = first->normal * first->depth;
+
+	// In 2D two planes pin down a corner, so fix the worst plane still violated and solve for both exactly
+	const ContactPlane_s* second       = nullptr;
+	r32                   worstOverlap = COL_RESOLVE_SLOP;
+	for (u32 pi = 0; pi < numPlanes; pi++)
+	{
+		const r32 overlap = planes[pi].depth - correction.dot(planes[pi].normal);
+		if (pi != deepest && (overlap > worstOverlap || (second && overlap == worstOverlap && PlaneIsDeeper(&planes[pi], second))))
+		{
+			worstOverlap = overlap;
+			second       = &planes[pi];
+		}
+	}
+
+	if (second)
+	{
+		const v2  n1  = first->normal;
+		const v2  n2  = second->normal;
+		const r32 det = n1.x * n2.y - n1.y * n2.x;
+		if (fabsf(det) < Q_R32_EPSILON)
+		{
+			// Squeezed between opposing planes, split the difference
+			correction = n1 * first->depth + n2 * second->depth;
+		}
+		else
+		{
+			correction.x = (first->depth * n2.y - second->depth * n1.y) / det;
+			correction.y = (n1.x * second->depth - n2.x * first->depth) / det;
+		}
+	}
+
+	if (velocity)
+	{
+		for (u32 pi = 0; pi < numPlanes; pi++)
+		{
+			const r32 intoPlane = velocity->dot(planes[pi].normal);
+			if (intoPlane < 0.0f)
+				*velocity += planes[pi].normal * -intoPlane;
+		}
+	}
+
+	return correction;
+}
+
+void
+Col_AddAxisContact(ColAxisContacts_s* contacts, const v2& normal, r32 depth)
+{
+	u32 dir;
+	if (fabsf(normal.x) >= fabsf(normal.y))
+		dir = normal.x < 0.0f ? 0 : 1;
+	else
+		dir = normal.y < 0.0f ? 2 : 3;
+
+	contacts->depth[dir] = Max(contacts->depth[dir], depth);
+}
+
+v2
+Col_ResolveAxisContacts(const ColAxisContacts_s* contacts, v2* velocity)
+{
+	GjkResult_s results[COL_AXIS_DIRS];
+	for (u32 dir = 0; dir < COL_AXIS_DIRS; dir++)
+	{
+		const r32 sign                 = (dir & 1) ? 1.0f : -1.0f;
+		results[dir].penetrationNormal = dir < 2 ? V2(sign, 0.0f) : V2(0.0f, sign);
+		results[dir].penetrationDepth  = contacts->depth[dir];
+		results[dir].intersected       = contacts->depth[dir] > 0.0f;
+	}
+
+	return Col_ResolveContacts(results, countof(results), velocity);
+}
@@ -0,0 +1,71 @@
+#ifndef __QI_COLLISION_H
+
+//
+// Copyright 2017, Quantum Immortality Software and Jon Davis
+//
+// Collision broadphase: cached tile rects for the static world, sort and sweep for moving things
+//
+
+#include "gjk.h"
+
+struct World_s;
+struct MemoryArena;
+
+// Merged solid tile rects overlapping bounds (meters), converted to boxes in meters. Pass a null tileArena from
+// worker threads, after Col_PrepareWorldBoxes has been run on the main thread for the same bounds. The first
+// firstBox are skipped, so a busy area can be read in batches; fewer than maxBoxes back means that was the last.
+u32  Col_GatherWorldBoxes(MemoryArena* tileArena, World_s* world, const Aabb_s* bounds, Aabb_s* boxes, u32 maxBoxes, u32 firstBox);
+void Col_PrepareWorldBoxes(MemoryArena* tileArena, World_s* world, const Aabb_s* bounds);
+
+// Bounds of box over the whole of move, what to gather or prepare for a sweep
+void Col_MoveBounds(const Aabb_s* box, const v2& move, Aabb_s* bounds);
+
+// Moves box by move through the static boxes, stopping at each first hit and sliding the rest of the move along
+// it, up to maxSlides times. One sweep per box per slide, so fast moves can't tunnel. Returns the displacement
+// actually made; velocity, if given, loses its component into every surface hit.
+v2 Col_SweepAndSlide(const Aabb_s* box, const v2& move, const Aabb_s* worldBoxes, u32 numWorldBoxes, v2* velocity, u32 maxSlides);
+
+// Col_SweepAndSlide against the world boxes under the move bounds, gathered COL_WORLD_BATCH at a time so there's no
+// cap on how many there can be. Same tileArena rules as Col_GatherWorldBoxes.
+#define COL_WORLD_BATCH 64
+v2 Col_SweepAndSlideWorld(MemoryArena* tileArena, World_s* world, const Aabb_s* box, const v2& move, v2* velocity, u32 maxSlides);
+
+struct ColPair_s
+{
+	u32 a;
+	u32 b;
+};
+
+// Sort and sweep on x. The order array is kept by the caller between calls so the insertion sort only has to fix
+// up what moved since last time; fill it with Col_InitSweepOrder when the box count changes. Pairs come out in a
+// fixed order for the same boxes, and the first firstPair are skipped, so a crowd can be read in batches the same
+// way as Col_GatherWorldBoxes.
+void Col_InitSweepOrder(u32* order, u32 count);
+u32  Col_FindOverlapPairs(const Aabb_s* boxes, u32 count, u32* order, ColPair_s* pairs, u32 maxPairs, u32 firstPair);
+
+// One pass resolve for a body against every pair it was tested in this step, all tested at the same position.
+// Returns the offset to apply to the body and removes velocity into the contacts. The result depends only on the
+// set of contacts, not the order they were found in.
+v2 Col_ResolveContacts(const GjkResult_s* results, u32 numResults, v2* velocity);
+
+// Box against box overlaps only ever push along the four axis directions, and Col_ResolveContacts only keeps the
+// deepest push per direction, so a body's overlaps can be folded into one of these as they're found, in batches or
+// from many pairs, and resolved together at the end with the same result.
+#define COL_AXIS_DIRS 4
+
+struct ColAxisContacts_s
+{
+	r32 depth[COL_AXIS_DIRS]; // -x, +x, -y, +y
+};
+
+void Col_AddAxisContact(ColAxisContacts_s* contacts, const v2& normal, r32 depth);
+v2   Col_ResolveAxisContacts(const ColAxisContacts_s* contacts, v2* velocity);
+
+inline bool
+Col_AabbsTouch(const Aabb_s* a, const Aabb_s* b)
+{
+	return a->min.x < b->max.x && b->min.x < a->max.x && a->min.y < b->max.y && b->min.y < a->max.y;
+}
+
+#define __QI_COLLISION_H
+#endif // #ifndef __QI_COLLISION_H
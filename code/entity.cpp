@@ -7,8 +7,430 @@
 #include "basictypes.h"
 
 #include "game.h"
+#include "deque.h"
 #include "entity.h"
 
+// Freed indices wait in the queue until at least this many are free, so a stale handle has to survive a lot of churn
+// before its index (and eventually its 8 bit generation) comes round again
 #define MIN_FREE_ENTS 4096
 
+#define QI_ENT_NO_ARCHETYPE 0xFFFF
+#define QI_ENT_MAX_WORK     (QI_ENT_MAX_CHUNKS * 8)
 
+static const u32 s_compSizes[ENT_COMP_COUNT] = {
+	sizeof(TransformComp_s),
+	sizeof(VelocityComp_s),
+	sizeof(ColliderComp_s),
+	sizeof(SpriteComp_s),
+	sizeof(WanderComp_s),
+};
+
+struct EntRecord_s
+{
+	u16 archIdx; // QI_ENT_NO_ARCHETYPE when the index is free
+	u16 chunkIdx;
+	u16 row;
+	u8  generation;
+	u8  __pad;
+};
+
+// data starts with the Ent array, then one 16 byte aligned array per component in the archetype
+struct EntChunk_s
+{
+	u32 count;
+	u32 archIdx;
+	u32 __pad[2];
+	u8  data[QI_ENT_CHUNK_SIZE - 16];
+};
+
+struct EntArchetype_s
+{
+	u32 mask;
+	u32 capacity;                    // Entities per chunk
+	u32 compOffsets[ENT_COMP_COUNT]; // Offset of each component array in chunk data, 0 if not in the archetype
+	u32 numChunks;                   // Every chunk but the last is full
+	u16 chunks[QI_ENT_MAX_CHUNKS];
+};
+
+struct EntWork_s
+{
+	const EntSystem_s* system;
+	u32                chunkIdx;
+};
+
+struct EntGlobals_s
+{
+	EntChunk_s              chunks[QI_ENT_MAX_CHUNKS];
+	u16                     freeChunks[QI_ENT_MAX_CHUNKS];
+	u32                     numFreeChunks;
+
+	EntArchetype_s          archetypes[QI_ENT_MAX_ARCHETYPES];
+	u32                     numArchetypes;
+
+	EntRecord_s             records[QI_MAX_ENTS];
+	Deque<u32, QI_MAX_ENTS> freeIndices;
+	u32                     numFree;
+	u32                     numIndicesUsed; // Indices below this have been handed out at least once
+	u32                     numAlive;
+
+	EntWork_s               work[QI_ENT_MAX_WORK];
+	r32                     workDT;
+	bool                    inSystems;
+};
+
+static EntGlobals_s* g_ents = nullptr;
+
+static void Ent_InitSubsystem(const SubSystem* sys, bool isReinit)
+{
+	g_ents = (EntGlobals_s*)sys->globalPtr;
+	if (!isReinit)
+	{
+		memset(g_ents, 0, sys->globalSize);
+		g_ents->freeIndices.Init();
+
+		// Hand out low chunks first
+		for (u32 ci = 0; ci < QI_ENT_MAX_CHUNKS; ci++)
+			g_ents->freeChunks[ci] = (u16)(QI_ENT_MAX_CHUNKS - 1 - ci);
+		g_ents->numFreeChunks = QI_ENT_MAX_CHUNKS;
+	}
+}
+
+SubSystem EntitySubSystem = {"Entity", Ent_InitSubsystem, sizeof(EntGlobals_s), nullptr};
+
+internal u32 AlignUp16(u32 val)
+{
+	return (val + 15) & ~15u;
+}
+
+internal u32 FindOrMakeArchetype(u32 mask)
+{
+	for (u32 ai = 0; ai < g_ents->numArchetypes; ai++)
+	{
+		if (g_ents->archetypes[ai].mask == mask)
+			return ai;
+	}
+
+	Assert(g_ents->numArchetypes < QI_ENT_MAX_ARCHETYPES);
+	const u32       archIdx = g_ents->numArchetypes++;
+	EntArchetype_s* arch    = &g_ents->archetypes[archIdx];
+	memset(arch, 0, sizeof(*arch));
+	arch->mask = mask;
+
+	// Leave room for each array to be padded out to 16 bytes
+	u32 bytesPerEnt = sizeof(Ent);
+	u32 numComps    = 0;
+	for (u32 ci = 0; ci < ENT_COMP_COUNT; ci++)
+	{
+		if (mask & ENT_COMP_BIT(ci))
+		{
+			bytesPerEnt += s_compSizes[ci];
+			numComps++;
+		}
+	}
+	arch->capacity = (u32)(sizeof(((EntChunk_s*)nullptr)->data) - 16 * (numComps + 1)) / bytesPerEnt;
+
+	u32 offset = AlignUp16(arch->capacity * sizeof(Ent));
+	for (u32 ci = 0; ci < ENT_COMP_COUNT; ci++)
+	{
+		if (mask & ENT_COMP_BIT(ci))
+		{
+			arch->compOffsets[ci] = offset;
+			offset                = AlignUp16(offset + arch->capacity * s_compSizes[ci]);
+		}
+	}
+	Assert(offset <= sizeof(((EntChunk_s*)nullptr)->data));
+
+	return archIdx;
+}
+
+internal inline Ent* ChunkEnts(EntChunk_s* chunk)
+{
+	return (Ent*)chunk->data;
+}
+
+internal inline u8* ChunkComp(EntChunk_s* chunk, const EntArchetype_s* arch, u32 compId, u32 row)
+{
+	Assert(arch->compOffsets[compId] != 0);
+	return chunk->data + arch->compOffsets[compId] + row * s_compSizes[compId];
+}
+
+// Appends ent to the archetype with all of its components zeroed
+internal void PushRow(u32 archIdx, Ent ent)
+{
+	EntArchetype_s* arch = &g_ents->archetypes[archIdx];
+
+	u32 chunkIdx;
+	if (arch->numChunks > 0 && g_ents->chunks[arch->chunks[arch->numChunks - 1]].count < arch->capacity)
+	{
+		chunkIdx = arch->chunks[arch->numChunks - 1];
+	}
+	else
+	{
+		Assert(g_ents->numFreeChunks > 0);
+		chunkIdx                         = g_ents->freeChunks[--g_ents->numFreeChunks];
+		arch->chunks[arch->numChunks++] = (u16)chunkIdx;
+		g_ents->chunks[chunkIdx].count   = 0;
+		g_ents->chunks[chunkIdx].archIdx = archIdx;
+	}
+
+	EntChunk_s* chunk = &g_ents->chunks[chunkIdx];
+	const u32   row   = chunk->count++;
+	ChunkEnts(chunk)[row] = ent;
+	for (u32 ci = 0; ci < ENT_COMP_COUNT; ci++)
+	{
+		if (arch->mask & ENT_COMP_BIT(ci))
+			memset(ChunkComp(chunk, arch, ci, row), 0, s_compSizes[ci]);
+	}
+
+	EntRecord_s* rec = &g_ents->records[ent.index()];
+	rec->archIdx     = (u16)archIdx;
+	rec->chunkIdx    = (u16)chunkIdx;
+	rec->row         = (u16)row;
+}
+
+// Fills the hole at (chunkIdx, row) with the archetype's last entity so its chunks stay packed
+internal void RemoveRow(u32 archIdx, u32 chunkIdx, u32 row)
+{
+	EntArchetype_s* arch         = &g_ents->archetypes[archIdx];
+	const u32       lastChunkIdx = arch->chunks[arch->numChunks - 1];
+	EntChunk_s*     lastChunk    = &g_ents->chunks[lastChunkIdx];
+	const u32       lastRow      = --lastChunk->count;
+
+	if (chunkIdx != lastChunkIdx || row != lastRow)
+	{
+		EntChunk_s* chunk     = &g_ents->chunks[chunkIdx];
+		const Ent   moved     = ChunkEnts(lastChunk)[lastRow];
+		ChunkEnts(chunk)[row] = moved;
+		for (u32 ci = 0; ci < ENT_COMP_COUNT; ci++)
+		{
+			if (arch->mask & ENT_COMP_BIT(ci))
+				memcpy(ChunkComp(chunk, arch, ci, row), ChunkComp(lastChunk, arch, ci, lastRow), s_compSizes[ci]);
+		}
+
+		EntRecord_s* movedRec = &g_ents->records[moved.index()];
+		movedRec->chunkIdx    = (u16)chunkIdx;
+		movedRec->row         = (u16)row;
+	}
+
+	if (lastChunk->count == 0)
+	{
+		arch->numChunks--;
+		g_ents->freeChunks[g_ents->numFreeChunks++] = (u16)lastChunkIdx;
+	}
+}
+
+// Moves ent to the archetype for newMask, carrying over the components both have
+internal void ChangeArchetype(Ent ent, u32 newMask)
+{
+	EntRecord_s*          rec         = &g_ents->records[ent.index()];
+	const u32             oldArchIdx  = rec->archIdx;
+	const u32             oldChunkIdx = rec->chunkIdx;
+	const u32             oldRow      = rec->row;
+	const EntArchetype_s* oldArch     = &g_ents->archetypes[oldArchIdx];
+
+	const u32 newArchIdx = FindOrMakeArchetype(newMask);
+	PushRow(newArchIdx, ent);
+
+	const EntArchetype_s* newArch  = &g_ents->archetypes[newArchIdx];
+	EntChunk_s*           oldChunk = &g_ents->chunks[oldChunkIdx];
+	EntChunk_s*           newChunk = &g_ents->chunks[rec->chunkIdx];
+	const u32             shared   = oldArch->mask & newMask;
+	for (u32 ci = 0; ci < ENT_COMP_COUNT; ci++)
+	{
+		if (shared & ENT_COMP_BIT(ci))
+			memcpy(ChunkComp(newChunk, newArch, ci, rec->row), ChunkComp(oldChunk, oldArch, ci, oldRow), s_compSizes[ci]);
+	}
+
+	RemoveRow(oldArchIdx, oldChunkIdx, oldRow);
+}
+
+bool EntManager::isAlive(const Ent ent)
+{
+	const u32 index = ent.index();
+	if (index >= g_ents->numIndicesUsed)
+		return false;
+
+	const EntRecord_s* rec = &g_ents->records[index];
+	return rec->archIdx != QI_ENT_NO_ARCHETYPE && rec->generation == ent.generation();
+}
+
+Ent EntManager::create(u32 compMask)
+{
+	Assert(!g_ents->inSystems);
+
+	u32 index;
+	if (g_ents->numFree > MIN_FREE_ENTS || (g_ents->numIndicesUsed == QI_MAX_ENTS && g_ents->numFree > 0))
+	{
+		index = g_ents->freeIndices.PopF();
+		g_ents->numFree--;
+	}
+	else
+	{
+		Assert(g_ents->numIndicesUsed < QI_MAX_ENTS);
+		index = g_ents->numIndicesUsed++;
+	}
+
+	const Ent ent = Ent::make(index, g_ents->records[index].generation);
+	PushRow(FindOrMakeArchetype(compMask), ent);
+
+	g_ents->numAlive++;
+	return ent;
+}
+
+void EntManager::destroy(Ent ent)
+{
+	Assert(!g_ents->inSystems);
+	if (!isAlive(ent))
+		return;
+
+	EntRecord_s* rec = &g_ents->records[ent.index()];
+	RemoveRow(rec->archIdx, rec->chunkIdx, rec->row);
+
+	rec->archIdx    = QI_ENT_NO_ARCHETYPE;
+	rec->generation = (u8)(rec->generation + 1);
+	g_ents->freeIndices.PushR(ent.index());
+	g_ents->numFree++;
+	g_ents->numAlive--;
+}
+
+u32 EntManager::numAlive()
+{
+	return g_ents->numAlive;
+}
+
+void* EntManager::getComp(Ent ent, u32 compId)
+{
+	if (!isAlive(ent))
+		return nullptr;
+
+	const EntRecord_s*    rec  = &g_ents->records[ent.index()];
+	const EntArchetype_s* arch = &g_ents->archetypes[rec->archIdx];
+	if (!(arch->mask & ENT_COMP_BIT(compId)))
+		return nullptr;
+
+	return ChunkComp(&g_ents->chunks[rec->chunkIdx], arch, compId, rec->row);
+}
+
+void* EntManager::addComp(Ent ent, u32 compId)
+{
+	Assert(!g_ents->inSystems);
+	Assert(isAlive(ent));
+
+	const EntRecord_s* rec  = &g_ents->records[ent.index()];
+	const u32          mask = g_ents->archetypes[rec->archIdx].mask;
+	if (!(mask & ENT_COMP_BIT(compId)))
+		ChangeArchetype(ent, mask | ENT_COMP_BIT(compId));
+
+	return getComp(ent, compId);
+}
+
+void EntManager::removeComp(Ent ent, u32 compId)
+{
+	Assert(!g_ents->inSystems);
+	if (!isAlive(ent))
+		return;
+
+	const EntRecord_s* rec  = &g_ents->records[ent.index()];
+	const u32          mask = g_ents->archetypes[rec->archIdx].mask;
+	if (mask & ENT_COMP_BIT(compId))
+		ChangeArchetype(ent, mask & ~ENT_COMP_BIT(compId));
+}
+
+internal void MakeSpan(u32 chunkIdx, EntSpan_s* span)
+{
+	EntChunk_s*           chunk = &g_ents->chunks[chunkIdx];
+	const EntArchetype_s* arch  = &g_ents->archetypes[chunk->archIdx];
+
+	span->ents  = ChunkEnts(chunk);
+	span->count = chunk->count;
+	for (u32 ci = 0; ci < ENT_COMP_COUNT; ci++)
+		span->comps[ci] = (arch->mask & ENT_COMP_BIT(ci)) ? chunk->data + arch->compOffsets[ci] : nullptr;
+}
+
+internal bool ArchetypeMatches(const EntArchetype_s* arch, u32 all, u32 none)
+{
+	return (arch->mask & all) == all && (arch->mask & none) == 0 && arch->numChunks > 0;
+}
+
+u32 Ent_Query(const EntQuery_s* query, EntSpan_s* spans, u32 maxSpans)
+{
+	u32 numSpans = 0;
+	for (u32 ai = 0; ai < g_ents->numArchetypes; ai++)
+	{
+		const EntArchetype_s* arch = &g_ents->archetypes[ai];
+		if (!ArchetypeMatches(arch, query->all, query->none))
+			continue;
+
+		for (u32 ci = 0; ci < arch->numChunks && numSpans < maxSpans; ci++)
+			MakeSpan(arch->chunks[ci], &spans[numSpans++]);
+	}
+	return numSpans;
+}
+
+internal void EntSystemJob(void*, u32 jobIdx)
+{
+	const EntWork_s* work = &g_ents->work[jobIdx];
+
+	EntSpan_s span;
+	MakeSpan(work->chunkIdx, &span);
+	work->system->func(&span, g_ents->workDT);
+}
+
+void Ent_RunSystems(const EntSystem_s* systems, u32 numSystems, r32 dT)
+{
+	Assert(!g_ents->inSystems);
+	g_ents->inSystems = true;
+	g_ents->workDT    = dT;
+
+	u32 first = 0;
+	while (first < numSystems)
+	{
+		// Grow the phase until the next system would race one already in it
+		u32 phaseReads  = 0;
+		u32 phaseWrites = 0;
+		u32 end         = first;
+		for (; end < numSystems; end++)
+		{
+			const EntSystem_s* sys = &systems[end];
+			if ((sys->writes & (phaseReads | phaseWrites)) || (sys->reads & phaseWrites))
+				break;
+			phaseReads |= sys->reads;
+			phaseWrites |= sys->writes;
+		}
+
+		u32 numWork = 0;
+		for (u32 si = first; si < end; si++)
+		{
+			const EntSystem_s* sys = &systems[si];
+			const u32          all = sys->reads | sys->writes;
+			for (u32 ai = 0; ai < g_ents->numArchetypes; ai++)
+			{
+				const EntArchetype_s* arch = &g_ents->archetypes[ai];
+				if (!ArchetypeMatches(arch, all, sys->exclude))
+					continue;
+
+				for (u32 ci = 0; ci < arch->numChunks; ci++)
+				{
+					Assert(numWork < QI_ENT_MAX_WORK);
+					g_ents->work[numWork].system   = sys;
+					g_ents->work[numWork].chunkIdx = arch->chunks[ci];
+					numWork++;
+				}
+			}
+		}
+
+		plat->ParallelFor(EntSystemJob, nullptr, numWork);
+		first = end;
+	}
+
+	g_ents->inSystems = false;
+}
+
+void Ent_Integrate(const EntSpan_s* span, r32 dT)
+{
+	TransformComp_s*      xforms = span->Get<TransformComp_s>();
+	const VelocityComp_s* vels   = span->Get<VelocityComp_s>();
+
+	for (u32 ei = 0; ei < span->count; ei++)
+		xforms[ei].pos += vels[ei].vel * dT;
+}
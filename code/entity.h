@@ -5,8 +5,14 @@
 //
 // Basic entity and entity manager defs
 //
+// Entities are stored by archetype: every entity with the same set of components lives in the same table, split
+// into fixed size chunks. Inside a chunk each component is its own packed array, so a system walking Transform +
+// Velocity touches two linear streams and nothing else.
+//
 
 #include "basictypes.h"
+#include "math_util.h"
+#include "debug.h"
 
 #define QI_ENT_INDEX_BITS 24
 #define QI_ENT_INDEX_MASK ((1 << (u32)QI_ENT_INDEX_BITS) - 1)
@@ -14,19 +20,143 @@
 #define QI_ENT_GENERATION_BITS 8
 #define QI_ENT_GENERATION_MASK (((1 << (u32)QI_ENT_GENERATION_BITS) - 1) << QI_ENT_INDEX_BITS)
 
+#define QI_MAX_ENTS 65536
+static_assert(QI_MAX_ENTS <= QI_ENT_INDEX_MASK, "Entity index doesn't fit in its bits");
+
+#define QI_ENT_CHUNK_SIZE      (16 * 1024)
+#define QI_ENT_MAX_CHUNKS      512
+#define QI_ENT_MAX_ARCHETYPES  64
+
 struct Ent
 {
 	u32 code;
-	u32 index() { return (code & QI_ENT_INDEX_MASK); }
-    u32 generation() { return code >> QI_ENT_INDEX_BITS; }
+	u32 index() const { return (code & QI_ENT_INDEX_MASK); }
+    u32 generation() const { return code >> QI_ENT_INDEX_BITS; }
+
+	static Ent make(u32 index, u32 generation) { return Ent{(generation << QI_ENT_INDEX_BITS) | (index & QI_ENT_INDEX_MASK)}; }
+	static Ent null() { return Ent{0xFFFFFFFF}; }
+};
+
+inline bool operator==(const Ent a, const Ent b) { return a.code == b.code; }
+inline bool operator!=(const Ent a, const Ent b) { return a.code != b.code; }
+
+// Components. kCompId ties each type to its bit in an archetype mask.
+enum EntComp_e
+{
+	ENT_COMP_TRANSFORM,
+	ENT_COMP_VELOCITY,
+	ENT_COMP_COLLIDER,
+	ENT_COMP_SPRITE,
+	ENT_COMP_WANDER,
+
+	ENT_COMP_COUNT
+};
+
+#define ENT_COMP_BIT(id) (1u << (u32)(id))
+
+struct TransformComp_s
+{
+	enum { kCompId = ENT_COMP_TRANSFORM };
+	v2 pos;     // Meters
+	v2 prevPos; // pos a fixed step ago, to draw in between
+};
+
+struct VelocityComp_s
+{
+	enum { kCompId = ENT_COMP_VELOCITY };
+	v2 vel; // Meters / sec
+};
+
+struct ColliderComp_s
+{
+	enum { kCompId = ENT_COMP_COLLIDER };
+	v2 radii; // Box half extents around the transform pos
+};
+
+struct SpriteComp_s
+{
+	enum { kCompId = ENT_COMP_SPRITE };
+	u16 atlasIdx;
+	u16 spriteIdx;
+	u16 frame;
+	u16 flags;
 };
 
+struct WanderComp_s
+{
+	enum { kCompId = ENT_COMP_WANDER };
+	u32 seed; // Picks every heading, so replays wander the same way
+};
+
+// A run of entities sharing one chunk. comps[id] is null for components the archetype doesn't have.
+struct EntSpan_s
+{
+	Ent*  ents;
+	void* comps[ENT_COMP_COUNT];
+	u32   count;
+
+	template<typename T>
+	T* Get() const { return (T*)comps[T::kCompId]; }
+};
+
+// Matches archetypes holding every component in all and none of those in none
+struct EntQuery_s
+{
+	u32 all;
+	u32 none;
+};
+
+// Structural changes (create / destroy / add / remove) move entities between chunks, so they invalidate spans and
+// are not allowed while systems are running.
 struct EntManager
 {
     static bool isAlive(const Ent ent);
-    static Ent create();
+    static Ent create(u32 compMask = 0); // Components start zeroed
     static void destroy(Ent ent);
+	static u32 numAlive();
+
+	// By component id, for code that doesn't know the type; add returns the existing component if there is one
+	static void* getComp(Ent ent, u32 compId);
+	static void* addComp(Ent ent, u32 compId);
+	static void  removeComp(Ent ent, u32 compId);
+
+	template<typename T>
+	static T* get(Ent ent) { return (T*)getComp(ent, T::kCompId); }
+
+	template<typename T>
+	static T* add(Ent ent, const T& value)
+	{
+		T* comp = (T*)addComp(ent, T::kCompId);
+		*comp   = value;
+		return comp;
+	}
+
+	template<typename T>
+	static void remove(Ent ent) { removeComp(ent, T::kCompId); }
+};
+
+// Fills spans with every non empty chunk matching query, returns the number written
+u32 Ent_Query(const EntQuery_s* query, EntSpan_s* spans, u32 maxSpans);
+
+// Systems run once per matching chunk, possibly on several threads at once, and must only touch the components
+// they declare. Entities matched are those with all of reads | writes and none of exclude.
+typedef void EntSystem_f(const EntSpan_s* span, r32 dT);
+
+struct EntSystem_s
+{
+	const char*  name;
+	EntSystem_f* func;
+	u32          reads;
+	u32          writes;
+	u32          exclude;
 };
 
+// Runs systems in list order as far as results go: consecutive systems whose writes don't overlap anything the
+// others read or write share a phase, and every chunk of every system in a phase goes to the job pool together.
+void Ent_RunSystems(const EntSystem_s* systems, u32 numSystems, r32 dT);
+
+// pos += vel * dT
+void Ent_Integrate(const EntSpan_s* span, r32 dT);
+
 #define __QI_ENT_H
 #endif // #ifndef __QI_ENT_H
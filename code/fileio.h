@@ -0,0 +1,54 @@
+#ifndef __QI_FILEIO_H
+
+//
+// Copyright 2017, Quantum Immortality Software and Jon Davis
+//
+// Asynchronous file reads. Lives in the platform layer next to the job pool; the game gets at it through
+// PlatFuncs_s. Reads go straight into a buffer the caller owns, a range of the file at a time. On Linux they are
+// submitted to io_uring, elsewhere (or when the kernel won't give us a ring) a few I/O threads do blocking reads.
+//
+// Everything here is called from the main thread only. Completion callbacks are run there too, from Io_Update or
+// Io_Wait, never from an I/O thread, so they are free to touch game state or queue more work.
+//
+
+#include "basictypes.h"
+
+#define IO_MAX_PENDING_READS 256
+
+// Names a read in flight. 0 is never a valid handle.
+typedef u32 IoRead_t;
+
+enum IoStatus_e
+{
+	IO_PENDING,
+	IO_DONE,   // bytesRead can be short of the size asked for when the range ran past the end of the file
+	IO_FAILED, // Couldn't open or read the file
+};
+
+typedef void IoDone_f(void *userData, IoStatus_e status, u64 bytesRead);
+
+void Io_Init();
+void Io_Shutdown();
+
+// Bytes in the file, or -1 if it can't be opened
+i64 Io_FileSize(const char *fileName);
+
+// Queues a read of size bytes from offset into buffer, which has to stay put until the read has finished. A full
+// queue holds the caller up until a read finishes. With a done callback the handle is released once that has run;
+// without one it's released by the Io_Poll or Io_Wait that sees the read finish.
+IoRead_t Io_Read(const char *fileName, void *buffer, u64 offset, u64 size, IoDone_f *done, void *userData);
+
+// IO_PENDING until the read has finished, without blocking
+IoStatus_e Io_Poll(IoRead_t read, u64 *bytesRead);
+
+// Blocks until the read has finished, running its callback if it has one
+IoStatus_e Io_Wait(IoRead_t read, u64 *bytesRead);
+
+// Blocks until every read queued so far has finished and had its callback run
+void Io_WaitAll();
+
+// Once a frame: runs the callbacks of reads that finished since last time
+void Io_Update();
+
+#define __QI_FILEIO_H
+#endif // #ifndef __QI_FILEIO_H
@@ -0,0 +1,526 @@
+//
+// Copyright 2017, Quantum Immortality Software and Jon Davis
+//
+// SDL implementation of the async file reads, with an io_uring backend on Linux
+//
+
+#include "basictypes.h"
+
+#include "debug.h"
+#include "fileio.h"
+
+#include "SDL.h"
+#include "SDL_atomic.h"
+#include "SDL_rwops.h"
+#include "SDL_thread.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if HAS(IO_URING)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define IO_MAX_PATH    256
+#define IO_NUM_THREADS 2
+#define IO_MAX_CHUNK   (1u << 30) // Most handed to the OS in one read
+
+static_assert(IO_MAX_PENDING_READS <= 256, "Handles keep the slot in their low 8 bits");
+
+enum IoSlotState_e
+{
+	IO_SLOT_FREE,
+	IO_SLOT_QUEUED,
+	IO_SLOT_FINISHED,
+};
+
+struct IoRequest_s
+{
+	SDL_atomic_t state; // Set to finished last, by whichever thread did the read
+	u32          generation;
+	char         fileName[IO_MAX_PATH];
+	u8 *         buffer;
+	u64          offset;
+	u64          size;
+	u64          bytesRead;
+	IoStatus_e   status;
+	IoDone_f *   done;
+	void *       userData;
+	int          fd; // io_uring only
+};
+
+#if HAS(IO_URING)
+// The kernel's rings, mapped
+struct IoRing_s
+{
+	int            fd;
+	u32 *          sqHead;
+	u32 *          sqTail;
+	u32 *          sqMask;
+	u32 *          sqArray;
+	io_uring_sqe * sqes;
+	u32 *          cqHead;
+	u32 *          cqTail;
+	u32 *          cqMask;
+	io_uring_cqe * cqes;
+	void *         sqMap;
+	void *         cqMap;
+	size_t         sqMapSize;
+	size_t         cqMapSize;
+	size_t         sqesSize;
+};
+#endif
+
+struct IoGlobals_s
+{
+	IoRequest_s requests[IO_MAX_PENDING_READS];
+	u32         nextGeneration;
+
+#if HAS(IO_URING)
+	bool     useRing;
+	IoRing_s ring;
+#endif
+
+	// Thread pool fallback. Slots are queued by index, any thread takes the next.
+	SDL_Thread * threads[IO_NUM_THREADS];
+	u32          numThreads;
+	SDL_mutex *  queueLock;
+	SDL_cond *   queueChanged;
+	u32          queue[IO_MAX_PENDING_READS];
+	u32          queueHead;
+	u32          queueCount;
+	bool         quit;
+	SDL_sem *    finished; // Posted once per finished read, for the main thread to sleep on
+};
+
+static IoGlobals_s s_io;
+
+static inline u64 Io_Min(u64 a, u64 b)
+{
+	return a < b ? a : b;
+}
+
+static void Io_Finished(IoRequest_s *req, IoStatus_e status)
+{
+	req->status = status;
+	SDL_AtomicSet(&req->state, IO_SLOT_FINISHED);
+	if (s_io.finished)
+		SDL_SemPost(s_io.finished);
+}
+
+//
+// Thread pool
+//
+
+static void Io_ReadBlocking(IoRequest_s *req)
+{
+	SDL_RWops *file = SDL_RWFromFile(req->fileName, "rb");
+	if (file == nullptr)
+	{
+		Io_Finished(req, IO_FAILED);
+		return;
+	}
+
+	IoStatus_e status = IO_FAILED;
+	if (SDL_RWseek(file, (Sint64)req->offset, RW_SEEK_SET) >= 0)
+	{
+		while (req->bytesRead < req->size)
+		{
+			const size_t chunk = (size_t)Io_Min(req->size - req->bytesRead, IO_MAX_CHUNK);
+			const size_t got   = SDL_RWread(file, req->buffer + req->bytesRead, 1, chunk);
+			if (got == 0)
+				break;
+			req->bytesRead += got;
+		}
+		status = IO_DONE;
+	}
+	SDL_RWclose(file);
+	Io_Finished(req, status);
+}
+
+static int Io_ThreadMain(void *)
+{
+	SDL_LockMutex(s_io.queueLock);
+	for (;;)
+	{
+		while (s_io.queueCount == 0 && !s_io.quit)
+			SDL_CondWait(s_io.queueChanged, s_io.queueLock);
+		if (s_io.queueCount == 0)
+			break;
+
+		IoRequest_s *req = &s_io.requests[s_io.queue[s_io.queueHead]];
+		s_io.queueHead   = (s_io.queueHead + 1) % IO_MAX_PENDING_READS;
+		s_io.queueCount--;
+
+		SDL_UnlockMutex(s_io.queueLock);
+		Io_ReadBlocking(req);
+		SDL_LockMutex(s_io.queueLock);
+	}
+	SDL_UnlockMutex(s_io.queueLock);
+	return 0;
+}
+
+static bool Io_StartThreads()
+{
+	s_io.queueLock    = SDL_CreateMutex();
+	s_io.queueChanged = SDL_CreateCond();
+	for (s_io.numThreads = 0; s_io.numThreads < IO_NUM_THREADS; s_io.numThreads++)
+	{
+		SDL_Thread *thread = SDL_CreateThread(Io_ThreadMain, "QiIo", nullptr);
+		if (thread == nullptr)
+			break;
+		s_io.threads[s_io.numThreads] = thread;
+	}
+	return s_io.numThreads > 0;
+}
+
+static void Io_StopThreads()
+{
+	SDL_LockMutex(s_io.queueLock);
+	s_io.quit = true;
+	SDL_CondBroadcast(s_io.queueChanged);
+	SDL_UnlockMutex(s_io.queueLock);
+
+	for (u32 ti = 0; ti < s_io.numThreads; ti++)
+		SDL_WaitThread(s_io.threads[ti], nullptr);
+
+	SDL_DestroyCond(s_io.queueChanged);
+	SDL_DestroyMutex(s_io.queueLock);
+}
+
+static void Io_QueueForThreads(u32 slot)
+{
+	SDL_LockMutex(s_io.queueLock);
+	s_io.queue[(s_io.queueHead + s_io.queueCount) % IO_MAX_PENDING_READS] = slot;
+	s_io.queueCount++;
+	SDL_CondSignal(s_io.queueChanged);
+	SDL_UnlockMutex(s_io.queueLock);
+}
+
+//
+// io_uring. Only the main thread touches the ring, submitting and reaping both, so there's no locking.
+//
+
+#if HAS(IO_URING)
+static bool Io_RingInit(IoRing_s *ring, u32 entries)
+{
+	io_uring_params params = {};
+	ring->fd               = (int)syscall(__NR_io_uring_setup, entries, &params);
+	if (ring->fd < 0)
+		return false;
+
+	ring->sqMapSize = params.sq_off.array + params.sq_entries * sizeof(u32);
+	ring->cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+		ring->sqMapSize = ring->cqMapSize = ring->sqMapSize > ring->cqMapSize ? ring->sqMapSize : ring->cqMapSize;
+
+	ring->sqMap = mmap(nullptr, ring->sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+	ring->cqMap = ring->sqMap;
+	if (ring->sqMap != MAP_FAILED && !(params.features & IORING_FEAT_SINGLE_MMAP))
+		ring->cqMap = mmap(nullptr, ring->cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+
+	ring->sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+	void *sqes     = MAP_FAILED;
+	if (ring->sqMap != MAP_FAILED && ring->cqMap != MAP_FAILED)
+		sqes = mmap(nullptr, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+
+	if (sqes == MAP_FAILED)
+	{
+		if (ring->cqMap != MAP_FAILED && ring->cqMap != ring->sqMap)
+			munmap(ring->cqMap, ring->cqMapSize);
+		if (ring->sqMap != MAP_FAILED)
+			munmap(ring->sqMap, ring->sqMapSize);
+		close(ring->fd);
+		return false;
+	}
+
+	u8 *sq        = (u8 *)ring->sqMap;
+	u8 *cq        = (u8 *)ring->cqMap;
+	ring->sqHead  = (u32 *)(sq + params.sq_off.head);
+	ring->sqTail  = (u32 *)(sq + params.sq_off.tail);
+	ring->sqMask  = (u32 *)(sq + params.sq_off.ring_mask);
+	ring->sqArray = (u32 *)(sq + params.sq_off.array);
+	ring->sqes    = (io_uring_sqe *)sqes;
+	ring->cqHead  = (u32 *)(cq + params.cq_off.head);
+	ring->cqTail  = (u32 *)(cq + params.cq_off.tail);
+	ring->cqMask  = (u32 *)(cq + params.cq_off.ring_mask);
+	ring->cqes    = (io_uring_cqe *)(cq + params.cq_off.cqes);
+	return true;
+}
+
+static void Io_RingShutdown(IoRing_s *ring)
+{
+	munmap(ring->sqes, ring->sqesSize);
+	if (ring->cqMap != ring->sqMap)
+		munmap(ring->cqMap, ring->cqMapSize);
+	munmap(ring->sqMap, ring->sqMapSize);
+	close(ring->fd);
+}
+
+// One read in flight per request at most, and the ring has a slot for each, so this never finds it full
+static void Io_RingSubmit(u32 slot)
+{
+	IoRing_s *   ring = &s_io.ring;
+	IoRequest_s *req  = &s_io.requests[slot];
+
+	const u32     tail = *ring->sqTail;
+	const u32     idx  = tail & *ring->sqMask;
+	io_uring_sqe *sqe  = &ring->sqes[idx];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode    = IORING_OP_READ;
+	sqe->fd        = req->fd;
+	sqe->addr      = (u64)(uintptr_t)(req->buffer + req->bytesRead);
+	sqe->len       = (u32)Io_Min(req->size - req->bytesRead, IO_MAX_CHUNK);
+	sqe->off       = req->offset + req->bytesRead;
+	sqe->user_data = slot;
+
+	ring->sqArray[idx] = idx;
+	__atomic_store_n(ring->sqTail, tail + 1, __ATOMIC_RELEASE);
+	syscall(__NR_io_uring_enter, ring->fd, 1, 0, 0, nullptr, 0);
+}
+
+static void Io_RingFinish(IoRequest_s *req, IoStatus_e status)
+{
+	close(req->fd);
+	req->fd = -1;
+	Io_Finished(req, status);
+}
+
+static void Io_RingReap(bool wait)
+{
+	IoRing_s *ring = &s_io.ring;
+	if (wait)
+		syscall(__NR_io_uring_enter, ring->fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+
+	u32       head = *ring->cqHead;
+	const u32 tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+	for (; head != tail; head++)
+	{
+		const io_uring_cqe *cqe = &ring->cqes[head & *ring->cqMask];
+		IoRequest_s *       req = &s_io.requests[cqe->user_data];
+		if (cqe->res < 0)
+		{
+			Io_RingFinish(req, IO_FAILED);
+			continue;
+		}
+
+		// Reads can come back short of what was asked; keep going until the range is done or the file ends
+		req->bytesRead += (u64)cqe->res;
+		if (cqe->res > 0 && req->bytesRead < req->size)
+			Io_RingSubmit((u32)cqe->user_data);
+		else
+			Io_RingFinish(req, IO_DONE);
+	}
+	__atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+}
+#endif
+
+//
+// Interface
+//
+
+void Io_Init()
+{
+	Assert(s_io.numThreads == 0);
+
+#if HAS(IO_URING)
+	s_io.useRing = Io_RingInit(&s_io.ring, IO_MAX_PENDING_READS);
+	if (s_io.useRing)
+		return;
+	fprintf(stderr, "No io_uring, reading files on threads instead\n");
+#endif
+
+	s_io.finished          = SDL_CreateSemaphore(0);
+	const bool haveThreads = Io_StartThreads();
+	Assert(haveThreads);
+}
+
+void Io_Shutdown()
+{
+	Io_WaitAll();
+
+#if HAS(IO_URING)
+	if (s_io.useRing)
+		Io_RingShutdown(&s_io.ring);
+	else
+#endif
+	{
+		Io_StopThreads();
+		SDL_DestroySemaphore(s_io.finished);
+	}
+	s_io = {};
+}
+
+i64 Io_FileSize(const char *fileName)
+{
+	SDL_RWops *file = SDL_RWFromFile(fileName, "rb");
+	if (file == nullptr)
+		return -1;
+	const i64 size = SDL_RWsize(file);
+	SDL_RWclose(file);
+	return size;
+}
+
+static IoRequest_s *Io_Lookup(IoRead_t read)
+{
+	IoRequest_s *req = &s_io.requests[read % IO_MAX_PENDING_READS];
+	Assert(read != 0 && req->generation == read / IO_MAX_PENDING_READS && SDL_AtomicGet(&req->state) != IO_SLOT_FREE);
+	return req;
+}
+
+// Frees the slot before the callback runs, which may well queue another read
+static IoStatus_e Io_Release(IoRequest_s *req, u64 *bytesRead)
+{
+	const IoStatus_e status   = req->status;
+	const u64        numRead  = req->bytesRead;
+	IoDone_f *const  done     = req->done;
+	void *const      userData = req->userData;
+	SDL_AtomicSet(&req->state, IO_SLOT_FREE);
+
+	if (bytesRead != nullptr)
+		*bytesRead = numRead;
+	if (done != nullptr)
+		done(userData, status, numRead);
+	return status;
+}
+
+// Sleeps until some read finishes
+static void Io_WaitForAny()
+{
+#if HAS(IO_URING)
+	if (s_io.useRing)
+	{
+		Io_RingReap(true);
+		return;
+	}
+#endif
+	SDL_SemWait(s_io.finished);
+}
+
+void Io_Update()
+{
+#if HAS(IO_URING)
+	if (s_io.useRing)
+		Io_RingReap(false);
+#endif
+
+	for (u32 slot = 0; slot < IO_MAX_PENDING_READS; slot++)
+	{
+		IoRequest_s *req = &s_io.requests[slot];
+		if (req->done != nullptr && SDL_AtomicGet(&req->state) == IO_SLOT_FINISHED)
+			Io_Release(req, nullptr);
+	}
+}
+
+IoRead_t Io_Read(const char *fileName, void *buffer, u64 offset, u64 size, IoDone_f *done, void *userData)
+{
+	Assert(fileName && (buffer || size == 0));
+	Assert(strlen(fileName) < IO_MAX_PATH);
+
+	u32  slot    = IO_MAX_PENDING_READS;
+	bool updated = false;
+	for (;;)
+	{
+		bool anyWillFree = false;
+		for (u32 si = 0; si < IO_MAX_PENDING_READS && slot == IO_MAX_PENDING_READS; si++)
+		{
+			const int state = SDL_AtomicGet(&s_io.requests[si].state);
+			if (state == IO_SLOT_FREE)
+				slot = si;
+			anyWillFree |= state == IO_SLOT_QUEUED || s_io.requests[si].done != nullptr;
+		}
+		if (slot < IO_MAX_PENDING_READS)
+			break;
+
+		// A table of finished reads nobody has polled would never free up
+		Assert(anyWillFree);
+
+		// Reads that already finished free their slots on Io_Update, only sleep if that didn't help
+		if (updated)
+			Io_WaitForAny();
+		Io_Update();
+		updated = true;
+	}
+
+	IoRequest_s *req = &s_io.requests[slot];
+	if (++s_io.nextGeneration >= 0xFFFFFFFFu / IO_MAX_PENDING_READS)
+		s_io.nextGeneration = 1;
+	req->generation = s_io.nextGeneration;
+	strcpy(req->fileName, fileName);
+	req->buffer    = (u8 *)buffer;
+	req->offset    = offset;
+	req->size      = size;
+	req->bytesRead = 0;
+	req->status    = IO_PENDING;
+	req->done      = done;
+	req->userData  = userData;
+	req->fd        = -1;
+	SDL_AtomicSet(&req->state, IO_SLOT_QUEUED);
+
+#if HAS(IO_URING)
+	if (s_io.useRing)
+	{
+		// Opening is left synchronous, it's the reads that take the time
+		req->fd = open(fileName, O_RDONLY | O_CLOEXEC);
+		if (req->fd < 0)
+			Io_Finished(req, IO_FAILED);
+		else if (size == 0)
+			Io_RingFinish(req, IO_DONE);
+		else
+			Io_RingSubmit(slot);
+	}
+	else
+#endif
+		Io_QueueForThreads(slot);
+
+	return req->generation * IO_MAX_PENDING_READS + slot;
+}
+
+IoStatus_e Io_Poll(IoRead_t read, u64 *bytesRead)
+{
+	IoRequest_s *req = Io_Lookup(read);
+
+#if HAS(IO_URING)
+	if (s_io.useRing)
+		Io_RingReap(false);
+#endif
+
+	if (SDL_AtomicGet(&req->state) != IO_SLOT_FINISHED)
+		return IO_PENDING;
+	return Io_Release(req, bytesRead);
+}
+
+IoStatus_e Io_Wait(IoRead_t read, u64 *bytesRead)
+{
+	for (;;)
+	{
+		const IoStatus_e status = Io_Poll(read, bytesRead);
+		if (status != IO_PENDING)
+			return status;
+		Io_WaitForAny();
+	}
+}
+
+void Io_WaitAll()
+{
+	for (;;)
+	{
+		Io_Update();
+
+		// A read can finish on an I/O thread after Io_Update looked, its callback still has to run
+		bool anyLeft = false;
+		for (u32 slot = 0; slot < IO_MAX_PENDING_READS && !anyLeft; slot++)
+		{
+			const int state = SDL_AtomicGet(&s_io.requests[slot].state);
+			anyLeft         = state == IO_SLOT_QUEUED || (state == IO_SLOT_FINISHED && s_io.requests[slot].done != nullptr);
+		}
+		if (!anyLeft)
+			return;
+
+		Io_WaitForAny();
+	}
+}
@@ -0,0 +1,41 @@
+#ifndef __QI_FILEWATCH_H
+
+//
+// Copyright 2017, Quantum Immortality Software and Jon Davis
+//
+// Watches data files for changes so the game can reload just what depends on them. Lives in the platform layer next
+// to the file reads; the game gets at it through PlatFuncs_s. A watcher thread sleeps on inotify on Linux, watching
+// each file's directory so editors that save by writing a new file and renaming it over the old one are caught too.
+// Elsewhere the thread stats the watched files a few times a second.
+//
+// Files are named as the game opens them, relative to the data directory. A change is only reported once the file
+// has gone quiet for a moment, so a save written in several goes, or a tool still writing, comes out as one change
+// of the finished file.
+//
+// Everything here is called from the main thread only, apart from the callbacks of Fw_WatchOnThread.
+//
+
+#include "basictypes.h"
+
+#define FW_MAX_WATCHES 256
+#define FW_SETTLE_MS   100 // Quiet time after the last write before a change is reported
+
+// Run on the watcher thread
+typedef void FwChanged_f(const char *fileName, void *userData);
+
+void Fw_Init();
+void Fw_Shutdown();
+
+// Starts watching the file, false if there's no room or its directory can't be watched. Watching the same file
+// again does nothing. The file itself doesn't have to exist yet.
+bool Fw_Watch(const char *fileName);
+
+// For the platform's own files: changes go to the callback, on the watcher thread, instead of Fw_NextChange. A slow
+// callback holds up every other watch, so keep it to work that would otherwise hold up a frame.
+bool Fw_WatchOnThread(const char *fileName, FwChanged_f *changed, void *userData);
+
+// Takes the next watched file that changed and has settled, copying its name. false when there are none.
+bool Fw_NextChange(char *fileName, u32 fileNameSize);
+
+#define __QI_FILEWATCH_H
+#endif // #ifndef __QI_FILEWATCH_H
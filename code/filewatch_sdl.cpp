@@ -0,0 +1,338 @@
+//
+// Copyright 2017, Quantum Immortality Software and Jon Davis
+//
+// SDL implementation of the file watches, with an inotify backend on Linux
+//
+
+#include "basictypes.h"
+
+#include "debug.h"
+#include "filewatch.h"
+
+#include "SDL.h"
+#include "SDL_atomic.h"
+#include "SDL_mutex.h"
+#include "SDL_thread.h"
+#include "SDL_timer.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#if HAS(INOTIFY)
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#define FW_MAX_PATH 1024 // Platform files are absolute paths
+#define FW_MAX_DIRS 64
+#define FW_POLL_MS  100 // Longest the thread goes without looking, also how long shutting it down can take
+
+struct FwWatch_s
+{
+	char         fileName[FW_MAX_PATH];
+	const char * baseName; // Into fileName, past its directory
+	FwChanged_f *callback; // Fw_WatchOnThread only
+	void *       userData;
+	bool         changed;
+	u32          changedTicks; // SDL_GetTicks at the last write seen, settling starts over from each
+	i32          dir;          // inotify only
+	i64          mtime;        // Stat polling only, -1 while the file is missing
+	i64          size;
+};
+
+#if HAS(INOTIFY)
+struct FwDir_s
+{
+	char path[FW_MAX_PATH];
+	int  wd;
+};
+#endif
+
+struct FwGlobals_s
+{
+	SDL_mutex *lock; // The watches: the main thread adds and takes them while the watcher thread marks changes
+	FwWatch_s  watches[FW_MAX_WATCHES];
+	u32        numWatches;
+
+	SDL_Thread * thread;
+	SDL_atomic_t quit;
+
+#if HAS(INOTIFY)
+	bool    useInotify;
+	int     inotifyFd;
+	FwDir_s dirs[FW_MAX_DIRS];
+	u32     numDirs;
+#endif
+};
+
+static FwGlobals_s s_fw;
+
+static void Fw_MarkChanged(FwWatch_s *watch)
+{
+	watch->changed      = true;
+	watch->changedTicks = SDL_GetTicks();
+}
+
+static bool Fw_Settled(const FwWatch_s *watch, u32 now)
+{
+	return watch->changed && now - watch->changedTicks >= FW_SETTLE_MS;
+}
+
+// Each time round the watcher thread: callbacks of settled changes are run with the lock released, names and
+// callbacks never change once a watch is added
+static void Fw_RunCallbacks()
+{
+	u32       settled[FW_MAX_WATCHES];
+	u32       numSettled = 0;
+	const u32 now        = SDL_GetTicks();
+
+	SDL_LockMutex(s_fw.lock);
+	for (u32 wi = 0; wi < s_fw.numWatches; wi++)
+	{
+		FwWatch_s *watch = &s_fw.watches[wi];
+		if (watch->callback != nullptr && Fw_Settled(watch, now))
+		{
+			watch->changed        = false;
+			settled[numSettled++] = wi;
+		}
+	}
+	SDL_UnlockMutex(s_fw.lock);
+
+	for (u32 si = 0; si < numSettled; si++)
+	{
+		const FwWatch_s *watch = &s_fw.watches[settled[si]];
+		watch->callback(watch->fileName, watch->userData);
+	}
+}
+
+//
+// Stat polling
+//
+
+static void Fw_Stat(const char *fileName, i64 *mtime, i64 *size)
+{
+	struct stat statbuf;
+	if (stat(fileName, &statbuf) != 0)
+	{
+		*mtime = -1;
+		*size  = -1;
+		return;
+	}
+
+#if HAS(INOTIFY)
+	*mtime = (i64)statbuf.st_mtim.tv_sec * 1000000000 + statbuf.st_mtim.tv_nsec;
+#elif HAS(OSX_BUILD)
+	*mtime = (i64)statbuf.st_mtimespec.tv_sec * 1000000000 + statbuf.st_mtimespec.tv_nsec;
+#else
+	*mtime = (i64)statbuf.st_mtime;
+#endif
+	*size = (i64)statbuf.st_size;
+}
+
+static int Fw_PollThreadMain(void *)
+{
+	while (!SDL_AtomicGet(&s_fw.quit))
+	{
+		Fw_RunCallbacks();
+
+		SDL_LockMutex(s_fw.lock);
+		for (u32 wi = 0; wi < s_fw.numWatches; wi++)
+		{
+			FwWatch_s *watch = &s_fw.watches[wi];
+			i64        mtime, size;
+			Fw_Stat(watch->fileName, &mtime, &size);
+			if (mtime != watch->mtime || size != watch->size)
+			{
+				watch->mtime = mtime;
+				watch->size  = size;
+				Fw_MarkChanged(watch);
+			}
+		}
+		SDL_UnlockMutex(s_fw.lock);
+
+		SDL_Delay(FW_POLL_MS);
+	}
+	return 0;
+}
+
+//
+// inotify. Directories are watched rather than files, a file replaced by a rename is a new inode the old watch
+// wouldn't follow.
+//
+
+#if HAS(INOTIFY)
+#define FW_INOTIFY_EVENTS (IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO | IN_CREATE)
+
+// Index of the directory in dirs, -1 if it can't be watched
+static i32 Fw_WatchDir(const char *fileName, u32 dirLen)
+{
+	char path[FW_MAX_PATH];
+	if (dirLen == 0)
+		strcpy(path, ".");
+	else
+		snprintf(path, sizeof(path), "%.*s", (int)dirLen, fileName);
+
+	for (u32 di = 0; di < s_fw.numDirs; di++)
+		if (strcmp(s_fw.dirs[di].path, path) == 0)
+			return (i32)di;
+
+	if (s_fw.numDirs == FW_MAX_DIRS)
+		return -1;
+	const int wd = inotify_add_watch(s_fw.inotifyFd, path, FW_INOTIFY_EVENTS);
+	if (wd < 0)
+		return -1;
+
+	FwDir_s *dir = &s_fw.dirs[s_fw.numDirs];
+	strcpy(dir->path, path);
+	dir->wd = wd;
+	return (i32)s_fw.numDirs++;
+}
+
+static int Fw_InotifyThreadMain(void *)
+{
+	alignas(inotify_event) char events[4096];
+	while (!SDL_AtomicGet(&s_fw.quit))
+	{
+		Fw_RunCallbacks();
+
+		pollfd    pfd   = {s_fw.inotifyFd, POLLIN, 0};
+		const int ready = poll(&pfd, 1, FW_POLL_MS);
+		if (ready <= 0)
+			continue;
+		const ssize_t got = read(s_fw.inotifyFd, events, sizeof(events));
+		if (got <= 0)
+			continue;
+
+		SDL_LockMutex(s_fw.lock);
+		for (const char *at = events; at < events + got;)
+		{
+			const inotify_event *ev = (const inotify_event *)at;
+			at += sizeof(inotify_event) + ev->len;
+			if (ev->len == 0)
+				continue;
+
+			for (u32 wi = 0; wi < s_fw.numWatches; wi++)
+			{
+				FwWatch_s *watch = &s_fw.watches[wi];
+				if (s_fw.dirs[watch->dir].wd == ev->wd && strcmp(watch->baseName, ev->name) == 0)
+					Fw_MarkChanged(watch);
+			}
+		}
+		SDL_UnlockMutex(s_fw.lock);
+	}
+	return 0;
+}
+#endif
+
+//
+// Interface
+//
+
+void Fw_Init()
+{
+	Assert(s_fw.thread == nullptr);
+	s_fw.lock = SDL_CreateMutex();
+
+	SDL_ThreadFunction threadMain = Fw_PollThreadMain;
+#if HAS(INOTIFY)
+	s_fw.inotifyFd  = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	s_fw.useInotify = s_fw.inotifyFd >= 0;
+	if (s_fw.useInotify)
+		threadMain = Fw_InotifyThreadMain;
+	else
+		fprintf(stderr, "No inotify, polling watched files instead\n");
+#endif
+
+	s_fw.thread = SDL_CreateThread(threadMain, "QiFileWatch", nullptr);
+	Assert(s_fw.thread);
+}
+
+void Fw_Shutdown()
+{
+	SDL_AtomicSet(&s_fw.quit, 1);
+	SDL_WaitThread(s_fw.thread, nullptr);
+
+#if HAS(INOTIFY)
+	if (s_fw.useInotify)
+		close(s_fw.inotifyFd);
+#endif
+	SDL_DestroyMutex(s_fw.lock);
+	s_fw = {};
+}
+
+static bool Fw_AddWatch(const char *fileName, FwChanged_f *callback, void *userData)
+{
+	Assert(fileName && strlen(fileName) < FW_MAX_PATH);
+
+	bool watching = false;
+	SDL_LockMutex(s_fw.lock);
+	for (u32 wi = 0; wi < s_fw.numWatches && !watching; wi++)
+		watching = strcmp(s_fw.watches[wi].fileName, fileName) == 0;
+
+	if (!watching && s_fw.numWatches < FW_MAX_WATCHES)
+	{
+		FwWatch_s *watch = &s_fw.watches[s_fw.numWatches];
+		memset(watch, 0, sizeof(*watch));
+		strcpy(watch->fileName, fileName);
+		const char *slash = strrchr(watch->fileName, '/');
+		watch->baseName   = slash ? slash + 1 : watch->fileName;
+		watch->callback   = callback;
+		watch->userData   = userData;
+
+#if HAS(INOTIFY)
+		if (s_fw.useInotify)
+		{
+			watch->dir = Fw_WatchDir(fileName, slash ? (u32)(slash - watch->fileName) : 0);
+			watching   = watch->dir >= 0;
+		}
+		else
+#endif
+		{
+			Fw_Stat(fileName, &watch->mtime, &watch->size);
+			watching = true;
+		}
+
+		if (watching)
+			s_fw.numWatches++;
+	}
+	SDL_UnlockMutex(s_fw.lock);
+
+	if (!watching)
+		fprintf(stderr, "Can't watch %s for changes\n", fileName);
+	return watching;
+}
+
+bool Fw_Watch(const char *fileName)
+{
+	return Fw_AddWatch(fileName, nullptr, nullptr);
+}
+
+bool Fw_WatchOnThread(const char *fileName, FwChanged_f *changed, void *userData)
+{
+	Assert(changed);
+	return Fw_AddWatch(fileName, changed, userData);
+}
+
+bool Fw_NextChange(char *fileName, u32 fileNameSize)
+{
+	Assert(fileName && fileNameSize > 0);
+
+	const u32 now   = SDL_GetTicks();
+	bool      found = false;
+	SDL_LockMutex(s_fw.lock);
+	for (u32 wi = 0; wi < s_fw.numWatches && !found; wi++)
+	{
+		FwWatch_s *watch = &s_fw.watches[wi];
+		if (watch->callback == nullptr && Fw_Settled(watch, now))
+		{
+			watch->changed = false;
+			snprintf(fileName, fileNameSize, "%s", watch->fileName);
+			found = true;
+		}
+	}
+	SDL_UnlockMutex(s_fw.lock);
+	return found;
+}
@@ -0,0 +1,43 @@
+#ifndef __QI_FRAMEPACE_H
+
+//
+// Copyright 2017, Quantum Immortality Software and Jon Davis
+//
+// Frame pacing for the platform main loop. Frames are due on a fixed schedule rather than a period after the last
+// one finished, so pacing doesn't drift. Waiting sleeps until just short of the deadline and spins only the last
+// stretch. On Linux the sleep is clock_nanosleep to an absolute time; elsewhere it's SDL_Delay, which only has whole
+// milliseconds. How early to wake adapts to how late the sleeps have been coming back.
+//
+// With vsync on, the swap is the real deadline. Fp_Presented puts the schedule in phase with it, so the wait ends
+// just before the swap would block anyway.
+//
+// Main thread only.
+//
+
+#include "basictypes.h"
+
+struct FpStats_s
+{
+	u64 frames;
+	u64 missed;       // Frames whose work ran past the deadline, or whose present came a frame late
+	r64 lastFrameMs;  // Deadline to deadline, or present to present with vsync
+	r64 worstFrameMs; // Since the last Fp_ResetWorst
+	r64 wakeLateUs;   // Average of how far past the requested time the sleeps wake
+	r64 wakeMarginUs; // How early the sleeps are asked to wake, the rest is spun
+	r64 spinUs;       // Average spin per frame
+};
+
+void Fp_Init(r64 secondsPerFrame, bool vsync);
+
+// Waits until the next frame is due. A frame that's already late doesn't wait, and the schedule skips ahead rather
+// than running the frames after it short to catch up.
+void Fp_WaitForFrame();
+
+// Just after the swap returns
+void Fp_Presented();
+
+const FpStats_s *Fp_Stats();
+void             Fp_ResetWorst();
+
+#define __QI_FRAMEPACE_H
+#endif // #ifndef __QI_FRAMEPACE_H
@@ -0,0 +1,213 @@
+//
+// Copyright 2017, Quantum Immortality Software and Jon Davis
+//
+// SDL implementation of frame pacing, with absolute clock_nanosleep on Linux
+//
+
+#include "basictypes.h"
+
+#include "debug.h"
+#include "framepace.h"
+#include "util.h"
+
+#include "SDL.h"
+#include "SDL_timer.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#if HAS(CLOCK_NANOSLEEP)
+#include <errno.h>
+#include <sys/prctl.h>
+#include <time.h>
+#endif
+
+#if HAS(SSE2_SIMD)
+#include <emmintrin.h>
+#endif
+
+#define FP_MIN_MARGIN_NS    50000      // Never trust a sleep to wake closer than this
+#define FP_MAX_MARGIN_NS    3000000    // Past this, SDL_Delay's millisecond rounding and the scheduler are the problem
+#define FP_PRESENT_SLACK_NS 1000000    // With vsync, how far ahead of the next swap the wait ends
+#define FP_LATE_WEIGHT      0.05       // Of each sleep in the running averages
+#define FP_LOG_INTERVAL_NS  1000000000 // Missed frames are logged at most this often
+
+struct FpGlobals_s
+{
+	u64  period; // ns
+	bool vsync;
+	u64  deadline; // ns, on Fp_Now's clock
+	u64  lastDeadline;
+	u64  lastPresent;
+
+	// Running averages of how late sleeps wake, and how far that strays
+	r64 lateNs;
+	r64 lateDevNs;
+	r64 spinNs;
+
+	FpStats_s stats;
+	u64       missedSinceLog;
+	r64       worstSinceLogMs;
+	u64       lastLog;
+
+#if !HAS(CLOCK_NANOSLEEP)
+	r64 nsPerCount;
+#endif
+};
+
+static FpGlobals_s s_fp;
+
+static u64 Fp_Now()
+{
+#if HAS(CLOCK_NANOSLEEP)
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (u64)now.tv_sec * 1000000000ull + (u64)now.tv_nsec;
+#else
+	return (u64)((r64)SDL_GetPerformanceCounter() * s_fp.nsPerCount);
+#endif
+}
+
+// Returns when the sleep woke
+static u64 Fp_SleepUntil(u64 wakeAt)
+{
+#if HAS(CLOCK_NANOSLEEP)
+	timespec until;
+	until.tv_sec  = (time_t)(wakeAt / 1000000000ull);
+	until.tv_nsec = (long)(wakeAt % 1000000000ull);
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, nullptr) == EINTR)
+		;
+#else
+	const u64 now = Fp_Now();
+	if (wakeAt > now + 1000000)
+		SDL_Delay((u32)((wakeAt - now) / 1000000));
+#endif
+	return Fp_Now();
+}
+
+static void Fp_SpinUntil(u64 until)
+{
+	while (Fp_Now() < until)
+	{
+#if HAS(SSE2_SIMD)
+		_mm_pause();
+#endif
+	}
+}
+
+static u64 Fp_WakeMargin()
+{
+	const r64 margin = s_fp.lateNs + 4.0 * s_fp.lateDevNs;
+	return (u64)Min(Max(margin, (r64)FP_MIN_MARGIN_NS), (r64)FP_MAX_MARGIN_NS);
+}
+
+static void Fp_MissedFrame(u64 now, r64 frameMs)
+{
+	s_fp.stats.missed++;
+	s_fp.missedSinceLog++;
+	s_fp.worstSinceLogMs = Max(s_fp.worstSinceLogMs, frameMs);
+	if (now - s_fp.lastLog < FP_LOG_INTERVAL_NS)
+		return;
+
+	fprintf(stderr, "Missed %llu frames, worst %.2fms against %.2fms\n", (unsigned long long)s_fp.missedSinceLog,
+	        s_fp.worstSinceLogMs, (r64)s_fp.period * 1e-6);
+	s_fp.missedSinceLog  = 0;
+	s_fp.worstSinceLogMs = 0.0;
+	s_fp.lastLog         = now;
+}
+
+void Fp_Init(r64 secondsPerFrame, bool vsync)
+{
+	Assert(secondsPerFrame > 0.0);
+	s_fp = {};
+
+#if HAS(CLOCK_NANOSLEEP)
+	// The default 50us of timer slack lets the kernel wake us late on purpose
+	prctl(PR_SET_TIMERSLACK, 1, 0, 0, 0);
+#else
+	s_fp.nsPerCount = 1e9 / (r64)SDL_GetPerformanceFrequency();
+#endif
+
+	s_fp.period   = (u64)(secondsPerFrame * 1e9);
+	s_fp.vsync    = vsync;
+	s_fp.lateNs   = 0.5 * FP_MAX_MARGIN_NS; // Pessimistic until the sleeps show otherwise
+	s_fp.deadline = Fp_Now() + s_fp.period;
+
+	s_fp.lastDeadline = s_fp.deadline - s_fp.period;
+}
+
+void Fp_WaitForFrame()
+{
+	const u64 now = Fp_Now();
+	s_fp.stats.frames++;
+
+	if (now >= s_fp.deadline)
+	{
+		// Start the schedule again from now rather than hurry the next frames
+		if (!s_fp.vsync)
+			Fp_MissedFrame(now, (r64)(now - s_fp.lastDeadline) * 1e-6);
+		s_fp.deadline = now;
+	}
+	else
+	{
+		const u64 margin = Fp_WakeMargin();
+		if (s_fp.deadline > now + margin)
+		{
+			const u64 wakeAt = s_fp.deadline - margin;
+			const u64 woke   = Fp_SleepUntil(wakeAt);
+
+			// Early wakes from the millisecond rounding count as on time
+			const r64 late = woke > wakeAt ? (r64)(woke - wakeAt) : 0.0;
+			s_fp.lateDevNs += (fabs(late - s_fp.lateNs) - s_fp.lateDevNs) * FP_LATE_WEIGHT;
+			s_fp.lateNs += (late - s_fp.lateNs) * FP_LATE_WEIGHT;
+		}
+
+		const u64 spinFrom = Fp_Now();
+		Fp_SpinUntil(s_fp.deadline);
+		const r64 spun = spinFrom < s_fp.deadline ? (r64)(s_fp.deadline - spinFrom) : 0.0;
+		s_fp.spinNs += (spun - s_fp.spinNs) * FP_LATE_WEIGHT;
+	}
+
+	const r64 frameMs = (r64)(s_fp.deadline - s_fp.lastDeadline) * 1e-6;
+	if (!s_fp.vsync)
+	{
+		s_fp.stats.lastFrameMs  = frameMs;
+		s_fp.stats.worstFrameMs = Max(s_fp.stats.worstFrameMs, frameMs);
+	}
+	s_fp.stats.wakeLateUs   = s_fp.lateNs * 1e-3;
+	s_fp.stats.wakeMarginUs = (r64)Fp_WakeMargin() * 1e-3;
+	s_fp.stats.spinUs       = s_fp.spinNs * 1e-3;
+
+	s_fp.lastDeadline = s_fp.deadline;
+	s_fp.deadline += s_fp.period;
+}
+
+void Fp_Presented()
+{
+	if (!s_fp.vsync)
+		return;
+
+	// The swap blocked until the display took the frame, so that's when frames really start. Aim the next wait a
+	// little ahead of the next one, whichever side of it the schedule had drifted to.
+	const u64 now = Fp_Now();
+	if (s_fp.lastPresent != 0)
+	{
+		const r64 frameMs = (r64)(now - s_fp.lastPresent) * 1e-6;
+		s_fp.stats.lastFrameMs  = frameMs;
+		s_fp.stats.worstFrameMs = Max(s_fp.stats.worstFrameMs, frameMs);
+		if (now - s_fp.lastPresent > s_fp.period + s_fp.period / 2)
+			Fp_MissedFrame(now, frameMs);
+	}
+	s_fp.lastPresent = now;
+	s_fp.deadline    = now + s_fp.period - Min((u64)FP_PRESENT_SLACK_NS, s_fp.period / 2);
+}
+
+const FpStats_s *Fp_Stats()
+{
+	return &s_fp.stats;
+}
+
+void Fp_ResetWorst()
+{
+	s_fp.stats.worstFrameMs = 0.0;
+}
@@ -11,12 +11,17 @@
 #include "tile.h"
 #include "math_util.h"
 #include "gjk.h"
+#include "collision.h"
+#include "sim.h"
+#include "entity.h"
 #include "util.h"
 #include "noise.h"
 #include "keystore.h"
 #include "qed_parse.h"
 #include "bitmap.h"
+#include "pixelops.h"
 #include "hwi.h"
+#include "hw_soft.h"
 #include "editor.h"
 #include <stdio.h>
 #include <imgui.h>
@@ -33,6 +38,47 @@
 #define PLAYER_RADIUS_X (0.5f * TILE_SIZE_METERS_X)
 #define PLAYER_RADIUS_Y (0.25f * TILE_SIZE_METERS_Y)
 
+// Enough to slide into a corner and along the second wall
+#define MAX_PLAYER_SLIDES 3
+
+#define NUM_WANDER_BODIES 128
+
+// Every sprite atlas, read again on its own when it changes outside release builds
+#define SPRITE_DEFS_FILE "qed/sprites/tiledefs.qed"
+
+// Sprite sort layers, back to front. Within a layer the draw list groups by atlas, then sorts by y.
+enum DrawLayer_e
+{
+	DRAW_LAYER_GROUND,      // Ground and tiles come from the chunk layer caches, drawn before the list
+	DRAW_LAYER_TILES,
+	DRAW_LAYER_PLAYER,      // Backing rect, then one layer per player bitmap part
+	DRAW_LAYER_PLAYER_MARK = DRAW_LAYER_PLAYER + 4,
+	DRAW_LAYER_BODIES,
+};
+
+// Ground and tile sprites for a whole chunk kept on the GPU, so a frame only redraws the chunks on screen with an
+// offset. Rebuilt when the chunk's version moves on.
+#define MAX_CACHED_CHUNK_LAYERS 16
+
+struct ChunkLayerCache_s
+{
+	i32            chunkX, chunkY;
+	u32            chunkVersion;
+	u32            lastUsedFrame;
+	bool           valid;
+	HwiSpriteCache ground;
+	HwiSpriteCache walls;
+	HwiSpriteCache invalid;
+};
+
+// A plain bitmap wrapped as a one frame sprite so it can go in the draw list
+struct BitmapSprite_s
+{
+	SpriteAtlas atlas;
+	Sprite      sprite;
+	SpriteFrame frame;
+};
+
 struct GameGlobals_s
 {
 	bool      isInitialized;
@@ -44,8 +90,13 @@ struct GameGlobals_s
 
 	World_s     world;
 	WorldPos_s  playerPos;
+	WorldPos_s  prevPlayerPos;
+	WorldPos_s  renderPlayerPos;
 	v2          dPlayerPos;
 	WorldPos_s  cameraPos;
+	r64         simAccumulator;
+	r32         renderAlpha;
+	SimState_s  sim;
 	MemoryArena tileArena;
 	MemoryArena spriteArena;
 	MemoryArena assetArena;
@@ -54,6 +105,14 @@ struct GameGlobals_s
 	Bitmap playerBmps[4][3];
 	i32    playerFacingIdx;
 
+	Bitmap         whiteBitmap;
+	BitmapSprite_s whiteSprite;
+	BitmapSprite_s playerSprites[4][3];
+	SpriteDLEntry  drawList[SPR_MAX_DRAW_LIST_ENTRIES];
+
+	ChunkLayerCache_s chunkLayers[MAX_CACHED_CHUNK_LAYERS];
+	u32               renderFrame;
+
 	BuddyAllocator *testAlloc;
 	Bitmap* screenBitmap;
 	Bitmap testBitmap;
@@ -79,6 +138,7 @@ T *MemoryArena_PushStruct(MemoryArena *arena)
 }
 
 static void InitGameGlobals(const SubSystem *, bool);
+internal void InitBitmapSprite(BitmapSprite_s *bmpSprite, Bitmap *bitmap);
 
 internal void TestKeyStore(void)
 {
@@ -213,8 +273,8 @@ void DrawDebugPoly(Bitmap *screen, PolyShape_s *poly, u32 rgba)
 	for (u32 pi = 0; pi < poly->numPoints; pi++)
 	{
 		u32 pn          = (pi + 1) % poly->numPoints;
-		v2  p0Cam       = MetersToScreenPixels(poly->points[pi] - camPosMeters);
-		v2  p1Cam       = MetersToScreenPixels(poly->points[pn] - camPosMeters);
+		v2  p0Cam       = MetersToScreenPixels(poly->Point(pi) - camPosMeters);
+		v2  p1Cam       = MetersToScreenPixels(poly->Point(pn) - camPosMeters);
 		v2  p0CamScreen = p0Cam + halfScreen;
 		v2  p1CamScreen = p1Cam + halfScreen;
 		DrawDebugLine(screen, p0CamScreen, p1CamScreen, rgba);
@@ -229,6 +289,9 @@ void DrawDebugShapes(Bitmap *screen)
 
 void AddDebugShape(PolyShape_s *poly, r32 r, r32 g, r32 b)
 {
+	if (numDebugShapes == MAX_DEBUG_SHAPES)
+		return;
+
 	u32 rgba                         = ((u32)(r * 255.0f + 0.5f) << 24) | ((u32)(g * 255 + 0.5f) << 16) | ((u32)(b * 255 + 0.5f) << 8) | 0xFF;
 	debugShapes[numDebugShapes]      = *poly;
 	debugShapeColors[numDebugShapes] = rgba;
@@ -240,16 +303,18 @@ void MakeSimplexShapes(PolyShape_s *shapea, PolyShape_s *shapeb, GjkResult_s *re
 	shapea->numPoints = shapeb->numPoints = result->simplex.numPts;
 	for (u32 i = 0; i < result->simplex.numPts; i++)
 	{
-		shapea->points[i] = result->simplex.pts[i].sa;
-		shapeb->points[i] = result->simplex.pts[i].sb;
+		shapea->SetPoint(i, result->simplex.pts[i].sa);
+		shapeb->SetPoint(i, result->simplex.pts[i].sb);
 	}
 }
 
-internal void UpdateGameState(Bitmap *screen, Input *input)
+// One fixed SIM_DT step of the player and every sim body
+internal void SimulateStep(Input *input, const r32 dT)
 {
-	numDebugShapes = 0;
 	Assert(g_game);
 
+	g_game->prevPlayerPos = g_game->playerPos;
+
 	// Controller 0 left stick
 	Analog *  ctr0        = &input->controllers[KBD].analogs[0];
 	const r32 ddPlayerMag = 35.0f + (50.0f * input->controllers[KBD].leftStickButton.endedDown);
@@ -257,85 +322,60 @@ internal void UpdateGameState(Bitmap *screen, Input *input)
 	v2 ddPlayer = ctr0->dir * ctr0->trigger.reading * ddPlayerMag;
 	ddPlayer += -8.7f * g_game->dPlayerPos;
 
-	v2 playerOffset = {};
-	playerOffset    = (ddPlayer * 0.5f * input->dT * input->dT) + g_game->dPlayerPos * input->dT;
-
-	WorldPos_s oldPlrPos = g_game->playerPos;
-	WorldPos_s newPlrPos = g_game->playerPos;
-	AddSubtileOffset(&newPlrPos, playerOffset);
-
-	g_game->dPlayerPos += ddPlayer * input->dT;
+	// Player motion is tuned in tiles, collision works in meters
+	const v2 playerOffset = (ddPlayer * 0.5f * dT * dT) + g_game->dPlayerPos * dT;
+	const v2 playerMove   = V2(playerOffset.x * TILE_SIZE_METERS_X, playerOffset.y * TILE_SIZE_METERS_Y);
 
-	// Compute bounding box of total player move in camera space
-	WorldPos_s oldPlrPosUL = oldPlrPos;
-	WorldPos_s oldPlrPosLR = oldPlrPos;
-	AddSubtileOffset(&oldPlrPosUL, V2(-PLAYER_RADIUS_X, -PLAYER_RADIUS_Y));
-	AddSubtileOffset(&oldPlrPosLR, V2(PLAYER_RADIUS_X, PLAYER_RADIUS_Y));
+	g_game->dPlayerPos += ddPlayer * dT;
 
-	WorldPos_s newPlrPosUL = newPlrPos;
-	WorldPos_s newPlrPosLR = newPlrPos;
-	AddSubtileOffset(&newPlrPosUL, V2(-PLAYER_RADIUS_X, -PLAYER_RADIUS_Y));
-	AddSubtileOffset(&newPlrPosLR, V2(PLAYER_RADIUS_X, PLAYER_RADIUS_Y));
+	// Sweep the player box along the move so fast moves can't tunnel, sliding along whatever it hits
+	const v2 plrRadii     = V2(PLAYER_RADIUS_X, PLAYER_RADIUS_Y);
+	const v2 oldPlrMeters = WorldPosToMeters(&g_game->playerPos);
 
-	i64 tileMinX, tileMinY, tileMaxX, tileMaxY;
-	tileMinX = Min(oldPlrPosUL.x.tile, newPlrPosLR.x.tile);
-	tileMinY = Min(oldPlrPosUL.y.tile, newPlrPosLR.y.tile);
-	tileMaxX = Max(oldPlrPosUL.x.tile, newPlrPosLR.x.tile);
-	tileMaxY = Max(oldPlrPosUL.y.tile, newPlrPosLR.y.tile);
+	Aabb_s plrBox;
+	plrBox.min = oldPlrMeters - plrRadii;
+	plrBox.max = oldPlrMeters + plrRadii;
 
-	bool collided = false;
+	WorldPos_s newPlrPos = g_game->playerPos;
+	AddMetersOffset(&newPlrPos, Col_SweepAndSlideWorld(&g_game->tileArena, &g_game->world, &plrBox, playerMove, &g_game->dPlayerPos, MAX_PLAYER_SLIDES));
 
-	// BoxShape_s plrCollideShape(WorldPosToMeters(&newPlrPos), V2(PLAYER_RADIUS_X, PLAYER_RADIUS_Y));
-	// AddDebugShape(&plrCollideShape, 1.0f, 0.0f, 1.0f);
+	// Anything still overlapping (float drift, or starting inside a tile) gets pushed out in one pass. Every box is
+	// tested against the same position and the contacts are resolved together afterwards.
+	const v2 finalPlrMeters = WorldPosToMeters(&newPlrPos);
+	plrBox.min              = finalPlrMeters - plrRadii;
+	plrBox.max              = finalPlrMeters + plrRadii;
 
-	for (i32 y = tileMinY; y <= tileMaxY; y++)
+	ColAxisContacts_s worldContacts = {};
+	Aabb_s            worldBoxes[COL_WORLD_BATCH];
+	for (u32 firstBox = 0;; firstBox += COL_WORLD_BATCH)
 	{
-		for (i32 x = tileMinX; x <= tileMaxX; x++)
+		const u32 numWorldBoxes = Col_GatherWorldBoxes(&g_game->tileArena, &g_game->world, &plrBox, worldBoxes, COL_WORLD_BATCH, firstBox);
+		for (u32 bi = 0; bi < numWorldBoxes; bi++)
 		{
-			u32 tileVal = GetTileValue(&g_game->world, x, y);
-
-			if (tileVal == TILE_EMPTY)
-				continue;
-
-			GjkResult_s result;
-			// EllipseShape_s plrCollideShape(WorldPosToMeters(&newPlrPos), V2(PLAYER_RADIUS_X, PLAYER_RADIUS_Y));
-			BoxShape_s plrCollideShape(WorldPosToMeters(&newPlrPos), V2(PLAYER_RADIUS_X, PLAYER_RADIUS_Y));
-			BoxShape_s tileShape(V2((r32)x * TILE_SIZE_METERS_X, (r32)y * TILE_SIZE_METERS_Y), V2(TILE_SIZE_METERS_X / 2, TILE_SIZE_METERS_Y / 2));
+			const Aabb_s* tileBox   = &worldBoxes[bi];
+			const v2      tileRadii = (tileBox->max - tileBox->min) * 0.5f;
+			BoxShape_s    tileShape(tileBox->min + tileRadii, tileRadii);
 			AddDebugShape(&tileShape, 1.0f, 1.0f, 0.0f);
-			PolyShape_s gjkResulta, gjkResultb;
-			if (Qi_Gjk(&result, &plrCollideShape, &tileShape))
-			{
-				collided = true;
-				AddSubtileOffset(&newPlrPos, result.penetrationNormal * result.penetrationDepth);
-				g_game->dPlayerPos += -result.penetrationNormal * g_game->dPlayerPos.dot(result.penetrationNormal);
 
-				MakeSimplexShapes(&gjkResulta, &gjkResultb, &result);
-				AddDebugShape(&gjkResulta, 0.0f, 1.0f, 0.0f);
-				AddDebugShape(&gjkResultb, 0.0f, 1.0f, 0.5f);
-			}
-			else
+			GjkResult_s result;
+			if (Qi_AabbOverlap(&result, &plrBox, tileBox))
 			{
-				MakeSimplexShapes(&gjkResulta, &gjkResultb, &result);
-				AddDebugShape(&gjkResulta, 0.0f, 1.0f, 1.0f);
-				AddDebugShape(&gjkResultb, 0.5f, 1.0f, 1.0f);
+				Col_AddAxisContact(&worldContacts, result.penetrationNormal, result.penetrationDepth);
+				for (u32 ci = 0; ci < result.numContacts; ci++)
+				{
+					BoxShape_s contactShape(result.contacts[ci].point, V2(0.05f, 0.05f));
+					AddDebugShape(&contactShape, 1.0f, 0.0f, 0.0f);
+				}
 			}
 		}
-	}
-
-	g_game->playerPos = newPlrPos;
-
-	// Offset camera half a tile since we want it to be centered in a screen
-	g_game->cameraPos.x.offset = g_game->cameraPos.y.offset = -0.5f;
-	g_game->cameraPos.z.offset                              = 0.0f;
 
-	i64 playerXScreen = (i64)floor((r64)g_game->playerPos.x.tile / SCREEN_NUM_TILES_X);
-	i64 playerYScreen = (i64)floor((r64)g_game->playerPos.y.tile / SCREEN_NUM_TILES_Y);
+		if (numWorldBoxes < COL_WORLD_BATCH)
+			break;
+	}
 
-	g_game->cameraPos.x.tile = (playerXScreen * SCREEN_NUM_TILES_X) + SCREEN_NUM_TILES_X / 2;
-	g_game->cameraPos.y.tile = (playerYScreen * SCREEN_NUM_TILES_Y) + SCREEN_NUM_TILES_Y / 2;
-	g_game->cameraPos.z.tile = g_game->playerPos.z.tile;
+	AddMetersOffset(&newPlrPos, Col_ResolveAxisContacts(&worldContacts, &g_game->dPlayerPos));
 
-	g_game->cameraPos = g_game->playerPos;
+	g_game->playerPos = newPlrPos;
 
 	if (ctr0->dir.y < 0)
 		g_game->playerFacingIdx = 0;
@@ -345,6 +385,41 @@ internal void UpdateGameState(Bitmap *screen, Input *input)
 		g_game->playerFacingIdx = 2;
 	if (ctr0->dir.x < 0)
 		g_game->playerFacingIdx = 3;
+
+	Sim_Step(&g_game->sim, &g_game->tileArena, &g_game->world, dT);
+}
+
+// Run as many fixed steps as the frame's elapsed time covers, then work out where between the last two steps to
+// draw everything
+internal void UpdateGameState(Input *input)
+{
+	numDebugShapes = 0;
+
+	g_game->simAccumulator += input->dT;
+
+	u32 numSteps = 0;
+	while (g_game->simAccumulator >= SIM_DT && numSteps < MAX_SIM_STEPS_PER_FRAME)
+	{
+		SimulateStep(input, (r32)SIM_DT);
+		g_game->simAccumulator -= SIM_DT;
+		numSteps++;
+	}
+
+	// Too far behind to catch up, drop the backlog beyond one step rather than spiral. Keeping the partial step
+	// keeps the interpolation continuous instead of snapping back to the previous state.
+	if (numSteps == MAX_SIM_STEPS_PER_FRAME)
+		g_game->simAccumulator = Min(g_game->simAccumulator, SIM_DT);
+
+	g_game->renderAlpha = (r32)(g_game->simAccumulator / SIM_DT);
+
+	WorldPos_s playerStepDelta;
+	WorldPosSub(&playerStepDelta, &g_game->playerPos, &g_game->prevPlayerPos);
+
+	g_game->renderPlayerPos = g_game->prevPlayerPos;
+	AddSubtileOffset(&g_game->renderPlayerPos,
+	                 V2((playerStepDelta.x.tile + playerStepDelta.x.offset) * g_game->renderAlpha, (playerStepDelta.y.tile + playerStepDelta.y.offset) * g_game->renderAlpha));
+
+	g_game->cameraPos = g_game->renderPlayerPos;
 }
 
 internal void VerifyLoad(const char *msg)
@@ -447,14 +522,28 @@ internal Sprite* LoadSprite(const KeyStore* ks, const SpriteAtlas* atlas, ValueR
 	return sprite;
 }
 
-void Spr_ReadAtlasFromKeyStore(const KeyStore *ks, ValueRef avr, SpriteAtlas *atlas)
+void Spr_ReadAtlasFromKeyStore(const KeyStore *ks, ValueRef avr, SpriteAtlas *atlas, Bitmap *bitmap)
 {
 	Assert(atlas);
 	atlas->name = KS_GetKeySymbol(ks, avr, "name", ST_Intern(KS_GetStringTable(), "(unnamed)"));
 	strncpy(atlas->imageFile, KS_GetKeyString(ks, avr, "imageFile"), sizeof(atlas->imageFile));
 
 	printf("Reading atlas %s from %s\n", ST_ToString(KS_GetStringTable(), atlas->name), atlas->imageFile);
-	atlas->bitmap = Bm_MakeBitmapFromFile(nullptr, &g_game->spriteArena, atlas->imageFile);
+	atlas->bitmap = bitmap;
+	if (atlas->bitmap == nullptr)
+	{
+		atlas->bitmap = (Bitmap *)MA_Alloc(&g_game->spriteArena, sizeof(Bitmap));
+		Bm_ReadBitmapAsync(nullptr, &g_game->spriteArena, atlas->bitmap, atlas->imageFile);
+	}
+
+	// Pixel art by default, atlases drawn scaled down ask for linear or mipmapped
+	const Symbol sampling = KS_GetKeySymbol(ks, avr, "sampling");
+	if (sampling == ST_Intern(KS_GetStringTable(), "linear"))
+		Bm_SetSampling(atlas->bitmap, Bitmap::SampleLinear);
+	else if (sampling == ST_Intern(KS_GetStringTable(), "mipmapped"))
+		Bm_SetSampling(atlas->bitmap, Bitmap::SampleMipmapped);
+	else
+		Bm_SetSampling(atlas->bitmap, Bitmap::SampleNearest);
 
 	ValueRef spriteArr  = KS_ObjectGetValue(ks, avr, "sprites");
 	u32      numSprites = KS_ArrayCount(ks, spriteArr);
@@ -468,21 +557,34 @@ void Spr_ReadAtlasFromKeyStore(const KeyStore *ks, ValueRef avr, SpriteAtlas *at
 	}
 }
 
+// The frame being drawn may still read atlas pixels from the arena
+internal void ResetSpriteArena()
+{
+	plat->SyncRender();
+	MA_Reset(&g_game->spriteArena);
+}
+
 internal void LoadSprites()
 {
 	if (g_game->atlases.numAtlases > 0)
 	{
+		// Decodes still running write into the arena about to be reset
+		Bm_FinishLoads();
 		for (i32 i = 0; i < g_game->atlases.numAtlases; i++)
 		{
+			Bm_ForgetFile(g_game->atlases.atlases[i].bitmap);
 			gHwi->UnregisterBitmap(g_game->atlases.atlases[i].bitmap);
 		}
 		g_game->atlases.numAtlases = 0;
 
-		MA_Reset(&g_game->spriteArena);
+		ResetSpriteArena();
 	}
 
 	KeyStore *atlasKs = nullptr;
-	VerifyLoad(QED_LoadFile(&atlasKs, "sprites", "qed/sprites/tiledefs.qed"));
+	VerifyLoad(QED_LoadFile(&atlasKs, "sprites", SPRITE_DEFS_FILE));
+#if !HAS(RELEASE_BUILD)
+	plat->WatchFile(SPRITE_DEFS_FILE);
+#endif
 
 	Assert(atlasKs);
 
@@ -525,13 +627,92 @@ void Game_CopyAtlasTableUsingArena(MemoryArena* arena, SpriteAtlasTable* destAtl
 	}
 }
 
+// Ground layers bake in sprite UVs and the atlas bitmaps' hardware slots
+internal void InvalidateChunkLayers()
+{
+	for (u32 ci = 0; ci < countof(g_game->chunkLayers); ci++)
+		g_game->chunkLayers[ci].valid = false;
+}
+
 void Game_CopyAtlases(const SpriteAtlasTable* editorAtlases)
 {
 	g_game->atlases.numAtlases = 0;
-	MA_Reset(&g_game->spriteArena);
+	ResetSpriteArena();
 
 	Game_CopyAtlasTableUsingArena(&g_game->spriteArena, &g_game->atlases, editorAtlases);
+	InvalidateChunkLayers();
+}
+
+#if !HAS(RELEASE_BUILD)
+// The atlas table read again from the changed defs. Atlases keep their bitmap when the image is a file they already
+// had, so only new images are read; images no longer used are dropped. The sprites are made again, the old ones stay
+// in the arena until LoadSprites resets it. Defs that don't parse leave everything as it was.
+internal void ReloadSpriteDefs()
+{
+	// Loose even when the pack has the defs, that's the file that changed
+	size_t      fileSize = 0;
+	void *      text     = plat->ReadEntireFile(nullptr, SPRITE_DEFS_FILE, &fileSize);
+	KeyStore *  atlasKs  = nullptr;
+	const char *error    = text ? QED_LoadBuffer(&atlasKs, "sprites", (const char *)text, fileSize) : "Couldn't read it";
+	if (text)
+		plat->ReleaseFileBuffer(nullptr, text);
+
+	ValueRef root = atlasKs ? KS_ObjectGetValue(atlasKs, KS_Root(atlasKs), "atlases") : NilValue;
+	if (error == nullptr && (root == NilValue || KS_ArrayCount(atlasKs, root) >= MAX_ATLASES_PER_TABLE))
+		error = "No atlases, or too many";
+	if (error != nullptr)
+	{
+		fprintf(stderr, "Not reloading %s: %s\n", SPRITE_DEFS_FILE, error);
+		if (atlasKs)
+			KS_Free(&atlasKs);
+		return;
+	}
+
+	SpriteAtlasTable *table  = &g_game->atlases;
+	const u32         numOld = table->numAtlases;
+	Bitmap *          oldBitmaps[MAX_ATLASES_PER_TABLE];
+	char              oldImages[MAX_ATLASES_PER_TABLE][sizeof(table->atlases[0].imageFile)];
+	for (u32 oi = 0; oi < numOld; oi++)
+	{
+		oldBitmaps[oi] = table->atlases[oi].bitmap;
+		memcpy(oldImages[oi], table->atlases[oi].imageFile, sizeof(oldImages[oi]));
+	}
+
+	table->numAtlases = KS_ArrayCount(atlasKs, root);
+	for (u32 ai = 0; ai < table->numAtlases; ai++)
+	{
+		ValueRef    avr       = KS_ArrayElem(atlasKs, root, ai);
+		const char *imageFile = KS_GetKeyString(atlasKs, avr, "imageFile");
+
+		Bitmap *kept = nullptr;
+		for (u32 oi = 0; oi < numOld && kept == nullptr; oi++)
+		{
+			if (oldBitmaps[oi] != nullptr && strncmp(oldImages[oi], imageFile, sizeof(oldImages[oi])) == 0)
+			{
+				kept           = oldBitmaps[oi];
+				oldBitmaps[oi] = nullptr;
+			}
+		}
+		Spr_ReadAtlasFromKeyStore(atlasKs, avr, &table->atlases[ai], kept);
+	}
+	KS_Free(&atlasKs);
+
+	bool finishedLoads = false;
+	for (u32 oi = 0; oi < numOld; oi++)
+	{
+		if (oldBitmaps[oi] == nullptr)
+			continue;
+		// Its load may still be on the way, and would upload it after it's gone
+		if (!finishedLoads)
+			Bm_FinishLoads();
+		finishedLoads = true;
+		Bm_ForgetFile(oldBitmaps[oi]);
+		gHwi->UnregisterBitmap(oldBitmaps[oi]);
+	}
+
+	InvalidateChunkLayers();
 }
+#endif
 
 internal void InitGameGlobals(const SubSystem *sys, bool isReInit)
 {
@@ -556,6 +737,11 @@ internal void InitGameGlobals(const SubSystem *sys, bool isReInit)
 	gHwi->RegisterBitmap(&g_game->testBitmap);
 	gHwi->UploadBitmap(&g_game->testBitmap);
 
+	Bm_CreateBitmap(&g_game->assetArena, &g_game->whiteBitmap, 1, 1, Bitmap::Format::RGBA8, 0);
+	g_game->whiteBitmap.pixels[0] = 0xFFFFFFFF;
+	gHwi->RegisterBitmap(&g_game->whiteBitmap);
+	gHwi->UploadBitmap(&g_game->whiteBitmap);
+
 	TestKeyStore();
 
 	LoadSprites();
@@ -594,27 +780,47 @@ internal void InitGameGlobals(const SubSystem *sys, bool isReInit)
 		}
 	}
 
-	Bm_ReadBitmap(nullptr, &g_game->tileArena, &g_game->testBitmaps[0], "test/test_scene_layer_00.bmp");
-	Bm_ReadBitmap(nullptr, &g_game->tileArena, &g_game->testBitmaps[1], "test/test_scene_layer_01.bmp");
-	Bm_ReadBitmap(nullptr, &g_game->tileArena, &g_game->testBitmaps[2], "test/test_scene_layer_02.bmp");
-	Bm_ReadBitmap(nullptr, &g_game->tileArena, &g_game->testBitmaps[3], "test/test_scene_layer_03.bmp");
-	Bm_ReadBitmap(nullptr, &g_game->tileArena, &g_game->testBitmaps[4], "test/test_scene_layer_04.bmp", true);
+	g_game->prevPlayerPos   = g_game->playerPos;
+	g_game->renderPlayerPos = g_game->playerPos;
 
-	Bm_ReadBitmap(nullptr, &g_game->tileArena, &g_game->playerBmps[0][0], "test/test_hero_back_head.bmp");
-	Bm_ReadBitmap(nullptr, &g_game->tileArena, &g_game->playerBmps[0][1], "test/test_hero_back_cape.bmp");
-	Bm_ReadBitmap(nullptr, &g_game->tileArena, &g_game->playerBmps[0][2], "test/test_hero_back_torso.bmp");
+	// Wanderers scattered over the empty tiles around the start room
+	for (u32 bodyIdx = 0; bodyIdx < NUM_WANDER_BODIES; bodyIdx++)
+	{
+		const u32  seed     = HashU32(bodyIdx + 1);
+		WorldPos_s spawnPos = {};
+		spawnPos.x.tile     = (i32)(seed % (ROOM_WID * 3)) - ROOM_WID;
+		spawnPos.y.tile     = (i32)((seed >> 16) % (ROOM_HGT * 3)) - ROOM_HGT;
+		if (GetTileValue(&g_game->world, &spawnPos) != TILE_EMPTY)
+			continue;
+		Sim_AddBody(&g_game->sim, WorldPosToMeters(&spawnPos), V2(0.2f, 0.2f), seed);
+	}
+
+	Bm_ReadBitmapAsync(nullptr, &g_game->tileArena, &g_game->testBitmaps[0], "test/test_scene_layer_00.bmp");
+	Bm_ReadBitmapAsync(nullptr, &g_game->tileArena, &g_game->testBitmaps[1], "test/test_scene_layer_01.bmp");
+	Bm_ReadBitmapAsync(nullptr, &g_game->tileArena, &g_game->testBitmaps[2], "test/test_scene_layer_02.bmp");
+	Bm_ReadBitmapAsync(nullptr, &g_game->tileArena, &g_game->testBitmaps[3], "test/test_scene_layer_03.bmp");
+	Bm_ReadBitmapAsync(nullptr, &g_game->tileArena, &g_game->testBitmaps[4], "test/test_scene_layer_04.bmp", true);
+
+	Bm_ReadBitmapAsync(nullptr, &g_game->tileArena, &g_game->playerBmps[0][0], "test/test_hero_back_head.bmp");
+	Bm_ReadBitmapAsync(nullptr, &g_game->tileArena, &g_game->playerBmps[0][1], "test/test_hero_back_cape.bmp");
+	Bm_ReadBitmapAsync(nullptr, &g_game->tileArena, &g_game->playerBmps[0][2], "test/test_hero_back_torso.bmp");
 
-	Bm_ReadBitmap(nullptr, &g_game->tileArena, &g_game->playerBmps[1][0], "test/test_hero_right_head.bmp");
-	Bm_ReadBitmap(nullptr, &g_game->tileArena, &g_game->playerBmps[1][1], "test/test_hero_right_cape.bmp");
-	Bm_ReadBitmap(nullptr, &g_game->tileArena, &g_game->playerBmps[1][2], "test/test_hero_right_torso.bmp");
+	Bm_ReadBitmapAsync(nullptr, &g_game->tileArena, &g_game->playerBmps[1][0], "test/test_hero_right_head.bmp");
+	Bm_ReadBitmapAsync(nullptr, &g_game->tileArena, &g_game->playerBmps[1][1], "test/test_hero_right_cape.bmp");
+	Bm_ReadBitmapAsync(nullptr, &g_game->tileArena, &g_game->playerBmps[1][2], "test/test_hero_right_torso.bmp");
 
-	Bm_ReadBitmap(nullptr, &g_game->tileArena, &g_game->playerBmps[2][0], "test/test_hero_front_head.bmp");
-	Bm_ReadBitmap(nullptr, &g_game->tileArena, &g_game->playerBmps[2][1], "test/test_hero_front_cape.bmp");
-	Bm_ReadBitmap(nullptr, &g_game->tileArena, &g_game->playerBmps[2][2], "test/test_hero_front_torso.bmp");
+	Bm_ReadBitmapAsync(nullptr, &g_game->tileArena, &g_game->playerBmps[2][0], "test/test_hero_front_head.bmp");
+	Bm_ReadBitmapAsync(nullptr, &g_game->tileArena, &g_game->playerBmps[2][1], "test/test_hero_front_cape.bmp");
+	Bm_ReadBitmapAsync(nullptr, &g_game->tileArena, &g_game->playerBmps[2][2], "test/test_hero_front_torso.bmp");
 
-	Bm_ReadBitmap(nullptr, &g_game->tileArena, &g_game->playerBmps[3][0], "test/test_hero_left_head.bmp");
-	Bm_ReadBitmap(nullptr, &g_game->tileArena, &g_game->playerBmps[3][1], "test/test_hero_left_cape.bmp");
-	Bm_ReadBitmap(nullptr, &g_game->tileArena, &g_game->playerBmps[3][2], "test/test_hero_left_torso.bmp");
+	Bm_ReadBitmapAsync(nullptr, &g_game->tileArena, &g_game->playerBmps[3][0], "test/test_hero_left_head.bmp");
+	Bm_ReadBitmapAsync(nullptr, &g_game->tileArena, &g_game->playerBmps[3][1], "test/test_hero_left_cape.bmp");
+	Bm_ReadBitmapAsync(nullptr, &g_game->tileArena, &g_game->playerBmps[3][2], "test/test_hero_left_torso.bmp");
+
+	InitBitmapSprite(&g_game->whiteSprite, &g_game->whiteBitmap);
+	for (u32 facing = 0; facing < 4; facing++)
+		for (u32 part = 0; part < 3; part++)
+			InitBitmapSprite(&g_game->playerSprites[facing][part], &g_game->playerBmps[facing][part]);
 }
 
 static u32 RoundReal(r32 val)
@@ -697,21 +903,6 @@ internal void ClipRectToBmp(const Bitmap *bmp, i32 *bx, i32 *by, i32 *bw, i32 *b
 	*bh = by1 - *by;
 }
 
-static inline void BlendPixel(u32 &dest, const u32 src)
-{
-	const u64 a = (src >> 24) + 1;
-
-	const u64 destGRB = (((u64)dest & 0x00FF00) << 24) | (dest & 0xFF00FF);
-	const u64 srcGRB  = (((u64)src & 0x00FF00) << 24) | (src & 0xFF00FF);
-
-	u64 dGRB = srcGRB - destGRB;
-	dGRB *= a;
-	dGRB >>= 8;
-
-	const u64 GRB = destGRB + dGRB;
-	dest          = (u32)(GRB & 0xFF00FF) | (u32)((GRB & 0xFF00000000ull) >> 24);
-}
-
 internal void BltBmpFixed(ThreadContext *thread, Bitmap *dest, i32 dx, i32 dy, const Bitmap *src)
 {
 	i32 sx = 0, sy = 0;
@@ -744,8 +935,7 @@ internal void BltBmpFixed(ThreadContext *thread, Bitmap *dest, i32 dx, i32 dy, c
 	{
 		u32 *const srcXelRow  = src->pixels + (sy + y) * src->pitch;
 		u32 *const destXelRow = dest->pixels + (dy + y) * dest->pitch;
-		for (i32 x = 0; x < sw; x++)
-			BlendPixel(destXelRow[x + dx], srcXelRow[x]);
+		Px_BlendSpan(destXelRow + dx, srcXelRow + sx, sw, PX_WHITE, PX_BLEND_OVER);
 	}
 }
 
@@ -799,7 +989,7 @@ internal void BltBmpStretched(ThreadContext *thread, Bitmap *dest, r32 rdx, r32
 		u32 *srcXelRow  = src->pixels + (curSy >> 16) * src->pitch;
 		u32 *destXelRow = dest->pixels + (dy + y) * dest->pitch;
 		for (i32 x = 0; x < dw; x++, curSx += sdx)
-			BlendPixel(destXelRow[x + dx], srcXelRow[curSx >> 16]);
+			destXelRow[x + dx] = Px_BlendPixel(destXelRow[x + dx], srcXelRow[curSx >> 16], PX_BLEND_OVER);
 	}
 #else
 	Rect srcRect, destRect;
@@ -840,6 +1030,390 @@ void Spr_DrawSpriteFrame(const Sprite *sprite, u32 frameIdx, const r32 dx, const
 	gHwi->BlitStretchedUV((Bitmap *)atlasBmp, frame->topLeftUV, frame->bottomRightUV, &dest, sprite->tint);
 }
 
+// Key and index buffers for the draw list sort, ping ponged between passes
+internal u32 s_drawListKeys[2][SPR_MAX_DRAW_LIST_ENTRIES];
+internal u32 s_drawListIdxs[2][SPR_MAX_DRAW_LIST_ENTRIES];
+
+// LSD radix sort, 8 bits a pass. Stable, so equal keys keep submission order. Passes where every key lands in one
+// bucket are skipped. Returns which buffer of s_drawListKeys / s_drawListIdxs holds the result.
+internal u32 RadixSortDrawKeys(u32 count)
+{
+	u32 src = 0;
+	for (u32 shift = 0; shift < 32; shift += 8)
+	{
+		u32 counts[256] = {};
+		for (u32 i = 0; i < count; i++)
+			counts[(s_drawListKeys[src][i] >> shift) & 0xFF]++;
+
+		if (counts[(s_drawListKeys[src][0] >> shift) & 0xFF] == count)
+			continue;
+
+		u32 offsets[256];
+		u32 total = 0;
+		for (u32 b = 0; b < 256; b++)
+		{
+			offsets[b] = total;
+			total += counts[b];
+		}
+
+		const u32 dst = src ^ 1;
+		for (u32 i = 0; i < count; i++)
+		{
+			const u32 key                = s_drawListKeys[src][i];
+			const u32 slot               = offsets[(key >> shift) & 0xFF]++;
+			s_drawListKeys[dst][slot] = key;
+			s_drawListIdxs[dst][slot] = s_drawListIdxs[src][i];
+		}
+		src = dst;
+	}
+	return src;
+}
+
+internal u32 ModulateColor(u32 a, u32 b)
+{
+	if (b == 0xFFFFFFFF)
+		return a;
+
+	u32 result = 0;
+	for (u32 shift = 0; shift < 32; shift += 8)
+		result |= ((((a >> shift) & 0xFF) * ((b >> shift) & 0xFF) + 0xFF) >> 8) << shift;
+	return result;
+}
+
+void Spr_DrawList(Bitmap *dest, const SpriteDLEntry *entries, u32 numEntries)
+{
+	Assert(numEntries <= SPR_MAX_DRAW_LIST_ENTRIES);
+
+	// Atlas bitmaps seen this call, the key holds the slot
+	const Bitmap *atlasBitmaps[256];
+	u32           numAtlases = 0;
+	u32           lastAtlas  = 0;
+
+	// Cull and build keys, layer:8 atlas:8 y:16
+	const i32 destWid = (i32)dest->width;
+	const i32 destHgt = (i32)dest->height;
+	u32       numDraw = 0;
+	for (u32 ei = 0; ei < numEntries; ei++)
+	{
+		const SpriteDLEntry *entry = &entries[ei];
+		if (entry->sprite == nullptr)
+			continue;
+
+		const i32 w = entry->w ? entry->w : entry->sprite->size.x;
+		const i32 h = entry->h ? entry->h : entry->sprite->size.y;
+		if (entry->x + w <= 0 || entry->y + h <= 0 || entry->x >= destWid || entry->y >= destHgt)
+			continue;
+
+		const Bitmap *bitmap = entry->sprite->atlas->bitmap;
+		if (numAtlases == 0 || atlasBitmaps[lastAtlas] != bitmap)
+		{
+			lastAtlas = 0;
+			while (lastAtlas < numAtlases && atlasBitmaps[lastAtlas] != bitmap)
+				lastAtlas++;
+			if (lastAtlas == numAtlases)
+			{
+				Assert(numAtlases < countof(atlasBitmaps));
+				atlasBitmaps[numAtlases++] = bitmap;
+			}
+		}
+
+		Assert(entry->layer < SPR_MAX_DRAW_LIST_LAYERS);
+		s_drawListKeys[0][numDraw] = ((u32)entry->layer << 24) | (lastAtlas << 16) | (u16)(entry->y + 0x8000);
+		s_drawListIdxs[0][numDraw] = ei;
+		numDraw++;
+	}
+
+	if (numDraw == 0)
+		return;
+
+	const u32  sorted = RadixSortDrawKeys(numDraw);
+	const u32 *keys   = s_drawListKeys[sorted];
+	const u32 *idxs   = s_drawListIdxs[sorted];
+
+	if (dest != g_game->screenBitmap)
+		gHwi->PushRenderTarget(dest);
+
+	// One append per run of the same atlas, written out in a single pass
+	u32 runStart = 0;
+	while (runStart < numDraw)
+	{
+		const u32 atlasSlot = (keys[runStart] >> 16) & 0xFF;
+		u32       runEnd    = runStart + 1;
+		while (runEnd < numDraw && ((keys[runEnd] >> 16) & 0xFF) == atlasSlot)
+			runEnd++;
+
+		HwiSprite *out = gHwi->AppendSprites((Bitmap *)atlasBitmaps[atlasSlot], runEnd - runStart);
+		for (u32 si = runStart; si < runEnd; si++, out++)
+		{
+			const SpriteDLEntry *entry  = &entries[idxs[si]];
+			const Sprite *       sprite = entry->sprite;
+			Assert(entry->frame < sprite->numFrames);
+			const SpriteFrame *frame = &sprite->frames[entry->frame];
+
+			out->dest[0] = entry->x;
+			out->dest[1] = entry->y;
+			out->dest[2] = entry->w ? entry->w : sprite->size.x;
+			out->dest[3] = entry->h ? entry->h : sprite->size.y;
+			out->uv[0]   = frame->topLeftUV.x;
+			out->uv[1]   = frame->topLeftUV.y;
+			out->uv[2]   = frame->bottomRightUV.x;
+			out->uv[3]   = frame->bottomRightUV.y;
+			out->color   = ModulateColor(entry->tint.color, sprite->tint.color);
+		}
+		runStart = runEnd;
+	}
+
+	if (dest != g_game->screenBitmap)
+		gHwi->PopRenderTarget();
+}
+
+// Lets a plain bitmap go through the draw list as a one frame sprite
+internal void InitBitmapSprite(BitmapSprite_s *bmpSprite, Bitmap *bitmap)
+{
+	SpriteAtlas *atlas = &bmpSprite->atlas;
+	Sprite *     sprite = &bmpSprite->sprite;
+
+	atlas->imageFile[0] = '\0';
+	atlas->name         = 0;
+	atlas->bitmap       = bitmap;
+	atlas->baseOrigin   = iv2(0, 0);
+	atlas->baseSize     = iv2((i32)bitmap->width, (i32)bitmap->height);
+	atlas->numSprites   = 1;
+	atlas->sprites[0]   = sprite;
+
+	sprite->atlas     = atlas;
+	sprite->name      = 0;
+	sprite->tint      = ColorU(255, 255, 255, 255);
+	sprite->size      = atlas->baseSize;
+	sprite->origin    = iv2(0, 0);
+	sprite->numFrames = 1;
+	sprite->frames    = &bmpSprite->frame;
+
+	bmpSprite->frame.topLeftUV     = V2(0.0f, 0.0f);
+	bmpSprite->frame.bottomRightUV = V2(1.0f, 1.0f);
+	bmpSprite->frame.weight        = 1.0f;
+}
+
+internal i16 ToPixelCoord(r32 val)
+{
+	return (i16)Qi_Clamp<i32>(RoundIReal(val), -0x8000, 0x7FFF);
+}
+
+// Fills an entry over the pixel rect, rounding both edges like DrawRectangle so neighbours don't leave gaps
+internal void SetDrawEntry(SpriteDLEntry *entry, const Sprite *sprite, r32 x, r32 y, r32 w, r32 h, u32 layer, ColorU tint)
+{
+	entry->sprite = sprite;
+	entry->x      = ToPixelCoord(x);
+	entry->y      = ToPixelCoord(y);
+	entry->w      = (i16)Max(ToPixelCoord(x + w) - entry->x, 1);
+	entry->h      = (i16)Max(ToPixelCoord(y + h) - entry->y, 1);
+	entry->frame  = 0;
+	entry->layer  = (u16)layer;
+	entry->tint   = tint;
+}
+
+// Ground and tile sprites for one chunk, in chunk local pixels, written by one job per tile row. Walls and invalid
+// tiles go to the start of their row's slots and get compacted afterwards.
+struct ChunkLayerBuildJob_s
+{
+	World_s *          world;
+	const SpriteAtlas *groundAtlas;
+	i32                baseTileX, baseTileY;
+	r32                tilePixelWid, tilePixelHgt;
+	HwiSprite *        ground;
+	HwiSprite *        walls;
+	HwiSprite *        invalid;
+	u32                numWalls[TILE_CHUNK_DIM];
+	u32                numInvalid[TILE_CHUNK_DIM];
+};
+
+internal void SetTileSprite(HwiSprite *out, i32 x, i32 y, const ChunkLayerBuildJob_s *job, v2 uvTL, v2 uvBR, u32 color)
+{
+	out->dest[0] = x * job->tilePixelWid;
+	out->dest[1] = y * job->tilePixelHgt;
+	out->dest[2] = job->tilePixelWid;
+	out->dest[3] = job->tilePixelHgt;
+	out->uv[0]   = uvTL.x;
+	out->uv[1]   = uvTL.y;
+	out->uv[2]   = uvBR.x;
+	out->uv[3]   = uvBR.y;
+	out->color   = color;
+}
+
+internal void ChunkLayerBuildJob(void *userData, u32 row)
+{
+	ChunkLayerBuildJob_s *job     = (ChunkLayerBuildJob_s *)userData;
+	const SpriteAtlas *   atlas   = job->groundAtlas;
+	const u32             rowBase = row * TILE_CHUNK_DIM;
+	const u32             white   = 0xFFFFFFFF;
+	const u32             red     = ColorU(Color(1.0f, 0.2f, 0.2f, 1.0f)).color;
+
+	NoiseGenerator rnd(1);
+	u32            numWalls   = 0;
+	u32            numInvalid = 0;
+	for (i32 x = 0; x < TILE_CHUNK_DIM; x++)
+	{
+		const r32 tx = (r32)(job->baseTileX + x);
+		const r32 ty = (r32)(job->baseTileY + (i32)row);
+
+		r32           rn        = rnd.Perlin2D(tx, ty, 10.0f) + 1 / 2;
+		u32           spriteIdx = Qi_Clamp<u32>((u32)(rn * atlas->numSprites + 0.5f), 0, atlas->numSprites - 1);
+		const Sprite *sprite    = atlas->sprites[spriteIdx];
+		const u32     frameIdx  = rnd.Get(tx * ty * 234521) % sprite->numFrames;
+		SetTileSprite(&job->ground[rowBase + x], x, row, job, sprite->frames[frameIdx].topLeftUV, sprite->frames[frameIdx].bottomRightUV, sprite->tint.color);
+
+		const u32 tileValue = GetTileValue(job->world, job->baseTileX + x, job->baseTileY + (i32)row);
+		if (tileValue == TILE_INVALID)
+			SetTileSprite(&job->invalid[rowBase + numInvalid++], x, row, job, V2(0.0f, 0.0f), V2(1.0f, 1.0f), red);
+		else if (tileValue != TILE_EMPTY)
+			SetTileSprite(&job->walls[rowBase + numWalls++], x, row, job, V2(0.0f, 0.0f), V2(1.0f, 1.0f), white);
+	}
+	job->numWalls[row]   = numWalls;
+	job->numInvalid[row] = numInvalid;
+}
+
+internal u32 CompactTileRows(HwiSprite *sprites, const u32 *rowCounts)
+{
+	u32 count = 0;
+	for (u32 row = 0; row < TILE_CHUNK_DIM; row++)
+	{
+		memmove(&sprites[count], &sprites[row * TILE_CHUNK_DIM], rowCounts[row] * sizeof(HwiSprite));
+		count += rowCounts[row];
+	}
+	return count;
+}
+
+internal HwiSprite s_chunkLayerScratch[3][TILE_CHUNK_DIM * TILE_CHUNK_DIM];
+
+internal void BuildChunkLayers(ChunkLayerCache_s *layers, r32 tilePixelWid, r32 tilePixelHgt)
+{
+	ChunkLayerBuildJob_s job;
+	job.world        = &g_game->world;
+	job.groundAtlas  = &g_game->atlases.atlases[1];
+	job.baseTileX    = layers->chunkX * TILE_CHUNK_DIM;
+	job.baseTileY    = layers->chunkY * TILE_CHUNK_DIM;
+	job.tilePixelWid = tilePixelWid;
+	job.tilePixelHgt = tilePixelHgt;
+	job.ground       = s_chunkLayerScratch[0];
+	job.walls        = s_chunkLayerScratch[1];
+	job.invalid      = s_chunkLayerScratch[2];
+
+	if (job.groundAtlas->numSprites > 0)
+	{
+		plat->ParallelFor(ChunkLayerBuildJob, &job, TILE_CHUNK_DIM);
+
+		const u32 numWalls   = CompactTileRows(job.walls, job.numWalls);
+		const u32 numInvalid = CompactTileRows(job.invalid, job.numInvalid);
+		gHwi->UploadSpriteCache(&layers->ground, job.groundAtlas->bitmap, job.ground, TILE_CHUNK_DIM * TILE_CHUNK_DIM);
+		gHwi->UploadSpriteCache(&layers->walls, &g_game->testBitmaps[1], job.walls, numWalls);
+		gHwi->UploadSpriteCache(&layers->invalid, &g_game->whiteBitmap, job.invalid, numInvalid);
+	}
+	else
+	{
+		gHwi->ReleaseSpriteCache(&layers->ground);
+		gHwi->ReleaseSpriteCache(&layers->walls);
+		gHwi->ReleaseSpriteCache(&layers->invalid);
+	}
+
+	TileChunk_s *chunk   = GetChunk(&g_game->world, job.baseTileX, job.baseTileY);
+	layers->chunkVersion = chunk ? chunk->version : 0;
+	layers->valid        = true;
+}
+
+// Cached layers for a chunk, rebuilt if its tiles changed. Misses take the least recently drawn entry.
+internal ChunkLayerCache_s *GetChunkLayers(i32 chunkX, i32 chunkY, r32 tilePixelWid, r32 tilePixelHgt)
+{
+	ChunkLayerCache_s *layers = nullptr;
+	for (u32 ci = 0; ci < countof(g_game->chunkLayers); ci++)
+	{
+		ChunkLayerCache_s *cached = &g_game->chunkLayers[ci];
+		if (cached->valid && cached->chunkX == chunkX && cached->chunkY == chunkY)
+		{
+			layers = cached;
+			break;
+		}
+		if (cached->lastUsedFrame != g_game->renderFrame && (layers == nullptr || !cached->valid || (layers->valid && cached->lastUsedFrame < layers->lastUsedFrame)))
+			layers = cached;
+	}
+	Assert(layers);
+
+	if (!layers->valid || layers->chunkX != chunkX || layers->chunkY != chunkY)
+	{
+		layers->chunkX = chunkX;
+		layers->chunkY = chunkY;
+		layers->valid  = false;
+	}
+
+	const TileChunk_s *chunk = GetChunk(&g_game->world, chunkX * TILE_CHUNK_DIM, chunkY * TILE_CHUNK_DIM);
+	if (!layers->valid || layers->chunkVersion != (chunk ? chunk->version : 0))
+		BuildChunkLayers(layers, tilePixelWid, tilePixelHgt);
+
+	layers->lastUsedFrame = g_game->renderFrame;
+	return layers;
+}
+
+struct BodyEntriesJob_s
+{
+	SpriteDLEntry *  entries;
+	const EntSpan_s *spans;
+	const u32 *      firstEntries; // Where each span's entries start
+	const Sprite *   whiteSprite;
+	v2               halfScreen;
+	v2               camPosMeters;
+	r32              alpha;
+};
+
+internal void BodyEntriesJob(void *userData, u32 jobIdx)
+{
+	const BodyEntriesJob_s *job       = (const BodyEntriesJob_s *)userData;
+	const EntSpan_s *       span      = &job->spans[jobIdx];
+	const TransformComp_s * xforms    = span->Get<TransformComp_s>();
+	const ColliderComp_s *  colliders = span->Get<ColliderComp_s>();
+	SpriteDLEntry *         entries   = job->entries + job->firstEntries[jobIdx];
+	const ColorU            tint      = Color(0.2f, 0.6f, 1.0f, 1.0f);
+
+	for (u32 ei = 0; ei < span->count; ei++)
+	{
+		const v2 radii    = colliders[ei].radii;
+		const v2 bodyMin  = MetersToScreenPixels(Sim_RenderPos(&xforms[ei], job->alpha) - radii - job->camPosMeters) + job->halfScreen;
+		const v2 bodySize = MetersToScreenPixels(radii * 2.0f);
+		SetDrawEntry(&entries[ei], job->whiteSprite, bodyMin.x, bodyMin.y, bodySize.x, bodySize.y, DRAW_LAYER_BODIES, tint);
+	}
+}
+
+#if !HAS(RELEASE_BUILD)
+// Reloads whatever depends on data files that changed since last frame, and only that. Bitmaps read again on jobs and
+// carry on drawing what they had, unless their size changed.
+internal void ReloadChangedFiles()
+{
+	char fileName[256];
+	while (plat->NextFileChange(fileName, sizeof(fileName)))
+	{
+		printf("Changed: %s\n", fileName);
+		if (strcmp(fileName, SPRITE_DEFS_FILE) == 0)
+		{
+			ReloadSpriteDefs();
+			continue;
+		}
+
+		if (!Bm_ReloadFile(fileName))
+			continue;
+
+		// Bitmaps made again at a new size have new hardware slots, and sprites with UVs worked out from the old size
+		InvalidateChunkLayers();
+		for (u32 facing = 0; facing < 4; facing++)
+			for (u32 part = 0; part < 3; part++)
+				InitBitmapSprite(&g_game->playerSprites[facing][part], &g_game->playerBmps[facing][part]);
+
+		bool isAtlasImage = false;
+		for (u32 ai = 0; ai < g_game->atlases.numAtlases && !isAtlasImage; ai++)
+			isAtlasImage = strncmp(g_game->atlases.atlases[ai].imageFile, fileName, sizeof(g_game->atlases.atlases[ai].imageFile)) == 0;
+		if (isAtlasImage)
+			ReloadSpriteDefs();
+	}
+}
+#endif
+
 void Qi_GameUpdateAndRender(ThreadContext *, Input *input, Bitmap *screenBitmap)
 {
 	static NoiseGenerator noise(1234);
@@ -849,7 +1423,11 @@ void Qi_GameUpdateAndRender(ThreadContext *, Input *input, Bitmap *screenBitmap)
 	g_game->screenHgt    = screenBitmap->height;
 
 	Assert(g_game && g_game->isInitialized);
-	UpdateGameState(screenBitmap, input);
+#if !HAS(RELEASE_BUILD)
+	ReloadChangedFiles();
+#endif
+	Bm_UpdateLoads();
+	UpdateGameState(input);
 
 	// Clear screen
 	// DrawRectangle(screenBitmap, 0.0f, 0.0f, (r32)screenBitmap->width, (r32)screenBitmap->height, 0.0f, 0.0f, 1.0f);
@@ -871,6 +1449,9 @@ void Qi_GameUpdateAndRender(ThreadContext *, Input *input, Bitmap *screenBitmap)
 		Editor_UpdateAndRender();
 	}
 
+	SpriteDLEntry *drawList    = g_game->drawList;
+	u32            numDrawList = 0;
+
 #if 0
 	if (drawBG)
 		for (i32 i = 4; i >= 0; i--)
@@ -894,59 +1475,65 @@ void Qi_GameUpdateAndRender(ThreadContext *, Input *input, Bitmap *screenBitmap)
 		}
 	}
 #else
-	NoiseGenerator rnd(1);
-	SpriteAtlas* atlas = &g_game->atlases.atlases[1];
-
-	for (i32 row = -1; row < numScreenTilesY + 1; row++)
+	// Ground and tiles come from the chunk caches, one draw per layer per chunk on screen
+	g_game->renderFrame++;
+
+	const i32 firstTileX  = g_game->cameraPos.x.tile - numScreenTilesX / 2 - 1;
+	const i32 firstTileY  = g_game->cameraPos.y.tile - numScreenTilesY / 2 - 1;
+	const i32 firstChunkX = firstTileX >> TILE_CHUNK_BITS;
+	const i32 firstChunkY = firstTileY >> TILE_CHUNK_BITS;
+	const i32 lastChunkX  = (firstTileX + numScreenTilesX + 1) >> TILE_CHUNK_BITS;
+	const i32 lastChunkY  = (firstTileY + numScreenTilesY + 1) >> TILE_CHUNK_BITS;
+
+	ChunkLayerCache_s *visibleLayers[MAX_CACHED_CHUNK_LAYERS];
+	v2                 visibleOffsets[MAX_CACHED_CHUNK_LAYERS];
+	u32                numVisible = 0;
+	for (i32 chunkY = firstChunkY; chunkY <= lastChunkY; chunkY++)
 	{
-		for (i32 col = -1; col < numScreenTilesX + 1; col++)
+		for (i32 chunkX = firstChunkX; chunkX <= lastChunkX; chunkX++)
 		{
-			const r32 sx        = col * tilePixelWid - tilePixelWid / 2 - cameraOffsetPixelsX;
-			const r32 sy        = row * tilePixelHgt - tilePixelHgt / 2 - cameraOffsetPixelsY;
-
-			const r32 tx = col + g_game->playerPos.x.tile;
-			const r32 ty = row + g_game->playerPos.y.tile;
-			r32 rn = rnd.Perlin2D(tx, ty, 10.0f) + 1 / 2;
-			u32 spriteIdx = Qi_Clamp<u32>((u32)(rn * atlas->numSprites + 0.5f), 0, atlas->numSprites - 1);
-			Sprite *  sprite    = atlas->sprites[spriteIdx];
-			Spr_DrawSpriteFrame(sprite, rnd.Get(tx * ty * 234521) % sprite->numFrames, sx, sy, tilePixelWid, tilePixelHgt);
+			Assert(numVisible < MAX_CACHED_CHUNK_LAYERS);
+			visibleLayers[numVisible]  = GetChunkLayers(chunkX, chunkY, tilePixelWid, tilePixelHgt);
+			visibleOffsets[numVisible] = V2((chunkX * TILE_CHUNK_DIM - firstTileX - 1) * tilePixelWid - tilePixelWid / 2 - cameraOffsetPixelsX,
+			                                (chunkY * TILE_CHUNK_DIM - firstTileY - 1) * tilePixelHgt - tilePixelHgt / 2 - cameraOffsetPixelsY);
+			numVisible++;
 		}
 	}
-#endif
 
-	for (i32 row = -1; row < numScreenTilesY + 1; row++)
+	for (u32 vi = 0; vi < numVisible; vi++)
+		gHwi->DrawSpriteCache(&visibleLayers[vi]->ground, visibleOffsets[vi]);
+	for (u32 vi = 0; vi < numVisible; vi++)
 	{
-		for (i32 col = -1; col < numScreenTilesX + 1; col++)
-		{
-			const r32 sx = col * tilePixelWid - tilePixelWid / 2 - cameraOffsetPixelsX;
-			const r32 sy = row * tilePixelHgt - tilePixelHgt / 2 - cameraOffsetPixelsY;
-
-			WorldPos_s tileCoord = {};
-			tileCoord.x.tile     = col + g_game->cameraPos.x.tile - numScreenTilesX / 2;
-			tileCoord.y.tile     = row + g_game->cameraPos.y.tile - numScreenTilesY / 2;
-
-			u32 tileValue = GetTileValue(&g_game->world, &tileCoord);
-#if 0
-			if (tileCoord.x.tile == g_game->playerPos.x.tile && tileCoord.y.tile == g_game->playerPos.y.tile)
-				DrawRectangle(screenBitmap, sx, sy, tilePixelWid, tilePixelHgt, 0.1f, 0.1f, 0.1f);
-			else if (tileValue == TILE_INVALID)
-				DrawRectangle(screenBitmap, sx, sy, tilePixelWid, tilePixelHgt, 1.0f, 0.2f, 0.2f);
-			else if (tileValue == TILE_EMPTY)
-				DrawRectangle(screenBitmap, sx, sy, tilePixelWid, tilePixelHgt, 0.3f, 0.3f, 0.3f);
-			else
-				DrawRectangle(screenBitmap, sx, sy, tilePixelWid, tilePixelHgt, .8f, .8f, .8f);
-#else
-			if (tileValue == TILE_INVALID)
-				DrawRectangle(screenBitmap, sx, sy, tilePixelWid, tilePixelHgt, 1.0f, 0.2f, 0.2f);
-			else if (tileValue != TILE_EMPTY)
-				BltBmpStretched(
-					nullptr, screenBitmap, sx, sy, tilePixelWid, tilePixelHgt, &g_game->testBitmaps[1], 0, 0, g_game->testBitmaps[1].width, g_game->testBitmaps[1].height);
+		gHwi->DrawSpriteCache(&visibleLayers[vi]->walls, visibleOffsets[vi]);
+		gHwi->DrawSpriteCache(&visibleLayers[vi]->invalid, visibleOffsets[vi]);
+	}
 #endif
-		}
+
+	// A job per chunk of bodies
+	EntSpan_s bodySpans[QI_ENT_MAX_CHUNKS];
+	u32       bodyFirstEntries[QI_ENT_MAX_CHUNKS];
+	const u32 numBodySpans = Sim_QueryBodies(bodySpans);
+	u32       numBodies    = 0;
+	for (u32 si = 0; si < numBodySpans; si++)
+	{
+		bodyFirstEntries[si] = numBodies;
+		numBodies += bodySpans[si].count;
 	}
 
+	BodyEntriesJob_s bodyJob;
+	Assert(numDrawList + numBodies + 5 <= SPR_MAX_DRAW_LIST_ENTRIES);
+	bodyJob.entries      = drawList + numDrawList;
+	bodyJob.spans        = bodySpans;
+	bodyJob.firstEntries = bodyFirstEntries;
+	bodyJob.whiteSprite  = &g_game->whiteSprite.sprite;
+	bodyJob.halfScreen   = V2(screenBitmap->width / 2.0f, screenBitmap->height / 2.0f);
+	bodyJob.camPosMeters = WorldPosToMeters(&g_game->cameraPos);
+	bodyJob.alpha        = g_game->renderAlpha;
+	plat->ParallelFor(BodyEntriesJob, &bodyJob, numBodySpans);
+	numDrawList += numBodies;
+
 	WorldPos_s playerCameraDelta = {};
-	WorldPosSub(&playerCameraDelta, &g_game->playerPos, &g_game->cameraPos);
+	WorldPosSub(&playerCameraDelta, &g_game->renderPlayerPos, &g_game->cameraPos);
 
 	const r32 playerOffsetPixelsX = (playerCameraDelta.x.tile + playerCameraDelta.x.offset) * tilePixelWid;
 	const r32 playerOffsetPixelsY = (playerCameraDelta.y.tile + playerCameraDelta.y.offset) * tilePixelHgt;
@@ -962,11 +1549,16 @@ void Qi_GameUpdateAndRender(ThreadContext *, Input *input, Bitmap *screenBitmap)
 	r32 playerWid = tilePixelWid;
 	r32 playerHgt = tilePixelHgt;
 
-	DrawRectangle(screenBitmap, playerX, playerY, playerWid, playerHgt, playerR, playerG, playerB);
-	BltBmpStretchedFixed(nullptr, screenBitmap, playerX, playerY, playerWid, playerHgt, &g_game->playerBmps[g_game->playerFacingIdx][0]);
-	BltBmpStretchedFixed(nullptr, screenBitmap, playerX, playerY, playerWid, playerHgt, &g_game->playerBmps[g_game->playerFacingIdx][1]);
-	BltBmpStretchedFixed(nullptr, screenBitmap, playerX, playerY, playerWid, playerHgt, &g_game->playerBmps[g_game->playerFacingIdx][2]);
-	DrawRectangle(screenBitmap, playerPosX - 2, playerPosY - 2, 4, 4, 0.0f, 0.0f, 1.0f);
+	const Sprite *whiteSprite = &g_game->whiteSprite.sprite;
+	SetDrawEntry(&drawList[numDrawList++], whiteSprite, playerX, playerY, playerWid, playerHgt, DRAW_LAYER_PLAYER, Color(playerR, playerG, playerB, 1.0f));
+	for (u32 part = 0; part < 3; part++)
+	{
+		const Sprite *partSprite = &g_game->playerSprites[g_game->playerFacingIdx][part].sprite;
+		SetDrawEntry(&drawList[numDrawList++], partSprite, playerX, playerY, playerWid, playerHgt, DRAW_LAYER_PLAYER + 1 + part, ColorU(255, 255, 255, 255));
+	}
+	SetDrawEntry(&drawList[numDrawList++], whiteSprite, playerPosX - 2, playerPosY - 2, 4, 4, DRAW_LAYER_PLAYER_MARK, Color(0.0f, 0.0f, 1.0f, 1.0f));
+
+	Spr_DrawList(screenBitmap, drawList, numDrawList);
 
 	DrawDebugShapes(screenBitmap);
 }
@@ -981,7 +1573,11 @@ extern SubSystem KeyStoreSubsystem;
 extern SubSystem DebugSubSystem;
 extern SubSystem UtilSubSystem;
 extern SubSystem HardwareSubSystem;
+extern SubSystem SoftHardwareSubSystem;
 extern SubSystem EditorSubSystem;
+extern SubSystem EntitySubSystem;
+extern SubSystem BitmapSubSystem;
+extern SubSystem PackSubSystem;
 
 SubSystem GameSubSystem = {"Game", InitGameGlobals, sizeof(GameGlobals_s), nullptr};
 
@@ -989,10 +1585,17 @@ internal SubSystem *s_subSystems[] = {
 #if !HAS(RELEASE_BUILD)
 	&DebugSubSystem,
 #endif
+	&PackSubSystem,
+#if HAS(SOFT_RENDER)
+	&SoftHardwareSubSystem,
+#else
 	&HardwareSubSystem,
+#endif
+	&BitmapSubSystem,
 	&KeyStoreSubsystem,
 	&SoundSubSystem,
 	&UtilSubSystem,
+	&EntitySubSystem,
 	&GameSubSystem,
 	&EditorSubSystem,
 };
@@ -1013,15 +1616,21 @@ internal void InitGameSystems(Memory *memory)
 
 	for (i32 i = 0; i < countof(s_subSystems); i++)
 	{
-		SubSystem *sys       = &g_game->gameSubsystems[i];
-		void *     curMemPtr = sys->globalPtr;
-		*sys                 = *s_subSystems[i];
+		SubSystem *sys             = &g_game->gameSubsystems[i];
+		void *     curMemPtr       = sys->globalPtr;
+		void *     curTransientPtr = sys->transientPtr;
+		*sys                       = *s_subSystems[i];
 
 		if (curMemPtr == nullptr)
 			sys->globalPtr = M_AllocRaw(memory, sys->globalSize);
 		else
 			sys->globalPtr = curMemPtr;
 
+		if (curTransientPtr == nullptr && sys->transientSize)
+			sys->transientPtr = M_TransientAllocRaw(memory, sys->transientSize);
+		else
+			sys->transientPtr = curTransientPtr;
+
 		sys->initFunc(sys, isReload);
 	}
 
@@ -1059,6 +1668,11 @@ internal GameFuncs_s s_game = {
 	Qi_GameUpdateAndRender,
 	Qi_GetHwi,
 	Qi_ToggleEditor,
+#if HAS(SOFT_RENDER)
+	QiSoft_WritePng,
+#else
+	nullptr,
+#endif
 };
 const GameFuncs_s *game = &s_game;
 
@@ -13,12 +13,19 @@
 #include "bitmap.h"
 #include "hwi.h"
 #include "stringtable.h"
+#include "jobs.h"
+#include "fileio.h"
 #include <string.h>
 
 #define GAME_DLL_NAME "qi.dll"
 
 #define TARGET_FPS 30.0
 
+// Simulation runs at a fixed rate regardless of TARGET_FPS; rendering interpolates between the last two steps
+#define SIM_HZ                  60.0
+#define SIM_DT                  (1.0 / SIM_HZ)
+#define MAX_SIM_STEPS_PER_FRAME 8
+
 #define GAME_IDEAL_RES_X 1920
 #define GAME_IDEAL_RES_Y 1080
 
@@ -104,7 +111,8 @@ void              Game_CopyAtlases(const SpriteAtlasTable *srcAtlases);
 
 struct KeyStore;
 typedef u32 ValueRef;
-void        Spr_ReadAtlasFromKeyStore(const KeyStore *ks, ValueRef ref, SpriteAtlas *atlas);
+// Reads the atlas image too unless given the bitmap, already read from the same file
+void        Spr_ReadAtlasFromKeyStore(const KeyStore *ks, ValueRef ref, SpriteAtlas *atlas, Bitmap *bitmap = nullptr);
 void        Spr_WriteAtlasToKeyStore(KeyStore **ks, const SpriteAtlas *atlas);
 void        Spr_CreateSimpleTileSheet(SpriteAtlas *atlas, const char *name, u32 tileSizeX, u32 tileSizeY, u32 *tileCount);
 void        Spr_Draw(Bitmap *dest, Sprite *sprite, i32 frame, i32 x, i32 y, ColorU tint = ColorU(255, 255, 255, 255));
@@ -112,13 +120,21 @@ void        Spr_DrawStretched(Bitmap *dest, Sprite *sprite, i32 frame, i32 x, i3
 
 struct SpriteDLEntry
 {
-	Sprite *sprite;
-	i32     x, y;
-	i32     frame;
-	ColorU  tint;
+	const Sprite *sprite; // Null entries are skipped, so fixed slots can be left empty
+	i16           x, y;   // Top left, pixels
+	i16           w, h;   // 0 for the sprite's own size
+	u16           frame;
+	u16           layer; // Drawn back to front by layer, then atlas, then y
+	ColorU        tint;  // Modulates the sprite's tint
 };
 static_assert(sizeof(SpriteDLEntry) == 24, "Weirdly sized SpriteDLEntry");
-void Spr_DrawList(Bitmap *dest, SpriteDLEntry *entries, u32 numEntries);
+
+#define SPR_MAX_DRAW_LIST_ENTRIES (16 * 1024)
+#define SPR_MAX_DRAW_LIST_LAYERS  256
+
+// Culls entries to dest, sorts them and writes them straight into the hardware's sprite stream, one append per atlas
+// run. Entries can be filled from any number of threads beforehand; the call itself is main thread only.
+void Spr_DrawList(Bitmap *dest, const SpriteDLEntry *entries, u32 numEntries);
 
 struct Button
 {
@@ -235,6 +251,8 @@ struct SubSystem
 	Qi_Init_SubSystem_f *initFunc;
 	size_t               globalSize;
 	void *               globalPtr;
+	size_t               transientSize; // Optional, from transient memory: kept across reloads but not in loop recordings
+	void *               transientPtr;
 };
 
 #define MAX_SUBSYSTEMS 16
@@ -257,6 +275,7 @@ typedef void Qi_GameUpdateAndRender_f(ThreadContext *tc, Input *input, Bitmap *s
 typedef void Qi_Init_f(const PlatFuncs_s *plat, Memory *memory);
 typedef Hwi *Qi_GetHwi_f();
 typedef void Qi_ToggleEditor_f();
+typedef bool Qi_WritePng_f(const Bitmap *bitmap, const char *fileName);
 
 struct SoundFuncs_s;
 
@@ -275,6 +294,7 @@ struct GameFuncs_s
 	Qi_GameUpdateAndRender_f *UpdateAndRender;
 	Qi_GetHwi_f *             GetHwi;
 	Qi_ToggleEditor_f *       ToggleEditor;
+	Qi_WritePng_f *           WritePng; // Soft render builds only, for headless runs. Null otherwise.
 };
 
 // Functions to be provided by the platform layer
@@ -285,6 +305,19 @@ typedef r64   QiPlat_WallSeconds_f(ThreadContext *tc);
 typedef void  QiPlat_SetupMainExeLibraries_f();
 struct ImGuiContext;
 typedef ImGuiContext *QiPlat_GetGuiContext();
+typedef void  QiPlat_ParallelFor_f(QiJob_f *job, void *userData, u32 numJobs);
+typedef u32   QiPlat_NumJobThreads_f();
+typedef void  QiPlat_RunAsync_f(QiJob_f *job, void *userData);
+typedef void  QiPlat_WaitAsync_f();
+typedef const void *QiPlat_MapFile_f(ThreadContext *tc, const char *fileName, size_t *fileSize);
+typedef void        QiPlat_UnmapFile_f(ThreadContext *tc, const void *ptr, size_t size);
+typedef IoRead_t    QiPlat_ReadFileAsync_f(const char *fileName, void *buffer, u64 offset, u64 size, IoDone_f *done, void *userData);
+typedef IoStatus_e  QiPlat_PollFileRead_f(IoRead_t read, u64 *bytesRead);
+typedef IoStatus_e  QiPlat_WaitFileRead_f(IoRead_t read, u64 *bytesRead);
+typedef i64         QiPlat_FileSize_f(const char *fileName);
+typedef bool        QiPlat_WatchFile_f(const char *fileName);
+typedef bool        QiPlat_NextFileChange_f(char *fileName, u32 fileNameSize);
+typedef void        QiPlat_SyncRender_f();
 
 struct PlatFuncs_s
 {
@@ -294,6 +327,19 @@ struct PlatFuncs_s
 	QiPlat_WallSeconds_f *          WallSeconds;
 	QiPlat_SetupMainExeLibraries_f *SetupMainExeLibraries;
 	QiPlat_GetGuiContext *          GetGuiContext;
+	QiPlat_ParallelFor_f *          ParallelFor;
+	QiPlat_NumJobThreads_f *        NumJobThreads;
+	QiPlat_RunAsync_f *             RunAsync;
+	QiPlat_WaitAsync_f *            WaitAsync;
+	QiPlat_MapFile_f *              MapFile; // Read only, nullptr when the file can't be opened
+	QiPlat_UnmapFile_f *            UnmapFile;
+	QiPlat_ReadFileAsync_f *        ReadFileAsync; // See fileio.h
+	QiPlat_PollFileRead_f *         PollFileRead;
+	QiPlat_WaitFileRead_f *         WaitFileRead;
+	QiPlat_FileSize_f *             FileSize;
+	QiPlat_WatchFile_f *            WatchFile; // See filewatch.h
+	QiPlat_NextFileChange_f *       NextFileChange;
+	QiPlat_SyncRender_f *           SyncRender; // Returns once the frame being drawn is done
 };
 
 extern const PlatFuncs_s * plat;
@@ -8,6 +8,11 @@
 
 #include "game.h"
 #include "gjk.h"
+#include "util.h"
+
+#if HAS(SSE2_SIMD)
+#include <emmintrin.h>
+#endif
 
 v2
 CircleShape_s::FarthestPointInDir(const v2& dir) const
@@ -23,14 +28,65 @@ EllipseShape_s::FarthestPointInDir(const v2& dir) const
 	return origin + dn * distToEllipse;
 }
 
+// Max-dot search over the SoA points: dots four lanes at a time into a scratch row, reduce to the max, then
+// find the first lane holding it. Ties resolve to the lowest index like the scalar loop.
 v2
 PolyShape_s::FarthestPointInDir(const v2& dir) const
 {
-	r32 farthestDot = points[0].dot(dir);
+	Assert(numPoints > 0);
+
+	u32 idx = 0;
+
+#if HAS(SSE2_SIMD)
+	if (numPoints >= 4)
+	{
+		alignas(16) r32 dots[QI_GJK_MAX_POLY_POINTS];
+
+		const __m128 dx      = _mm_set1_ps(dir.x);
+		const __m128 dy      = _mm_set1_ps(dir.y);
+		__m128       bestDot = _mm_set1_ps(-Q_R32_LARGE_NUMBER);
+
+		for (; idx + 4 <= numPoints; idx += 4)
+		{
+			const __m128 laneDots = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(xs + idx), dx), _mm_mul_ps(_mm_loadu_ps(ys + idx), dy));
+			_mm_store_ps(dots + idx, laneDots);
+			bestDot = _mm_max_ps(bestDot, laneDots);
+		}
+		const u32 simdEnd = idx;
+
+		for (; idx < numPoints; idx++)
+		{
+			dots[idx] = xs[idx] * dir.x + ys[idx] * dir.y;
+			bestDot   = _mm_max_ps(bestDot, _mm_set1_ps(dots[idx]));
+		}
+
+		bestDot = _mm_max_ps(bestDot, _mm_shuffle_ps(bestDot, bestDot, _MM_SHUFFLE(1, 0, 3, 2)));
+		bestDot = _mm_max_ps(bestDot, _mm_shuffle_ps(bestDot, bestDot, _MM_SHUFFLE(2, 3, 0, 1)));
+
+		for (idx = 0; idx < simdEnd; idx += 4)
+		{
+			const u32 hitMask = (u32)_mm_movemask_ps(_mm_cmpeq_ps(_mm_load_ps(dots + idx), bestDot));
+			if (hitMask)
+				return Point(idx + CountTrailingZeros64(hitMask));
+		}
+
+		const r32 farthestDot = _mm_cvtss_f32(bestDot);
+		for (; idx < numPoints; idx++)
+		{
+			if (dots[idx] == farthestDot)
+				return Point(idx);
+		}
+
+		Assert(0);
+		return Point(0);
+	}
+#endif
+
+	r32 farthestDot = xs[0] * dir.x + ys[0] * dir.y;
 	u32 farthestIdx = 0;
-	for (u32 idx = 1; idx < numPoints; idx++)
+	for (idx = 1; idx < numPoints; idx++)
 	{
-		const r32 curDot = points[idx].dot(dir);
+		const r32 curDot = xs[idx] * dir.x + ys[idx] * dir.y;
 		if (curDot > farthestDot)
 		{
 			farthestIdx = idx;
@@ -38,11 +94,12 @@ PolyShape_s::FarthestPointInDir(const v2& dir) const
 		}
 	}
 	Assert(farthestIdx < numPoints);
-	return points[farthestIdx];
+	return Point(farthestIdx);
 }
 
+template <typename ShapeA, typename ShapeB>
 static inline void
-Support(Simplex_s* simplex, const GjkShape_s* a, const GjkShape_s* b, const v2& d)
+Support(Simplex_s* simplex, const ShapeA* a, const ShapeB* b, const v2& d)
 {
 	const v2 as = a->FarthestPointInDir(d);
 	const v2 bs = b->FarthestPointInDir(-d);
@@ -352,8 +409,15 @@ DoSimplex(Simplex_s* simplex, v2* dir)
 	return false;
 }
 
+// Expanding polytope scratch for the penetration search
+struct EpaPoly_s
+{
+	v2  points[QI_GJK_MAX_POLY_POINTS];
+	u32 numPoints;
+};
+
 static r32
-OriginDistToClosestEdge(PolyShape_s* poly, v2* normal, u32* index)
+OriginDistToClosestEdge(const EpaPoly_s* poly, v2* normal, u32* index)
 {
 	r32 nearestDist = Q_R32_LARGE_NUMBER;
 	v2  bestNormal;
@@ -397,10 +461,149 @@ OriginDistToClosestEdge(PolyShape_s* poly, v2* normal, u32* index)
 	return nearestDist;
 }
 
+// Feature of a shape facing along dir: the edge most perpendicular to dir for polys, a single point for curved shapes
+struct ContactFeature_s
+{
+	v2   deepest;
+	v2   edgeA;
+	v2   edgeB;
+	bool isEdge;
+};
+
+static inline void
+GetContactFeature(ContactFeature_s* feature, const CircleShape_s* shape, const v2& dir)
+{
+	feature->deepest = shape->FarthestPointInDir(dir);
+	feature->isEdge  = false;
+}
+
+static inline void
+GetContactFeature(ContactFeature_s* feature, const EllipseShape_s* shape, const v2& dir)
+{
+	feature->deepest = shape->FarthestPointInDir(dir);
+	feature->isEdge  = false;
+}
+
 static void
-GetPenetrationDepthAndNormal(GjkResult_s* result, const GjkShape_s* shapeA, const GjkShape_s* shapeB)
+GetContactFeature(ContactFeature_s* feature, const PolyShape_s* shape, const v2& dir)
 {
-	PolyShape_s spoly;
+	u32 deepIdx = 0;
+	r32 deepDot = -Q_R32_LARGE_NUMBER;
+	for (u32 idx = 0; idx < shape->numPoints; idx++)
+	{
+		const r32 curDot = shape->Point(idx).dot(dir);
+		if (curDot > deepDot)
+		{
+			deepDot = curDot;
+			deepIdx = idx;
+		}
+	}
+
+	feature->deepest = shape->Point(deepIdx);
+	feature->isEdge  = shape->numPoints > 1;
+	if (!feature->isEdge)
+		return;
+
+	const v2 prev = shape->Point((deepIdx + shape->numPoints - 1) % shape->numPoints);
+	const v2 next = shape->Point((deepIdx + 1) % shape->numPoints);
+
+	v2 toPrev = feature->deepest - prev;
+	v2 toNext = next - feature->deepest;
+	if (fabsf(toPrev.normal().dot(dir)) <= fabsf(toNext.normal().dot(dir)))
+	{
+		feature->edgeA = prev;
+		feature->edgeB = feature->deepest;
+	}
+	else
+	{
+		feature->edgeA = feature->deepest;
+		feature->edgeB = next;
+	}
+}
+
+// Clip the segment to the half plane dot(axis, p) >= offset, returns the number of points kept
+static u32
+ClipSegment(v2* out, const v2& p0, const v2& p1, const v2& axis, const r32 offset)
+{
+	const r32 d0      = axis.dot(p0) - offset;
+	const r32 d1      = axis.dot(p1) - offset;
+	u32       numKept = 0;
+
+	if (d0 >= 0.0f)
+		out[numKept++] = p0;
+	if (d1 >= 0.0f)
+		out[numKept++] = p1;
+	if (d0 * d1 < 0.0f)
+		out[numKept++] = p0 + (p1 - p0) * (d0 / (d0 - d1));
+
+	return numKept;
+}
+
+// Clip the incident edge to the reference edge, keeping the points that are inside the other shape
+static void
+ClipEdgeContacts(GjkResult_s* result, const ContactFeature_s* featA, const ContactFeature_s* featB, const v2& sepDir)
+{
+	// The reference face is the edge closer to perpendicular to the normal, the other edge gets clipped to it
+	const v2  edgeA  = featA->edgeB - featA->edgeA;
+	const v2  edgeB  = featB->edgeB - featB->edgeA;
+	const bool refIsA = fabsf(edgeA.dot(sepDir)) * edgeB.len() <= fabsf(edgeB.dot(sepDir)) * edgeA.len();
+
+	const ContactFeature_s* ref     = refIsA ? featA : featB;
+	const ContactFeature_s* inc     = refIsA ? featB : featA;
+	const v2                refDir  = (ref->edgeB - ref->edgeA).normal();
+	const v2                refNorm = refIsA ? sepDir : -sepDir;
+
+	v2  clipped[3];
+	u32 numClipped = ClipSegment(clipped, inc->edgeA, inc->edgeB, refDir, refDir.dot(ref->edgeA));
+	if (numClipped < 2)
+		return;
+
+	v2 clipped2[3];
+	numClipped = ClipSegment(clipped2, clipped[0], clipped[1], -refDir, -refDir.dot(ref->edgeB));
+
+	const r32 refOffset = refNorm.dot(ref->edgeA);
+	for (u32 ci = 0; ci < numClipped && result->numContacts < QI_GJK_MAX_CONTACTS; ci++)
+	{
+		const r32 depth = refOffset - refNorm.dot(clipped2[ci]);
+		if (depth < 0.0f)
+			continue;
+
+		GjkContact_s* contact = &result->contacts[result->numContacts++];
+		contact->point        = clipped2[ci] + refNorm * (depth * 0.5f);
+		contact->depth        = depth;
+	}
+}
+
+// Build the manifold from the features of A and B facing each other along sepDir, the direction from A into B
+static void
+BuildContacts(GjkResult_s* result, const ContactFeature_s* featA, const ContactFeature_s* featB, const v2& sepDir)
+{
+	result->numContacts = 0;
+
+	if (featA->isEdge && featB->isEdge)
+		ClipEdgeContacts(result, featA, featB, sepDir);
+
+	// Curved surfaces touch at one point, and edges that only just cross can clip away to nothing; either way a
+	// pair that intersects gets the deepest point, put halfway across the overlap
+	if (result->numContacts == 0)
+	{
+		const v2 deepest = featA->isEdge ? featB->deepest + sepDir * (result->penetrationDepth * 0.5f)
+		                                 : featA->deepest - sepDir * (result->penetrationDepth * 0.5f);
+
+		result->contacts[0].point = deepest;
+		result->contacts[0].depth = result->penetrationDepth;
+		result->numContacts       = 1;
+	}
+}
+
+// Polys converge exactly, the tolerance only bounds how long curved shapes keep refining
+#define QI_EPA_TOLERANCE 1.0e-4f
+
+template <typename ShapeA, typename ShapeB>
+static void
+GetPenetrationDepthAndNormal(GjkResult_s* result, const ShapeA* shapeA, const ShapeB* shapeB)
+{
+	EpaPoly_s spoly;
 	spoly.numPoints = result->simplex.numPts;
 	for (u32 i = 0; i < result->simplex.numPts; i++)
 		spoly.points[i] = result->simplex.pts[i].pt;
@@ -415,15 +618,20 @@ GetPenetrationDepthAndNormal(GjkResult_s* result, const GjkShape_s* shapeA, cons
 		v2 sb         = shapeB->FarthestPointInDir(-normal);
 		v2 newSupport = sa - sb;
 
+		// Curved shapes can keep refining forever, so a full polytope also ends the search with the best edge so far
 		const r32 newSupDist = newSupport.dot(normal);
-		if (newSupDist - distToOrigin < 0.02)
+		if (newSupDist - distToOrigin < QI_EPA_TOLERANCE || spoly.numPoints >= QI_GJK_MAX_POLY_POINTS)
 		{
 			result->penetrationDepth  = distToOrigin;
 			result->penetrationNormal = -normal;
+
+			ContactFeature_s featA, featB;
+			GetContactFeature(&featA, shapeA, normal);
+			GetContactFeature(&featB, shapeB, -normal);
+			BuildContacts(result, &featA, &featB, normal);
 			break;
 		}
 
-		Assert(spoly.numPoints < QI_GJK_MAX_POLY_POINTS - 1);
 		for (u32 moveIdx = spoly.numPoints - 1; moveIdx > index; moveIdx--)
 			spoly.points[moveIdx + 1] = spoly.points[moveIdx];
 
@@ -432,21 +640,22 @@ GetPenetrationDepthAndNormal(GjkResult_s* result, const GjkShape_s* shapeA, cons
 	}
 }
 
-bool
-Qi_Gjk(GjkResult_s* result, const GjkShape_s* shapeA, const GjkShape_s* shapeB)
+#define QI_GJK_MAX_ITERATIONS 64
+
+template <typename ShapeA, typename ShapeB>
+static bool
+GjkPair(GjkResult_s* result, const ShapeA* shapeA, const ShapeB* shapeB)
 {
 	memset(result, 0, sizeof(*result));
 
 	Simplex_s* simplex = &result->simplex;
-    Simplex_s prevSimplex;
 
 	v2 dir = shapeB->origin - shapeA->origin;
 	Support(simplex, shapeA, shapeB, dir);
 	dir = -simplex->pts[simplex->numPts].pt;
 	simplex->numPts++;
-    prevSimplex = *simplex;
 
-	for (;;)
+	for (u32 iter = 0; iter < QI_GJK_MAX_ITERATIONS; iter++)
 	{
 		Support(simplex, shapeA, shapeB, dir);
 		if (VDot(simplex->pts[simplex->numPts].pt, dir) < 0.0f)
@@ -469,6 +678,445 @@ Qi_Gjk(GjkResult_s* result, const GjkShape_s* shapeA, const GjkShape_s* shapeB)
 			GetPenetrationDepthAndNormal(result, shapeA, shapeB);
 			return true;
 		}
-        prevSimplex = *simplex;
 	}
+
+	// Failed to converge, only happens with degenerate input. Report no contact rather than a garbage normal.
+	result->intersected = false;
+	return false;
+}
+
+template <typename ShapeA, typename ShapeB>
+static u32
+GjkRun(GjkResult_s* results, const GjkPair_s* pairs, const u32 numPairs)
+{
+	u32 numHits = 0;
+	for (u32 pairIdx = 0; pairIdx < numPairs; pairIdx++)
+	{
+		if (GjkPair(&results[pairIdx], (const ShapeA*)pairs[pairIdx].a, (const ShapeB*)pairs[pairIdx].b))
+			numHits++;
+	}
+	return numHits;
+}
+
+// Boxes share the poly support, so the table is indexed by support class rather than shape type
+enum GjkSupportClass_e
+{
+	GjkSupport_Circle = 0,
+	GjkSupport_Ellipse,
+	GjkSupport_Poly,
+	GjkSupport_Count
+};
+
+static inline u32
+SupportClass(const GjkShapeType_e type)
+{
+	switch (type)
+	{
+	case GjkShape_Circle:
+		return GjkSupport_Circle;
+	case GjkShape_Ellipse:
+		return GjkSupport_Ellipse;
+	case GjkShape_Poly:
+	case GjkShape_Box:
+		return GjkSupport_Poly;
+	}
+
+	Assert(0);
+	return GjkSupport_Poly;
+}
+
+typedef u32 GjkRunFunc(GjkResult_s* results, const GjkPair_s* pairs, const u32 numPairs);
+
+// Every support class pairing of a templated query, indexed [classA][classB]
+#define GJK_PAIR_TABLE(func)                                                                       \
+	{                                                                                              \
+		{func<CircleShape_s, CircleShape_s>, func<CircleShape_s, EllipseShape_s>, func<CircleShape_s, PolyShape_s>},    \
+		    {func<EllipseShape_s, CircleShape_s>, func<EllipseShape_s, EllipseShape_s>, func<EllipseShape_s, PolyShape_s>}, \
+		    {func<PolyShape_s, CircleShape_s>, func<PolyShape_s, EllipseShape_s>, func<PolyShape_s, PolyShape_s>},       \
+	}
+
+static GjkRunFunc* const s_gjkRuns[GjkSupport_Count][GjkSupport_Count] = GJK_PAIR_TABLE(GjkRun);
+
+bool
+Qi_Gjk(GjkResult_s* result, const GjkShape_s* shapeA, const GjkShape_s* shapeB)
+{
+	const GjkPair_s pair = {shapeA, shapeB};
+	return s_gjkRuns[SupportClass(shapeA->type)][SupportClass(shapeB->type)](result, &pair, 1) != 0;
+}
+
+u32
+Qi_GjkBatch(GjkResult_s* results, const GjkPair_s* pairs, const u32 numPairs)
+{
+	u32 numHits  = 0;
+	u32 runStart = 0;
+	while (runStart < numPairs)
+	{
+		const u32 classA = SupportClass(pairs[runStart].a->type);
+		const u32 classB = SupportClass(pairs[runStart].b->type);
+
+		u32 runEnd = runStart + 1;
+		while (runEnd < numPairs && SupportClass(pairs[runEnd].a->type) == classA && SupportClass(pairs[runEnd].b->type) == classB)
+			runEnd++;
+
+		numHits += s_gjkRuns[classA][classB](results + runStart, pairs + runStart, runEnd - runStart);
+		runStart = runEnd;
+	}
+	return numHits;
+}
+
+bool
+Qi_AabbOverlap(GjkResult_s* result, const Aabb_s* a, const Aabb_s* b)
+{
+	memset(result, 0, sizeof(*result));
+
+	const r32 pushNegX = a->max.x - b->min.x;
+	const r32 pushPosX = b->max.x - a->min.x;
+	const r32 pushNegY = a->max.y - b->min.y;
+	const r32 pushPosY = b->max.y - a->min.y;
+
+	if (pushNegX <= 0.0f || pushPosX <= 0.0f || pushNegY <= 0.0f || pushPosY <= 0.0f)
+	{
+		result->intersected = false;
+		return false;
+	}
+
+	const r32 depthX = Min(pushNegX, pushPosX);
+	const r32 depthY = Min(pushNegY, pushPosY);
+
+	// The overlap rectangle's two corners along the contact face make the manifold
+	const v2 overlapMin = V2(Max(a->min.x, b->min.x), Max(a->min.y, b->min.y));
+	const v2 overlapMax = V2(Min(a->max.x, b->max.x), Min(a->max.y, b->max.y));
+
+	if (depthX < depthY)
+	{
+		const r32 midX            = (overlapMin.x + overlapMax.x) * 0.5f;
+		result->penetrationNormal = V2(pushNegX < pushPosX ? -1.0f : 1.0f, 0.0f);
+		result->penetrationDepth  = depthX;
+		result->contacts[0].point = V2(midX, overlapMin.y);
+		result->contacts[1].point = V2(midX, overlapMax.y);
+	}
+	else
+	{
+		const r32 midY            = (overlapMin.y + overlapMax.y) * 0.5f;
+		result->penetrationNormal = V2(0.0f, pushNegY < pushPosY ? -1.0f : 1.0f);
+		result->penetrationDepth  = depthY;
+		result->contacts[0].point = V2(overlapMin.x, midY);
+		result->contacts[1].point = V2(overlapMax.x, midY);
+	}
+
+	result->contacts[0].depth = result->contacts[1].depth = result->penetrationDepth;
+	result->numContacts                                   = 2;
+	result->intersected                                   = true;
+	return true;
+}
+
+bool
+Qi_Collide(GjkResult_s* result, const GjkShape_s* shapeA, const GjkShape_s* shapeB)
+{
+	if (shapeA->type == GjkShape_Box && shapeB->type == GjkShape_Box)
+	{
+		const Aabb_s a = BoxShapeAabb((const BoxShape_s*)shapeA);
+		const Aabb_s b = BoxShapeAabb((const BoxShape_s*)shapeB);
+		return Qi_AabbOverlap(result, &a, &b);
+	}
+
+	return Qi_Gjk(result, shapeA, shapeB);
+}
+
+// Closest point to the origin on segment a-b, as the weight of b
+static inline r32
+ClosestOnSegmentWeight(const v2& a, const v2& b)
+{
+	const v2  ab     = b - a;
+	const r32 abLenSq = ab.lenSq();
+	if (abLenSq < Q_R32_EPSILON)
+		return 0.0f;
+	return Qi_Clamp(-a.dot(ab) / abLenSq, 0.0f, 1.0f);
+}
+
+// Reduce the simplex to the smallest feature holding its closest point to the origin. Returns false when a
+// triangle encloses the origin.
+static bool
+ReduceDistanceSimplex(SimplexPt_s* pts, u32* numPts, r32* weights, v2* closest)
+{
+	if (*numPts == 2)
+	{
+		const r32 t = ClosestOnSegmentWeight(pts[0].pt, pts[1].pt);
+		if (t <= 0.0f)
+		{
+			*numPts = 1;
+		}
+		else if (t >= 1.0f)
+		{
+			pts[0]  = pts[1];
+			*numPts = 1;
+		}
+		else
+		{
+			weights[0] = 1.0f - t;
+			weights[1] = t;
+			*closest   = pts[0].pt * weights[0] + pts[1].pt * weights[1];
+			return true;
+		}
+
+		weights[0] = 1.0f;
+		*closest   = pts[0].pt;
+		return true;
+	}
+
+	Assert(*numPts == 3);
+	const r32 c0 = VCross(pts[1].pt - pts[0].pt, -pts[0].pt);
+	const r32 c1 = VCross(pts[2].pt - pts[1].pt, -pts[1].pt);
+	const r32 c2 = VCross(pts[0].pt - pts[2].pt, -pts[2].pt);
+	if ((c0 >= 0.0f && c1 >= 0.0f && c2 >= 0.0f) || (c0 <= 0.0f && c1 <= 0.0f && c2 <= 0.0f))
+		return false;
+
+	// Origin is outside, the closest feature lies on one of the edges
+	r32 bestDistSq = Q_R32_LARGE_NUMBER;
+	u32 bestEdge   = 0;
+	r32 bestT      = 0.0f;
+	for (u32 edge = 0; edge < 3; edge++)
+	{
+		const v2& a      = pts[edge].pt;
+		const v2& b      = pts[(edge + 1) % 3].pt;
+		const r32 t      = ClosestOnSegmentWeight(a, b);
+		const r32 distSq = (a + (b - a) * t).lenSq();
+		if (distSq < bestDistSq)
+		{
+			bestDistSq = distSq;
+			bestEdge   = edge;
+			bestT      = t;
+		}
+	}
+
+	const SimplexPt_s a = pts[bestEdge];
+	const SimplexPt_s b = pts[(bestEdge + 1) % 3];
+	pts[0]              = a;
+	pts[1]              = b;
+	*numPts             = 2;
+	return ReduceDistanceSimplex(pts, numPts, weights, closest);
+}
+
+#define QI_GJK_DIST_TOLERANCE 1.0e-5f
+
+// Distance between A translated by offsetA and B. Returns false if they overlap.
+template <typename ShapeA, typename ShapeB>
+static bool
+GjkClosest(GjkDistance_s* result, const ShapeA* shapeA, const v2& offsetA, const ShapeB* shapeB)
+{
+	SimplexPt_s pts[3];
+	r32         weights[3];
+	u32         numPts = 1;
+
+	v2 dir       = shapeB->origin - (shapeA->origin + offsetA);
+	pts[0].sa    = shapeA->FarthestPointInDir(dir) + offsetA;
+	pts[0].sb    = shapeB->FarthestPointInDir(-dir);
+	pts[0].pt    = pts[0].sa - pts[0].sb;
+	weights[0]   = 1.0f;
+	v2 closest   = pts[0].pt;
+	r32 prevDist = Q_R32_LARGE_NUMBER;
+
+	for (u32 iter = 0; iter < QI_GJK_MAX_ITERATIONS; iter++)
+	{
+		const r32 distSq = closest.lenSq();
+		if (distSq < QI_GJK_DIST_TOLERANCE * QI_GJK_DIST_TOLERANCE)
+			return false;
+
+		SimplexPt_s newPt;
+		newPt.sa = shapeA->FarthestPointInDir(-closest) + offsetA;
+		newPt.sb = shapeB->FarthestPointInDir(closest);
+		newPt.pt = newPt.sa - newPt.sb;
+
+		// No support point gets any closer to the origin than the current estimate
+		if (distSq - closest.dot(newPt.pt) <= QI_GJK_DIST_TOLERANCE * sqrtf(distSq) || distSq >= prevDist)
+			break;
+		prevDist = distSq;
+
+		pts[numPts++] = newPt;
+		if (!ReduceDistanceSimplex(pts, &numPts, weights, &closest))
+			return false;
+	}
+
+	result->pointA = V2(0.0f, 0.0f);
+	result->pointB = V2(0.0f, 0.0f);
+	for (u32 pi = 0; pi < numPts; pi++)
+	{
+		result->pointA += pts[pi].sa * weights[pi];
+		result->pointB += pts[pi].sb * weights[pi];
+	}
+	result->distance = closest.len();
+	result->normal   = closest * (1.0f / result->distance);
+	return true;
+}
+
+template <typename ShapeA, typename ShapeB>
+static bool
+GjkDistancePair(GjkDistance_s* result, const GjkShape_s* shapeA, const GjkShape_s* shapeB)
+{
+	return GjkClosest(result, (const ShapeA*)shapeA, V2(0.0f, 0.0f), (const ShapeB*)shapeB);
+}
+
+// Copies of A moved to where the advancement has got to
+static inline void
+TranslateShape(CircleShape_s* shape, const v2& offset)
+{
+	shape->origin += offset;
+}
+
+static inline void
+TranslateShape(EllipseShape_s* shape, const v2& offset)
+{
+	shape->origin += offset;
+}
+
+static inline void
+TranslateShape(PolyShape_s* shape, const v2& offset)
+{
+	shape->origin += offset;
+	for (u32 idx = 0; idx < shape->numPoints; idx++)
+		shape->SetPoint(idx, shape->Point(idx) + offset);
+}
+
+// Stop advancing once this close; the reported time leaves about half of it as a gap
+#define QI_TOI_TOLERANCE      1.0e-3f
+#define QI_TOI_MAX_ITERATIONS 32
+
+// Conservative advancement: B's separating plane can't be crossed any sooner than distance / closing speed,
+// so stepping by that never overshoots. Converges in a handful of steps for polys.
+template <typename ShapeA, typename ShapeB>
+static bool
+ToiPair(GjkToiResult_s* result, const GjkShape_s* genericA, const v2& motion, const GjkShape_s* genericB)
+{
+	const ShapeA* shapeA = (const ShapeA*)genericA;
+	const ShapeB* shapeB = (const ShapeB*)genericB;
+
+	r32 time   = 0.0f;
+	v2  offset = V2(0.0f, 0.0f);
+
+	for (u32 iter = 0; iter < QI_TOI_MAX_ITERATIONS; iter++)
+	{
+		GjkDistance_s dist;
+		if (!GjkClosest(&dist, shapeA, offset, shapeB))
+		{
+			// Only reachable when already overlapping at the start; report the way out instead, from where A is
+			ShapeA movedA = *shapeA;
+			TranslateShape(&movedA, offset);
+
+			GjkResult_s overlap;
+			GjkPair(&overlap, &movedA, shapeB);
+			result->hit    = true;
+			result->time   = time;
+			result->normal = overlap.penetrationNormal;
+			result->point  = overlap.numContacts ? overlap.contacts[0].point : shapeB->origin;
+			return true;
+		}
+
+		if (dist.distance <= QI_TOI_TOLERANCE)
+		{
+			result->hit    = true;
+			result->time   = time;
+			result->normal = dist.normal;
+			result->point  = dist.pointB;
+			return true;
+		}
+
+		const r32 closing = -motion.dot(dist.normal);
+		if (closing <= Q_R32_EPSILON)
+			break;
+
+		time += (dist.distance - QI_TOI_TOLERANCE * 0.5f) / closing;
+		if (time >= 1.0f)
+			break;
+
+		offset = motion * time;
+	}
+
+	result->hit = false;
+	return false;
+}
+
+typedef bool GjkDistanceFunc(GjkDistance_s* result, const GjkShape_s* shapeA, const GjkShape_s* shapeB);
+typedef bool GjkToiFunc(GjkToiResult_s* result, const GjkShape_s* shapeA, const v2& motion, const GjkShape_s* shapeB);
+
+static GjkDistanceFunc* const s_gjkDistances[GjkSupport_Count][GjkSupport_Count] = GJK_PAIR_TABLE(GjkDistancePair);
+static GjkToiFunc* const      s_gjkTois[GjkSupport_Count][GjkSupport_Count]      = GJK_PAIR_TABLE(ToiPair);
+
+bool
+Qi_GjkDistance(GjkDistance_s* result, const GjkShape_s* shapeA, const GjkShape_s* shapeB)
+{
+	memset(result, 0, sizeof(*result));
+	return s_gjkDistances[SupportClass(shapeA->type)][SupportClass(shapeB->type)](result, shapeA, shapeB);
+}
+
+bool
+Qi_AabbSweep(GjkToiResult_s* result, const Aabb_s* a, const v2& motion, const Aabb_s* b)
+{
+	memset(result, 0, sizeof(*result));
+
+	GjkResult_s overlap;
+	if (Qi_AabbOverlap(&overlap, a, b))
+	{
+		result->hit    = true;
+		result->time   = 0.0f;
+		result->normal = overlap.penetrationNormal;
+		result->point  = overlap.contacts[0].point;
+		return true;
+	}
+
+	// Slab test on the Minkowski sum: per axis the window of time the projections overlap
+	r32 axisEnter[2], axisExit[2];
+	for (u32 axis = 0; axis < 2; axis++)
+	{
+		const r32 m = motion.v[axis];
+		if (fabsf(m) < Q_R32_EPSILON)
+		{
+			if (a->max.v[axis] <= b->min.v[axis] || b->max.v[axis] <= a->min.v[axis])
+				return false;
+			axisEnter[axis] = -Q_R32_LARGE_NUMBER;
+			axisExit[axis]  = Q_R32_LARGE_NUMBER;
+		}
+		else if (m > 0.0f)
+		{
+			axisEnter[axis] = (b->min.v[axis] - a->max.v[axis]) / m;
+			axisExit[axis]  = (b->max.v[axis] - a->min.v[axis]) / m;
+		}
+		else
+		{
+			axisEnter[axis] = (b->max.v[axis] - a->min.v[axis]) / m;
+			axisExit[axis]  = (b->min.v[axis] - a->max.v[axis]) / m;
+		}
+	}
+
+	const u32 hitAxis   = axisEnter[0] > axisEnter[1] ? 0 : 1;
+	const r32 enterTime = axisEnter[hitAxis];
+	const r32 exitTime  = Min(axisExit[0], axisExit[1]);
+	if (enterTime > exitTime || enterTime < 0.0f || enterTime > 1.0f)
+		return false;
+
+	result->hit            = true;
+	result->time           = enterTime;
+	result->normal         = V2(0.0f, 0.0f);
+	result->normal.v[hitAxis] = motion.v[hitAxis] > 0.0f ? -1.0f : 1.0f;
+
+	// Middle of the touching span on the face that gets hit
+	const v2 movedMin = a->min + motion * enterTime;
+	const v2 movedMax = a->max + motion * enterTime;
+	const u32 spanAxis = 1 - hitAxis;
+	result->point.v[hitAxis]  = motion.v[hitAxis] > 0.0f ? b->min.v[hitAxis] : b->max.v[hitAxis];
+	result->point.v[spanAxis] = (Max(movedMin.v[spanAxis], b->min.v[spanAxis]) + Min(movedMax.v[spanAxis], b->max.v[spanAxis])) * 0.5f;
+	return true;
+}
+
+bool
+Qi_TimeOfImpact(GjkToiResult_s* result, const GjkShape_s* shapeA, const v2& motionA, const GjkShape_s* shapeB)
+{
+	if (shapeA->type == GjkShape_Box && shapeB->type == GjkShape_Box)
+	{
+		const Aabb_s a = BoxShapeAabb((const BoxShape_s*)shapeA);
+		const Aabb_s b = BoxShapeAabb((const BoxShape_s*)shapeB);
+		return Qi_AabbSweep(result, &a, motionA, &b);
+	}
+
+	memset(result, 0, sizeof(*result));
+	return s_gjkTois[SupportClass(shapeA->type)][SupportClass(shapeB->type)](result, shapeA, motionA, shapeB);
 }
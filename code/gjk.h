@@ -6,6 +6,7 @@
 // 2D implementation of GJK
 //
 
+#include "debug.h"
 #include "math_util.h"
 
 struct SimplexPt_s
@@ -22,32 +23,58 @@ struct Simplex_s
 	u32         numPts;
 };
 
+// Contact point in world space, halfway between the two surfaces, with the overlap along the normal there
+#define QI_GJK_MAX_CONTACTS 2
+struct GjkContact_s
+{
+	v2  point;
+	r32 depth;
+};
+
+// On intersection penetrationNormal * penetrationDepth is the minimum translation that moves A out of B, and
+// contacts holds the manifold: two points for edge against edge, one when either side is curved or a corner.
 struct GjkResult_s
 {
-	Simplex_s simplex;
-	v2        closestPoint;
-	v2        penetrationNormal;
-	r32       penetrationDepth;
-	bool      intersected;
+	Simplex_s    simplex;
+	v2           closestPoint;
+	v2           penetrationNormal;
+	r32          penetrationDepth;
+	GjkContact_s contacts[QI_GJK_MAX_CONTACTS];
+	u32          numContacts;
+	bool         intersected;
+};
+
+enum GjkShapeType_e
+{
+	GjkShape_Circle = 0,
+	GjkShape_Ellipse,
+	GjkShape_Poly,
+	GjkShape_Box,
 };
 
+// Shapes are tagged rather than virtual; Qi_Gjk switches on the tag pair once and runs a GJK instantiated for
+// those two concrete types, so the support functions inline into the loop.
 struct GjkShape_s
 {
-	GjkShape_s() { origin = V2(0.0f, 0.0f); }
-	GjkShape_s(const v2& iOrigin)
+	GjkShape_s(const GjkShapeType_e iType)
+	    : type(iType)
+	{
+		origin = V2(0.0f, 0.0f);
+	}
+	GjkShape_s(const GjkShapeType_e iType, const v2& iOrigin)
 	    : origin(iOrigin)
+	    , type(iType)
 	{
 	}
 
-	virtual v2 FarthestPointInDir(const v2& dir) const = 0;
-
-	v2 origin;
+	v2             origin;
+	GjkShapeType_e type;
 };
 
 struct CircleShape_s : public GjkShape_s
 {
 	CircleShape_s(const v2& iOrigin, const r32 iRadius)
-	    : GjkShape_s(iOrigin)
+	    : GjkShape_s(GjkShape_Circle, iOrigin)
 	    , radius(iRadius)
 	{
 	}
@@ -60,7 +87,7 @@ struct CircleShape_s : public GjkShape_s
 struct EllipseShape_s : public GjkShape_s
 {
 	EllipseShape_s(const v2& iOrigin, const v2& iRadii)
-	    : GjkShape_s(iOrigin)
+	    : GjkShape_s(GjkShape_Ellipse, iOrigin)
 	    , radii(iRadii)
 	{
 	}
@@ -70,13 +97,19 @@ struct EllipseShape_s : public GjkShape_s
 	v2 radii;
 };
 
+// Points are stored SoA so the support search can dot four points at a time
 #define QI_GJK_MAX_POLY_POINTS 32
 struct PolyShape_s : public GjkShape_s
 {
-	PolyShape_s() {}
+	PolyShape_s()
+	    : GjkShape_s(GjkShape_Poly)
+	    , numPoints(0)
+	{
+	}
 
-	PolyShape_s(v2* iPoints, const u32 iNumPoints)
-	    : numPoints(iNumPoints)
+	PolyShape_s(const v2* iPoints, const u32 iNumPoints)
+	    : GjkShape_s(GjkShape_Poly)
+	    , numPoints(iNumPoints)
 	{
 		Assert(numPoints > 0 && numPoints < QI_GJK_MAX_POLY_POINTS);
 
@@ -85,32 +118,104 @@ struct PolyShape_s : public GjkShape_s
 		for (u32 idx = 0; idx < numPoints; idx++)
 		{
 			center += iPoints[idx] * invCount;
-			points[idx] = iPoints[idx];
+			SetPoint(idx, iPoints[idx]);
 		}
 
 		origin = center;
 	}
 
+	v2 Point(const u32 idx) const { return V2(xs[idx], ys[idx]); }
+
+	void SetPoint(const u32 idx, const v2& pt)
+	{
+		xs[idx] = pt.x;
+		ys[idx] = pt.y;
+	}
+
 	v2 FarthestPointInDir(const v2& dir) const;
 
-	v2  points[QI_GJK_MAX_POLY_POINTS];
+	alignas(16) r32 xs[QI_GJK_MAX_POLY_POINTS];
+	alignas(16) r32 ys[QI_GJK_MAX_POLY_POINTS];
 	u32 numPoints;
 };
 
+// Axis aligned box. Still a valid poly for GJK, but box vs box tests take the AABB fast path in Qi_Collide.
 struct BoxShape_s : public PolyShape_s
 {
 	BoxShape_s(const v2& iOrigin, const v2& iRadii)
+	    : radii(iRadii)
 	{
-		origin    = iOrigin;
-		points[0] = V2(iOrigin.x - iRadii.x, iOrigin.y - iRadii.y);
-		points[1] = V2(iOrigin.x - iRadii.x, iOrigin.y + iRadii.y);
-		points[2] = V2(iOrigin.x + iRadii.x, iOrigin.y + iRadii.y);
-		points[3] = V2(iOrigin.x + iRadii.x, iOrigin.y - iRadii.y);
+		type   = GjkShape_Box;
+		origin = iOrigin;
+		SetPoint(0, V2(iOrigin.x - iRadii.x, iOrigin.y - iRadii.y));
+		SetPoint(1, V2(iOrigin.x - iRadii.x, iOrigin.y + iRadii.y));
+		SetPoint(2, V2(iOrigin.x + iRadii.x, iOrigin.y + iRadii.y));
+		SetPoint(3, V2(iOrigin.x + iRadii.x, iOrigin.y - iRadii.y));
 		numPoints = 4;
 	}
+
+	v2 radii;
 };
 
+struct Aabb_s
+{
+	v2 min;
+	v2 max;
+};
+
+inline Aabb_s
+BoxShapeAabb(const BoxShape_s* box)
+{
+	Aabb_s result;
+	result.min = box->origin - box->radii;
+	result.max = box->origin + box->radii;
+	return result;
+}
+
 extern bool Qi_Gjk(GjkResult_s* result, const GjkShape_s* shapeA, const GjkShape_s* shapeB);
 
+struct GjkPair_s
+{
+	const GjkShape_s* a;
+	const GjkShape_s* b;
+};
+
+// Runs GJK on every pair, results[i] matching pairs[i]. Consecutive pairs with the same shape types share one
+// dispatch, so callers that group their pairs by type get a tight loop per group. Returns the number intersecting.
+extern u32 Qi_GjkBatch(GjkResult_s* results, const GjkPair_s* pairs, const u32 numPairs);
+
+// Overlap test for two boxes, no simplex is produced. Penetration normal follows Qi_Gjk: the direction to move A out of B.
+extern bool Qi_AabbOverlap(GjkResult_s* result, const Aabb_s* a, const Aabb_s* b);
+
+// Narrow phase entry point: boxes use the AABB test, anything else runs GJK
+extern bool Qi_Collide(GjkResult_s* result, const GjkShape_s* shapeA, const GjkShape_s* shapeB);
+
+// Closest points of two separated shapes; normal points from B towards A. Returns false if they overlap.
+struct GjkDistance_s
+{
+	v2  pointA;
+	v2  pointB;
+	v2  normal;
+	r32 distance;
+};
+
+extern bool Qi_GjkDistance(GjkDistance_s* result, const GjkShape_s* shapeA, const GjkShape_s* shapeB);
+
+// First contact of A moving by motion against a static B (pass the relative motion if both move). Time is the
+// fraction of motion travelled before touching, normal points away from B like penetrationNormal, and point is
+// on B's surface. Shapes already overlapping report time 0 with the way out as the normal.
+struct GjkToiResult_s
+{
+	v2   normal;
+	v2   point;
+	r32  time;
+	bool hit;
+};
+
+extern bool Qi_AabbSweep(GjkToiResult_s* result, const Aabb_s* a, const v2& motion, const Aabb_s* b);
+
+// Boxes use the analytic sweep, anything else conservative advancement on GJK distance
+extern bool Qi_TimeOfImpact(GjkToiResult_s* result, const GjkShape_s* shapeA, const v2& motionA, const GjkShape_s* shapeB);
+
 #define __QI_GJK_H
 #endif // #ifndef __QI_GJK_H
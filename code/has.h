@@ -65,6 +65,12 @@
 #error Undefined platform! Need define for PLAT_EXPORT / PLAT_IMPORT
 #endif
 
+#if defined(QI_SOFT_RENDER_BUILD) && QI_SOFT_RENDER_BUILD == 1
+#define SOFT_RENDER     HAS_X
+#else
+#define SOFT_RENDER     HAS__
+#endif
+
 #if defined(QI_COMPILER_CLANG) && QI_COMPILER_CLANG == 1
 #define IS_CLANG        HAS_X
 #define IS_MSVC         HAS__
@@ -73,5 +79,41 @@
 #define IS_MSVC         HAS_X
 #endif
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SSE2_SIMD       HAS_X
+#else
+#define SSE2_SIMD       HAS__
+#endif
+
+#if defined(__AVX2__)
+#define AVX2_SIMD       HAS_X
+#else
+#define AVX2_SIMD       HAS__
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define NEON_SIMD       HAS_X
+#else
+#define NEON_SIMD       HAS__
+#endif
+
+#if defined(__linux__)
+#define IO_URING        HAS_X
+#else
+#define IO_URING        HAS__
+#endif
+
+#if defined(__linux__)
+#define INOTIFY         HAS_X
+#else
+#define INOTIFY         HAS__
+#endif
+
+#if defined(__linux__)
+#define CLOCK_NANOSLEEP HAS_X
+#else
+#define CLOCK_NANOSLEEP HAS__
+#endif
+
 #define __HAS_H
 #endif // #ifndef __HAS_H
@@ -15,6 +15,9 @@
 #include "imgui.h"
 #include "bitmap.h"
 #include "hwi.h"
+#include "pack.h"
+#include "bcn.h"
+#include "pixelops.h"
 
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h"
@@ -23,16 +26,201 @@
 
 #define FR() ((float)rand()) / (float)RAND_MAX
 
-const u32    kMaxTextures               = 128;
+const u32    kMaxTextureSlots           = 4096; // Registered bitmaps; slot 0 is reserved
 const size_t kOglHardwareMemSize        = 1024 * 1024;
 const size_t kMaxRenderBitmapStackDepth = 32;
-
+const size_t kMaxBlendStackDepth        = 16;
+
+// Sprite batcher limits, all per frame
+const u32 kMaxSpriteInstances = 64 * 1024;
+const u32 kMaxSpriteDraws     = 4096;
+const u32 kMaxSpriteBatches   = 256;
+const u32 kSpriteBufferFrames = 3; // Regions of the persistent instance buffer, so the render thread never writes one the GPU is reading
+const u32 kMaxSpriteCaches     = 256;
+const u32 kMaxSpriteCacheDraws = 256; // Per frame
+
+// Texture pages: layers of one array texture, as many as fit the budget
+const u32    kTexturePageSize   = 2048;
+const size_t kTexturePageBudget = 64 * 1024 * 1024;
+const u32    kMaxTexturePages   = (u32)(kTexturePageBudget / (kTexturePageSize * kTexturePageSize * 4));
+const u32    kMaxPageShelves    = 64;
+const u32    kPagePadding       = 1; // Gap right and below each bitmap so neighbours never get sampled
+
+// Texture units the state cache follows: 0 for whatever a draw samples, 1 the page array, 2 the slot rects
+const u32 kCachedTextureUnits = 3;
+
+// Bitmap streaming: queued pixels go up through a ring of pixel buffer regions, one region's worth a frame
+const u32 kUploadBytesPerFrame = 4 * 1024 * 1024;
+const u32 kUploadBufferFrames  = 3;
+
+// Frames between the game and render threads: one recorded while the other draws
+const u32    kRenderFrames      = 2;
+const u32    kMaxFrameOps       = 8192;
+const size_t kMaxFrameOpBytes   = 16 * 1024 * 1024; // Sprite cache contents going up with the frame
+const u32    kMaxFrameDrawLists = 16;
+
+// The game thread's view of a registered bitmap. Its GL objects are the render thread's, in the OglTexture of the
+// same slot.
 struct OglBitmap
 {
 	Bitmap *bitmap;
-	GLuint  texture;
-	GLuint  fbo;
-	u32     textureIdx;
+	u32     textureIdx; // Slot, stays put until the bitmap is unregistered
+	bool    standalone; // Has a standalone texture, or will by the time the frame draws
+	bool    target;     // Render target, drawn into through its framebuffer
+	bool    pageable;   // Fits a page, is sampled nearest and isn't a render target
+	i32     page;       // Array layer holding it, -1 when not resident
+	u16     pageX, pageY;
+	bool    ready;        // Pixels are on the GPU, so it can be drawn
+	bool    uploadQueued; // Waiting in or at the head of the upload queue
+	u32     uploadRow;    // Rows of the queued upload already sent
+};
+
+struct TexturePageShelf
+{
+	u32 y;
+	u32 height;
+	u32 used;
+};
+
+struct TexturePage
+{
+	TexturePageShelf shelves[kMaxPageShelves];
+	u32              numShelves;
+	u32              shelfTop;
+	u32              lastUsedFrame;
+};
+
+struct OglTexture
+{
+	GLuint texture; // Standalone texture, 0 until something needs one
+	GLuint fbo;
+};
+
+// A run of instances sharing texture and blend state: one instanced draw call
+struct SpriteDraw
+{
+	u32        texKey; // Slot whose standalone texture it samples, 0 for the page array
+	BlendState blend;
+	u32        firstInstance; // In this frame's instances
+	u32        numInstances;
+};
+
+// Sprites drawn by a single callback in the ImGui background list. Stays open across flushes and appends until
+// something that has to keep its place relative to the sprites goes in the list.
+struct SpriteBatch
+{
+	u32    firstDraw;
+	u32    numDraws;
+	ImVec4 clipRect;
+};
+
+// Static instances with their own buffer, kept across frames. The buffer is the render thread's, in the
+// spriteCacheVbos entry of the same index.
+struct OglSpriteCache
+{
+	bool       used;
+	OglBitmap *bitmap;
+	u32        numSprites;
+};
+
+struct SpriteCacheDraw
+{
+	u32        cache; // Index in spriteCaches
+	u32        numSprites;
+	u32        texKey;
+	BlendState blend;
+	r32        offset[2];
+	ImVec4     clipRect;
+};
+
+// GL work the game thread asks for while it records a frame, done by the render thread in order before the frame
+// draws. The bitmap is a copy as it was when the op went in, except the pixels, which are only read when it runs.
+enum OglOpType
+{
+	OOP_CreateTexture, // Standalone texture, filtered for the bitmap's sampling
+	OOP_LoadTexture,   // Every level of the standalone texture from the pixels
+	OOP_SetSampling,
+	OOP_DeleteTexture, // And the framebuffer, for a target
+	OOP_CreateTarget,  // Framebuffer around the standalone texture
+	OOP_UploadToPage,
+	OOP_StreamRows, // A band of rows through the pixel buffer, to the page and / or the standalone texture
+	OOP_UploadSpriteCache,
+	OOP_ReleaseSpriteCache,
+};
+
+struct OglOp
+{
+	OglOpType type;
+	u32       slot; // Texture slot, or the sprite cache for the cache ops
+	Bitmap    bitmap;
+	i32       page;
+	u16       pageX, pageY;
+	bool      toTexture;   // Streamed rows go to the standalone texture too
+	bool      makeStorage; // Before the first band, size the standalone texture with nothing in it
+	u32       firstRow, numRows;
+	u32       offset; // Of the rows in the frame's pixel buffer region, or of the sprites in the frame's op bytes
+	u32       numSprites;
+};
+
+// ImGui's output, copied out since the next NewFrame starts over on its lists. Texture ids are slots by then.
+struct OglDrawList
+{
+	ImVector<ImDrawVert> vtx;
+	ImVector<ImDrawIdx>  idx;
+	ImVector<ImDrawCmd>  cmds;
+};
+
+// Everything the render thread needs to draw one frame. The game thread records into one while the render thread
+// draws the other, which it empties once done; callbacks in the draw lists index its sprite arrays.
+struct OglFrame
+{
+	OglOp ops[kMaxFrameOps];
+	u32   numOps;
+	u8    opBytes[kMaxFrameOpBytes];
+	u32   numOpBytes;
+
+	HwiSprite   sprites[kMaxSpriteInstances]; // Sorted, copied into the instance buffer when the frame draws
+	u32         numSprites;
+	SpriteDraw  spriteDraws[kMaxSpriteDraws];
+	u32         numSpriteDraws;
+	SpriteBatch spriteBatches[kMaxSpriteBatches];
+	u32         numSpriteBatches;
+
+	SpriteCacheDraw spriteCacheDraws[kMaxSpriteCacheDraws];
+	u32             numSpriteCacheDraws;
+
+	r32  slotRects[kMaxTextureSlots][8]; // Only copied when they changed
+	bool slotRectsChanged;
+
+	OglDrawList drawLists[kMaxFrameDrawLists];
+	u32         numDrawLists;
+	ImVec2      displayPos, displaySize, framebufferScale;
+};
+
+enum OglTexTarget
+{
+	OTT_2D,
+	OTT_2DArray,
+	OTT_Buffer,
+
+	OTT_Count
+};
+
+// Shadow of the GL state that changes while drawing, so binds and enables that wouldn't change anything never reach
+// the driver. Only valid as long as every change goes through the helpers below.
+struct OglStateCache
+{
+	GLuint program;
+	GLuint vao;
+	GLuint arrayBuffer;
+	GLuint framebuffer;
+	u32    activeUnit;
+	GLuint textures[kCachedTextureUnits][OTT_Count];
+	bool   blend;
+	GLenum blendFunc[4]; // Source and dest rgb, then source and dest alpha
+	bool   scissorTest;
+	GLint  scissor[4];
+	GLint  viewport[4];
 };
 
 enum StateDirtyBits
@@ -43,8 +231,17 @@ enum StateDirtyBits
 
 struct OglHwi;
 
-struct OglGlobals
+// Split between the threads. The game thread records frames and keeps the books on slots, pages, uploads and sprite
+// caches; the render thread owns every GL object and the state cache. What one half needs from the other goes over
+// in an OglFrame.
+//
+// The render thread's half sits in the subsystem's transient memory next to the frames. A loop restore rewinds the
+// game, but the GL objects are whatever the render thread has made since, so their names, fences and cached state
+// can't be rewound with it.
+struct OglRenderGlobals
 {
+	bool glReady;
+
 	// Blit game framebuffer
 	GLuint blitTexture;
 	GLuint blitProgram;
@@ -55,27 +252,103 @@ struct OglGlobals
 	GLint samplerUniformLocation;
 
 	// ImGui draw support
-	Bitmap fontBitmap;
-
 	GLuint drawUIProgram, drawUIVertexProgram, drawUIFragmentProgram;
 	i32    uiTexLocation, uiProjMtxLocation;
 	i32    uiVtxPosLocation, uiVtxUVLocation, uiVtxColorLocation;
-	GLuint uiVbo, uiElements;
+	GLuint uiVao, uiVbo, uiElements;
+
+	OglStateCache glState;
+	OglTexture    glTextures[kMaxTextureSlots];
+
+	GLuint pageArray;
+	GLuint slotRectBuffer, slotRectTexture; // Buffer texture, two texels a slot: uv offset and scale, then layer
+
+	GLuint uploadPbo;
+	u8 *   uploadMapped; // Persistently mapped, kUploadBufferFrames regions. Null without ARB_buffer_storage.
+	GLsync uploadFences[kUploadBufferFrames];
+	u32    uploadFrame;
+
+	// Sprite batcher
+	GLuint spriteProgram;
+	i32    spriteTexLocation, spriteProjMtxLocation, spriteOffsetLocation;
+	i32    spritePagesLocation, spriteSlotRectsLocation;
+	GLuint spriteVao, spriteQuadVbo, spriteQuadElements, spriteInstanceVbo;
+
+	HwiSprite *spriteMapped; // Persistently mapped instance buffer, kSpriteBufferFrames regions. Null without ARB_buffer_storage.
+	GLsync     spriteFences[kSpriteBufferFrames];
+	u32        spriteFrame;
+	r32        spriteOffset[2]; // Last value of the offset uniform
+
+	GLuint spriteCacheVbos[kMaxSpriteCaches];
+
+	// Captured from the ImGui draw so sprite batches render in the same space
+	r32    orthoMtx[4][4];
+	i32    fbHeight;
+	ImVec2 clipOffset, clipScale;
+
+	// Block formats the driver samples directly, the others are decoded on upload
+	bool hasS3tc, hasBptc;
+
+	const OglFrame *drawingFrame; // The one RenderFrame is on, for the draw list callbacks
+};
+
+struct OglGlobals
+{
+	Bitmap fontBitmap;
+
+	OglBitmap textures[kMaxTextureSlots];
+	u32       freeTextureSlots[kMaxTextureSlots];
+	u32       numFreeTextureSlots;
 
-	OglBitmap textures[kMaxTextures];
-	u32       numTextures;
+	TexturePage pages[kMaxTexturePages];
+	r32         slotRects[kMaxTextureSlots][8];
+	bool        slotRectsDirty; // Since the last frame took a copy
+	u32         frameIndex;
+
+	// Upload queue, slots in FIFO order. The head streams a band of rows a frame until it's done.
+	u32 uploadQueue[kMaxTextureSlots];
+	u32 uploadQueueHead, numQueuedUploads;
 
 	Bitmap *renderBitmapStack[kMaxRenderBitmapStackDepth];
 	i32     renderBitmapStackPos;
 
+	BlendState blendStack[kMaxBlendStackDepth];
+	i32        blendStackPos;
+
+	u32       spriteLayer;
+	i32       openSpriteBatch; // Takes further sprites until something else goes in the draw list, -1 for none
+
+	OglSpriteCache spriteCaches[kMaxSpriteCaches];
+
+	Bitmap whiteBitmap; // Texture for untextured rects so they batch with everything else
+	u32    whitePixel;
+
 	u32 stateDirty;
 	i32 inBeginFrame;
 
 	Bitmap *screenBitmap;
 };
 
-static OglGlobals *gOgl;
+// The frames and the sprites waiting for a flush, tens of megabytes that only mean anything until the frame they're
+// for is drawn. They live in the subsystem's transient memory so loop recordings don't copy them with every snapshot,
+// and the counters go with them so a restore can't put the two threads out of step.
+struct OglFrameBuffers
+{
+	OglFrame frames[kRenderFrames];
+	u32      recordedFrames; // The one being recorded is frames[recordedFrames % kRenderFrames]
+	u32      renderedFrames;
 
+	HwiSprite pendingSprites[kMaxSpriteInstances]; // Since the last flush, in submission order
+	u64       pendingSpriteKeys[kMaxSpriteInstances];
+	u32       numPendingSprites;
+};
+static_assert(sizeof(OglFrameBuffers) % alignof(OglRenderGlobals) == 0, "OglRenderGlobals follows OglFrameBuffers");
+
+static OglGlobals *      gOgl;
+static OglRenderGlobals *gOglRender;
+static OglFrameBuffers * gOglFrames;
+
+#if HAS(DEV_BUILD)
 static void CheckGl()
 {
 	GLenum err;
@@ -88,6 +361,156 @@ static void CheckGl()
 
 	Assert(!errored);
 }
+#else
+// glGetError syncs with the driver, so it's dev builds only
+static inline void CheckGl() {}
+#endif
+
+static void QiOgl_InitStateCache()
+{
+	OglStateCache *cache = &gOglRender->glState;
+	memset(cache, 0, sizeof(*cache));
+	cache->blendFunc[0] = GL_ONE;
+	cache->blendFunc[1] = GL_ZERO;
+	cache->blendFunc[2] = GL_ONE;
+	cache->blendFunc[3] = GL_ZERO;
+
+	// Not known until set
+	for (u32 i = 0; i < 4; i++)
+	{
+		cache->scissor[i]  = -1;
+		cache->viewport[i] = -1;
+	}
+}
+
+static void QiOgl_UseProgram(GLuint program)
+{
+	if (gOglRender->glState.program != program)
+	{
+		glUseProgram(program);
+		gOglRender->glState.program = program;
+	}
+}
+
+static void QiOgl_BindVertexArray(GLuint vao)
+{
+	if (gOglRender->glState.vao != vao)
+	{
+		glBindVertexArray(vao);
+		gOglRender->glState.vao = vao;
+	}
+}
+
+static void QiOgl_BindArrayBuffer(GLuint buffer)
+{
+	if (gOglRender->glState.arrayBuffer != buffer)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		gOglRender->glState.arrayBuffer = buffer;
+	}
+}
+
+static void QiOgl_BindFramebuffer(GLuint fbo)
+{
+	if (gOglRender->glState.framebuffer != fbo)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+		gOglRender->glState.framebuffer = fbo;
+	}
+}
+
+static void QiOgl_BindTexture(u32 unit, GLenum target, GLuint texture)
+{
+	Assert(unit < kCachedTextureUnits);
+	const u32 targetIdx = target == GL_TEXTURE_2D ? OTT_2D : (target == GL_TEXTURE_2D_ARRAY ? OTT_2DArray : OTT_Buffer);
+	Assert(targetIdx != OTT_Buffer || target == GL_TEXTURE_BUFFER);
+
+	OglStateCache *cache = &gOglRender->glState;
+	if (cache->textures[unit][targetIdx] == texture)
+		return;
+
+	if (cache->activeUnit != unit)
+	{
+		glActiveTexture(GL_TEXTURE0 + unit);
+		cache->activeUnit = unit;
+	}
+	glBindTexture(target, texture);
+	cache->textures[unit][targetIdx] = texture;
+}
+
+// Deleting a texture unbinds it everywhere
+static void QiOgl_DeleteTexture(GLuint *texture)
+{
+	OglStateCache *cache = &gOglRender->glState;
+	for (u32 unit = 0; unit < kCachedTextureUnits; unit++)
+		for (u32 ti = 0; ti < OTT_Count; ti++)
+			if (cache->textures[unit][ti] == *texture)
+				cache->textures[unit][ti] = 0;
+
+	glDeleteTextures(1, texture);
+	*texture = 0;
+}
+
+// Blend funcs are left alone while blending is off
+static void QiOgl_SetBlend(bool enable, GLenum srcRgb, GLenum dstRgb, GLenum srcAlpha, GLenum dstAlpha)
+{
+	OglStateCache *cache = &gOglRender->glState;
+	if (cache->blend != enable)
+	{
+		if (enable)
+			glEnable(GL_BLEND);
+		else
+			glDisable(GL_BLEND);
+		cache->blend = enable;
+	}
+
+	if (enable && (cache->blendFunc[0] != srcRgb || cache->blendFunc[1] != dstRgb || cache->blendFunc[2] != srcAlpha || cache->blendFunc[3] != dstAlpha))
+	{
+		glBlendFuncSeparate(srcRgb, dstRgb, srcAlpha, dstAlpha);
+		cache->blendFunc[0] = srcRgb;
+		cache->blendFunc[1] = dstRgb;
+		cache->blendFunc[2] = srcAlpha;
+		cache->blendFunc[3] = dstAlpha;
+	}
+}
+
+static void QiOgl_SetScissorTest(bool enable)
+{
+	if (gOglRender->glState.scissorTest != enable)
+	{
+		if (enable)
+			glEnable(GL_SCISSOR_TEST);
+		else
+			glDisable(GL_SCISSOR_TEST);
+		gOglRender->glState.scissorTest = enable;
+	}
+}
+
+static void QiOgl_SetScissor(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	GLint *box = gOglRender->glState.scissor;
+	if (box[0] != x || box[1] != y || box[2] != width || box[3] != height)
+	{
+		glScissor(x, y, width, height);
+		box[0] = x;
+		box[1] = y;
+		box[2] = width;
+		box[3] = height;
+	}
+}
+
+static void QiOgl_SetViewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	GLint *vp = gOglRender->glState.viewport;
+	if (vp[0] != x || vp[1] != y || vp[2] != width || vp[3] != height)
+	{
+		glViewport(x, y, width, height);
+		vp[0] = x;
+		vp[1] = y;
+		vp[2] = width;
+		vp[3] = height;
+	}
+}
 
 // TODO: Change shader load to use platform functionality once we have proper files / asset system
 internal char *GetShaderText(const char *fileName)
@@ -117,162 +540,1119 @@ internal void FreeShaderText(void *text)
 
 static GLuint LoadGlslShader(GLenum shaderType, const char *shaderFile)
 {
-	GLuint shader       = glCreateShader(shaderType);
-	char * shaderSource = GetShaderText(shaderFile);
-	int    sourceLen    = -1;
+	GLuint             shader = glCreateShader(shaderType);
+	const PackEntry_s *packed = Pack_Find(shaderFile, PACK_SHADER);
+	if (packed != nullptr)
+	{
+		const char *shaderSource = (const char *)Pack_Data(packed);
+		const int   sourceLen    = (int)packed->size;
+		glShaderSource(shader, 1, &shaderSource, &sourceLen);
+	}
+	else
+	{
+		char *shaderSource = GetShaderText(shaderFile);
+		int   sourceLen    = -1;
+		glShaderSource(shader, 1, &shaderSource, &sourceLen);
+		FreeShaderText(shaderSource);
+	}
+	glCompileShader(shader);
+
+	GLint compileStatus;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &compileStatus);
+
+	if (compileStatus != GL_TRUE)
+	{
+		GLint logLen;
+		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLen);
+		char *log = (char *)malloc(logLen + 1);
+		glGetShaderInfoLog(shader, logLen + 1, nullptr, log);
+		printf("Shader compile failed! Log follows:\n");
+		printf("%s", log);
+		free(log);
+	}
+
+	return shader;
+}
+
+// Render thread, before the first frame's ops run
+static void QiOgl_InitGl()
+{
+	if (!gladLoadGL())
+	{
+		Assert(0 && "Couldn't init OpenGL");
+	}
+	QiOgl_InitStateCache();
+
+	// Neither is core in the 4.1 we ask for
+	gOglRender->hasS3tc = GLAD_GL_EXT_texture_compression_s3tc && GLAD_GL_EXT_texture_sRGB;
+	gOglRender->hasBptc = GLAD_GL_ARB_texture_compression_bptc;
+
+	// Nothing ever changes these
+	glBlendEquation(GL_FUNC_ADD);
+	glDisable(GL_CULL_FACE);
+	glDisable(GL_DEPTH_TEST);
+	glEnable(GL_FRAMEBUFFER_SRGB);
+
+	// Set up screen blit
+	glGenTextures(1, &gOglRender->blitTexture);
+	QiOgl_BindTexture(0, GL_TEXTURE_2D, gOglRender->blitTexture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+
+	// Create program for blit
+	GLuint vs = LoadGlslShader(GL_VERTEX_SHADER, "blit_vs.glsl");
+	GLuint fs = LoadGlslShader(GL_FRAGMENT_SHADER, "blit_fs.glsl");
+
+	gOglRender->blitProgram = glCreateProgram();
+	glAttachShader(gOglRender->blitProgram, vs);
+	glAttachShader(gOglRender->blitProgram, fs);
+	glLinkProgram(gOglRender->blitProgram);
+
+	GLint status;
+	glGetProgramiv(gOglRender->blitProgram, GL_LINK_STATUS, &status);
+	Assert(status == GL_TRUE);
+
+	QiOgl_UseProgram(gOglRender->blitProgram);
+	gOglRender->samplerUniformLocation = glGetUniformLocation(gOglRender->blitProgram, "tex");
+
+	// Create program for imgui
+	vs = LoadGlslShader(GL_VERTEX_SHADER, "imgui_vs.glsl");
+	fs = LoadGlslShader(GL_FRAGMENT_SHADER, "imgui_fs.glsl");
+
+	gOglRender->drawUIProgram = glCreateProgram();
+	glAttachShader(gOglRender->drawUIProgram, vs);
+	glAttachShader(gOglRender->drawUIProgram, fs);
+	glLinkProgram(gOglRender->drawUIProgram);
+
+	glGetProgramiv(gOglRender->drawUIProgram, GL_LINK_STATUS, &status);
+	Assert(status == GL_TRUE);
+
+	QiOgl_UseProgram(gOglRender->drawUIProgram);
+	gOglRender->uiTexLocation      = glGetUniformLocation(gOglRender->drawUIProgram, "tex");
+	gOglRender->uiProjMtxLocation  = glGetUniformLocation(gOglRender->drawUIProgram, "projMtx");
+	gOglRender->uiVtxPosLocation   = glGetAttribLocation(gOglRender->drawUIProgram, "pos");
+	gOglRender->uiVtxUVLocation    = glGetAttribLocation(gOglRender->drawUIProgram, "uv");
+	gOglRender->uiVtxColorLocation = glGetAttribLocation(gOglRender->drawUIProgram, "color");
+
+	glUniform1i(gOglRender->uiTexLocation, 0);
+
+	// ImDrawVert layout, set up once. The buffers are respecified every frame but keep their names.
+	glGenBuffers(1, &gOglRender->uiVbo);
+	glGenBuffers(1, &gOglRender->uiElements);
+	glGenVertexArrays(1, &gOglRender->uiVao);
+	QiOgl_BindVertexArray(gOglRender->uiVao);
+	QiOgl_BindArrayBuffer(gOglRender->uiVbo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gOglRender->uiElements);
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (GLvoid *)IM_OFFSETOF(ImDrawVert, pos));
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (GLvoid *)IM_OFFSETOF(ImDrawVert, uv));
+	glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ImDrawVert), (GLvoid *)IM_OFFSETOF(ImDrawVert, col));
+	QiOgl_BindVertexArray(0);
+	CheckGl();
+
+	glGenVertexArrays(1, &gOglRender->quadVao);
+	glGenBuffers(1, &gOglRender->quadVbo);
+
+	void QiOgl_InitTexturePages();
+	QiOgl_InitTexturePages();
+
+	void QiOgl_InitSprites();
+	QiOgl_InitSprites();
+
+	gOglRender->glReady = true;
+}
+
+void QiOgl_InitSprites()
+{
+	GLuint vs = LoadGlslShader(GL_VERTEX_SHADER, "sprite_vs.glsl");
+	GLuint fs = LoadGlslShader(GL_FRAGMENT_SHADER, "sprite_fs.glsl");
+
+	gOglRender->spriteProgram = glCreateProgram();
+	glAttachShader(gOglRender->spriteProgram, vs);
+	glAttachShader(gOglRender->spriteProgram, fs);
+	glLinkProgram(gOglRender->spriteProgram);
+
+	GLint status;
+	glGetProgramiv(gOglRender->spriteProgram, GL_LINK_STATUS, &status);
+	Assert(status == GL_TRUE);
+
+	gOglRender->spriteTexLocation     = glGetUniformLocation(gOglRender->spriteProgram, "tex");
+	gOglRender->spriteProjMtxLocation = glGetUniformLocation(gOglRender->spriteProgram, "projMtx");
+	gOglRender->spriteOffsetLocation  = glGetUniformLocation(gOglRender->spriteProgram, "offset");
+	gOglRender->spritePagesLocation     = glGetUniformLocation(gOglRender->spriteProgram, "pages");
+	gOglRender->spriteSlotRectsLocation = glGetUniformLocation(gOglRender->spriteProgram, "slotRects");
+
+	// Samplers always read the same units
+	QiOgl_UseProgram(gOglRender->spriteProgram);
+	glUniform1i(gOglRender->spriteTexLocation, 0);
+	glUniform1i(gOglRender->spritePagesLocation, 1);
+	glUniform1i(gOglRender->spriteSlotRectsLocation, 2);
+	glUniform2f(gOglRender->spriteOffsetLocation, 0.0f, 0.0f);
+
+	const GLfloat corners[]  = {0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f};
+	const GLuint  elements[] = {0, 1, 2, 0, 2, 3};
+
+	glGenVertexArrays(1, &gOglRender->spriteVao);
+	QiOgl_BindVertexArray(gOglRender->spriteVao);
+
+	glGenBuffers(1, &gOglRender->spriteQuadVbo);
+	QiOgl_BindArrayBuffer(gOglRender->spriteQuadVbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 2, nullptr);
+
+	glGenBuffers(1, &gOglRender->spriteQuadElements);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gOglRender->spriteQuadElements);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(elements), elements, GL_STATIC_DRAW);
+
+	// Per instance attributes; pointers are set per draw since each draw starts at a different instance
+	glGenBuffers(1, &gOglRender->spriteInstanceVbo);
+	QiOgl_BindArrayBuffer(gOglRender->spriteInstanceVbo);
+	for (GLuint attrib = 1; attrib <= 4; attrib++)
+	{
+		glEnableVertexAttribArray(attrib);
+		glVertexAttribDivisor(attrib, 1);
+	}
+
+	const GLsizeiptr regionSize = (GLsizeiptr)kMaxSpriteInstances * sizeof(HwiSprite);
+	if (GLAD_GL_ARB_buffer_storage)
+	{
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_ARRAY_BUFFER, regionSize * kSpriteBufferFrames, nullptr, flags);
+		gOglRender->spriteMapped = (HwiSprite *)glMapBufferRange(GL_ARRAY_BUFFER, 0, regionSize * kSpriteBufferFrames, flags);
+		Assert(gOglRender->spriteMapped);
+	}
+	else
+	{
+		glBufferData(GL_ARRAY_BUFFER, regionSize, nullptr, GL_STREAM_DRAW);
+	}
+	CheckGl();
+
+	QiOgl_BindVertexArray(0);
+}
+
+static void QiOgl_InitBlitBufferState()
+{
+	GLfloat vertices[] = {
+		-1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f, 1.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f,
+	};
+
+	QiOgl_SetScissorTest(false);
+	QiOgl_BindVertexArray(gOglRender->quadVao);
+	QiOgl_BindArrayBuffer(gOglRender->quadVbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glDisableVertexAttribArray(2);
+
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 5, nullptr);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 5, (void *)(sizeof(GLfloat) * 3));
+}
+
+// Render thread. The callback data is the target's slot, 0 for the default framebuffer.
+static void IGC_SetRenderBitmap(const ImDrawList *, const ImDrawCmd *cmd)
+{
+	static GLenum drawNone[] = {GL_NONE};
+
+	const u32 slot = (u32)(uintptr_t)cmd->UserCallbackData;
+	if (slot == 0)
+	{
+		QiOgl_BindFramebuffer(0);
+		return;
+	}
+
+	const OglTexture *tex = &gOglRender->glTextures[slot];
+	Assert(tex->fbo);
+	QiOgl_BindFramebuffer(tex->fbo);
+}
+
+static void IGC_ClearCurrentTarget(const ImDrawList *, const ImDrawCmd* cmd)
+{
+	Color clearColor((u32)(uintptr_t)cmd->UserCallbackData);
+
+	glClearColor(clearColor.r, clearColor.g, clearColor.b, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void QiOgl_LoadBitmapToTex(GLuint tex, const Bitmap *bitmap);
+
+static OglFrame *QiOgl_RecordingFrame()
+{
+	return &gOglFrames->frames[gOglFrames->recordedFrames % kRenderFrames];
+}
+
+// Game thread. Runs on the render thread ahead of the frame being recorded, with the bitmap as it is now.
+static OglOp *QiOgl_AddOp(OglOpType type, const OglBitmap *oglBmp)
+{
+	OglFrame *frame = QiOgl_RecordingFrame();
+	Assert(frame->numOps < kMaxFrameOps);
+	OglOp *op = &frame->ops[frame->numOps++];
+	memset(op, 0, sizeof(*op));
+	op->type = type;
+	if (oglBmp)
+	{
+		op->slot      = oglBmp->textureIdx;
+		op->bitmap    = *oglBmp->bitmap;
+		op->page      = oglBmp->page;
+		op->pageX     = oglBmp->pageX;
+		op->pageY     = oglBmp->pageY;
+		op->toTexture = oglBmp->standalone;
+	}
+	return op;
+}
+
+// Texture pages. Bitmaps that fit are packed into layers of one array texture by a shelf allocator, so sprites from
+// any of them share a draw. Each sprite instance carries its bitmap's slot; the slot rect table maps that to a layer
+// and a uv offset and scale. A page is evicted whole, least recently drawn first, when a bitmap needs room. The game
+// thread does the packing; the render thread only copies pixels and the table in.
+
+static void QiOgl_SetSlotRect(u32 slot, r32 u, r32 v, r32 su, r32 sv, i32 layer)
+{
+	r32 *rect = gOgl->slotRects[slot];
+	rect[0]   = u;
+	rect[1]   = v;
+	rect[2]   = su;
+	rect[3]   = sv;
+	rect[4]   = (r32)layer;
+	gOgl->slotRectsDirty = true;
+}
+
+void QiOgl_InitTexturePages()
+{
+	glGenTextures(1, &gOglRender->pageArray);
+	QiOgl_BindTexture(1, GL_TEXTURE_2D_ARRAY, gOglRender->pageArray);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_SRGB8_ALPHA8, kTexturePageSize, kTexturePageSize, kMaxTexturePages, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	CheckGl();
+
+	glGenBuffers(1, &gOglRender->slotRectBuffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, gOglRender->slotRectBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(gOgl->slotRects), nullptr, GL_DYNAMIC_DRAW);
+	glGenTextures(1, &gOglRender->slotRectTexture);
+	QiOgl_BindTexture(2, GL_TEXTURE_BUFFER, gOglRender->slotRectTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, gOglRender->slotRectBuffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	CheckGl();
+
+	glGenBuffers(1, &gOglRender->uploadPbo);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, gOglRender->uploadPbo);
+	if (GLAD_GL_ARB_buffer_storage)
+	{
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)kUploadBytesPerFrame * kUploadBufferFrames, nullptr, flags);
+		gOglRender->uploadMapped = (u8 *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)kUploadBytesPerFrame * kUploadBufferFrames, flags);
+		Assert(gOglRender->uploadMapped);
+	}
+	else
+	{
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, kUploadBytesPerFrame, nullptr, GL_STREAM_DRAW);
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	CheckGl();
+}
+
+static void QiOgl_UploadSlotRects(const OglFrame *frame)
+{
+	if (!frame->slotRectsChanged)
+		return;
+
+	glBindBuffer(GL_TEXTURE_BUFFER, gOglRender->slotRectBuffer);
+	glBufferSubData(GL_TEXTURE_BUFFER, 0, sizeof(frame->slotRects), frame->slotRects);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+static void QiOgl_RunUploadToPage(const OglOp *op)
+{
+	const Bitmap *bitmap = &op->bitmap;
+	Assert(!Bm_IsCompressed(bitmap->format) && op->page >= 0);
+	QiOgl_BindTexture(1, GL_TEXTURE_2D_ARRAY, gOglRender->pageArray);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, (GLint)bitmap->pitch);
+	glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, op->pageX, op->pageY, op->page, bitmap->width, bitmap->height, 1, GL_RGBA, GL_UNSIGNED_BYTE, bitmap->pixels);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	CheckGl();
+}
+
+// First fit on the existing shelves, else a new shelf under the last one. Sizes include the padding.
+static bool QiOgl_PageAlloc(TexturePage *page, u32 width, u32 height, u32 *x, u32 *y)
+{
+	for (u32 si = 0; si < page->numShelves; si++)
+	{
+		TexturePageShelf *shelf = &page->shelves[si];
+		if (shelf->height >= height && shelf->used + width <= kTexturePageSize)
+		{
+			*x = shelf->used;
+			*y = shelf->y;
+			shelf->used += width;
+			return true;
+		}
+	}
+
+	if (page->numShelves == kMaxPageShelves || page->shelfTop + height > kTexturePageSize)
+		return false;
+
+	TexturePageShelf *shelf = &page->shelves[page->numShelves++];
+	shelf->y                = page->shelfTop;
+	shelf->height           = height;
+	shelf->used             = width;
+	page->shelfTop += height;
+	*x = 0;
+	*y = shelf->y;
+	return true;
+}
+
+static void QiOgl_EvictPage(u32 pageIdx)
+{
+	for (u32 slot = 1; slot < kMaxTextureSlots; slot++)
+	{
+		OglBitmap *oglBmp = &gOgl->textures[slot];
+		if (oglBmp->bitmap && oglBmp->page == (i32)pageIdx)
+		{
+			// A stream half way into this page starts over wherever it lands next
+			oglBmp->page      = -1;
+			oglBmp->uploadRow = 0;
+			QiOgl_SetSlotRect(slot, 0.0f, 0.0f, 1.0f, 1.0f, -1);
+		}
+	}
+
+	TexturePage *page = &gOgl->pages[pageIdx];
+	page->numShelves  = 0;
+	page->shelfTop    = 0;
+}
+
+// Finds the bitmap room in a page without uploading anything
+static bool QiOgl_PagePlace(OglBitmap *oglBmp)
+{
+	const u32 width  = oglBmp->bitmap->width + kPagePadding;
+	const u32 height = oglBmp->bitmap->height + kPagePadding;
+
+	u32 x, y;
+	i32 pageIdx = -1;
+	for (u32 pi = 0; pi < kMaxTexturePages && pageIdx < 0; pi++)
+		if (QiOgl_PageAlloc(&gOgl->pages[pi], width, height, &x, &y))
+			pageIdx = (i32)pi;
+
+	if (pageIdx < 0)
+	{
+		// Pages drawn this frame can't go, their sprites are already queued. Ones the frame before drew can: their
+		// uploads are ops of this frame, so they run after that frame has drawn.
+		for (u32 pi = 0; pi < kMaxTexturePages; pi++)
+		{
+			const TexturePage *page = &gOgl->pages[pi];
+			if (page->lastUsedFrame != gOgl->frameIndex && (pageIdx < 0 || page->lastUsedFrame < gOgl->pages[pageIdx].lastUsedFrame))
+				pageIdx = (i32)pi;
+		}
+		if (pageIdx < 0)
+			return false;
+
+		QiOgl_EvictPage((u32)pageIdx);
+		const bool fits = QiOgl_PageAlloc(&gOgl->pages[pageIdx], width, height, &x, &y);
+		Assert(fits);
+	}
+
+	oglBmp->page  = pageIdx;
+	oglBmp->pageX = (u16)x;
+	oglBmp->pageY = (u16)y;
+	return true;
+}
+
+static void QiOgl_SetPageSlotRect(const OglBitmap *oglBmp)
+{
+	const r32 invPage = 1.0f / (r32)kTexturePageSize;
+	QiOgl_SetSlotRect(oglBmp->textureIdx, oglBmp->pageX * invPage, oglBmp->pageY * invPage, oglBmp->bitmap->width * invPage,
+	                  oglBmp->bitmap->height * invPage, oglBmp->page);
+}
+
+static bool QiOgl_PageIn(OglBitmap *oglBmp)
+{
+	if (!QiOgl_PagePlace(oglBmp))
+		return false;
+
+	QiOgl_AddOp(OOP_UploadToPage, oglBmp);
+	QiOgl_SetPageSlotRect(oglBmp);
+	return true;
+}
+
+// Filtering of the bound GL_TEXTURE_2D for the bitmap's sampling, over the levels it has
+static void QiOgl_SetTexSampling(const Bitmap *bitmap, u32 numLevels)
+{
+	const bool nearest = bitmap->sampling == Bitmap::SampleNearest;
+	const bool mips    = bitmap->sampling == Bitmap::SampleMipmapped && numLevels > 1;
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, nearest ? GL_NEAREST : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, nearest ? GL_NEAREST : mips ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)numLevels - 1);
+}
+
+// Gives the bitmap its own GL_TEXTURE_2D on first use. Render targets, bitmaps too big for a page or not sampled
+// nearest, and anything ImGui draws need one.
+static void QiOgl_StandaloneTexture(OglBitmap *oglBmp)
+{
+	if (oglBmp->standalone)
+		return;
+
+	oglBmp->standalone = true;
+	QiOgl_AddOp(OOP_CreateTexture, oglBmp);
+	if (oglBmp->ready && oglBmp->bitmap->pixels)
+		QiOgl_AddOp(OOP_LoadTexture, oglBmp);
+	else if (oglBmp->uploadQueued)
+		oglBmp->uploadRow = 0; // Rows already streamed went elsewhere
+}
+
+// Makes the bitmap drawable by sprites this frame and returns its texture key: 0 for the page array, otherwise its
+// slot, whose standalone texture has to be bound. Only for ready bitmaps.
+static u32 QiOgl_TouchSpriteBitmap(OglBitmap *oglBmp)
+{
+	Assert(oglBmp->ready);
+	if (oglBmp->pageable && oglBmp->page < 0 && !QiOgl_PageIn(oglBmp))
+		QiOgl_StandaloneTexture(oglBmp);
+
+	if (oglBmp->page >= 0)
+	{
+		gOgl->pages[oglBmp->page].lastUsedFrame = gOgl->frameIndex;
+		return 0;
+	}
+	return oglBmp->textureIdx;
+}
+
+// Render thread
+static GLuint QiOgl_KeyTexture(u32 texKey)
+{
+	return texKey ? gOglRender->glTextures[texKey].texture : 0;
+}
+
+static void QiOgl_RunCreateTexture(const OglOp *op)
+{
+	OglTexture *tex = &gOglRender->glTextures[op->slot];
+	Assert(tex->texture == 0);
+	glGenTextures(1, &tex->texture);
+	QiOgl_BindTexture(0, GL_TEXTURE_2D, tex->texture);
+	QiOgl_SetTexSampling(&op->bitmap, 1);
+	CheckGl();
+}
+
+// Framebuffer around the slot's standalone texture
+static void QiOgl_RunCreateTarget(const OglOp *op)
+{
+	static GLenum drawBuffers[] = {GL_COLOR_ATTACHMENT0};
+
+	OglTexture *tex = &gOglRender->glTextures[op->slot];
+	Assert(tex->texture && tex->fbo == 0);
+	glGenFramebuffers(1, &tex->fbo);
+	CheckGl();
+
+	const GLuint prevFbo = gOglRender->glState.framebuffer;
+	QiOgl_BindFramebuffer(tex->fbo);
+	CheckGl();
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex->texture, 0);
+	CheckGl();
+	glDrawBuffers(1, drawBuffers);
+	CheckGl();
+	Assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+	QiOgl_BindFramebuffer(prevFbo);
+}
+
+static void QiOgl_RunDeleteTexture(const OglOp *op)
+{
+	OglTexture *tex = &gOglRender->glTextures[op->slot];
+	if (tex->texture)
+		QiOgl_DeleteTexture(&tex->texture);
+	if (tex->fbo)
+	{
+		if (gOglRender->glState.framebuffer == tex->fbo)
+			gOglRender->glState.framebuffer = 0;
+		glDeleteFramebuffers(1, &tex->fbo);
+		tex->fbo = 0;
+	}
+}
+
+// Streaming uploads. UploadBitmap only queues the bitmap. At the start of each frame the queue head gets as many rows
+// as fit what's left of kUploadBytesPerFrame, then the next in line, until the budget is gone. The render thread
+// copies those rows into its region of the pixel buffer when the frame's ops run, and sends them on from there to the
+// page and / or standalone texture. A region isn't written again until its fence says the GPU has finished reading it.
+
+static void QiOgl_QueueUpload(OglBitmap *oglBmp)
+{
+	oglBmp->uploadRow = 0;
+	if (oglBmp->uploadQueued)
+		return;
+
+	Assert(gOgl->numQueuedUploads < kMaxTextureSlots);
+	gOgl->uploadQueue[(gOgl->uploadQueueHead + gOgl->numQueuedUploads) % kMaxTextureSlots] = oglBmp->textureIdx;
+	gOgl->numQueuedUploads++;
+	oglBmp->uploadQueued = true;
+}
+
+static void QiOgl_CancelUpload(OglBitmap *oglBmp)
+{
+	if (!oglBmp->uploadQueued)
+		return;
+
+	u32 kept = 0;
+	for (u32 qi = 0; qi < gOgl->numQueuedUploads; qi++)
+	{
+		const u32 slot = gOgl->uploadQueue[(gOgl->uploadQueueHead + qi) % kMaxTextureSlots];
+		if (slot != oglBmp->textureIdx)
+			gOgl->uploadQueue[(gOgl->uploadQueueHead + kept++) % kMaxTextureSlots] = slot;
+	}
+	gOgl->numQueuedUploads = kept;
+	oglBmp->uploadQueued   = false;
+}
+
+// Queues the next band of rows that fits in the region from used on, returning the bytes it takes
+static u32 QiOgl_StreamRows(OglBitmap *oglBmp, u32 used)
+{
+	const Bitmap *bitmap   = oglBmp->bitmap;
+	const u32     rowBytes = bitmap->width * sizeof(u32);
+	Assert(rowBytes <= kUploadBytesPerFrame && !Bm_IsCompressed(bitmap->format) && bitmap->sampling != Bitmap::SampleMipmapped);
+
+	const u32 rowsFit  = (kUploadBytesPerFrame - used) / rowBytes;
+	const u32 rowsLeft = bitmap->height - oglBmp->uploadRow;
+	const u32 numRows  = rowsFit < rowsLeft ? rowsFit : rowsLeft;
+	if (numRows == 0)
+		return 0;
+
+	// Storage has to exist before the rows arrive
+	bool makeStorage = false;
+	if (oglBmp->uploadRow == 0)
+	{
+		if (oglBmp->pageable && oglBmp->page < 0 && !QiOgl_PagePlace(oglBmp))
+			QiOgl_StandaloneTexture(oglBmp);
+		makeStorage = oglBmp->standalone && !oglBmp->ready;
+	}
+
+	OglOp *op       = QiOgl_AddOp(OOP_StreamRows, oglBmp);
+	op->makeStorage = makeStorage;
+	op->firstRow    = oglBmp->uploadRow;
+	op->numRows     = numRows;
+	op->offset      = used;
+
+	oglBmp->uploadRow += numRows;
+	return numRows * rowBytes;
+}
+
+static void QiOgl_StreamUploads()
+{
+	u32 used = 0;
+	while (gOgl->numQueuedUploads > 0)
+	{
+		OglBitmap *oglBmp = &gOgl->textures[gOgl->uploadQueue[gOgl->uploadQueueHead]];
+		used += QiOgl_StreamRows(oglBmp, used);
+		if (oglBmp->uploadRow < oglBmp->bitmap->height)
+			break;
+
+		oglBmp->ready        = true;
+		oglBmp->uploadQueued = false;
+		if (oglBmp->page >= 0)
+			QiOgl_SetPageSlotRect(oglBmp);
+		gOgl->uploadQueueHead = (gOgl->uploadQueueHead + 1) % kMaxTextureSlots;
+		gOgl->numQueuedUploads--;
+	}
+}
+
+// Render thread, before a frame's first band: on to the next region once the GPU is done with it
+static void QiOgl_BeginUploadRegion()
+{
+	gOglRender->uploadFrame = (gOglRender->uploadFrame + 1) % kUploadBufferFrames;
+	if (gOglRender->uploadFences[gOglRender->uploadFrame])
+	{
+		glClientWaitSync(gOglRender->uploadFences[gOglRender->uploadFrame], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+		glDeleteSync(gOglRender->uploadFences[gOglRender->uploadFrame]);
+		gOglRender->uploadFences[gOglRender->uploadFrame] = nullptr;
+	}
+
+	if (!gOglRender->uploadMapped)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, gOglRender->uploadPbo);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, kUploadBytesPerFrame, nullptr, GL_STREAM_DRAW);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+}
+
+static void QiOgl_RunStreamRows(const OglOp *op)
+{
+	const Bitmap *bitmap   = &op->bitmap;
+	const u32     rowBytes = bitmap->width * sizeof(u32);
+	const GLuint  texture  = gOglRender->glTextures[op->slot].texture;
+	Assert(!op->toTexture || texture);
+
+	// Can't happen with the pixel buffer bound
+	if (op->makeStorage)
+	{
+		QiOgl_BindTexture(0, GL_TEXTURE_2D, texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, bitmap->width, bitmap->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	}
+
+	// Packed tight in the buffer whatever the bitmap's pitch
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, gOglRender->uploadPbo);
+	const u32 bandBytes = op->numRows * rowBytes;
+	const u32 offset    = (gOglRender->uploadMapped ? gOglRender->uploadFrame * kUploadBytesPerFrame : 0) + op->offset;
+	u8 *      dest      = gOglRender->uploadMapped ? gOglRender->uploadMapped + offset
+	                                         : (u8 *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, offset, bandBytes,
+	                                                                  GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	Assert(dest);
+	const u32 *src = bitmap->pixels + op->firstRow * bitmap->pitch;
+	for (u32 row = 0; row < op->numRows; row++)
+		memcpy(dest + row * rowBytes, src + row * bitmap->pitch, rowBytes);
+	if (!gOglRender->uploadMapped)
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+	if (op->page >= 0)
+	{
+		QiOgl_BindTexture(1, GL_TEXTURE_2D_ARRAY, gOglRender->pageArray);
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, op->pageX, op->pageY + op->firstRow, op->page, bitmap->width, op->numRows, 1, GL_RGBA,
+		                GL_UNSIGNED_BYTE, (void *)(uintptr_t)offset);
+	}
+	if (op->toTexture)
+	{
+		QiOgl_BindTexture(0, GL_TEXTURE_2D, texture);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, op->firstRow, bitmap->width, op->numRows, GL_RGBA, GL_UNSIGNED_BYTE, (void *)(uintptr_t)offset);
+	}
+	CheckGl();
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+static BlendState QiOgl_CurBlendState()
+{
+	return gOgl->blendStackPos > 0 ? gOgl->blendStack[gOgl->blendStackPos - 1] : BSTATE_SrcAlpha_OneMinusDstAlpha;
+}
+
+static void QiOgl_ApplyBlendState(BlendState blend)
+{
+	switch (blend)
+	{
+	case BSTATE_None:
+		QiOgl_SetBlend(false, GL_ONE, GL_ZERO, GL_ONE, GL_ZERO);
+		break;
+	case BSTATE_SrcAlpha_OneMinusDstAlpha:
+		// Same as the ImGui state sprites were drawn with before they were batched
+		QiOgl_SetBlend(true, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+		break;
+	case BSTATE_Src_DstAlpha:
+		QiOgl_SetBlend(true, GL_ONE, GL_DST_ALPHA, GL_ONE, GL_DST_ALPHA);
+		break;
+	}
+}
+
+static void QiOgl_BeginSpriteDraw(const ImVec4 &clip, GLuint instanceVbo, r32 offsetX, r32 offsetY)
+{
+	QiOgl_UseProgram(gOglRender->spriteProgram);
+	if (gOglRender->spriteOffset[0] != offsetX || gOglRender->spriteOffset[1] != offsetY)
+	{
+		glUniform2f(gOglRender->spriteOffsetLocation, offsetX, offsetY);
+		gOglRender->spriteOffset[0] = offsetX;
+		gOglRender->spriteOffset[1] = offsetY;
+	}
+	QiOgl_BindVertexArray(gOglRender->spriteVao);
+	QiOgl_BindArrayBuffer(instanceVbo);
+	QiOgl_BindTexture(1, GL_TEXTURE_2D_ARRAY, gOglRender->pageArray);
+	QiOgl_BindTexture(2, GL_TEXTURE_BUFFER, gOglRender->slotRectTexture);
+
+	const r32 x0 = (clip.x - gOglRender->clipOffset.x) * gOglRender->clipScale.x;
+	const r32 y0 = (clip.y - gOglRender->clipOffset.y) * gOglRender->clipScale.y;
+	const r32 x1 = (clip.z - gOglRender->clipOffset.x) * gOglRender->clipScale.x;
+	const r32 y1 = (clip.w - gOglRender->clipOffset.y) * gOglRender->clipScale.y;
+	QiOgl_SetScissor((int)x0, (int)(gOglRender->fbHeight - y1), (int)(x1 - x0), (int)(y1 - y0));
+}
+
+static void QiOgl_SetSpriteAttribs(uintptr_t base)
+{
+	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(HwiSprite), (void *)(base + offsetof(HwiSprite, dest)));
+	glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(HwiSprite), (void *)(base + offsetof(HwiSprite, uv)));
+	glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(HwiSprite), (void *)(base + offsetof(HwiSprite, color)));
+	glVertexAttribIPointer(4, 1, GL_UNSIGNED_INT, sizeof(HwiSprite), (void *)(base + offsetof(HwiSprite, texSlot)));
+}
+
+static void IGC_DrawSprites(const ImDrawList *, const ImDrawCmd *cmd)
+{
+	const OglFrame *   frame = gOglRender->drawingFrame;
+	const SpriteBatch *batch = &frame->spriteBatches[(uintptr_t)cmd->UserCallbackData];
+	QiOgl_BeginSpriteDraw(batch->clipRect, gOglRender->spriteInstanceVbo, 0.0f, 0.0f);
+
+	const u32 regionBase = gOglRender->spriteMapped ? gOglRender->spriteFrame * kMaxSpriteInstances : 0;
+	for (u32 di = 0; di < batch->numDraws; di++)
+	{
+		// Paged draws don't read unit 0, so whatever is there can stay
+		const SpriteDraw *draw = &frame->spriteDraws[batch->firstDraw + di];
+		QiOgl_ApplyBlendState(draw->blend);
+		if (draw->texKey)
+			QiOgl_BindTexture(0, GL_TEXTURE_2D, QiOgl_KeyTexture(draw->texKey));
+
+		QiOgl_SetSpriteAttribs((uintptr_t)(regionBase + draw->firstInstance) * sizeof(HwiSprite));
+		glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr, (GLsizei)draw->numInstances);
+	}
+	CheckGl();
+}
+
+static void IGC_DrawSpriteCache(const ImDrawList *, const ImDrawCmd *cmd)
+{
+	const SpriteCacheDraw *draw = &gOglRender->drawingFrame->spriteCacheDraws[(uintptr_t)cmd->UserCallbackData];
+	QiOgl_BeginSpriteDraw(draw->clipRect, gOglRender->spriteCacheVbos[draw->cache], draw->offset[0], draw->offset[1]);
+
+	QiOgl_ApplyBlendState(draw->blend);
+	if (draw->texKey)
+		QiOgl_BindTexture(0, GL_TEXTURE_2D, QiOgl_KeyTexture(draw->texKey));
+	QiOgl_SetSpriteAttribs(0);
+	glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr, (GLsizei)draw->numSprites);
+	CheckGl();
+}
+
+static int CompareSpriteKeys(const void *a, const void *b)
+{
+	const u64 ka = *(const u64 *)a;
+	const u64 kb = *(const u64 *)b;
+	return ka < kb ? -1 : (ka > kb ? 1 : 0);
+}
+
+static SpriteBatch *QiOgl_OpenSpriteBatch()
+{
+	OglFrame *frame = QiOgl_RecordingFrame();
+	if (gOgl->openSpriteBatch >= 0)
+		return &frame->spriteBatches[gOgl->openSpriteBatch];
+
+	Assert(frame->numSpriteBatches < kMaxSpriteBatches);
+	ImDrawList *dl = ImGui::GetBackgroundDrawList();
+	Assert(dl);
+
+	const u32    batchIdx = frame->numSpriteBatches++;
+	SpriteBatch *batch    = &frame->spriteBatches[batchIdx];
+	batch->firstDraw      = frame->numSpriteDraws;
+	batch->numDraws       = 0;
+	batch->clipRect       = ImVec4(dl->GetClipRectMin().x, dl->GetClipRectMin().y, dl->GetClipRectMax().x, dl->GetClipRectMax().y);
+
+	dl->AddCallback(IGC_DrawSprites, (void *)(uintptr_t)batchIdx);
+	dl->AddCallback(ImDrawCallback_ResetRenderState, nullptr);
+
+	gOgl->openSpriteBatch = (i32)batchIdx;
+	return batch;
+}
+
+// Adds instances already written at firstInstance to the open batch, extending its last draw when texture and blend
+// match and the instances follow on
+static void QiOgl_AddSpriteDraw(SpriteBatch *batch, u32 texKey, BlendState blend, u32 firstInstance, u32 numInstances)
+{
+	OglFrame *frame = QiOgl_RecordingFrame();
+	if (batch->numDraws > 0)
+	{
+		SpriteDraw *last = &frame->spriteDraws[batch->firstDraw + batch->numDraws - 1];
+		if (last->texKey == texKey && last->blend == blend && last->firstInstance + last->numInstances == firstInstance)
+		{
+			last->numInstances += numInstances;
+			return;
+		}
+	}
+
+	// Only the open batch adds draws, which keeps each batch's draws contiguous
+	Assert(frame->numSpriteDraws < kMaxSpriteDraws);
+	Assert(frame->numSpriteDraws == batch->firstDraw + batch->numDraws);
+	SpriteDraw *draw    = &frame->spriteDraws[frame->numSpriteDraws++];
+	draw->texKey        = texKey;
+	draw->blend         = blend;
+	draw->firstInstance = firstInstance;
+	draw->numInstances  = numInstances;
+	batch->numDraws++;
+}
+
+// Sorts everything pushed since the last flush by layer, blend and texture and appends it to the frame's instances
+// as draws in the open batch
+static void QiOgl_FlushSprites()
+{
+	const u32 numPending = gOglFrames->numPendingSprites;
+	if (numPending == 0)
+		return;
+
+	OglFrame *frame = QiOgl_RecordingFrame();
+	Assert(frame->numSprites + numPending <= kMaxSpriteInstances);
+
+	// Low 32 bits are the submission index, which keeps the sort stable
+	qsort(gOglFrames->pendingSpriteKeys, numPending, sizeof(u64), CompareSpriteKeys);
+
+	SpriteBatch *batch    = QiOgl_OpenSpriteBatch();
+	HwiSprite *  dest     = frame->sprites + frame->numSprites;
+	u32          runStart = 0;
+	u32          runGroup = (u32)(gOglFrames->pendingSpriteKeys[0] >> 32);
+	for (u32 si = 0; si < numPending; si++)
+	{
+		const u64 key   = gOglFrames->pendingSpriteKeys[si];
+		const u32 group = (u32)(key >> 32);
+		dest[si]        = gOglFrames->pendingSprites[(u32)key];
+
+		if (group != runGroup)
+		{
+			const BlendState blend = (BlendState)((runGroup >> 12) & 0xF);
+			QiOgl_AddSpriteDraw(batch, runGroup & 0xFFF, blend, frame->numSprites + runStart, si - runStart);
+			runStart = si;
+			runGroup = group;
+		}
+	}
+	const BlendState blend = (BlendState)((runGroup >> 12) & 0xF);
+	QiOgl_AddSpriteDraw(batch, runGroup & 0xFFF, blend, frame->numSprites + runStart, numPending - runStart);
+
+	frame->numSprites += numPending;
+	gOglFrames->numPendingSprites = 0;
+}
+
+// Called before anything that has to stay in order with the sprites (targets, clip rects, ImGui primitives) goes into
+// the background draw list, so sprites after it start a new batch
+static void QiOgl_CloseSpriteBatch()
+{
+	QiOgl_FlushSprites();
+	gOgl->openSpriteBatch = -1;
+}
+
+// Room for numSprites pre-sorted instances straight in the frame's stream, drawn after everything submitted so far
+static HwiSprite *QiOgl_AppendSprites(Bitmap *bitmap, u32 numSprites)
+{
+	Assert(gOgl->inBeginFrame > 0);
+	Assert(bitmap->hardwareId);
 
-	glShaderSource(shader, 1, &shaderSource, &sourceLen);
-	glCompileShader(shader);
-	FreeShaderText(shaderSource);
+	QiOgl_FlushSprites();
+	OglFrame *frame = QiOgl_RecordingFrame();
+	Assert(frame->numSprites + numSprites <= kMaxSpriteInstances);
 
-	GLint compileStatus;
-	glGetShaderiv(shader, GL_COMPILE_STATUS, &compileStatus);
+	// Not there yet: somewhere to write that nothing draws, and the next call writes over
+	OglBitmap *oglBmp = (OglBitmap *)bitmap->hardwareId;
+	if (!oglBmp->ready)
+		return frame->sprites + frame->numSprites;
 
-	if (compileStatus != GL_TRUE)
-	{
-		GLint logLen;
-		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLen);
-		char *log = (char *)malloc(logLen + 1);
-		glGetShaderInfoLog(shader, logLen + 1, nullptr, log);
-		printf("Shader compile failed! Log follows:\n");
-		printf("%s", log);
-		free(log);
-	}
+	const u32 texKey        = QiOgl_TouchSpriteBitmap(oglBmp);
+	const u32 firstInstance = frame->numSprites;
+	QiOgl_AddSpriteDraw(QiOgl_OpenSpriteBatch(), texKey, QiOgl_CurBlendState(), firstInstance, numSprites);
 
-	return shader;
+	// The caller fills in everything else
+	HwiSprite *sprites = frame->sprites + firstInstance;
+	for (u32 si = 0; si < numSprites; si++)
+		sprites[si].texSlot = oglBmp->textureIdx;
+
+	frame->numSprites += numSprites;
+	return sprites;
 }
 
-void QiOgl_Init()
+// Render thread, before any batch draws: into the next region of the mapped buffer once the GPU is done with it, or
+// without a mapping up in one orphaned upload
+static void QiOgl_UploadFrameSprites(const OglFrame *frame)
 {
-	if (!gladLoadGL())
+	if (frame->numSprites == 0)
+		return;
+
+	const size_t bytes = (size_t)frame->numSprites * sizeof(HwiSprite);
+	if (gOglRender->spriteMapped)
 	{
-		Assert(0 && "Couldn't init OpenGL");
+		gOglRender->spriteFrame = (gOglRender->spriteFrame + 1) % kSpriteBufferFrames;
+		if (gOglRender->spriteFences[gOglRender->spriteFrame])
+		{
+			glClientWaitSync(gOglRender->spriteFences[gOglRender->spriteFrame], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+			glDeleteSync(gOglRender->spriteFences[gOglRender->spriteFrame]);
+			gOglRender->spriteFences[gOglRender->spriteFrame] = nullptr;
+		}
+		memcpy(gOglRender->spriteMapped + gOglRender->spriteFrame * kMaxSpriteInstances, frame->sprites, bytes);
+	}
+	else
+	{
+		QiOgl_BindArrayBuffer(gOglRender->spriteInstanceVbo);
+		glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)kMaxSpriteInstances * sizeof(HwiSprite), nullptr, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, (GLsizeiptr)bytes, frame->sprites);
+		CheckGl();
 	}
+}
 
-	// Set up screen blit
-	glGenTextures(1, &gOgl->blitTexture);
-	glBindTexture(GL_TEXTURE_2D, gOgl->blitTexture);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+static u32 QiOgl_SpriteCacheIndex(const OglSpriteCache *oglCache)
+{
+	return (u32)(oglCache - gOgl->spriteCaches);
+}
 
-	// Create program for blit
-	GLuint vs = LoadGlslShader(GL_VERTEX_SHADER, "blit_vs.glsl");
-	GLuint fs = LoadGlslShader(GL_FRAGMENT_SHADER, "blit_fs.glsl");
+static void QiOgl_UploadSpriteCache(HwiSpriteCache *cache, const Bitmap *texture, const HwiSprite *sprites, u32 numSprites)
+{
+	Assert(texture->hardwareId);
 
-	gOgl->blitProgram = glCreateProgram();
-	glAttachShader(gOgl->blitProgram, vs);
-	glAttachShader(gOgl->blitProgram, fs);
-	glLinkProgram(gOgl->blitProgram);
+	OglSpriteCache *oglCache = (OglSpriteCache *)cache->hardwareId;
+	if (oglCache == nullptr)
+	{
+		for (u32 ci = 0; ci < kMaxSpriteCaches && oglCache == nullptr; ci++)
+			if (!gOgl->spriteCaches[ci].used)
+				oglCache = &gOgl->spriteCaches[ci];
+		Assert(oglCache);
 
-	GLint status;
-	glGetProgramiv(gOgl->blitProgram, GL_LINK_STATUS, &status);
-	Assert(status == GL_TRUE);
+		oglCache->used    = true;
+		cache->hardwareId = oglCache;
+	}
 
-	glUseProgram(gOgl->blitProgram);
-	gOgl->samplerUniformLocation = glGetUniformLocation(gOgl->blitProgram, "tex");
+	oglCache->bitmap     = (OglBitmap *)texture->hardwareId;
+	oglCache->numSprites = numSprites;
+	cache->numSprites    = numSprites;
+	if (numSprites == 0)
+		return;
 
-	// Create program for imgui
-	vs = LoadGlslShader(GL_VERTEX_SHADER, "imgui_vs.glsl");
-	fs = LoadGlslShader(GL_FRAGMENT_SHADER, "imgui_fs.glsl");
+	// Copied into the frame with the slot stamped on the way, so the caller can let go of its sprites straight away
+	OglFrame *frame = QiOgl_RecordingFrame();
+	const u32 bytes = numSprites * sizeof(HwiSprite);
+	Assert(frame->numOpBytes + bytes <= kMaxFrameOpBytes);
+	HwiSprite *dest = (HwiSprite *)(frame->opBytes + frame->numOpBytes);
+	for (u32 si = 0; si < numSprites; si++)
+	{
+		dest[si]         = sprites[si];
+		dest[si].texSlot = oglCache->bitmap->textureIdx;
+	}
 
-	gOgl->drawUIProgram = glCreateProgram();
-	glAttachShader(gOgl->drawUIProgram, vs);
-	glAttachShader(gOgl->drawUIProgram, fs);
-	glLinkProgram(gOgl->drawUIProgram);
+	OglOp *op      = QiOgl_AddOp(OOP_UploadSpriteCache, nullptr);
+	op->slot       = QiOgl_SpriteCacheIndex(oglCache);
+	op->offset     = frame->numOpBytes;
+	op->numSprites = numSprites;
+	frame->numOpBytes += bytes;
+}
 
-	glGetProgramiv(gOgl->drawUIProgram, GL_LINK_STATUS, &status);
-	Assert(status == GL_TRUE);
+static void QiOgl_ReleaseSpriteCache(HwiSpriteCache *cache)
+{
+	OglSpriteCache *oglCache = (OglSpriteCache *)cache->hardwareId;
+	if (oglCache == nullptr)
+		return;
+
+	OglOp *op = QiOgl_AddOp(OOP_ReleaseSpriteCache, nullptr);
+	op->slot  = QiOgl_SpriteCacheIndex(oglCache);
+	memset(oglCache, 0, sizeof(*oglCache));
+	cache->hardwareId = nullptr;
+	cache->numSprites = 0;
+}
 
-	glUseProgram(gOgl->drawUIProgram);
-	gOgl->uiTexLocation      = glGetUniformLocation(gOgl->drawUIProgram, "tex");
-	gOgl->uiProjMtxLocation  = glGetUniformLocation(gOgl->drawUIProgram, "projMtx");
-	gOgl->uiVtxPosLocation   = glGetAttribLocation(gOgl->drawUIProgram, "pos");
-	gOgl->uiVtxUVLocation    = glGetAttribLocation(gOgl->drawUIProgram, "uv");
-	gOgl->uiVtxColorLocation = glGetAttribLocation(gOgl->drawUIProgram, "color");
+// Respecifying the whole store orphans the old one, so a frame still drawing it isn't stalled
+static void QiOgl_RunUploadSpriteCache(const OglFrame *frame, const OglOp *op)
+{
+	GLuint *vbo = &gOglRender->spriteCacheVbos[op->slot];
+	if (*vbo == 0)
+		glGenBuffers(1, vbo);
 
-	glGenBuffers(1, &gOgl->uiVbo);
-	glGenBuffers(1, &gOgl->uiElements);
+	QiOgl_BindArrayBuffer(*vbo);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)op->numSprites * sizeof(HwiSprite), frame->opBytes + op->offset, GL_STATIC_DRAW);
+	CheckGl();
+}
 
-	glGenVertexArrays(1, &gOgl->quadVao);
-	glGenBuffers(1, &gOgl->quadVbo);
+static void QiOgl_RunReleaseSpriteCache(const OglOp *op)
+{
+	GLuint *vbo = &gOglRender->spriteCacheVbos[op->slot];
+	if (*vbo == 0)
+		return;
 
-	void QiOgl_CreateFontsTexture();
-	QiOgl_CreateFontsTexture();
+	if (gOglRender->glState.arrayBuffer == *vbo)
+		gOglRender->glState.arrayBuffer = 0;
+	glDeleteBuffers(1, vbo);
+	*vbo = 0;
 }
 
-static void QiOgl_InitBlitBufferState()
+static void QiOgl_DrawSpriteCache(const HwiSpriteCache *cache, v2 offset)
 {
-	GLfloat vertices[] = {
-		-1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f, 1.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f,
-	};
+	Assert(gOgl->inBeginFrame > 0);
+	if (cache->hardwareId == nullptr || cache->numSprites == 0 || !((const OglSpriteCache *)cache->hardwareId)->bitmap->ready)
+		return;
 
-	glDisable(GL_SCISSOR_TEST);
-	glBindVertexArray(gOgl->quadVao);
-	glBindBuffer(GL_ARRAY_BUFFER, gOgl->quadVbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+	QiOgl_CloseSpriteBatch();
+	OglFrame *frame = QiOgl_RecordingFrame();
+	Assert(frame->numSpriteCacheDraws < kMaxSpriteCacheDraws);
 
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glDisableVertexAttribArray(2);
+	ImDrawList *dl = ImGui::GetBackgroundDrawList();
+	Assert(dl);
 
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 5, nullptr);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 5, (void *)(sizeof(GLfloat) * 3));
+	const OglSpriteCache *oglCache = (const OglSpriteCache *)cache->hardwareId;
+	const u32             drawIdx  = frame->numSpriteCacheDraws++;
+	SpriteCacheDraw *     draw     = &frame->spriteCacheDraws[drawIdx];
+	draw->cache                    = QiOgl_SpriteCacheIndex(oglCache);
+	draw->numSprites               = oglCache->numSprites;
+	draw->texKey                   = QiOgl_TouchSpriteBitmap(oglCache->bitmap);
+	draw->blend                    = QiOgl_CurBlendState();
+	draw->offset[0]                = offset.x;
+	draw->offset[1]                = offset.y;
+	draw->clipRect                 = ImVec4(dl->GetClipRectMin().x, dl->GetClipRectMin().y, dl->GetClipRectMax().x, dl->GetClipRectMax().y);
+
+	dl->AddCallback(IGC_DrawSpriteCache, (void *)(uintptr_t)drawIdx);
+	dl->AddCallback(ImDrawCallback_ResetRenderState, nullptr);
 }
 
-static void IGC_SetRenderBitmap(const ImDrawList *, const ImDrawCmd *cmd)
+static void QiOgl_PushSprite(const Bitmap *bitmap, r32 u0, r32 v0, r32 u1, r32 v1, const Rect *destRect, ColorU tint)
 {
-	static GLenum drawNone[] = {GL_NONE};
+	Assert(gOgl->inBeginFrame > 0);
+	Assert(bitmap->hardwareId);
 
-	if (cmd->UserCallbackData == nullptr)
-	{
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		CheckGl();
+	OglBitmap *oglBmp = (OglBitmap *)bitmap->hardwareId;
+	if (!oglBmp->ready)
 		return;
-	}
 
-	Bitmap *renderBitmap = (Bitmap *)cmd->UserCallbackData;
-	Assert(renderBitmap->hardwareId != nullptr);
-	OglBitmap *oglBitmap = (OglBitmap *)renderBitmap->hardwareId;
-	Assert(oglBitmap->fbo);
-	glBindFramebuffer(GL_FRAMEBUFFER, oglBitmap->fbo);
-	CheckGl();
+	if (gOglFrames->numPendingSprites == kMaxSpriteInstances)
+		QiOgl_FlushSprites();
+
+	const u32  texKey = QiOgl_TouchSpriteBitmap(oglBmp);
+	const u32  idx    = gOglFrames->numPendingSprites++;
+	HwiSprite *inst   = &gOglFrames->pendingSprites[idx];
+	inst->dest[0]           = destRect->left;
+	inst->dest[1]           = destRect->top;
+	inst->dest[2]           = destRect->width;
+	inst->dest[3]           = destRect->height;
+	inst->uv[0]             = u0;
+	inst->uv[1]             = v0;
+	inst->uv[2]             = u1;
+	inst->uv[3]             = v1;
+	inst->color             = (u32)tint;
+	inst->texSlot           = oglBmp->textureIdx;
+
+	// layer:16 blend:4 texture key:12 | submission index:32. Paged bitmaps all share key 0.
+	Assert(texKey <= 0xFFF);
+	const u32 group                  = (gOgl->spriteLayer << 16) | ((u32)QiOgl_CurBlendState() << 12) | texKey;
+	gOglFrames->pendingSpriteKeys[idx] = ((u64)group << 32) | idx;
 }
 
-static void IGC_ClearCurrentTarget(const ImDrawList *, const ImDrawCmd* cmd)
+// Targets go in the draw list by slot, 0 for the default framebuffer
+static void *QiOgl_TargetCallbackData(const Bitmap *renderBitmap)
 {
-	Color clearColor((u32)(uintptr_t)cmd->UserCallbackData);
+	if (renderBitmap == nullptr)
+		return nullptr;
 
-	glClearColor(clearColor.r, clearColor.g, clearColor.b, 1.0f);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	const OglBitmap *oglBmp = (const OglBitmap *)renderBitmap->hardwareId;
+	Assert(oglBmp && oglBmp->target);
+	return (void *)(uintptr_t)oglBmp->textureIdx;
 }
 
 static void QiOgl_PushRenderBitmap(Bitmap *renderBitmap)
 {
+	QiOgl_CloseSpriteBatch();
+
 	Assert(gOgl->renderBitmapStackPos < kMaxRenderBitmapStackDepth - 1);
 	gOgl->renderBitmapStack[gOgl->renderBitmapStackPos++] = renderBitmap;
 
 	ImDrawList *dl = ImGui::GetBackgroundDrawList();
 	Assert(dl);
-	dl->AddCallback(IGC_SetRenderBitmap, renderBitmap);
+	dl->AddCallback(IGC_SetRenderBitmap, QiOgl_TargetCallbackData(renderBitmap));
 }
 
 static void QiOgl_PopRenderBitmap()
 {
+	QiOgl_CloseSpriteBatch();
+
 	Assert(gOgl->renderBitmapStackPos > 0);
 	Bitmap *renderBitmap                                = gOgl->renderBitmapStack[--gOgl->renderBitmapStackPos];
 	gOgl->renderBitmapStack[gOgl->renderBitmapStackPos] = nullptr;
 
 	ImDrawList *dl = ImGui::GetBackgroundDrawList();
 	Assert(dl);
-	dl->AddCallback(IGC_SetRenderBitmap, renderBitmap);
+	dl->AddCallback(IGC_SetRenderBitmap, QiOgl_TargetCallbackData(renderBitmap));
 }
 
 void QiOgl_BeginFrame()
 {
-	QiOgl_Clear();
-
 	Assert(gOgl->inBeginFrame == 0);
 	gOgl->inBeginFrame++;
+	gOgl->frameIndex++;
+
+	// The render thread empties a frame once it has drawn it
+	const OglFrame *frame = QiOgl_RecordingFrame();
+	Assert(frame->numSprites == 0 && frame->numSpriteBatches == 0 && frame->numSpriteCacheDraws == 0);
+	gOglFrames->numPendingSprites = 0;
+	gOgl->openSpriteBatch   = -1;
+	gOgl->spriteLayer       = 0;
+	gOgl->blendStackPos     = 0;
+
+	QiOgl_StreamUploads();
 
 	Assert(gOgl->renderBitmapStackPos == 0);
 	QiOgl_PushRenderBitmap(gOgl->screenBitmap);
@@ -300,6 +1680,55 @@ void QiOgl_EndFrame()
 	dl->AddImage(gOgl->screenBitmap, ImVec2(0.0, 0.0), io.DisplaySize, ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
 }
 
+template <typename T> static void QiOgl_CopyVector(ImVector<T> *dest, const ImVector<T> &src)
+{
+	dest->resize(src.Size);
+	if (src.Size > 0)
+		memcpy(dest->Data, src.Data, (size_t)src.Size * sizeof(T));
+}
+
+// Game thread, once ImGui has rendered. Takes copies of what the game would change under the render thread, and
+// moves recording on to the other frame.
+static void QiOgl_CloseFrame(const ImDrawData *drawData)
+{
+	OglFrame *frame = QiOgl_RecordingFrame();
+	if (gOgl->slotRectsDirty)
+	{
+		memcpy(frame->slotRects, gOgl->slotRects, sizeof(frame->slotRects));
+		frame->slotRectsChanged = true;
+		gOgl->slotRectsDirty    = false;
+	}
+
+	Assert(drawData->CmdListsCount <= (int)kMaxFrameDrawLists);
+	frame->numDrawLists     = (u32)drawData->CmdListsCount;
+	frame->displayPos       = drawData->DisplayPos;
+	frame->displaySize      = drawData->DisplaySize;
+	frame->framebufferScale = drawData->FramebufferScale;
+	for (u32 li = 0; li < frame->numDrawLists; li++)
+	{
+		const ImDrawList *src  = drawData->CmdLists[li];
+		OglDrawList *     dest = &frame->drawLists[li];
+		QiOgl_CopyVector(&dest->vtx, src->VtxBuffer);
+		QiOgl_CopyVector(&dest->idx, src->IdxBuffer);
+		QiOgl_CopyVector(&dest->cmds, src->CmdBuffer);
+
+		// Bitmaps ImGui draws need their own texture, and the render thread knows them by slot
+		for (int ci = 0; ci < dest->cmds.Size; ci++)
+		{
+			ImDrawCmd *cmd = &dest->cmds[ci];
+			if (cmd->UserCallback != nullptr || cmd->TextureId == nullptr)
+				continue;
+
+			OglBitmap *oglBmp = (OglBitmap *)((Bitmap *)cmd->TextureId)->hardwareId;
+			Assert(oglBmp);
+			QiOgl_StandaloneTexture(oglBmp);
+			cmd->TextureId = (ImTextureID)(uintptr_t)oglBmp->textureIdx;
+		}
+	}
+
+	gOglFrames->recordedFrames++;
+}
+
 struct TexCoordRect
 {
 	ImVec2 ul;
@@ -316,46 +1745,100 @@ static void QiOgl_PixelRectToTexCoords(const Bitmap *bitmap, const Rect *pixelRe
 
 static void QiOgl_BlitUV(const Bitmap *bitmap, v2 uvtl, v2 uvbr, const Rect *destRect, ColorU tint)
 {
-	Assert(gOgl->inBeginFrame > 0);
+	QiOgl_PushSprite(bitmap, uvtl.x, uvtl.y, uvbr.x, uvbr.y, destRect, tint);
+}
 
-	ImVec2       ul(destRect->left, destRect->top);
-	ImVec2       br(destRect->left + destRect->width, destRect->top + destRect->height);
+static void QiOgl_Blit(const Bitmap *bitmap, const Rect *srcRect, const Rect *destRect, ColorU tint)
+{
 	TexCoordRect srcUVs;
-
-	Assert(bitmap->hardwareId);
-
-	ImDrawList *dl = ImGui::GetBackgroundDrawList();
-	Assert(dl);
-	const ImVec2 iuvtl(uvtl.x, uvtl.y);
-	const ImVec2 iuvbr(uvbr.x, uvbr.y);
-	dl->AddImage((ImTextureID)bitmap, ul, br, iuvtl, iuvbr, (u32)tint);
+	QiOgl_PixelRectToTexCoords(bitmap, srcRect, &srcUVs);
+	QiOgl_PushSprite(bitmap, srcUVs.ul.x, srcUVs.ul.y, srcUVs.br.x, srcUVs.br.y, destRect, tint);
 }
 
-static void QiOgl_Blit(const Bitmap *bitmap, const Rect *srcRect, const Rect *destRect, ColorU tint)
+// The internal format blocks go up as, 0 when the driver can't take them
+static GLenum QiOgl_CompressedFormat(Bitmap::Format format)
 {
-	Assert(gOgl->inBeginFrame > 0);
+	switch (format)
+	{
+	case Bitmap::BC1:
+		return gOglRender->hasS3tc ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT : 0;
+	case Bitmap::BC3:
+		return gOglRender->hasS3tc ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : 0;
+	case Bitmap::BC7:
+		return gOglRender->hasBptc ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM_ARB : 0;
+	default:
+		return 0;
+	}
+}
 
-	ImVec2       ul(destRect->left, destRect->top);
-	ImVec2       br(destRect->left + destRect->width, destRect->top + destRect->height);
-	TexCoordRect srcUVs;
+// Every mip level of a compressed bitmap, as blocks if the driver has the format and decoded if not
+static void QiOgl_LoadCompressedToTex(const Bitmap *bitmap)
+{
+	const GLenum internalFormat = QiOgl_CompressedFormat(bitmap->format);
+	u32 *        decoded        = internalFormat ? nullptr : (u32 *)malloc(bitmap->width * bitmap->height * sizeof(u32));
 
-	QiOgl_PixelRectToTexCoords(bitmap, srcRect, &srcUVs);
+	const u8 *blocks = (const u8 *)bitmap->pixels;
+	for (u32 mip = 0; mip < bitmap->numMips; mip++)
+	{
+		const u32 width      = Bm_MipSize(bitmap->width, mip);
+		const u32 height     = Bm_MipSize(bitmap->height, mip);
+		const u32 levelBytes = Bm_LevelBytes(bitmap->format, width, height);
+		if (internalFormat)
+		{
+			glCompressedTexImage2D(GL_TEXTURE_2D, mip, internalFormat, width, height, 0, levelBytes, blocks);
+		}
+		else
+		{
+			Bc_Decode(bitmap->format, decoded, width, blocks, width, height);
+			glTexImage2D(GL_TEXTURE_2D, mip, GL_SRGB8_ALPHA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, decoded);
+		}
+		blocks += levelBytes;
+	}
+	free(decoded);
+	QiOgl_SetTexSampling(bitmap, bitmap->numMips);
+}
 
-	Assert(bitmap->hardwareId);
+// The full size from the pixels, then for mipmapped bitmaps each level down made from the one before
+static void QiOgl_LoadPixelsToTex(const Bitmap *bitmap)
+{
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, (GLint)bitmap->pitch);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, bitmap->width, bitmap->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, bitmap->pixels);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	if (bitmap->sampling != Bitmap::SampleMipmapped)
+	{
+		QiOgl_SetTexSampling(bitmap, 1);
+		return;
+	}
 
-	ImDrawList *dl = ImGui::GetBackgroundDrawList();
-	Assert(dl);
-	dl->AddImage((ImTextureID)bitmap, ul, br, srcUVs.ul, srcUVs.br, (u32)tint);
+	// Level 1 is a quarter of the size and each after it a quarter of that, so two of them hold every level
+	const u32  numLevels = Bm_NumMips(bitmap->width, bitmap->height);
+	const u32  maxLevel  = Bm_MipSize(bitmap->width, 1) * Bm_MipSize(bitmap->height, 1);
+	u32 *      scratch   = (u32 *)malloc(maxLevel * 2 * sizeof(u32));
+	u32 *      level     = scratch;
+	const u32 *src       = bitmap->pixels;
+	u32        srcPitch  = bitmap->pitch;
+	for (u32 mip = 1; mip < numLevels; mip++)
+	{
+		const u32 srcWidth = Bm_MipSize(bitmap->width, mip - 1), srcHeight = Bm_MipSize(bitmap->height, mip - 1);
+		const u32 width = Bm_MipSize(bitmap->width, mip), height = Bm_MipSize(bitmap->height, mip);
+		Px_Downsample2x(level, src, srcWidth, srcHeight, srcPitch);
+		glTexImage2D(GL_TEXTURE_2D, mip, GL_SRGB8_ALPHA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, level);
+
+		src      = level;
+		srcPitch = width;
+		level    = level == scratch ? scratch + maxLevel : scratch;
+	}
+	free(scratch);
+	QiOgl_SetTexSampling(bitmap, numLevels);
 }
 
 void QiOgl_LoadBitmapToTex(GLuint tex, const Bitmap *bitmap)
 {
-	glBindTexture(GL_TEXTURE_2D, tex);
-	CheckGl();
-	//glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, bitmap->width, bitmap->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, bitmap->pixels);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, bitmap->width, bitmap->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, bitmap->pixels);
-	CheckGl();
-	glBindTexture(GL_TEXTURE_2D, 0);
+	QiOgl_BindTexture(0, GL_TEXTURE_2D, tex);
+	if (Bm_IsCompressed(bitmap->format))
+		QiOgl_LoadCompressedToTex(bitmap);
+	else
+		QiOgl_LoadPixelsToTex(bitmap);
 	CheckGl();
 }
 
@@ -374,8 +1857,14 @@ void QiOgl_LoadBitmap(Bitmap *bitmap)
 		QiOgl_RegisterBitmap(bitmap, false);
 		Assert(bitmap->hardwareId);
 	}
+	// Pageable bitmaps with nowhere to go yet are read from their pixels when they first page in
 	OglBitmap *oglBmp = (OglBitmap *)bitmap->hardwareId;
-	QiOgl_LoadBitmapToTex(oglBmp->texture, bitmap);
+	QiOgl_CancelUpload(oglBmp);
+	if (oglBmp->standalone)
+		QiOgl_AddOp(OOP_LoadTexture, oglBmp);
+	if (oglBmp->page >= 0)
+		QiOgl_AddOp(OOP_UploadToPage, oglBmp);
+	oglBmp->ready = true;
 }
 
 void QiOgl_RegisterBitmap(Bitmap *bitmap, bool canBeTarget)
@@ -385,46 +1874,81 @@ void QiOgl_RegisterBitmap(Bitmap *bitmap, bool canBeTarget)
 		QiOgl_UnregisterBitmap(bitmap);
 	}
 
-	Assert(gOgl->numTextures < kMaxTextures);
-	OglBitmap *oglBmp = &gOgl->textures[gOgl->numTextures];
+	Assert(gOgl->numFreeTextureSlots > 0);
+	const u32  slot   = gOgl->freeTextureSlots[--gOgl->numFreeTextureSlots];
+	OglBitmap *oglBmp = &gOgl->textures[slot];
 	memset(oglBmp, 0, sizeof(*oglBmp));
-	oglBmp->textureIdx = gOgl->numTextures++;
-	glGenTextures(1, &oglBmp->texture);
-	CheckGl();
-	oglBmp->bitmap = bitmap;
+	oglBmp->textureIdx = slot;
+	oglBmp->target     = canBeTarget;
+	oglBmp->page       = -1;
+	oglBmp->pageable   = !canBeTarget && !Bm_IsCompressed(bitmap->format) && bitmap->sampling == Bitmap::SampleNearest &&
+	                   bitmap->width + kPagePadding <= kTexturePageSize && bitmap->height + kPagePadding <= kTexturePageSize;
+	oglBmp->bitmap     = bitmap;
 	bitmap->hardwareId = oglBmp;
+	QiOgl_SetSlotRect(slot, 0.0f, 0.0f, 1.0f, 1.0f, -1);
 
-	glBindTexture(GL_TEXTURE_2D, oglBmp->texture);
-
-	// Poor filtering. Needed !
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	CheckGl();
-
-	glBindTexture(GL_TEXTURE_2D, 0);
+	if (!oglBmp->pageable)
+		QiOgl_StandaloneTexture(oglBmp);
 
+	// The framebuffer goes round the texture once it holds the pixels
 	if (canBeTarget)
 	{
 		QiOgl_LoadBitmap(bitmap);
-		glGenFramebuffers(1, &oglBmp->fbo);
-		CheckGl();
-
-		glBindFramebuffer(GL_FRAMEBUFFER, oglBmp->fbo);
-		CheckGl();
+		QiOgl_AddOp(OOP_CreateTarget, oglBmp);
+	}
+}
 
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, oglBmp->texture, 0);
-		CheckGl();
+// Pages are sampled nearest, so anything else moves to a standalone texture. Its page space is only reclaimed when
+// the page is evicted, and it stays standalone if it goes back to nearest.
+static void QiOgl_UpdateBitmapSampling(Bitmap *bitmap)
+{
+	OglBitmap *oglBmp = (OglBitmap *)bitmap->hardwareId;
+	Assert(oglBmp && !(oglBmp->target && bitmap->sampling == Bitmap::SampleMipmapped));
+	if (bitmap->sampling != Bitmap::SampleNearest && oglBmp->pageable)
+	{
+		// Pending sprites name the page array
+		QiOgl_FlushSprites();
+		oglBmp->pageable = false;
+		oglBmp->page     = -1;
+		QiOgl_SetSlotRect(oglBmp->textureIdx, 0.0f, 0.0f, 1.0f, 1.0f, -1);
+	}
 
-		GLenum drawColor0[] = {GL_COLOR_ATTACHMENT0};
-		glDrawBuffers(1, drawColor0);
-		CheckGl();
+	// A new texture is made with the right levels. One already loaded is loaded again for them, otherwise only its
+	// filtering changes and the upload on the way takes care of the rest, unless that can't be streamed.
+	const bool hadTexture = oglBmp->standalone;
+	if (!oglBmp->pageable)
+		QiOgl_StandaloneTexture(oglBmp);
 
-		GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-		Assert(status == GL_FRAMEBUFFER_COMPLETE);
+	if (oglBmp->uploadQueued && bitmap->sampling == Bitmap::SampleMipmapped)
+	{
+		QiOgl_LoadBitmap(bitmap);
+	}
+	else if (hadTexture && oglBmp->ready && !oglBmp->target)
+	{
+		QiOgl_LoadBitmap(bitmap);
+	}
+	else if (hadTexture)
+	{
+		QiOgl_AddOp(OOP_SetSampling, oglBmp);
+	}
+}
 
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		CheckGl();
+// The pixels of a bitmap going away may be gone by the time the recording frame's ops run
+static void QiOgl_DropPixelOps(u32 slot)
+{
+	OglFrame *frame = QiOgl_RecordingFrame();
+	u32       kept  = 0;
+	for (u32 oi = 0; oi < frame->numOps; oi++)
+	{
+		const OglOp *op          = &frame->ops[oi];
+		const bool   readsPixels = op->type == OOP_LoadTexture || op->type == OOP_UploadToPage || op->type == OOP_StreamRows;
+		if (readsPixels && op->slot == slot)
+			continue;
+		if (kept != oi)
+			frame->ops[kept] = *op;
+		kept++;
 	}
+	frame->numOps = kept;
 }
 
 void QiOgl_UnregisterBitmap(Bitmap *bitmap)
@@ -432,20 +1956,28 @@ void QiOgl_UnregisterBitmap(Bitmap *bitmap)
 	if (!bitmap->hardwareId)
 		return;
 
-	OglBitmap *oglBmp = (OglBitmap *)bitmap->hardwareId;
-	glDeleteTextures(1, &oglBmp->texture);
+	// Pending sprites refer to textures by slot, which is about to be reused
+	QiOgl_FlushSprites();
 
-	u32 curIdx = oglBmp->textureIdx;
-	Assert(oglBmp == &gOgl->textures[curIdx]);
-	u32 lastIdx                       = --gOgl->numTextures;
-	gOgl->textures[curIdx]            = gOgl->textures[lastIdx];
-	gOgl->textures[curIdx].textureIdx = curIdx;
+	OglBitmap *oglBmp = (OglBitmap *)bitmap->hardwareId;
+	QiOgl_CancelUpload(oglBmp);
+	QiOgl_DropPixelOps(oglBmp->textureIdx);
+	if (oglBmp->standalone)
+		QiOgl_AddOp(OOP_DeleteTexture, oglBmp);
+
+	// Its page space is only reclaimed when the page is evicted
+	const u32 slot = oglBmp->textureIdx;
+	Assert(oglBmp == &gOgl->textures[slot]);
+	memset(oglBmp, 0, sizeof(*oglBmp));
+	QiOgl_SetSlotRect(slot, 0.0f, 0.0f, 1.0f, 1.0f, -1);
+	gOgl->freeTextureSlots[gOgl->numFreeTextureSlots++] = slot;
 
 	bitmap->hardwareId = nullptr;
 }
 
 void QiOgl_Clear()
 {
+	QiOgl_SetScissorTest(false);
 	glClearColor(FR(), FR(), FR(), 1.0f);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 }
@@ -454,127 +1986,95 @@ void QiOgl_BlitBufferToScreen(const Bitmap *bitmap)
 {
 #if 0
 	QiOgl_InitBlitBufferState();
-	QiOgl_BitmapToTexture(gOgl->blitTexture, bitmap);
-	glBindVertexArray(gOgl->quadVao);
-	glUseProgram(gOgl->blitProgram);
+	QiOgl_BitmapToTexture(gOglRender->blitTexture, bitmap);
+	glBindVertexArray(gOglRender->quadVao);
+	glUseProgram(gOglRender->blitProgram);
 	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gOgl->blitTexture);
-	glUniform1i(gOgl->samplerUniformLocation, 0);
+	glBindTexture(GL_TEXTURE_2D, gOglRender->blitTexture);
+	glUniform1i(gOglRender->samplerUniformLocation, 0);
 	glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
 #else
 #endif
 }
 
-void QiOgl_SetupImGuiState(ImDrawData *drawData, i32 fbWidth, i32 fbHeight, GLuint vao)
+// Viewport and projection, once a frame
+void QiOgl_SetupImGuiFrame(const OglFrame *frame, i32 fbWidth, i32 fbHeight)
 {
-	// Setup render state: alpha-blending enabled, no face culling, no depth testing, scissor enabled, polygon fill
-	glEnable(GL_BLEND);
-	glBlendEquation(GL_FUNC_ADD);
-	glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
-	// glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glDisable(GL_CULL_FACE);
-	glDisable(GL_DEPTH_TEST);
-	glEnable(GL_SCISSOR_TEST);
-	glEnable(GL_FRAMEBUFFER_SRGB);
-	CheckGl();
-
-	// Setup viewport, orthographic projection matrix
 	// Our visible imgui space lies from draw_data->DisplayPos (top left) to draw_data->DisplayPos+data_data->DisplaySize (bottom right). DisplayPos is (0,0) for single viewport
 	// apps.
-	glViewport(0, 0, (GLsizei)fbWidth, (GLsizei)fbHeight);
-	float       L              = drawData->DisplayPos.x;
-	float       R              = drawData->DisplayPos.x + drawData->DisplaySize.x;
-	float       T              = drawData->DisplayPos.y;
-	float       B              = drawData->DisplayPos.y + drawData->DisplaySize.y;
+	QiOgl_SetViewport(0, 0, (GLsizei)fbWidth, (GLsizei)fbHeight);
+	float       L              = frame->displayPos.x;
+	float       R              = frame->displayPos.x + frame->displaySize.x;
+	float       T              = frame->displayPos.y;
+	float       B              = frame->displayPos.y + frame->displaySize.y;
 	const float orthoMtx[4][4] = {
 		{2.0f / (R - L), 0.0f, 0.0f, 0.0f},
 		{0.0f, 2.0f / (T - B), 0.0f, 0.0f},
 		{0.0f, 0.0f, -1.0f, 0.0f},
 		{(R + L) / (L - R), (T + B) / (B - T), 0.0f, 1.0f},
 	};
-	glUseProgram(gOgl->drawUIProgram);
-	glUniform1i(gOgl->uiTexLocation, 0);
-	glUniformMatrix4fv(gOgl->uiProjMtxLocation, 1, GL_FALSE, &orthoMtx[0][0]);
-	CheckGl();
-
-
-	// Bind vertex/index buffers and setup attributes for ImDrawVert
-	glBindVertexArray(vao);
-	CheckGl();
-	glBindBuffer(GL_ARRAY_BUFFER, gOgl->uiVbo);
-	CheckGl();
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gOgl->uiElements);
-	CheckGl();
+	memcpy(gOglRender->orthoMtx, orthoMtx, sizeof(orthoMtx));
 
-	glEnableVertexAttribArray(0);
-	CheckGl();
-	glEnableVertexAttribArray(1);
-	CheckGl();
-	glEnableVertexAttribArray(2);
+	QiOgl_UseProgram(gOglRender->spriteProgram);
+	glUniformMatrix4fv(gOglRender->spriteProjMtxLocation, 1, GL_FALSE, &orthoMtx[0][0]);
+	QiOgl_UseProgram(gOglRender->drawUIProgram);
+	glUniformMatrix4fv(gOglRender->uiProjMtxLocation, 1, GL_FALSE, &orthoMtx[0][0]);
 	CheckGl();
+}
 
-	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (GLvoid *)IM_OFFSETOF(ImDrawVert, pos));
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (GLvoid *)IM_OFFSETOF(ImDrawVert, uv));
-	glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ImDrawVert), (GLvoid *)IM_OFFSETOF(ImDrawVert, col));
-	CheckGl();
+// Alpha blending, scissor on, ImGui's program and vertex layout. Run after every callback, but only what a callback
+// actually changed gets set again.
+void QiOgl_SetupImGuiState()
+{
+	QiOgl_SetBlend(true, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+	QiOgl_SetScissorTest(true);
+	QiOgl_UseProgram(gOglRender->drawUIProgram);
+	QiOgl_BindVertexArray(gOglRender->uiVao);
+	QiOgl_BindArrayBuffer(gOglRender->uiVbo);
 }
 
-void QiOgl_DrawImGui(ImDrawData *drawData)
+// Nothing else draws with this context, so the state is left as the frame ends rather than saved and restored
+static void QiOgl_DrawImGui(const OglFrame *frame)
 {
-	i32 fbWidth  = (i32)(drawData->DisplaySize.x * drawData->FramebufferScale.x);
-	i32 fbHeight = (i32)(drawData->DisplaySize.y * drawData->FramebufferScale.y);
+	i32 fbWidth  = (i32)(frame->displaySize.x * frame->framebufferScale.x);
+	i32 fbHeight = (i32)(frame->displaySize.y * frame->framebufferScale.y);
 
 	if (fbWidth <= 0 || fbHeight <= 0)
 		return;
 
-	GLint lastViewport[4];
-	glGetIntegerv(GL_VIEWPORT, lastViewport);
-	GLint lastScissorBox[4];
-	glGetIntegerv(GL_SCISSOR_BOX, lastScissorBox);
-	GLenum lastBlendSrcRgb;
-	glGetIntegerv(GL_BLEND_SRC_RGB, (GLint *)&lastBlendSrcRgb);
-	GLenum lastBlendDstRgb;
-	glGetIntegerv(GL_BLEND_DST_RGB, (GLint *)&lastBlendDstRgb);
-	GLenum lastBlendSrcAlpha;
-	glGetIntegerv(GL_BLEND_SRC_ALPHA, (GLint *)&lastBlendSrcAlpha);
-	GLenum lastBlendDstAlpha;
-	glGetIntegerv(GL_BLEND_DST_ALPHA, (GLint *)&lastBlendDstAlpha);
-	GLenum lastBlendEquationRgb;
-	glGetIntegerv(GL_BLEND_EQUATION_RGB, (GLint *)&lastBlendEquationRgb);
-	GLenum lastBlendEquationAlpha;
-	glGetIntegerv(GL_BLEND_EQUATION_ALPHA, (GLint *)&lastBlendEquationAlpha);
-	GLboolean lastEnableBlend       = glIsEnabled(GL_BLEND);
-	GLboolean lastEnableCullFace    = glIsEnabled(GL_CULL_FACE);
-	GLboolean lastEnableDepthTest   = glIsEnabled(GL_DEPTH_TEST);
-	GLboolean lastEnableScissorTest = glIsEnabled(GL_SCISSOR_TEST);
-
-	GLuint vao = 0;
-	glGenVertexArrays(1, &vao);
-
-	QiOgl_SetupImGuiState(drawData, fbWidth, fbHeight, vao);
-
-	ImVec2 clipOffset = drawData->DisplayPos;
-	ImVec2 clipScale  = drawData->FramebufferScale;
-
-	for (int drawIdx = 0; drawIdx < drawData->CmdListsCount; drawIdx++)
-	{
-		const ImDrawList *cmdList = drawData->CmdLists[drawIdx];
+	QiOgl_SetupImGuiFrame(frame, fbWidth, fbHeight);
+
+	ImVec2 clipOffset = frame->displayPos;
+	ImVec2 clipScale  = frame->framebufferScale;
+
+	gOglRender->fbHeight   = fbHeight;
+	gOglRender->clipOffset = clipOffset;
+	gOglRender->clipScale  = clipScale;
+
+	QiOgl_UploadSlotRects(frame);
+	QiOgl_UploadFrameSprites(frame);
+
+	for (u32 drawIdx = 0; drawIdx < frame->numDrawLists; drawIdx++)
+	{
+		const OglDrawList *cmdList = &frame->drawLists[drawIdx];
 
 		// Upload vtx data
-		glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)cmdList->VtxBuffer.Size * sizeof(ImDrawVert), (const GLvoid *)cmdList->VtxBuffer.Data, GL_STREAM_DRAW);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)cmdList->IdxBuffer.Size * sizeof(ImDrawIdx), (const GLvoid *)cmdList->IdxBuffer.Data, GL_STREAM_DRAW);
+		QiOgl_SetupImGuiState();
+		glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)cmdList->vtx.Size * sizeof(ImDrawVert), (const GLvoid *)cmdList->vtx.Data, GL_STREAM_DRAW);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)cmdList->idx.Size * sizeof(ImDrawIdx), (const GLvoid *)cmdList->idx.Data, GL_STREAM_DRAW);
 		CheckGl();
 
-		for (int cmdIdx = 0; cmdIdx < cmdList->CmdBuffer.Size; cmdIdx++)
+		for (int cmdIdx = 0; cmdIdx < cmdList->cmds.Size; cmdIdx++)
 		{
-			const ImDrawCmd *cmd = &cmdList->CmdBuffer[cmdIdx];
+			const ImDrawCmd *cmd = &cmdList->cmds[cmdIdx];
 
+			// None of the callbacks look at the list, which is a copy by now
 			if (cmd->UserCallback != nullptr)
 			{
 				if (cmd->UserCallback == ImDrawCallback_ResetRenderState)
-					QiOgl_SetupImGuiState(drawData, fbWidth, fbHeight, vao);
+					QiOgl_SetupImGuiState();
 				else
-					cmd->UserCallback(cmdList, cmd);
+					cmd->UserCallback(nullptr, cmd);
 			}
 			else
 			{
@@ -586,49 +2086,100 @@ void QiOgl_DrawImGui(ImDrawData *drawData)
 
 				if (clipRect.x < fbWidth && clipRect.y < fbHeight && clipRect.z >= 0.0f && clipRect.w >= 0.0f)
 				{
-					glScissor(clipRect.x, (int)(fbHeight - clipRect.w), (int)(clipRect.z - clipRect.x), (int)(clipRect.w - clipRect.y));
-					CheckGl();
+					QiOgl_SetScissor((int)clipRect.x, (int)(fbHeight - clipRect.w), (int)(clipRect.z - clipRect.x), (int)(clipRect.w - clipRect.y));
 
-					Bitmap* bmp = (Bitmap *)cmd->TextureId;
-					if (bmp)
+					const u32 slot = (u32)(uintptr_t)cmd->TextureId;
+					if (slot)
 					{
-						OglBitmap *oglBmp = (OglBitmap *)bmp->hardwareId;
-						Assert(oglBmp);
-
-						glBindTexture(GL_TEXTURE_2D, oglBmp->texture);
-						CheckGl();
+						Assert(gOglRender->glTextures[slot].texture);
+						QiOgl_BindTexture(0, GL_TEXTURE_2D, gOglRender->glTextures[slot].texture);
 					}
 					glDrawElements(GL_TRIANGLES, (GLsizei)cmd->ElemCount, GL_UNSIGNED_SHORT, (void *)(intptr_t)(cmd->IdxOffset * sizeof(ImDrawIdx)));
-					CheckGl();
 				}
 			}
 		}
 	}
-
-	glBindTexture(GL_TEXTURE_2D, 0);
-	CheckGl();
-	glDeleteVertexArrays(1, &vao);
 	CheckGl();
-	glBlendEquationSeparate(lastBlendEquationRgb, lastBlendEquationAlpha);
-	glBlendFuncSeparate(lastBlendSrcRgb, lastBlendDstRgb, lastBlendSrcAlpha, lastBlendDstAlpha);
-	if (lastEnableBlend)
-		glEnable(GL_BLEND);
-	else
-		glDisable(GL_BLEND);
-	if (lastEnableCullFace)
-		glEnable(GL_CULL_FACE);
-	else
-		glDisable(GL_CULL_FACE);
-	if (lastEnableDepthTest)
-		glEnable(GL_DEPTH_TEST);
-	else
-		glDisable(GL_DEPTH_TEST);
-	if (lastEnableScissorTest)
-		glEnable(GL_SCISSOR_TEST);
-	else
-		glDisable(GL_SCISSOR_TEST);
-	glViewport(lastViewport[0], lastViewport[1], (GLsizei)lastViewport[2], (GLsizei)lastViewport[3]);
-	glScissor(lastScissorBox[0], lastScissorBox[1], (GLsizei)lastScissorBox[2], (GLsizei)lastScissorBox[3]);
+
+	if (gOglRender->spriteMapped && frame->numSprites > 0)
+		gOglRender->spriteFences[gOglRender->spriteFrame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+// Render thread, everything the game asked for while it recorded the frame
+static void QiOgl_RunOps(const OglFrame *frame)
+{
+	bool streamed = false;
+	for (u32 oi = 0; oi < frame->numOps; oi++)
+	{
+		const OglOp *op = &frame->ops[oi];
+		switch (op->type)
+		{
+		case OOP_CreateTexture:
+			QiOgl_RunCreateTexture(op);
+			break;
+		case OOP_LoadTexture:
+			QiOgl_LoadBitmapToTex(gOglRender->glTextures[op->slot].texture, &op->bitmap);
+			break;
+		case OOP_SetSampling:
+			QiOgl_BindTexture(0, GL_TEXTURE_2D, gOglRender->glTextures[op->slot].texture);
+			QiOgl_SetTexSampling(&op->bitmap, 1);
+			CheckGl();
+			break;
+		case OOP_DeleteTexture:
+			QiOgl_RunDeleteTexture(op);
+			break;
+		case OOP_CreateTarget:
+			QiOgl_RunCreateTarget(op);
+			break;
+		case OOP_UploadToPage:
+			QiOgl_RunUploadToPage(op);
+			break;
+		case OOP_StreamRows:
+			if (!streamed)
+				QiOgl_BeginUploadRegion();
+			streamed = true;
+			QiOgl_RunStreamRows(op);
+			break;
+		case OOP_UploadSpriteCache:
+			QiOgl_RunUploadSpriteCache(frame, op);
+			break;
+		case OOP_ReleaseSpriteCache:
+			QiOgl_RunReleaseSpriteCache(op);
+			break;
+		}
+	}
+
+	if (streamed && gOglRender->uploadMapped)
+		gOglRender->uploadFences[gOglRender->uploadFrame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+// Render thread, with the context current. Draws the oldest frame the game has finished and hands it back empty.
+void QiOgl_RenderFrame()
+{
+	if (!gOglRender->glReady)
+		QiOgl_InitGl();
+
+	OglFrame *frame = &gOglFrames->frames[gOglFrames->renderedFrames % kRenderFrames];
+	Assert(gOglFrames->renderedFrames < gOglFrames->recordedFrames);
+	gOglRender->drawingFrame = frame;
+
+	QiOgl_RunOps(frame);
+	QiOgl_Clear();
+	QiOgl_DrawImGui(frame);
+
+	gOglRender->drawingFrame   = nullptr;
+	frame->numOps              = 0;
+	frame->numOpBytes          = 0;
+	frame->numSprites          = 0;
+	frame->numSpriteDraws      = 0;
+	frame->numSpriteBatches    = 0;
+	frame->numSpriteCacheDraws = 0;
+	frame->slotRectsChanged    = false;
+	frame->numDrawLists        = 0;
+	gOglFrames->renderedFrames++;
+
+	// The context goes to another thread for the swap
+	glFlush();
 }
 
 void QiOgl_CreateFontsTexture()
@@ -640,19 +2191,31 @@ void QiOgl_CreateFontsTexture()
 
 	// stbi_write_png("font.png", width, height, 4, pixels, 0);
 
+	// Linear keeps it out of the pages, ImGui draws need its own texture
 	Bm_CreateBitmapFromBuffer(pixels, &gOgl->fontBitmap, width, height);
+	Bm_SetSampling(&gOgl->fontBitmap, Bitmap::SampleLinear);
 	QiOgl_RegisterBitmap(&gOgl->fontBitmap, false);
 	QiOgl_LoadBitmap(&gOgl->fontBitmap);
+	Assert(((OglBitmap *)gOgl->fontBitmap.hardwareId)->standalone);
+
+	io.Fonts->TexID = (ImTextureID)(&gOgl->fontBitmap);
+}
 
-	OglBitmap* oglBmp = (OglBitmap *)gOgl->fontBitmap.hardwareId;
-	Assert(oglBmp);
+// Game thread, at startup. GL itself is set up by the first RenderFrame, before it runs the ops recorded here.
+void QiOgl_Init()
+{
+	// Slot 0 is never handed out, so a texture key of 0 can mean the page array
+	for (u32 slot = kMaxTextureSlots - 1; slot > 0; slot--)
+		gOgl->freeTextureSlots[gOgl->numFreeTextureSlots++] = slot;
+	for (u32 slot = 0; slot < kMaxTextureSlots; slot++)
+		QiOgl_SetSlotRect(slot, 0.0f, 0.0f, 1.0f, 1.0f, -1);
 
-	glBindTexture(GL_TEXTURE_2D, oglBmp->texture);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	QiOgl_CreateFontsTexture();
 
-	io.Fonts->TexID = (ImTextureID)(&gOgl->fontBitmap);
+	gOgl->whitePixel = 0xFFFFFFFF;
+	Bm_CreateBitmapFromBuffer(&gOgl->whitePixel, &gOgl->whiteBitmap, 1, 1);
+	QiOgl_RegisterBitmap(&gOgl->whiteBitmap, false);
+	QiOgl_LoadBitmap(&gOgl->whiteBitmap);
 }
 
 // HWI interface
@@ -670,17 +2233,31 @@ struct OglHwi : public Hwi
 	void EndFrame() override
 	{
 		QiOgl_EndFrame();
-		QiOgl_Clear();
 		ImGui::EndFrame();
 		ImGui::Render();
-		QiOgl_DrawImGui(ImGui::GetDrawData());
+		QiOgl_CloseFrame(ImGui::GetDrawData());
 	}
 
+	void RenderFrame() override { QiOgl_RenderFrame(); }
+
 	void RegisterBitmap(Bitmap *bitmap, bool canBeRenderTarget) override { QiOgl_RegisterBitmap(bitmap, canBeRenderTarget); }
 
 	void UnregisterBitmap(Bitmap *bitmap) override { QiOgl_UnregisterBitmap(bitmap); }
 
-	void UploadBitmap(Bitmap *bitmap) override { QiOgl_LoadBitmap(bitmap); }
+	void UploadBitmap(Bitmap *bitmap) override
+	{
+		Assert(bitmap->hardwareId);
+		// Blocks are a quarter of the size or less and go up in one go, not through the row streaming. So do mipmapped
+		// bitmaps, whose levels are made from the whole of the one above.
+		if (Bm_IsCompressed(bitmap->format) || bitmap->sampling == Bitmap::SampleMipmapped)
+			QiOgl_LoadBitmap(bitmap);
+		else
+			QiOgl_QueueUpload((OglBitmap *)bitmap->hardwareId);
+	}
+
+	bool IsBitmapReady(const Bitmap *bitmap) override { return bitmap->hardwareId && ((const OglBitmap *)bitmap->hardwareId)->ready; }
+
+	void UpdateBitmapSampling(Bitmap *bitmap) override { QiOgl_UpdateBitmapSampling(bitmap); }
 
 	void SetScreenTarget(Bitmap *screenTarget) override
 	{
@@ -730,6 +2307,7 @@ struct OglHwi : public Hwi
 
 	void PushClipRect(Rect *clipRect) override
 	{
+		QiOgl_CloseSpriteBatch();
 		ImDrawList *dl = ImGui::GetBackgroundDrawList();
 		Assert(dl);
 		ImVec2 mins, maxs;
@@ -739,17 +2317,33 @@ struct OglHwi : public Hwi
 
 	void PopClipRect() override
 	{
+		QiOgl_CloseSpriteBatch();
 		ImDrawList *dl = ImGui::GetBackgroundDrawList();
 		Assert(dl);
 		dl->PopClipRect();
 	}
 
-	void PushBlendState(BlendState blend) override {}
+	void PushBlendState(BlendState blend) override
+	{
+		Assert(gOgl->blendStackPos < kMaxBlendStackDepth);
+		gOgl->blendStack[gOgl->blendStackPos++] = blend;
+	}
+
+	void PopBlendState() override
+	{
+		Assert(gOgl->blendStackPos > 0);
+		gOgl->blendStackPos--;
+	}
 
-	void PopBlendState() override {}
+	void SetSortLayer(u32 layer) override
+	{
+		Assert(layer <= 0xFFFF);
+		gOgl->spriteLayer = layer;
+	}
 
 	void DrawLine(v2 p0, v2 p1, ColorU color) override
 	{
+		QiOgl_CloseSpriteBatch();
 		ImDrawList *dl = ImGui::GetBackgroundDrawList();
 		Assert(dl);
 		dl->AddLine(ImVec2(p0.x, p0.y), ImVec2(p1.x, p1.y), (u32)color, 1.0f);
@@ -757,6 +2351,7 @@ struct OglHwi : public Hwi
 
 	void DrawRect(const Rect *rect, ColorU color) override
 	{
+		QiOgl_CloseSpriteBatch();
 		ImDrawList *dl = ImGui::GetBackgroundDrawList();
 		Assert(dl);
 		ImVec2 mins, maxs;
@@ -764,17 +2359,21 @@ struct OglHwi : public Hwi
 		dl->AddRect(mins, maxs, (u32)color, 0, 0, 1.0f);
 	}
 
-	void FillRect(const Rect *rect, ColorU color) override
+	HwiSprite *AppendSprites(Bitmap *texture, u32 numSprites) override { return QiOgl_AppendSprites(texture, numSprites); }
+
+	void UploadSpriteCache(HwiSpriteCache *cache, Bitmap *texture, const HwiSprite *sprites, u32 numSprites) override
 	{
-		ImDrawList *dl = ImGui::GetBackgroundDrawList();
-		Assert(dl);
-		ImVec2 mins, maxs;
-		CvtRectToImVecs(rect, mins, maxs);
-		dl->AddRectFilled(mins, maxs, (u32)color, 0, 0);
+		QiOgl_UploadSpriteCache(cache, texture, sprites, numSprites);
 	}
 
+	void ReleaseSpriteCache(HwiSpriteCache *cache) override { QiOgl_ReleaseSpriteCache(cache); }
+	void DrawSpriteCache(const HwiSpriteCache *cache, v2 offset) override { QiOgl_DrawSpriteCache(cache, offset); }
+
+	void FillRect(const Rect *rect, ColorU color) override { QiOgl_PushSprite(&gOgl->whiteBitmap, 0.0f, 0.0f, 1.0f, 1.0f, rect, color); }
+
 	void DrawBezier(v2 a, v2 b, v2 c, v2 d, ColorU color) override
 	{
+		QiOgl_CloseSpriteBatch();
 		ImDrawList *dl = ImGui::GetBackgroundDrawList();
 		Assert(dl);
 		ImVec2 ia(a.x, a.y), ib(b.x, b.y), ic(c.x, c.y), id(d.x, d.y);
@@ -791,14 +2390,19 @@ Hwi *gHwi = nullptr;
 void QiOgl_InitSystem(const SubSystem *sys, bool isReinit)
 {
 	gOgl         = (OglGlobals *)sys->globalPtr;
+	gOglFrames   = (OglFrameBuffers *)sys->transientPtr;
+	gOglRender   = (OglRenderGlobals *)(gOglFrames + 1);
 	void *hwiPtr = (void *)(gOgl + 1);
 	gHwi         = new (hwiPtr) OglHwi();
 
 	if (!isReinit)
 	{
 		memset(gOgl, 0, sizeof(*gOgl));
+		memset(gOglFrames, 0, sizeof(*gOglFrames));
+		memset(gOglRender, 0, sizeof(*gOglRender));
 		QiOgl_Init();
 	}
 }
 
-SubSystem HardwareSubSystem = {"OglHardware", QiOgl_InitSystem, sizeof(OglGlobals) + sizeof(OglHwi) + kOglHardwareMemSize};
+SubSystem HardwareSubSystem = {"OglHardware", QiOgl_InitSystem, sizeof(OglGlobals) + sizeof(OglHwi) + kOglHardwareMemSize, nullptr,
+                               sizeof(OglFrameBuffers) + sizeof(OglRenderGlobals)};
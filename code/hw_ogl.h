@@ -10,11 +10,9 @@
 #include "bitmap.h"
 #include <glad/glad.h>
 
-class ImDrawData;
-
 void QiOgl_Init();
 void QiOgl_Clear();
-void QiOgl_DrawImGui(ImDrawData* drawData);
+void QiOgl_RenderFrame();
 void QiOgl_SetScreenBitmap(Bitmap* bitmap);
 void QiOgl_BeginFrame();
 void QiOgl_EndFrame();
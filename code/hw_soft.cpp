@@ -0,0 +1,843 @@
+//
+// Copyright 2017, Quantum Immortality Software and Jon Davis
+//
+// Software rasterizer behind the Hwi. Draws are recorded through the frame the same way the OGL batcher keeps them:
+// blits and fills wait to be sorted by layer until something that has to stay in order (a line, a target or clip
+// change, appended sprites, a sprite cache) goes in. At EndFrame each run of commands on one target is split into
+// bands of rows, and every band job replays the whole run clipped to its rows, so the result doesn't depend on how
+// many threads there were.
+//
+
+#include "basictypes.h"
+
+#include "hw_soft.h"
+#include "game.h"
+#include "bitmap.h"
+#include "hwi.h"
+#include "imgui.h"
+#include "memory.h"
+#include "pixelops.h"
+#include "bcn.h"
+#include "util.h"
+
+#include "stb_image_write.h"
+
+#include <math.h>
+#include <new>
+
+const u32    kMaxSoftBitmaps           = 4096; // Registered bitmaps; slot 0 stands for a solid fill
+const u32    kSoftSolidSlot            = 0;
+const u32    kMaxSoftSprites           = 64 * 1024; // Per frame
+const u32    kMaxSoftCmds              = 8192;
+const u32    kMaxSoftPasses            = 256;
+const u32    kMaxSoftSpriteCaches      = 256;
+const size_t kSoftCacheMemSize         = 64 * 1024 * 1024; // Sprite cache copies
+const u32    kMaxSoftTargetStackDepth  = 32;
+const u32    kMaxSoftBlendStackDepth   = 16;
+const u32    kMaxSoftClipStackDepth    = 32;
+const u32    kSoftBandRows             = 32; // Rows of the target a job rasterizes
+const u32    kSoftSpanPixels           = 256; // Widest run of texels gathered at once, longer ones go in pieces
+const r32    kSoftBezierStep           = 8.0f; // Pixels of control polygon a flattened segment
+const u32    kMaxSoftBezierSegments    = 64;
+
+struct SoftBitmap
+{
+	Bitmap *bitmap; // Null for a free slot
+	bool    ready;
+	Bitmap  decoded; // Top level of a compressed bitmap, which draws read instead. Pixels are malloc'd.
+};
+
+struct SoftSpriteCache
+{
+	HwiSprite *sprites; // Null for a free slot
+	u32        numSprites;
+};
+
+enum SoftCmdType
+{
+	SCT_Clear,
+	SCT_Sprites,
+	SCT_SpriteCache,
+	SCT_Line,
+};
+
+struct SoftCmd
+{
+	SoftCmdType type;
+	BlendState  blend;
+	i32         clip[4]; // Left, top, right, bottom in target pixels, already inside the target
+
+	union
+	{
+		u32 clearColor;
+		struct
+		{
+			u32 first; // Into the frame's sprites
+			u32 count;
+		} sprites;
+		struct
+		{
+			const SoftSpriteCache *cache;
+			r32                    offset[2];
+		} cache;
+		struct
+		{
+			r32 p0[2];
+			r32 p1[2];
+			u32 color;
+		} line;
+	};
+};
+
+// A run of commands drawing into one target
+struct SoftPass
+{
+	Bitmap *target;
+	u32     firstCmd;
+	u32     numCmds;
+};
+
+struct SoftHwi;
+
+struct SoftGlobals
+{
+	SoftBitmap bitmaps[kMaxSoftBitmaps];
+	u32        freeBitmapSlots[kMaxSoftBitmaps];
+	u32        numFreeBitmapSlots;
+
+	Bitmap fontBitmap;
+
+	HwiSprite frameSprites[kMaxSoftSprites]; // Sorted, in the order they rasterize
+	u32       numFrameSprites;
+
+	HwiSprite  pendingSprites[kMaxSoftSprites]; // Since the last flush, in submission order
+	BlendState pendingBlends[kMaxSoftSprites];
+	u64        pendingSpriteKeys[kMaxSoftSprites];
+	u32        numPendingSprites;
+	u32        spriteLayer;
+
+	SoftCmd  cmds[kMaxSoftCmds];
+	u32      numCmds;
+	SoftPass passes[kMaxSoftPasses];
+	u32      numPasses;
+
+	SoftSpriteCache spriteCaches[kMaxSoftSpriteCaches];
+	BuddyAllocator *cacheAllocator;
+
+	Bitmap *targetStack[kMaxSoftTargetStackDepth];
+	u32     targetStackPos;
+
+	BlendState blendStack[kMaxSoftBlendStackDepth];
+	u32        blendStackPos;
+
+	Rect clipStack[kMaxSoftClipStackDepth];
+	u32  clipStackPos;
+
+	i32 inBeginFrame;
+
+	Bitmap *screenBitmap;
+};
+
+static SoftGlobals *gSoft;
+
+// Pixel ops doing what each Hwi blend state does in GL
+static const PxBlend_e kSoftBlends[] = {PX_BLEND_COPY, PX_BLEND_OVER, PX_BLEND_ADD_DST_ALPHA};
+
+//
+// Rasterizing. A pixel is covered when its center is inside the rect, the same rule GL fills by.
+//
+
+static inline i32 QiSoft_PixelEdge(r32 coord)
+{
+	return (i32)ceilf(coord - 0.5f);
+}
+
+static void QiSoft_DrawSprite(Bitmap *target, const i32 clip[4], const HwiSprite *sprite, r32 offsetX, r32 offsetY, PxBlend_e blend)
+{
+	const r32 left   = sprite->dest[0] + offsetX;
+	const r32 top    = sprite->dest[1] + offsetY;
+	const r32 width  = sprite->dest[2];
+	const r32 height = sprite->dest[3];
+
+	const i32 x0 = Max(QiSoft_PixelEdge(left), clip[0]);
+	const i32 x1 = Min(QiSoft_PixelEdge(left + width), clip[2]);
+	const i32 y0 = Max(QiSoft_PixelEdge(top), clip[1]);
+	const i32 y1 = Min(QiSoft_PixelEdge(top + height), clip[3]);
+	if (x0 >= x1 || y0 >= y1)
+		return;
+
+	const Bitmap *texture = nullptr;
+	if (sprite->texSlot != kSoftSolidSlot)
+	{
+		const SoftBitmap *softBmp = &gSoft->bitmaps[sprite->texSlot];
+		if (softBmp->bitmap == nullptr || !softBmp->ready)
+			return;
+		texture = softBmp->decoded.pixels ? &softBmp->decoded : softBmp->bitmap;
+	}
+
+	// Texel coords at pixel centers step linearly, in 16.16 fixed point across a row
+	const r32 texW   = texture ? (r32)texture->width : 1.0f;
+	const r32 texH   = texture ? (r32)texture->height : 1.0f;
+	const r32 dudx   = (sprite->uv[2] - sprite->uv[0]) * texW / width;
+	const r32 dvdy   = (sprite->uv[3] - sprite->uv[1]) * texH / height;
+	const r32 uStart = sprite->uv[0] * texW + ((r32)x0 + 0.5f - left) * dudx;
+	const r32 vStart = sprite->uv[1] * texH + ((r32)y0 + 0.5f - top) * dvdy;
+
+	const i32 count   = x1 - x0;
+	const i32 uStep   = (i32)(dudx * 65536.0f);
+	const i32 uFixed  = (i32)floorf(uStart * 65536.0f);
+	const i32 uFirst  = uFixed >> 16;
+	const i32 uLast   = (i32)(((i64)uFixed + (i64)uStep * (count - 1)) >> 16);
+	const bool inside = texture && uFirst >= 0 && uLast >= 0 && uFirst < (i32)texture->width && uLast < (i32)texture->width;
+	const i32  maxU   = texture ? (i32)texture->width - 1 : 0;
+	const i32  maxV   = texture ? (i32)texture->height - 1 : 0;
+
+	u32 gathered[kSoftSpanPixels];
+	u32 *dstRow = target->pixels + (size_t)y0 * target->pitch + x0;
+	for (i32 y = y0; y < y1; y++, dstRow += target->pitch)
+	{
+		if (texture == nullptr)
+		{
+			Px_FillSpan(dstRow, count, sprite->color, blend);
+			continue;
+		}
+
+		const i32  v      = Qi_Clamp<i32>((i32)floorf(vStart + (r32)(y - y0) * dvdy), 0, maxV);
+		const u32 *srcRow = texture->pixels + (size_t)v * texture->pitch;
+
+		// Unscaled blits go straight from the texture row
+		if (uStep == 65536 && inside)
+		{
+			Px_BlendSpan(dstRow, srcRow + uFirst, count, sprite->color, blend);
+			continue;
+		}
+
+		i64 u = uFixed;
+		for (i32 done = 0; done < count; done += kSoftSpanPixels)
+		{
+			const u32 pieceCount = Min<u32>(count - done, kSoftSpanPixels);
+			if (inside)
+			{
+				for (u32 pi = 0; pi < pieceCount; pi++, u += uStep)
+					gathered[pi] = srcRow[u >> 16];
+			}
+			else
+			{
+				for (u32 pi = 0; pi < pieceCount; pi++, u += uStep)
+					gathered[pi] = srcRow[Qi_Clamp<i64>(u >> 16, 0, maxU)];
+			}
+			Px_BlendSpan(dstRow + done, gathered, pieceCount, sprite->color, blend);
+		}
+	}
+}
+
+// One pixel wide, stepping the long axis a pixel at a time. The last pixel is left off so joined segments don't blend
+// their shared point twice.
+static void QiSoft_DrawLine(Bitmap *target, const i32 clip[4], const SoftCmd *cmd)
+{
+	const i32 x0 = (i32)floorf(cmd->line.p0[0]);
+	const i32 y0 = (i32)floorf(cmd->line.p0[1]);
+	const i32 dx = (i32)floorf(cmd->line.p1[0]) - x0;
+	const i32 dy = (i32)floorf(cmd->line.p1[1]) - y0;
+
+	const i32 steps = Max(abs(dx), abs(dy));
+	if (steps == 0)
+		return;
+
+	const i32 xStep = (dx * 65536) / steps;
+	const i32 yStep = (dy * 65536) / steps;
+	i32       x     = (x0 << 16) + 0x8000;
+	i32       y     = (y0 << 16) + 0x8000;
+	for (i32 si = 0; si < steps; si++, x += xStep, y += yStep)
+	{
+		const i32 px = x >> 16;
+		const i32 py = y >> 16;
+		if (px < clip[0] || px >= clip[2] || py < clip[1] || py >= clip[3])
+			continue;
+
+		u32 *dst = target->pixels + (size_t)py * target->pitch + px;
+		*dst     = Px_BlendPixel(*dst, cmd->line.color, kSoftBlends[cmd->blend]);
+	}
+}
+
+struct SoftBandJob
+{
+	const SoftPass *pass;
+};
+
+static void QiSoft_BandJob(void *userData, u32 jobIdx)
+{
+	const SoftPass *pass   = ((const SoftBandJob *)userData)->pass;
+	Bitmap *        target = pass->target;
+	const i32       bandY0 = (i32)(jobIdx * kSoftBandRows);
+	const i32       bandY1 = Min<i32>(bandY0 + kSoftBandRows, (i32)target->height);
+
+	for (u32 ci = 0; ci < pass->numCmds; ci++)
+	{
+		const SoftCmd *cmd = &gSoft->cmds[pass->firstCmd + ci];
+
+		i32 clip[4] = {cmd->clip[0], Max(cmd->clip[1], bandY0), cmd->clip[2], Min(cmd->clip[3], bandY1)};
+		if (clip[0] >= clip[2] || clip[1] >= clip[3])
+			continue;
+
+		switch (cmd->type)
+		{
+		case SCT_Clear:
+			for (i32 y = clip[1]; y < clip[3]; y++)
+			{
+				Px_FillSpan(target->pixels + (size_t)y * target->pitch + clip[0], clip[2] - clip[0], cmd->clearColor, PX_BLEND_COPY);
+			}
+			break;
+
+		case SCT_Sprites:
+			for (u32 si = 0; si < cmd->sprites.count; si++)
+				QiSoft_DrawSprite(target, clip, &gSoft->frameSprites[cmd->sprites.first + si], 0.0f, 0.0f, kSoftBlends[cmd->blend]);
+			break;
+
+		case SCT_SpriteCache:
+		{
+			const SoftSpriteCache *cache = cmd->cache.cache;
+			for (u32 si = 0; si < cache->numSprites; si++)
+				QiSoft_DrawSprite(target, clip, &cache->sprites[si], cmd->cache.offset[0], cmd->cache.offset[1], kSoftBlends[cmd->blend]);
+			break;
+		}
+
+		case SCT_Line:
+			QiSoft_DrawLine(target, clip, cmd);
+			break;
+		}
+	}
+}
+
+static void QiSoft_RunPasses()
+{
+	for (u32 pi = 0; pi < gSoft->numPasses; pi++)
+	{
+		const SoftPass *pass = &gSoft->passes[pi];
+		if (pass->numCmds == 0)
+			continue;
+
+		// Passes go one after another, a later one may read what an earlier one drew
+		SoftBandJob job;
+		job.pass = pass;
+		plat->ParallelFor(QiSoft_BandJob, &job, (pass->target->height + kSoftBandRows - 1) / kSoftBandRows);
+	}
+	gSoft->numPasses = 0;
+	gSoft->numCmds   = 0;
+}
+
+//
+// Recording
+//
+
+static Bitmap *QiSoft_CurTarget()
+{
+	Assert(gSoft->targetStackPos > 0);
+	return gSoft->targetStack[gSoft->targetStackPos - 1];
+}
+
+static BlendState QiSoft_CurBlendState()
+{
+	return gSoft->blendStackPos > 0 ? gSoft->blendStack[gSoft->blendStackPos - 1] : BSTATE_SrcAlpha_OneMinusDstAlpha;
+}
+
+static void QiSoft_BeginPass(Bitmap *target)
+{
+	Assert(target && target->pixels);
+	Assert(gSoft->numPasses < kMaxSoftPasses);
+	SoftPass *pass = &gSoft->passes[gSoft->numPasses++];
+	pass->target   = target;
+	pass->firstCmd = gSoft->numCmds;
+	pass->numCmds  = 0;
+}
+
+static SoftCmd *QiSoft_AddCmd(SoftCmdType type)
+{
+	Assert(gSoft->numPasses > 0);
+	Assert(gSoft->numCmds < kMaxSoftCmds);
+	SoftCmd *cmd = &gSoft->cmds[gSoft->numCmds++];
+	gSoft->passes[gSoft->numPasses - 1].numCmds++;
+
+	const Bitmap *target = QiSoft_CurTarget();
+	cmd->type            = type;
+	cmd->blend           = QiSoft_CurBlendState();
+	cmd->clip[0]         = 0;
+	cmd->clip[1]         = 0;
+	cmd->clip[2]         = (i32)target->width;
+	cmd->clip[3]         = (i32)target->height;
+	if (gSoft->clipStackPos > 0)
+	{
+		const Rect *clipRect = &gSoft->clipStack[gSoft->clipStackPos - 1];
+		cmd->clip[0]         = Max(cmd->clip[0], QiSoft_PixelEdge(clipRect->left));
+		cmd->clip[1]         = Max(cmd->clip[1], QiSoft_PixelEdge(clipRect->top));
+		cmd->clip[2]         = Min(cmd->clip[2], QiSoft_PixelEdge(clipRect->left + clipRect->width));
+		cmd->clip[3]         = Min(cmd->clip[3], QiSoft_PixelEdge(clipRect->top + clipRect->height));
+	}
+	return cmd;
+}
+
+static int CompareSoftSpriteKeys(const void *a, const void *b)
+{
+	const u64 ka = *(const u64 *)a;
+	const u64 kb = *(const u64 *)b;
+	return ka < kb ? -1 : (ka > kb ? 1 : 0);
+}
+
+// Sorts everything pushed since the last flush by layer and appends it to the frame's sprites, one command a run of
+// the same blend state. Texture order doesn't matter to the CPU, so within a layer they stay as submitted.
+static void QiSoft_FlushSprites()
+{
+	const u32 numPending = gSoft->numPendingSprites;
+	if (numPending == 0)
+		return;
+
+	Assert(gSoft->numFrameSprites + numPending <= kMaxSoftSprites);
+	qsort(gSoft->pendingSpriteKeys, numPending, sizeof(u64), CompareSoftSpriteKeys);
+
+	SoftCmd *cmd = nullptr;
+	for (u32 si = 0; si < numPending; si++)
+	{
+		const u32        idx   = (u32)gSoft->pendingSpriteKeys[si];
+		const BlendState blend = gSoft->pendingBlends[idx];
+		if (cmd == nullptr || cmd->blend != blend)
+		{
+			cmd                = QiSoft_AddCmd(SCT_Sprites);
+			cmd->blend         = blend;
+			cmd->sprites.first = gSoft->numFrameSprites;
+			cmd->sprites.count = 0;
+		}
+		gSoft->frameSprites[gSoft->numFrameSprites++] = gSoft->pendingSprites[idx];
+		cmd->sprites.count++;
+	}
+	gSoft->numPendingSprites = 0;
+}
+
+static void QiSoft_PushSprite(const Bitmap *bitmap, r32 u0, r32 v0, r32 u1, r32 v1, const Rect *destRect, ColorU tint)
+{
+	Assert(gSoft->inBeginFrame > 0);
+
+	u32 texSlot = kSoftSolidSlot;
+	if (bitmap)
+	{
+		const SoftBitmap *softBmp = (const SoftBitmap *)bitmap->hardwareId;
+		Assert(softBmp);
+		if (!softBmp->ready)
+			return;
+		texSlot = (u32)(softBmp - gSoft->bitmaps);
+	}
+
+	if (gSoft->numFrameSprites + gSoft->numPendingSprites == kMaxSoftSprites)
+		QiSoft_FlushSprites();
+	Assert(gSoft->numFrameSprites + gSoft->numPendingSprites < kMaxSoftSprites);
+
+	const u32  idx = gSoft->numPendingSprites++;
+	HwiSprite *inst = &gSoft->pendingSprites[idx];
+	inst->dest[0]   = destRect->left;
+	inst->dest[1]   = destRect->top;
+	inst->dest[2]   = destRect->width;
+	inst->dest[3]   = destRect->height;
+	inst->uv[0]     = u0;
+	inst->uv[1]     = v0;
+	inst->uv[2]     = u1;
+	inst->uv[3]     = v1;
+	inst->color     = (u32)tint;
+	inst->texSlot   = texSlot;
+
+	// layer | submission index, which keeps the sort stable
+	gSoft->pendingBlends[idx]     = QiSoft_CurBlendState();
+	gSoft->pendingSpriteKeys[idx] = ((u64)gSoft->spriteLayer << 32) | idx;
+}
+
+static void QiSoft_PushLine(v2 p0, v2 p1, ColorU color)
+{
+	Assert(gSoft->inBeginFrame > 0);
+	QiSoft_FlushSprites();
+
+	SoftCmd *cmd    = QiSoft_AddCmd(SCT_Line);
+	cmd->line.p0[0] = p0.x;
+	cmd->line.p0[1] = p0.y;
+	cmd->line.p1[0] = p1.x;
+	cmd->line.p1[1] = p1.y;
+	cmd->line.color = (u32)color;
+}
+
+static HwiSprite *QiSoft_AppendSprites(Bitmap *bitmap, u32 numSprites)
+{
+	Assert(gSoft->inBeginFrame > 0);
+	Assert(bitmap->hardwareId);
+
+	QiSoft_FlushSprites();
+	Assert(gSoft->numFrameSprites + numSprites <= kMaxSoftSprites);
+
+	// Not there yet: somewhere to write that nothing draws, and the next call writes over
+	const SoftBitmap *softBmp = (const SoftBitmap *)bitmap->hardwareId;
+	HwiSprite *       sprites = gSoft->frameSprites + gSoft->numFrameSprites;
+	if (!softBmp->ready)
+		return sprites;
+
+	SoftCmd *cmd       = QiSoft_AddCmd(SCT_Sprites);
+	cmd->sprites.first = gSoft->numFrameSprites;
+	cmd->sprites.count = numSprites;
+
+	const u32 texSlot = (u32)(softBmp - gSoft->bitmaps);
+	for (u32 si = 0; si < numSprites; si++)
+		sprites[si].texSlot = texSlot;
+
+	gSoft->numFrameSprites += numSprites;
+	return sprites;
+}
+
+static void QiSoft_UploadSpriteCache(HwiSpriteCache *cache, const Bitmap *texture, const HwiSprite *sprites, u32 numSprites)
+{
+	Assert(texture->hardwareId);
+
+	SoftSpriteCache *softCache = (SoftSpriteCache *)cache->hardwareId;
+	if (softCache == nullptr)
+	{
+		for (u32 ci = 0; ci < kMaxSoftSpriteCaches && softCache == nullptr; ci++)
+			if (gSoft->spriteCaches[ci].sprites == nullptr)
+				softCache = &gSoft->spriteCaches[ci];
+		Assert(softCache);
+		cache->hardwareId = softCache;
+	}
+
+	// Room for at least one so a live cache never has null sprites
+	const size_t size = Max<u32>(numSprites, 1) * sizeof(HwiSprite);
+	softCache->sprites    = (HwiSprite *)(softCache->sprites ? BA_Realloc(gSoft->cacheAllocator, softCache->sprites, size)
+	                                                         : BA_Alloc(gSoft->cacheAllocator, size));
+	Assert(softCache->sprites);
+	softCache->numSprites = numSprites;
+	cache->numSprites     = numSprites;
+
+	const u32 texSlot = (u32)((const SoftBitmap *)texture->hardwareId - gSoft->bitmaps);
+	for (u32 si = 0; si < numSprites; si++)
+	{
+		softCache->sprites[si]         = sprites[si];
+		softCache->sprites[si].texSlot = texSlot;
+	}
+}
+
+static void QiSoft_ReleaseSpriteCache(HwiSpriteCache *cache)
+{
+	SoftSpriteCache *softCache = (SoftSpriteCache *)cache->hardwareId;
+	if (softCache == nullptr)
+		return;
+
+	BA_Free(gSoft->cacheAllocator, softCache->sprites);
+	memset(softCache, 0, sizeof(*softCache));
+	cache->hardwareId = nullptr;
+	cache->numSprites = 0;
+}
+
+static void QiSoft_DrawSpriteCache(const HwiSpriteCache *cache, v2 offset)
+{
+	Assert(gSoft->inBeginFrame > 0);
+	if (cache->hardwareId == nullptr || cache->numSprites == 0)
+		return;
+
+	QiSoft_FlushSprites();
+	SoftCmd *cmd         = QiSoft_AddCmd(SCT_SpriteCache);
+	cmd->cache.cache     = (const SoftSpriteCache *)cache->hardwareId;
+	cmd->cache.offset[0] = offset.x;
+	cmd->cache.offset[1] = offset.y;
+}
+
+static void QiSoft_PushRenderBitmap(Bitmap *renderBitmap)
+{
+	QiSoft_FlushSprites();
+
+	Assert(gSoft->targetStackPos < kMaxSoftTargetStackDepth);
+	gSoft->targetStack[gSoft->targetStackPos++] = renderBitmap;
+	QiSoft_BeginPass(renderBitmap);
+}
+
+static void QiSoft_PopRenderBitmap()
+{
+	QiSoft_FlushSprites();
+
+	Assert(gSoft->targetStackPos > 0);
+	gSoft->targetStack[--gSoft->targetStackPos] = nullptr;
+	if (gSoft->targetStackPos > 0)
+		QiSoft_BeginPass(QiSoft_CurTarget());
+}
+
+//
+// Bitmaps
+//
+
+static void QiSoft_RegisterBitmap(Bitmap *bitmap, bool canBeTarget)
+{
+	Assert(bitmap->hardwareId == nullptr);
+	Assert(gSoft->numFreeBitmapSlots > 0);
+
+	const u32   slot    = gSoft->freeBitmapSlots[--gSoft->numFreeBitmapSlots];
+	SoftBitmap *softBmp = &gSoft->bitmaps[slot];
+	softBmp->bitmap     = bitmap;
+	softBmp->ready      = canBeTarget;
+	bitmap->hardwareId  = softBmp;
+	if (canBeTarget)
+		bitmap->flags |= Bitmap::RenderTarget;
+}
+
+static void QiSoft_UnregisterBitmap(Bitmap *bitmap)
+{
+	SoftBitmap *softBmp = (SoftBitmap *)bitmap->hardwareId;
+	if (softBmp == nullptr)
+		return;
+
+	// Sprites this frame that still name the slot find it empty and draw nothing
+	free(softBmp->decoded.pixels);
+	memset(softBmp, 0, sizeof(*softBmp));
+	gSoft->freeBitmapSlots[gSoft->numFreeBitmapSlots++] = (u32)(softBmp - gSoft->bitmaps);
+	bitmap->hardwareId                                   = nullptr;
+}
+
+bool QiSoft_WritePng(const Bitmap *bitmap, const char *fileName)
+{
+	return stbi_write_png(fileName, (int)bitmap->width, (int)bitmap->height, 4, bitmap->pixels, (int)(bitmap->pitch * sizeof(u32))) != 0;
+}
+
+//
+// Frame
+//
+
+static void QiSoft_BeginFrame()
+{
+	Assert(gSoft->inBeginFrame == 0);
+	Assert(gSoft->screenBitmap);
+	gSoft->inBeginFrame++;
+
+	gSoft->numFrameSprites   = 0;
+	gSoft->numPendingSprites = 0;
+	gSoft->spriteLayer       = 0;
+	gSoft->blendStackPos     = 0;
+	gSoft->clipStackPos      = 0;
+
+	Assert(gSoft->targetStackPos == 0);
+	QiSoft_PushRenderBitmap(gSoft->screenBitmap);
+
+	// Opaque black rather than a fresh random color each frame, so frames can be compared
+	SoftCmd *clear    = QiSoft_AddCmd(SCT_Clear);
+	clear->clearColor = 0xFF000000;
+}
+
+static void QiSoft_EndFrame()
+{
+	gSoft->inBeginFrame--;
+	Assert(gSoft->inBeginFrame == 0);
+
+	QiSoft_PopRenderBitmap();
+	Assert(gSoft->targetStackPos == 0);
+
+	QiSoft_RunPasses();
+}
+
+static void QiSoft_Init()
+{
+	// Highest slots handed out first, and the solid slot never
+	for (u32 slot = 1; slot < kMaxSoftBitmaps; slot++)
+		gSoft->freeBitmapSlots[gSoft->numFreeBitmapSlots++] = kMaxSoftBitmaps - slot;
+
+	// Nothing draws ImGui here, but NewFrame won't run without the font atlas built
+	ImGuiIO &io = ImGui::GetIO();
+	u8 *     pixels;
+	i32      width, height;
+	io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+
+	Bm_CreateBitmapFromBuffer(pixels, &gSoft->fontBitmap, width, height);
+	gSoft->fontBitmap.hardwareId = nullptr;
+	QiSoft_RegisterBitmap(&gSoft->fontBitmap, false);
+	((SoftBitmap *)gSoft->fontBitmap.hardwareId)->ready = true;
+	io.Fonts->TexID = (ImTextureID)(&gSoft->fontBitmap);
+}
+
+// HWI interface
+struct SoftHwi : public Hwi
+{
+	SoftHwi() {}
+	virtual ~SoftHwi() {}
+
+	void BeginFrame() override
+	{
+		ImGui::NewFrame();
+		QiSoft_BeginFrame();
+	}
+
+	void EndFrame() override
+	{
+		QiSoft_EndFrame();
+		ImGui::EndFrame();
+	}
+
+	// The passes already ran in EndFrame
+	void RenderFrame() override {}
+
+	void RegisterBitmap(Bitmap *bitmap, bool canBeRenderTarget) override { QiSoft_RegisterBitmap(bitmap, canBeRenderTarget); }
+
+	void UnregisterBitmap(Bitmap *bitmap) override { QiSoft_UnregisterBitmap(bitmap); }
+
+	// Draws read the bitmap's own pixels, so there's nothing to copy unless they're blocks
+	void UploadBitmap(Bitmap *bitmap) override
+	{
+		Assert(bitmap->hardwareId && bitmap->pixels);
+		SoftBitmap *softBmp = (SoftBitmap *)bitmap->hardwareId;
+		if (Bm_IsCompressed(bitmap->format))
+		{
+			Bitmap *decoded = &softBmp->decoded;
+			free(decoded->pixels);
+			Bm_CreateBitmapFromBuffer(malloc(bitmap->width * bitmap->height * sizeof(u32)), decoded, bitmap->width, bitmap->height);
+			Bc_Decode(bitmap->format, decoded->pixels, decoded->pitch, bitmap->pixels, bitmap->width, bitmap->height);
+		}
+		softBmp->ready = true;
+	}
+
+	bool IsBitmapReady(const Bitmap *bitmap) override { return bitmap->hardwareId && ((const SoftBitmap *)bitmap->hardwareId)->ready; }
+
+	// Draws are point sampled whatever the bitmap asks for
+	void UpdateBitmapSampling(Bitmap *) override {}
+
+	void SetScreenTarget(Bitmap *screenTarget) override
+	{
+		if (screenTarget->hardwareId == nullptr)
+			QiSoft_RegisterBitmap(screenTarget, true);
+		gSoft->screenBitmap = screenTarget;
+	}
+
+	void PushRenderTarget(Bitmap *targetBitmap) override { QiSoft_PushRenderBitmap(targetBitmap); }
+
+	void PopRenderTarget() override { QiSoft_PopRenderBitmap(); }
+
+	void BlitStretchedUV(Bitmap *srcBitmap, v2 ul, v2 lr, const Rect *destRectPixels, ColorU tint) override
+	{
+		QiSoft_PushSprite(srcBitmap, ul.x, ul.y, lr.x, lr.y, destRectPixels, tint);
+	}
+
+	void BlitStretched(Bitmap *srcBitmap, const Rect *srcRectPixels, const Rect *destRectPixels, ColorU tint) override
+	{
+		const r32 iw = 1.0f / (r32)srcBitmap->width;
+		const r32 ih = 1.0f / (r32)srcBitmap->height;
+		QiSoft_PushSprite(srcBitmap,
+		                  srcRectPixels->left * iw,
+		                  srcRectPixels->top * ih,
+		                  (srcRectPixels->left + srcRectPixels->width) * iw,
+		                  (srcRectPixels->top + srcRectPixels->height) * ih,
+		                  destRectPixels,
+		                  tint);
+	}
+
+	void Blit(Bitmap *srcBitmap, v2 srcXY, v2 destXY, v2 size, ColorU tint) override
+	{
+		Rect srcRect, destRect;
+
+		srcRect.left   = srcXY.x;
+		srcRect.top    = srcXY.y;
+		srcRect.width  = size.x;
+		srcRect.height = size.y;
+
+		destRect.left   = destXY.x;
+		destRect.top    = destXY.y;
+		destRect.width  = size.x;
+		destRect.height = size.y;
+
+		BlitStretched(srcBitmap, &srcRect, &destRect, tint);
+	}
+
+	// Like the OGL side, a pushed clip rect replaces the current one rather than narrowing it
+	void PushClipRect(Rect *clipRect) override
+	{
+		QiSoft_FlushSprites();
+		Assert(gSoft->clipStackPos < kMaxSoftClipStackDepth);
+		gSoft->clipStack[gSoft->clipStackPos++] = *clipRect;
+	}
+
+	void PopClipRect() override
+	{
+		QiSoft_FlushSprites();
+		Assert(gSoft->clipStackPos > 0);
+		gSoft->clipStackPos--;
+	}
+
+	void PushBlendState(BlendState blend) override
+	{
+		Assert(gSoft->blendStackPos < kMaxSoftBlendStackDepth);
+		gSoft->blendStack[gSoft->blendStackPos++] = blend;
+	}
+
+	void PopBlendState() override
+	{
+		Assert(gSoft->blendStackPos > 0);
+		gSoft->blendStackPos--;
+	}
+
+	void SetSortLayer(u32 layer) override
+	{
+		Assert(layer <= 0xFFFF);
+		gSoft->spriteLayer = layer;
+	}
+
+	void DrawLine(v2 p0, v2 p1, ColorU color) override { QiSoft_PushLine(p0, p1, color); }
+
+	void DrawRect(const Rect *rect, ColorU color) override
+	{
+		const v2 tl(rect->left, rect->top);
+		const v2 tr(rect->left + rect->width, rect->top);
+		const v2 br(rect->left + rect->width, rect->top + rect->height);
+		const v2 bl(rect->left, rect->top + rect->height);
+		QiSoft_PushLine(tl, tr, color);
+		QiSoft_PushLine(tr, br, color);
+		QiSoft_PushLine(br, bl, color);
+		QiSoft_PushLine(bl, tl, color);
+	}
+
+	HwiSprite *AppendSprites(Bitmap *texture, u32 numSprites) override { return QiSoft_AppendSprites(texture, numSprites); }
+
+	void UploadSpriteCache(HwiSpriteCache *cache, Bitmap *texture, const HwiSprite *sprites, u32 numSprites) override
+	{
+		QiSoft_UploadSpriteCache(cache, texture, sprites, numSprites);
+	}
+
+	void ReleaseSpriteCache(HwiSpriteCache *cache) override { QiSoft_ReleaseSpriteCache(cache); }
+	void DrawSpriteCache(const HwiSpriteCache *cache, v2 offset) override { QiSoft_DrawSpriteCache(cache, offset); }
+
+	void FillRect(const Rect *rect, ColorU color) override { QiSoft_PushSprite(nullptr, 0.0f, 0.0f, 1.0f, 1.0f, rect, color); }
+
+	// Flattened into as many segments as the control polygon is long in steps of kSoftBezierStep, within limits
+	void DrawBezier(v2 a, v2 b, v2 c, v2 d, ColorU color) override
+	{
+		const v2  ab          = b - a;
+		const v2  bc          = c - b;
+		const v2  cd          = d - c;
+		const r32 hullLength  = VLength(&ab) + VLength(&bc) + VLength(&cd);
+		const u32 numSegments = Qi_Clamp<u32>((u32)(hullLength / kSoftBezierStep), 1, kMaxSoftBezierSegments);
+
+		v2 prev = a;
+		for (u32 si = 1; si <= numSegments; si++)
+		{
+			const r32 t  = (r32)si / (r32)numSegments;
+			const r32 it = 1.0f - t;
+			const v2  p  = a * (it * it * it) + b * (3.0f * it * it * t) + c * (3.0f * it * t * t) + d * (t * t * t);
+			QiSoft_PushLine(prev, p, color);
+			prev = p;
+		}
+	}
+
+	void ResetState() override {}
+
+	void Finalize() override {}
+};
+
+void QiSoft_InitSystem(const SubSystem *sys, bool isReinit)
+{
+	gSoft         = (SoftGlobals *)sys->globalPtr;
+	void *hwiPtr  = (void *)(gSoft + 1);
+	gHwi          = new (hwiPtr) SoftHwi();
+
+	if (!isReinit)
+	{
+		memset(gSoft, 0, sizeof(*gSoft));
+		gSoft->cacheAllocator = BA_InitBuffer((u8 *)hwiPtr + sizeof(SoftHwi), kSoftCacheMemSize, 256);
+		QiSoft_Init();
+	}
+}
+
+SubSystem SoftHardwareSubSystem = {"SoftHardware", QiSoft_InitSystem, sizeof(SoftGlobals) + sizeof(SoftHwi) + kSoftCacheMemSize};
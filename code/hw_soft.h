@@ -0,0 +1,19 @@
+#ifndef __QI_SOFT_H
+
+//
+// Copyright 2017, Quantum Immortality Software and Jon Davis
+//
+// CPU implementation of the Hwi, for running without a GPU: headless servers, golden image tests and benchmarks.
+// Everything drawn in a frame is recorded, then rasterized at EndFrame into the target bitmaps' own pixels, one band
+// of rows a job. Blends are done on the stored 8 bit values, no sRGB conversion.
+//
+
+#include "basictypes.h"
+
+struct Bitmap;
+
+// Writes the bitmap's pixels out as a PNG, for checking a frame against a known good one
+bool QiSoft_WritePng(const Bitmap *bitmap, const char *fileName);
+
+#define __QI_SOFT_H
+#endif // #ifndef __QI_SOFT_H
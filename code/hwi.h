@@ -11,6 +11,22 @@ struct Bitmap;
 struct Rect;
 struct Brush;
 
+// One batched quad as the hardware draws it
+struct HwiSprite
+{
+	r32 dest[4]; // left, top, width, height in pixels
+	r32 uv[4];   // top left u, v, bottom right u, v
+	u32 color;
+	u32 texSlot; // Set by the hardware layer, callers leave it alone
+};
+
+// Sprites uploaded once and kept by the hardware, for geometry that rarely changes
+struct HwiSpriteCache
+{
+	void *hardwareId;
+	u32   numSprites;
+};
+
 enum BlendState
 {
 	BSTATE_None,
@@ -20,12 +36,26 @@ enum BlendState
 
 struct Hwi
 {
+	// Frames are recorded on the game thread between BeginFrame and EndFrame, and drawn by RenderFrame, which can be on
+	// a thread of its own. Once EndFrame of one frame returns, nothing goes into the next until RenderFrame of the one
+	// before has returned. RenderFrame leaves nothing unsent, the swap may happen on another thread.
 	virtual void BeginFrame() = 0;
 	virtual void EndFrame() = 0;
+	virtual void RenderFrame() = 0;
 
 	virtual void RegisterBitmap(Bitmap *bitmap, bool canBeRenderTarget = false) = 0;
+	// Nothing recorded after this reads the bitmap's pixels, but the frame being drawn may until the platform's
+	// SyncRender returns.
 	virtual void UnregisterBitmap(Bitmap *bitmap) = 0;
+
+	// Queues the pixels to stream up over the next frames within a per frame byte budget. Until the first upload is
+	// all on the GPU the bitmap isn't ready and blits of it draw nothing. Render targets are ready once registered.
+	// Pixels are read when the frame draws, so they have to stay put until it has.
 	virtual void UploadBitmap(Bitmap *bitmap) = 0;
+	virtual bool IsBitmapReady(const Bitmap *bitmap) = 0;
+
+	// Picks up a change to the bitmap's sampling, see Bm_SetSampling
+	virtual void UpdateBitmapSampling(Bitmap *bitmap) = 0;
 
 	virtual void SetScreenTarget(Bitmap *screenTarget) = 0;
 	virtual void PushRenderTarget(Bitmap *targetBitmap) = 0;
@@ -41,6 +71,20 @@ struct Hwi
 	virtual void PushBlendState(BlendState blend) = 0;
 	virtual void PopBlendState() = 0;
 
+	// Blits and filled rects are batched. Within a sort layer they may be reordered to group blend state and
+	// texture, so anything that has to draw over something else needs a higher layer. Reset to 0 each frame.
+	virtual void SetSortLayer(u32 layer) = 0;
+
+	// Space for numSprites already sorted quads from one texture, drawn in the order written and after everything
+	// submitted before. Fill them all before the next call into the Hwi.
+	virtual HwiSprite *AppendSprites(Bitmap *texture, u32 numSprites) = 0;
+
+	// Upload replaces whatever the cache held. Drawing adds offset to every sprite's dest and goes after everything
+	// submitted before it, in the current blend state.
+	virtual void UploadSpriteCache(HwiSpriteCache *cache, Bitmap *texture, const HwiSprite *sprites, u32 numSprites) = 0;
+	virtual void ReleaseSpriteCache(HwiSpriteCache *cache) = 0;
+	virtual void DrawSpriteCache(const HwiSpriteCache *cache, v2 offset) = 0;
+
 	virtual void DrawLine(v2 p0, v2 p1, ColorU color = ColorU(255, 255, 255, 255)) = 0;
 	virtual void DrawRect(const Rect *rect, ColorU color = ColorU(255, 255, 255, 255)) = 0;
 	virtual void FillRect(const Rect *rect, ColorU color = ColorU(255, 255, 255, 255)) = 0;
@@ -0,0 +1,34 @@
+#ifndef __QI_JOBS_H
+
+//
+// Copyright 2017, Quantum Immortality Software and Jon Davis
+//
+// Fork / join worker pool. Lives in the platform layer so no worker can be inside game code when the game
+// library reloads; the game gets at it through PlatFuncs_s.
+//
+
+#include "basictypes.h"
+
+typedef void QiJob_f(void *userData, u32 jobIdx);
+
+// numWorkers of 0 picks one per core, less the calling thread
+void Jobs_Init(u32 numWorkers);
+void Jobs_Shutdown();
+
+// Threads that take part in a ParallelFor, counting the caller
+u32 Jobs_NumThreads();
+
+// Runs job(userData, i) for every i in [0, numJobs) across the pool and the calling thread, returning once all
+// are done. Which thread runs which index is arbitrary, so jobs must only write state owned by their index.
+// Not reentrant, call from the main thread only.
+void Jobs_ParallelFor(QiJob_f *job, void *userData, u32 numJobs);
+
+// Queues job(userData, 0) for the background thread, which runs queued jobs one at a time in the order given. For
+// work that takes longer than a frame, like decoding assets. Call from the main thread only.
+void Jobs_RunAsync(QiJob_f *job, void *userData);
+
+// Returns once every job queued so far has finished
+void Jobs_WaitAsync();
+
+#define __QI_JOBS_H
+#endif // #ifndef __QI_JOBS_H
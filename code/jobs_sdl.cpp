@@ -0,0 +1,216 @@
+//
+// Copyright 2017, Quantum Immortality Software and Jon Davis
+//
+// SDL implementation of the worker pool
+//
+
+#include "basictypes.h"
+
+#include "debug.h"
+#include "jobs.h"
+
+#include "SDL.h"
+#include "SDL_atomic.h"
+#include "SDL_thread.h"
+
+#define JOBS_MAX_WORKERS 31
+#define JOBS_MAX_ASYNC   256
+
+struct JobBatch_s
+{
+	QiJob_f *    job;
+	void *       userData;
+	u32          numJobs;
+	SDL_atomic_t nextJob;
+};
+
+struct AsyncJob_s
+{
+	QiJob_f *job;
+	void *   userData;
+};
+
+struct JobGlobals_s
+{
+	SDL_Thread * workers[JOBS_MAX_WORKERS];
+	u32          numWorkers;
+	SDL_sem *    wake;
+	SDL_sem *    finished;
+	SDL_atomic_t quit;
+	JobBatch_s   batch;
+	bool         inParallelFor;
+
+	// Background queue. A job stays counted until it has finished running, so waiting for the count to hit zero
+	// waits for the one in progress too.
+	SDL_Thread * asyncThread;
+	SDL_mutex *  asyncLock;
+	SDL_cond *   asyncChanged; // Signalled when a job is queued or finishes
+	AsyncJob_s   asyncJobs[JOBS_MAX_ASYNC];
+	u32          asyncHead;
+	u32          asyncCount;
+};
+
+static JobGlobals_s s_jobs;
+
+static void RunBatch(JobBatch_s *batch)
+{
+	for (;;)
+	{
+		const u32 jobIdx = (u32)SDL_AtomicAdd(&batch->nextJob, 1);
+		if (jobIdx >= batch->numJobs)
+			return;
+		batch->job(batch->userData, jobIdx);
+	}
+}
+
+static int WorkerMain(void *)
+{
+	for (;;)
+	{
+		SDL_SemWait(s_jobs.wake);
+		if (SDL_AtomicGet(&s_jobs.quit))
+			return 0;
+
+		RunBatch(&s_jobs.batch);
+		SDL_SemPost(s_jobs.finished);
+	}
+}
+
+static int AsyncMain(void *)
+{
+	SDL_LockMutex(s_jobs.asyncLock);
+	for (;;)
+	{
+		while (s_jobs.asyncCount == 0 && !SDL_AtomicGet(&s_jobs.quit))
+			SDL_CondWait(s_jobs.asyncChanged, s_jobs.asyncLock);
+
+		// Whatever was queued still runs on quit
+		if (s_jobs.asyncCount == 0)
+			break;
+
+		const AsyncJob_s job = s_jobs.asyncJobs[s_jobs.asyncHead];
+		SDL_UnlockMutex(s_jobs.asyncLock);
+		job.job(job.userData, 0);
+		SDL_LockMutex(s_jobs.asyncLock);
+
+		s_jobs.asyncHead = (s_jobs.asyncHead + 1) % JOBS_MAX_ASYNC;
+		s_jobs.asyncCount--;
+		SDL_CondBroadcast(s_jobs.asyncChanged);
+	}
+	SDL_UnlockMutex(s_jobs.asyncLock);
+	return 0;
+}
+
+void Jobs_Init(u32 numWorkers)
+{
+	Assert(s_jobs.wake == nullptr);
+
+	if (numWorkers == 0)
+	{
+		const i32 numCores = SDL_GetCPUCount();
+		numWorkers         = numCores > 1 ? (u32)numCores - 1 : 0;
+	}
+	if (numWorkers > JOBS_MAX_WORKERS)
+		numWorkers = JOBS_MAX_WORKERS;
+
+	s_jobs.wake     = SDL_CreateSemaphore(0);
+	s_jobs.finished = SDL_CreateSemaphore(0);
+	SDL_AtomicSet(&s_jobs.quit, 0);
+
+	for (s_jobs.numWorkers = 0; s_jobs.numWorkers < numWorkers; s_jobs.numWorkers++)
+	{
+		SDL_Thread *worker = SDL_CreateThread(WorkerMain, "QiWorker", nullptr);
+		if (worker == nullptr)
+			break;
+		s_jobs.workers[s_jobs.numWorkers] = worker;
+	}
+
+	s_jobs.asyncLock    = SDL_CreateMutex();
+	s_jobs.asyncChanged = SDL_CreateCond();
+	s_jobs.asyncThread  = SDL_CreateThread(AsyncMain, "QiAsync", nullptr);
+	Assert(s_jobs.asyncThread);
+}
+
+void Jobs_Shutdown()
+{
+	SDL_AtomicSet(&s_jobs.quit, 1);
+	for (u32 wi = 0; wi < s_jobs.numWorkers; wi++)
+		SDL_SemPost(s_jobs.wake);
+	for (u32 wi = 0; wi < s_jobs.numWorkers; wi++)
+		SDL_WaitThread(s_jobs.workers[wi], nullptr);
+
+	SDL_LockMutex(s_jobs.asyncLock);
+	SDL_CondBroadcast(s_jobs.asyncChanged);
+	SDL_UnlockMutex(s_jobs.asyncLock);
+	SDL_WaitThread(s_jobs.asyncThread, nullptr);
+
+	SDL_DestroySemaphore(s_jobs.wake);
+	SDL_DestroySemaphore(s_jobs.finished);
+	SDL_DestroyCond(s_jobs.asyncChanged);
+	SDL_DestroyMutex(s_jobs.asyncLock);
+	s_jobs = {};
+}
+
+u32 Jobs_NumThreads()
+{
+	return s_jobs.numWorkers + 1;
+}
+
+void Jobs_ParallelFor(QiJob_f *job, void *userData, u32 numJobs)
+{
+	Assert(!s_jobs.inParallelFor);
+
+	if (numJobs == 0)
+		return;
+
+	if (numJobs == 1 || s_jobs.numWorkers == 0)
+	{
+		for (u32 jobIdx = 0; jobIdx < numJobs; jobIdx++)
+			job(userData, jobIdx);
+		return;
+	}
+
+	s_jobs.inParallelFor  = true;
+	s_jobs.batch.job      = job;
+	s_jobs.batch.userData = userData;
+	s_jobs.batch.numJobs  = numJobs;
+	SDL_AtomicSet(&s_jobs.batch.nextJob, 0);
+
+	// Only wake as many workers as there are jobs for besides the one this thread takes
+	const u32 numWoken = numJobs - 1 < s_jobs.numWorkers ? numJobs - 1 : s_jobs.numWorkers;
+	for (u32 wi = 0; wi < numWoken; wi++)
+		SDL_SemPost(s_jobs.wake);
+
+	RunBatch(&s_jobs.batch);
+
+	// The batch can't be reused until every woken worker has stopped looking at it
+	for (u32 wi = 0; wi < numWoken; wi++)
+		SDL_SemWait(s_jobs.finished);
+
+	s_jobs.inParallelFor = false;
+}
+
+void Jobs_RunAsync(QiJob_f *job, void *userData)
+{
+	SDL_LockMutex(s_jobs.asyncLock);
+
+	// A full queue holds the caller up rather than dropping work
+	while (s_jobs.asyncCount == JOBS_MAX_ASYNC)
+		SDL_CondWait(s_jobs.asyncChanged, s_jobs.asyncLock);
+
+	AsyncJob_s *slot = &s_jobs.asyncJobs[(s_jobs.asyncHead + s_jobs.asyncCount) % JOBS_MAX_ASYNC];
+	slot->job        = job;
+	slot->userData   = userData;
+	s_jobs.asyncCount++;
+
+	SDL_CondBroadcast(s_jobs.asyncChanged);
+	SDL_UnlockMutex(s_jobs.asyncLock);
+}
+
+void Jobs_WaitAsync()
+{
+	SDL_LockMutex(s_jobs.asyncLock);
+	while (s_jobs.asyncCount > 0)
+		SDL_CondWait(s_jobs.asyncChanged, s_jobs.asyncLock);
+	SDL_UnlockMutex(s_jobs.asyncLock);
+}
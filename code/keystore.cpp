@@ -107,7 +107,7 @@ static ValueRef KS__Write(KeyStore **ksp, ValueType type, const void *data, size
 	const size_t neededSpace = sizeBytes + extraSizeBytes;
 	while (ks->sizeBytes - ks->usedBytes < neededSpace)
 	{
-		const size_t newBufSize = (ks->sizeBytes - ks->usedBytes) * 2;
+		const size_t newBufSize = ks->sizeBytes * 2;
 		ks                      = (KeyStore *)BA_Realloc(gks->allocator, ks, newBufSize);
 		ks->sizeBytes           = newBufSize;
 		*ksp                    = ks;
@@ -744,6 +744,106 @@ KeyStore *KS_CompactCopy(const KeyStore *ks)
 	return newKS;
 }
 
+// Block headers are bigger in dev builds, so an image only loads into the kind of build that wrote it
+struct KSImageHeader
+{
+	u32 blockHeaderBytes;
+	u32 storeBytes;
+	u32 stringBytes;
+	u32 pad;
+};
+
+template <typename RemapFunc>
+static void KS__RemapSymbols(KeyStore *ks, ValueRef *ref, RemapFunc remap)
+{
+	switch (ValueRefType(*ref))
+	{
+	case SYMBOL:
+		*ref = MakeValueRef(remap((Symbol)ValueRefOffset(*ref)), SYMBOL);
+		break;
+
+	case ARRAY:
+	case OBJECT:
+	{
+		// Object blocks hold key / value pairs, both of which may be symbols
+		const u32 refsPerElem = ValueRefType(*ref) == OBJECT ? 2 : 1;
+		ValueRef  nextBlock   = *ref;
+		do
+		{
+			DataBlock *db   = KS__GetBlock(ks, nextBlock);
+			ValueRef * refs = KS__GetBlockDataPtr(ks, db);
+			for (u32 i = 0; i < db->usedElems * refsPerElem; i++)
+				KS__RemapSymbols(ks, &refs[i], remap);
+			nextBlock = db->nextBlock;
+		} while (nextBlock != NilValue);
+		break;
+	}
+
+	default:
+		break;
+	}
+}
+
+u32 KS_WriteImage(const KeyStore *ks, void *buffer, u32 bufferSize)
+{
+	KSImageHeader *header = (KSImageHeader *)buffer;
+	if (bufferSize < sizeof(KSImageHeader) + ks->usedBytes)
+		return 0;
+
+	KeyStore *image = (KeyStore *)(header + 1);
+	memcpy(image, ks, ks->usedBytes);
+	image->sizeBytes = ks->usedBytes;
+	image->name      = 0;
+
+	// Symbols become offsets into the strings following the store
+	char *     strings     = (char *)image + ks->usedBytes;
+	const u32  stringRoom  = bufferSize - (u32)sizeof(KSImageHeader) - ks->usedBytes;
+	u32        stringBytes = 0;
+	bool       fits        = true;
+	KS__RemapSymbols(image, &image->root, [&](Symbol sym) -> Symbol {
+		const char *str = ST_ToString(gks->symbolTable, sym);
+		const u32   len = (u32)strlen(str) + 1;
+		if (stringBytes + len > stringRoom)
+		{
+			fits = false;
+			return 0;
+		}
+		memcpy(strings + stringBytes, str, len);
+		stringBytes += len;
+		return stringBytes - len;
+	});
+	if (!fits)
+		return 0;
+
+	header->blockHeaderBytes = sizeof(DataBlock);
+	header->storeBytes       = ks->usedBytes;
+	header->stringBytes      = stringBytes;
+	header->pad              = 0;
+	return (u32)sizeof(KSImageHeader) + ks->usedBytes + stringBytes;
+}
+
+KeyStore *KS_CreateFromImage(const char *name, const void *image, size_t imageSize)
+{
+	const KSImageHeader *header = (const KSImageHeader *)image;
+	if (imageSize < sizeof(KSImageHeader) || header->blockHeaderBytes != sizeof(DataBlock) ||
+	    sizeof(KSImageHeader) + (size_t)header->storeBytes + header->stringBytes > imageSize)
+	{
+		return nullptr;
+	}
+
+	// Leave some room so the first edit doesn't have to grow it
+	const u8 *   storeBytes = (const u8 *)(header + 1);
+	const char * strings    = (const char *)storeBytes + header->storeBytes;
+	const size_t sizeBytes  = header->storeBytes + kKSDefaultInitialSize;
+	KeyStore *   ks         = (KeyStore *)BA_Alloc(gks->allocator, sizeBytes);
+	memcpy(ks, storeBytes, header->storeBytes);
+	ks->sizeBytes = (u32)sizeBytes;
+	ks->name      = ST_Intern(gks->symbolTable, name);
+
+	KS__RemapSymbols(ks, &ks->root, [&](Symbol offset) -> Symbol { return ST_Intern(gks->symbolTable, strings + offset); });
+	return ks;
+}
+
 SmallIntValue KS_GetKeySmallInt(const KeyStore *ks, ValueRef object, const char *key, SmallIntValue def)
 {
 	return KS_GetKeySmallInt(ks, object, ST_Intern(gks->symbolTable, key), def);
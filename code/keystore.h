@@ -85,6 +85,12 @@ u32          KS_ValueToString(const KeyStore *ks, ValueRef value, const char *bu
 // space in objects/arrays, no unreferenced int/string/real values, etc.
 KeyStore *KS_CompactCopy(const KeyStore *ks);
 
+// A store as a flat image another process can load, for baking into packs: the store's bytes with its symbols turned
+// into strings carried along after them. Returns the bytes written, or 0 if the buffer is too small.
+u32       KS_WriteImage(const KeyStore *ks, void *buffer, u32 bufferSize);
+// New store from an image, with its symbols interned again. nullptr if the image was written by an incompatible build.
+KeyStore *KS_CreateFromImage(const char *name, const void *image, size_t imageSize);
+
 inline constexpr ValueRef KS_AddSmallInt(KeyStore **, SmallIntValue val)
 {
 	return MakeValueRef(val, SMALLINT);
@@ -4,13 +4,19 @@
 #include "sound.h"
 #include "debug.h"
 #include "hwi.h"
+#include "jobs.h"
+#include "fileio.h"
+#include "filewatch.h"
+#include "framepace.h"
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #if HAS(OSX_BUILD)
 #include <sys/mman.h>
+#include <fcntl.h>
 #include <dlfcn.h>
 #include <libproc.h>
 #include <unistd.h>
@@ -33,6 +39,10 @@
 #define PATH_MAX MAX_PATH
 #endif
 
+#if HAS(SSE2_SIMD)
+#include <xmmintrin.h>
+#endif
+
 #include "SDL.h"
 #include "SDL_opengl.h"
 #include "SDL_events.h"
@@ -47,19 +57,47 @@
 
 #define internal static
 
-#define NUM_AUDIO_BUFFERS 2
+#define AUDIO_DEVICE_FRAMES 512 // Mixed each time SDL's audio thread asks, about 11ms
+
+// Mixed on SDL's audio thread as the device asks, however late the frame is. The callback runs game code, so it
+// mustn't be inside the library while a reload swaps it; it takes the update function once a callback and the main
+// thread clears it and waits for any callback still running before unloading. Neither side ever blocks the other.
 struct Sound_s
 {
+	SDL_AudioDeviceID device; // 0 without sound
+	SDL_atomic_t      inCallback;
+	void *            update; // Qis_UpdateSound_f of the loaded library, null while it's being swapped
+};
+
+enum RenderRequest_e
+{
+	RENDER_FRAME, // Draw the frame the game just finished
+	RENDER_QUIT,
+};
+
+// The render thread draws each frame while the game records the next. A request is handed over with posted, and
+// finished comes back once it's done, so the main thread never runs more than one frame ahead. The swap stays on the
+// main thread, the only one macOS allows it on: the render thread only holds the context while it draws, and the
+// main thread takes it between frames to swap the one just drawn.
+struct Render_s
+{
+	SDL_Thread *    thread;
+	SDL_GLContext   context;
+	SDL_sem *       posted;
+	SDL_sem *       finished;
+	RenderRequest_e request;
+	bool            unswapped; // A frame went to the render thread and hasn't been swapped yet
 };
 
 // All the globals!
 struct Globals_s
 {
 	bool gameRunning;
+	bool headless; // No window, GL or sound, see RunHeadless
 
 	Bitmap         frameBuffer;
 	Sound_s        sound;
-	SoundBuffer_s *soundUpdateBuffer;
+	Render_s       render;
 	Input          inputState;
 	Memory         memory;
 	u32            cursorBuf[16];
@@ -69,10 +107,17 @@ struct Globals_s
 	char gameRecordBasePath[PATH_MAX];
 
 	void *             gameDylib;
-	char               gameDylibPath[PATH_MAX];
-	i32                gameDylibLastMtime;
+	char               gameDylibPath[PATH_MAX];       // Where the build writes it
+	char               gameDylibLoadedPath[PATH_MAX]; // The copy of it that's loaded, removed once replaced
+	u32                gameDylibNumCopies;
+	u64                gameDylibHash; // Of the last copy made, the watcher thread's after startup
 	const GameFuncs_s *game;
 
+	// A new copy handed from the file watcher thread to the main thread, which only has to check the flag each frame
+	SDL_mutex *  gameDylibLock;
+	char         gameDylibNextPath[PATH_MAX];
+	SDL_atomic_t gameDylibNextReady;
+
 	FILE *loopingFile;
 	i32   recordingChannel;
 	i32   playbackChannel;
@@ -98,6 +143,7 @@ struct Globals_s
 	ImGuiContext *imGuiContext;
 
 	bool showDemoWin;
+	bool showPacingWin;
 } g;
 
 #define NOTE_UNUSED(x) ((void)x);
@@ -206,56 +252,296 @@ static void MakeGameEXERelativePath(char *dst, const char *filename)
 	StringAppend(dst, PATH_MAX, filename);
 }
 
-static void OS_UpdateSound() {}
+static void OS_AudioCallback(void *, u8 *stream, int len)
+{
+#if HAS(SSE2_SIMD)
+	// Flush denormals to zero, a voice fading out mustn't slow the mix down
+	_mm_setcsr(_mm_getcsr() | 0x8040);
+#endif
 
-static r64 WallSeconds()
+	SDL_AtomicIncRef(&g.sound.inCallback);
+	Qis_UpdateSound_f *update = (Qis_UpdateSound_f *)SDL_AtomicGetPtr(&g.sound.update);
+	if (update != nullptr)
+	{
+		// The device's own buffer, nothing to allocate or copy
+		SoundBuffer_s buffer  = {};
+		buffer.channels       = QI_SOUND_CHANNELS;
+		buffer.bytesPerSample = QI_SOUND_BYTES_PER_SAMPLE;
+		buffer.samplesPerSec  = QI_SOUND_SAMPLES_PER_SECOND;
+		buffer.numSamples     = (u32)len / QI_SOUND_BYTES_PER_SAMPLE;
+		buffer.byteSize       = (u32)len;
+		buffer.bytes          = stream;
+		update(&buffer, buffer.numSamples);
+	}
+	else
+	{
+		memset(stream, 0, (size_t)len);
+	}
+	SDL_AtomicDecRef(&g.sound.inCallback);
+}
+
+// Before the library goes. A callback that saw the old update function before it was cleared is waited out, at most
+// one mix; any after see null and play silence.
+static void OS_DetachSound()
 {
-	return (r64)SDL_GetPerformanceCounter() * g.timeConversionFactor;
+	SDL_AtomicSetPtr(&g.sound.update, nullptr);
+	while (SDL_AtomicGet(&g.sound.inCallback) != 0)
+		SDL_Delay(0);
 }
 
-static void OS_LoadGameDll()
+static void OS_AttachSound()
 {
-	struct stat statbuf;
-	if (stat(g.gameDylibPath, &statbuf) != 0)
+	SDL_AtomicSetPtr(&g.sound.update, (void *)g.game->sound->Update);
+}
+
+static void OS_InitSound()
+{
+	if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0)
 	{
-		fprintf(stderr, "Couldn't find game dylib: %s\n", g.gameDylibPath);
+		fprintf(stderr, "No audio: %s\n", SDL_GetError());
 		return;
 	}
 
-#if HAS(OSX_BUILD)
-	if (statbuf.st_mtimespec.tv_sec == g.gameDylibLastMtime)
+	SDL_AudioSpec want = {};
+	want.freq          = QI_SOUND_SAMPLES_PER_SECOND;
+	want.format        = AUDIO_S16SYS;
+	want.channels      = QI_SOUND_CHANNELS;
+	want.samples       = AUDIO_DEVICE_FRAMES;
+	want.callback      = OS_AudioCallback;
+
+	// SDL converts if the device wants something else, the mixer always sees its own format
+	SDL_AudioSpec have;
+	g.sound.device = SDL_OpenAudioDevice(nullptr, 0, &want, &have, 0);
+	if (g.sound.device == 0)
+	{
+		fprintf(stderr, "Can't open audio device: %s\n", SDL_GetError());
 		return;
-	g.gameDylibLastMtime = statbuf.st_mtimespec.tv_sec;
-#else
-	if (statbuf.st_mtime == g.gameDylibLastMtime)
+	}
+
+	OS_AttachSound();
+	SDL_PauseAudioDevice(g.sound.device, 0);
+}
+
+static void OS_ShutdownSound()
+{
+	// Closing waits for the callback to finish
+	if (g.sound.device != 0)
+		SDL_CloseAudioDevice(g.sound.device);
+	g.sound.device = 0;
+	SDL_QuitSubSystem(SDL_INIT_AUDIO);
+}
+
+static int OS_RenderThreadMain(void *)
+{
+	for (;;)
+	{
+		SDL_SemWait(g.render.posted);
+		if (g.render.request == RENDER_QUIT)
+			break;
+
+		SDL_GL_MakeCurrent(g.window, g.render.context);
+		g.game->GetHwi()->RenderFrame();
+		SDL_GL_MakeCurrent(g.window, nullptr);
+		SDL_SemPost(g.render.finished);
+	}
+
+	return 0;
+}
+
+// Only once the render thread has finished the request before
+static void OS_PostRender(RenderRequest_e request)
+{
+	g.render.request   = request;
+	g.render.unswapped = request == RENDER_FRAME;
+	SDL_SemPost(g.render.posted);
+}
+
+// Waits for the render thread to finish the frame it's on, then swaps it. Returns false when there was none.
+static bool OS_SwapRendered()
+{
+	SDL_SemWait(g.render.finished);
+	if (!g.render.unswapped)
+		return false;
+
+	SDL_GL_MakeCurrent(g.window, g.render.context);
+	SDL_GL_SwapWindow(g.window);
+	SDL_GL_MakeCurrent(g.window, nullptr);
+	g.render.unswapped = false;
+	return true;
+}
+
+// The context can only be current on one thread at a time, so the main thread lets go of it
+static void OS_InitRender(SDL_GLContext context)
+{
+	g.render.context  = context;
+	g.render.posted   = SDL_CreateSemaphore(0);
+	g.render.finished = SDL_CreateSemaphore(1);
+	SDL_GL_MakeCurrent(g.window, nullptr);
+
+	g.render.thread = SDL_CreateThread(OS_RenderThreadMain, "QiRender", nullptr);
+	Assert(g.render.thread);
+}
+
+// Waits out the frame the render thread is drawing
+static void OS_SyncRender()
+{
+	if (g.render.thread == nullptr)
 		return;
-	g.gameDylibLastMtime = statbuf.st_mtime;
-#endif
+
+	SDL_SemWait(g.render.finished);
+	SDL_SemPost(g.render.finished);
+}
+
+static void OS_ShutdownRender()
+{
+	SDL_SemWait(g.render.finished);
+	OS_PostRender(RENDER_QUIT);
+	SDL_WaitThread(g.render.thread, nullptr);
+	SDL_DestroySemaphore(g.render.posted);
+	SDL_DestroySemaphore(g.render.finished);
+	g.render = {};
+}
+
+static r64 WallSeconds()
+{
+	return (r64)SDL_GetPerformanceCounter() * g.timeConversionFactor;
+}
+
+// FNV-1a, enough to tell a relink that came out the same
+static u64 OS_HashBytes(const u8 *bytes, size_t size)
+{
+	u64 hash = 0xCBF29CE484222325ull;
+	for (size_t bi = 0; bi < size; bi++)
+		hash = (hash ^ bytes[bi]) * 0x100000001B3ull;
+	return hash;
+}
+
+static void *OS_ReadEntireFile(ThreadContext *, const char *fileName, size_t *fileSize);
+
+// The library is loaded from a copy, so the build can write the next one while this one is in use and a load never
+// sees a half written file. Each copy gets a new name, the loader hands back one it already has open otherwise.
+static bool OS_CopyGameDll(char *copyPath, u64 *hash)
+{
+	snprintf(copyPath, PATH_MAX, "%s.hot%u", g.gameDylibPath, ++g.gameDylibNumCopies);
+
+	size_t size  = 0;
+	u8 *   bytes = (u8 *)OS_ReadEntireFile(nullptr, g.gameDylibPath, &size);
+	if (bytes == nullptr)
+		return false;
+
+	FILE *copy   = fopen(copyPath, "wb");
+	bool  copied = copy != nullptr && fwrite(bytes, 1, size, copy) == size;
+	if (copy != nullptr)
+		copied = fclose(copy) == 0 && copied;
+	if (!copied)
+		remove(copyPath);
+
+	*hash = OS_HashBytes(bytes, size);
+	free(bytes);
+	return copied;
+}
+
+// The new library is loaded before the old one goes, so a build that won't load leaves the game running on the old
+static void OS_LoadGameDll(const char *copyPath)
+{
+	void *dylib = SDL_LoadObject(copyPath);
+	if (dylib == nullptr)
+	{
+		fprintf(stderr, "Couldn't dlopen game dylib: %s\n", copyPath);
+		remove(copyPath);
+		return;
+	}
 
 	if (g.gameDylib != nullptr)
 	{
+		// Read callbacks, background jobs and the render thread run game code
+		OS_SyncRender();
+		Io_WaitAll();
+		Jobs_WaitAsync();
+		OS_DetachSound();
 		SDL_UnloadObject(g.gameDylib);
-		g.gameDylib = nullptr;
+		remove(g.gameDylibLoadedPath);
 	}
 
 	printf("Hotloading game dylib\n");
+	g.gameDylib = dylib;
+	StringCopy(g.gameDylibLoadedPath, PATH_MAX, copyPath);
 
-	g.gameDylib = SDL_LoadObject(g.gameDylibPath);
+	typedef const GameFuncs_s *GetGameFuncs_f();
+	GetGameFuncs_f *           GetGameFuncs = (GetGameFuncs_f *)SDL_LoadFunction(g.gameDylib, "Qi_GetGameFuncs");
+	Assert(GetGameFuncs);
+	g.game = GetGameFuncs();
 
-	if (g.gameDylib)
-	{
-		typedef const GameFuncs_s *GetGameFuncs_f();
-		GetGameFuncs_f *           GetGameFuncs = (GetGameFuncs_f *)SDL_LoadFunction(g.gameDylib, "Qi_GetGameFuncs");
-		Assert(GetGameFuncs);
-		g.game = GetGameFuncs();
+	// Subsystems keep their state in game memory and pick it up again in their init, see InitGameSystems
+	Assert(g.game->Init);
+	g.game->Init(plat, &g.memory);
+
+	if (g.sound.device != 0)
+		OS_AttachSound();
+}
 
-		Assert(g.game->Init);
-		g.game->Init(plat, &g.memory);
+// On the file watcher thread, once the build has finished writing the library
+static void OS_GameDllChanged(const char *, void *)
+{
+	char copyPath[PATH_MAX];
+	u64  hash = 0;
+	if (!OS_CopyGameDll(copyPath, &hash))
+	{
+		fprintf(stderr, "Couldn't copy game dylib: %s\n", g.gameDylibPath);
+		return;
 	}
-	else
+
+	// Relinked to the same bytes: nothing to reload, and no subsystem has to init again
+	if (hash == g.gameDylibHash)
 	{
-		fprintf(stderr, "Couldn't dlopen game dylib: %s\n", g.gameDylibPath);
+		remove(copyPath);
+		return;
 	}
+	g.gameDylibHash = hash;
+
+	SDL_LockMutex(g.gameDylibLock);
+	if (SDL_AtomicGet(&g.gameDylibNextReady))
+		remove(g.gameDylibNextPath); // Superseded before the main thread got to it
+	StringCopy(g.gameDylibNextPath, PATH_MAX, copyPath);
+	SDL_AtomicSet(&g.gameDylibNextReady, 1);
+	SDL_UnlockMutex(g.gameDylibLock);
+}
+
+// Once a frame, before any game code runs
+static void OS_UpdateGameDll()
+{
+	if (!SDL_AtomicGet(&g.gameDylibNextReady))
+		return;
+
+	char copyPath[PATH_MAX];
+	SDL_LockMutex(g.gameDylibLock);
+	StringCopy(copyPath, PATH_MAX, g.gameDylibNextPath);
+	SDL_AtomicSet(&g.gameDylibNextReady, 0);
+	SDL_UnlockMutex(g.gameDylibLock);
+
+	OS_LoadGameDll(copyPath);
+}
+
+static void OS_InitGameDll()
+{
+	g.gameDylibLock = SDL_CreateMutex();
+
+	char copyPath[PATH_MAX];
+	if (OS_CopyGameDll(copyPath, &g.gameDylibHash))
+		OS_LoadGameDll(copyPath);
+	else
+		fprintf(stderr, "Couldn't find game dylib: %s\n", g.gameDylibPath);
+
+	Fw_WatchOnThread(g.gameDylibPath, OS_GameDllChanged, nullptr);
+}
+
+// After the file watches have stopped
+static void OS_ShutdownGameDll()
+{
+	if (SDL_AtomicGet(&g.gameDylibNextReady))
+		remove(g.gameDylibNextPath);
+	remove(g.gameDylibLoadedPath);
+	SDL_DestroyMutex(g.gameDylibLock);
 }
 
 // Game platform service functions
@@ -264,22 +550,29 @@ static r64 OS_WallSeconds(ThreadContext *)
 	return WallSeconds();
 }
 
+// nullptr when the file can't be read. The buffer has a 0 past the end for the text parsers.
 static void *OS_ReadEntireFile(ThreadContext *, const char *fileName, size_t *fileSize)
 {
+	FILE *f = fopen(fileName, "rb");
+	if (f == nullptr)
+		return nullptr;
+
 	struct stat statBuf;
-	if (stat(fileName, &statBuf) != 0)
+	u8 *        fileBuf = nullptr;
+	if (fstat(fileno(f), &statBuf) == 0)
+		fileBuf = (u8 *)malloc(statBuf.st_size + 1);
+
+	if (fileBuf != nullptr && fread(fileBuf, 1, statBuf.st_size, f) != (size_t)statBuf.st_size)
 	{
-		Assert(0 && "Couldn't stat a shader file");
+		free(fileBuf);
+		fileBuf = nullptr;
 	}
-
-	void *fileBuf = malloc(statBuf.st_size + 1);
-	memset(fileBuf, 0, statBuf.st_size + 1);
-	Assert(fileBuf);
-
-	FILE *f = fopen(fileName, "rb");
-	fread(fileBuf, 1, statBuf.st_size, f);
 	fclose(f);
 
+	if (fileBuf == nullptr)
+		return nullptr;
+
+	fileBuf[statBuf.st_size] = 0;
 	if (fileSize != nullptr)
 		*fileSize = statBuf.st_size;
 
@@ -300,6 +593,47 @@ static void OS_ReleaseFileBuffer(ThreadContext *, void *buffer)
 	free(buffer);
 }
 
+#if HAS(OSX_BUILD)
+static const void *OS_MapFile(ThreadContext *, const char *fileName, size_t *fileSize)
+{
+	const int fd = open(fileName, O_RDONLY);
+	if (fd < 0)
+		return nullptr;
+
+	struct stat statBuf;
+	void *      mapped = MAP_FAILED;
+	if (fstat(fd, &statBuf) == 0 && statBuf.st_size > 0)
+		mapped = mmap(nullptr, statBuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); // The mapping keeps its own reference to the file
+
+	if (mapped == MAP_FAILED)
+		return nullptr;
+
+	if (fileSize != nullptr)
+		*fileSize = statBuf.st_size;
+	return mapped;
+}
+
+static void OS_UnmapFile(ThreadContext *, const void *ptr, size_t size)
+{
+	munmap((void *)ptr, size);
+}
+#else
+// No mapping here yet, a copy in memory reads the same
+static const void *OS_MapFile(ThreadContext *tc, const char *fileName, size_t *fileSize)
+{
+	struct stat statBuf;
+	if (stat(fileName, &statBuf) != 0)
+		return nullptr;
+	return OS_ReadEntireFile(tc, fileName, fileSize);
+}
+
+static void OS_UnmapFile(ThreadContext *tc, const void *ptr, size_t)
+{
+	OS_ReleaseFileBuffer(tc, (void *)ptr);
+}
+#endif
+
 static void OS_SetupMainExeLibraries()
 {
 	ImGui::SetCurrentContext(g.imGuiContext);
@@ -505,10 +839,11 @@ static void InitGameGlobals()
 	MakeGameEXERelativePath(g.gameDylibPath, gameDylibName);
 	MakeGameEXERelativePath(g.gameRecordBasePath, "qi_");
 
-	OS_LoadGameDll();
+	OS_InitGameDll();
 
-	// Assert(g.game && g.game->sound);
-	Assert(g.game);
+	Assert(g.game && g.game->sound);
+	if (!g.headless)
+		OS_InitSound();
 #if HAS(DEV_BUILD) || HAS(PROF_BUILD)
 	// Assert(g.game->debug);
 #endif
@@ -592,7 +927,15 @@ void BeginPlayback(i32 channel)
 		return;
 	}
 
-	if (fread(g.memory.permanentStorage, 1, memSize, g.loopingFile) != memSize)
+	// The frame being drawn reads game memory too, bitmap pixels and the rest. The mixer is in there as well, the
+	// audio thread mustn't be mixing out of it while it's overwritten.
+	OS_SyncRender();
+	OS_DetachSound();
+	const size_t memRead = fread(g.memory.permanentStorage, 1, memSize, g.loopingFile);
+	g.game->sound->Restored();
+	if (g.sound.device != 0)
+		OS_AttachSound();
+	if (memRead != memSize)
 	{
 		fprintf(stderr, "Failed to read memory block on playback\n");
 		fclose(g.loopingFile);
@@ -657,7 +1000,12 @@ void BeginRecording(i32 channel)
 		size_t bytesWritten = 0;
 		bytesWritten        = fwrite(&permSize, 1, sizeof(size_t), g.loopingFile);
 		Assert(bytesWritten == sizeof(permSize));
+		// As for playback, the frame being drawn and the mixer are waited out, or the snapshot could hold a half run mix
+		OS_SyncRender();
+		OS_DetachSound();
 		bytesWritten = fwrite(g.memory.permanentStorage, 1, permSize, g.loopingFile);
+		if (g.sound.device != 0)
+			OS_AttachSound();
 		Assert(bytesWritten == permSize);
 	}
 
@@ -853,6 +1201,10 @@ static void HandleKeyEvent(SDL_Event *event, Input *newInput)
 	{
 		g.game->ToggleEditor();
 	}
+	else if (vkCode == SDLK_f && ctrlKey && isDown)
+	{
+		g.showPacingWin = !g.showPacingWin;
+	}
 	else if (vkCode == SDLK_e)
 	{
 		ProcessButton(&kbdController->rightShoulder, isDown);
@@ -926,6 +1278,73 @@ void UpdateImGui(Input *newInput)
 #ifdef main
 #undef main
 #endif
+// Ctrl-F: how well the main loop is keeping to its schedule
+static void ShowFramePacing()
+{
+	const FpStats_s *stats = Fp_Stats();
+	if (ImGui::Begin("Frame pacing", &g.showPacingWin, ImGuiWindowFlags_AlwaysAutoResize))
+	{
+		ImGui::Text("Frame %.2f ms, worst %.2f ms", stats->lastFrameMs, stats->worstFrameMs);
+		ImGui::Text("Missed %llu of %llu", (unsigned long long)stats->missed, (unsigned long long)stats->frames);
+		ImGui::Text("Wake late %.0f us, margin %.0f us, spin %.0f us", stats->wakeLateUs, stats->wakeMarginUs, stats->spinUs);
+		if (ImGui::Button("Reset worst"))
+			Fp_ResetWorst();
+	}
+	ImGui::End();
+}
+
+#if HAS(SOFT_RENDER)
+// qi --headless <frames> <out dir>: runs that many frames with no input and a fixed step, so runs repeat exactly, and
+// writes each frame to <out dir>/frame_NNNN.png for checking against known good ones.
+static int RunHeadless(u32 numFrames, const char *outDir)
+{
+	SDL_Init(SDL_INIT_TIMER);
+
+	Jobs_Init(0);
+	Io_Init();
+	Fw_Init();
+
+	InitImGui(nullptr);
+	InitGameGlobals();
+	Assert(g.game->WritePng);
+
+	ImGuiIO &io    = ImGui::GetIO();
+	io.DisplaySize = ImVec2((r32)GAME_RES_X, (r32)GAME_RES_Y);
+	io.DeltaTime   = (r32)SIM_DT;
+
+	int exitCode = EXIT_SUCCESS;
+	for (u32 frame = 0; frame < numFrames; frame++)
+	{
+		g.inputState    = {};
+		g.inputState.dT = (Time_t)SIM_DT;
+
+		Hwi *hwi = g.game->GetHwi();
+		hwi->BeginFrame();
+		Io_Update();
+		g.game->UpdateAndRender(&g.thread, &g.inputState, &g.frameBuffer);
+		hwi->EndFrame();
+		hwi->RenderFrame();
+
+		char pngPath[PATH_MAX];
+		snprintf(pngPath, sizeof(pngPath), "%s/frame_%04u.png", outDir, frame);
+		if (!g.game->WritePng(&g.frameBuffer, pngPath))
+		{
+			fprintf(stderr, "Couldn't write %s\n", pngPath);
+			exitCode = EXIT_FAILURE;
+			break;
+		}
+	}
+
+	Fw_Shutdown();
+	OS_ShutdownGameDll();
+	Io_Shutdown();
+	Jobs_Shutdown();
+	SDL_Quit();
+
+	return exitCode;
+}
+#endif
+
 int main(int argc, const char *argv[])
 {
 // In dev builds, chdir into the hardcoded data directory to facilitate running the exe from
@@ -938,9 +1357,29 @@ int main(int argc, const char *argv[])
 
 	// SDL_SetMemoryFunctions(SdlMalloc, SdlCalloc, SdlRealloc, SdlFree);
 
+	if (argc > 1 && strcmp(argv[1], "--headless") == 0)
+	{
+#if HAS(SOFT_RENDER)
+		if (argc != 4 || atoi(argv[2]) <= 0)
+		{
+			fprintf(stderr, "usage: %s --headless <frames> <out dir>\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+		g.headless = true;
+		return RunHeadless((u32)atoi(argv[2]), argv[3]);
+#else
+		fprintf(stderr, "--headless needs a QI_SOFT_RENDER build\n");
+		return EXIT_FAILURE;
+#endif
+	}
+
 	SDL_Init(SDL_INIT_VIDEO);
 	SDL_Init(SDL_INIT_TIMER);
 
+	Jobs_Init(0);
+	Io_Init();
+	Fw_Init();
+
 	SDL_GL_SetAttribute(SDL_GL_RED_SIZE, 8);
 	SDL_GL_SetAttribute(SDL_GL_GREEN_SIZE, 8);
 	SDL_GL_SetAttribute(SDL_GL_BLUE_SIZE, 8);
@@ -969,7 +1408,12 @@ int main(int argc, const char *argv[])
 	r64 oneSec = WallSeconds() - secs;
 	printf("Onesec: %g\n", oneSec);
 
-	r64 frameStart = WallSeconds();
+	// With vsync on, the swap is what really paces frames and the pacer keeps in step with it. Asked while the
+	// context is still current here.
+	Fp_Init(1.0 / TARGET_FPS, SDL_GL_GetSwapInterval() != 0);
+	OS_InitRender(context);
+
+	r64 lastUpdate = WallSeconds() - 1.0 / TARGET_FPS;
 	g.gameRunning  = true;
 
 	bool showDemoWindow = false;
@@ -978,7 +1422,7 @@ int main(int argc, const char *argv[])
 	{
 		Input newInput = {};
 
-		OS_LoadGameDll();
+		OS_UpdateGameDll();
 
 		Controller *      kbdController = &newInput.controllers[KBD];
 		const Controller *oldController = &g.inputState.controllers[KBD];
@@ -1000,9 +1444,15 @@ int main(int argc, const char *argv[])
 				HandleMiscEvent(&event, &newInput);
 		}
 
-		g.inputState = newInput;
+		// Real elapsed time; the game steps its simulation in fixed SIM_DT slices out of it. Set before recording
+		// so playback replays the same steps.
+		const r64 updateTime      = WallSeconds();
+		const r64 maxElapsed      = MAX_SIM_STEPS_PER_FRAME * SIM_DT;
+		const r64 sinceLastUpdate = updateTime - lastUpdate;
+		newInput.dT               = (Time_t)(sinceLastUpdate < maxElapsed ? sinceLastUpdate : maxElapsed);
+		lastUpdate                = updateTime;
 
-		OS_UpdateSound();
+		g.inputState = newInput;
 
 		if (g.recordingChannel > 0)
 			RecordInput(&g.inputState);
@@ -1010,9 +1460,6 @@ int main(int argc, const char *argv[])
 		if (g.playbackChannel > 0)
 			PlaybackInput(&g.inputState);
 
-		const r64 secondsPerFrame = 1.0 / TARGET_FPS;
-		g.inputState.dT           = (Time_t)secondsPerFrame;
-
 		UpdateImGui(&g.inputState);
 
 		Hwi* hwi = g.game->GetHwi();
@@ -1020,41 +1467,28 @@ int main(int argc, const char *argv[])
 
 		if (g.showDemoWin)
 			ImGui::ShowDemoWindow(&showDemoWindow);
+		if (g.showPacingWin)
+			ShowFramePacing();
 
+		// Reads that finished while the last frame ran hand their data over before this one
+		Io_Update();
 		g.game->UpdateAndRender(&g.thread, &g.inputState, &g.frameBuffer);
 
-		volatile r64 frameElapsed    = WallSeconds() - frameStart;
-		u32          maxSoundSleepMS = QI_SOUND_REQUESTED_LATENCY_MS / NUM_AUDIO_BUFFERS;
-
-		if (frameElapsed < secondsPerFrame)
-		{
-			u32 msToSleep = (u32)(1000.0 * (secondsPerFrame - frameElapsed));
-			while (msToSleep > maxSoundSleepMS)
-			{
-				OS_UpdateSound();
-				SDL_Delay(maxSoundSleepMS);
-				msToSleep -= maxSoundSleepMS;
-			}
-
-			if (msToSleep > 0)
-				SDL_Delay(msToSleep);
-
-			while (frameElapsed < secondsPerFrame)
-			{
-				OS_UpdateSound();
-				frameElapsed = WallSeconds() - frameStart;
-			}
-		}
-		else
-		{
-			// TODO: Log missed frame
-		}
-
-		frameStart = WallSeconds();
+		// The render thread draws this frame while the next is recorded. The one before it is swapped first.
 		hwi->EndFrame();
-		SDL_GL_SwapWindow(window);
+		Fp_WaitForFrame();
+		if (OS_SwapRendered())
+			Fp_Presented();
+		OS_PostRender(RENDER_FRAME);
 	}
 
+	OS_ShutdownRender();
+	Fw_Shutdown();
+	OS_ShutdownSound();
+	OS_ShutdownGameDll();
+	Io_Shutdown();
+	Jobs_Shutdown();
+
 	SDL_GL_DeleteContext(context);
 	SDL_DestroyWindow(window);
 	SDL_Quit();
@@ -1070,5 +1504,18 @@ static PlatFuncs_s s_plat = {
 	OS_WallSeconds,
 	OS_SetupMainExeLibraries,
 	OS_GetGuiContext,
+	Jobs_ParallelFor,
+	Jobs_NumThreads,
+	Jobs_RunAsync,
+	Jobs_WaitAsync,
+	OS_MapFile,
+	OS_UnmapFile,
+	Io_Read,
+	Io_Poll,
+	Io_Wait,
+	Io_FileSize,
+	Fw_Watch,
+	Fw_NextChange,
+	OS_SyncRender,
 };
 const PlatFuncs_s *plat = &s_plat;
@@ -290,6 +290,12 @@ static inline void VNormalize(v2 *inOut)
 	VNormalizeInto(inOut, inOut);
 }
 
+// Z of the 3D cross product, positive when b is counter clockwise from a
+static inline r32 VCross(const v2 &a, const v2 &b)
+{
+	return a.x * b.y - a.y * b.x;
+}
+
 // This gives a vector perpendicular to ac that points in the direction of b
 static inline v2 VTriple(const v2 &a, const v2 &b, const v2 &c)
 {
@@ -453,6 +453,7 @@ BA_InitBuffer(u8* buffer, const size_t size, const size_t smallestBlockSize)
 	BA_DumpInfo(allocator);
 #endif
 
+	const size_t metadataBytes = overheadBytes;
 	overheadBytes = (overheadBytes + smallestBlock - 1) & ~(smallestBlock - 1);
 	Assert((overheadBytes % smallestBlock) == 0);
 	const size_t overheadBlocks = overheadBytes / smallestBlock;
@@ -463,8 +464,9 @@ BA_InitBuffer(u8* buffer, const size_t size, const size_t smallestBlockSize)
 	for (size_t i = 0; i < overheadBlocks - 1; i++)
 		BA_Alloc(allocator, smallestBlock);
 
-	// Copy allocator and initialized bit sets into its final location at the beginning of the actual memory arena
-	memcpy(firstBlock, allocator, overheadBytes);
+	// Copy allocator and initialized bit sets into its final location at the beginning of the actual memory arena. Only
+	// the metadata itself, the temp copy ends at the end of the buffer.
+	memcpy(firstBlock, allocator, metadataBytes);
 
 	return allocator;
 }
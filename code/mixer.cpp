@@ -0,0 +1,651 @@
+//
+// Copyright 2017, Quantum Immortality Software and Jon Davis
+//
+// Software audio mixer. Each block, every voice resamples its source into stereo floats, which are added into the
+// accumulator with the voice's gains ramping from where the last block left them. Converting samples in and out and
+// the accumulate run as wide as the build allows (SSE2 or NEON) with scalar tails; the resampling is scalar, it has
+// to gather.
+//
+
+#include "basictypes.h"
+
+#include "mixer.h"
+#include "debug.h"
+#include "math_util.h"
+#include "util.h"
+
+#include <math.h>
+#include <string.h>
+#include <new>
+
+#if HAS(SSE2_SIMD)
+#include <emmintrin.h>
+#endif
+
+#if HAS(NEON_SIMD)
+#include <arm_neon.h>
+#endif
+
+#define MIX_ONE_FRAME ((u64)1 << 32)
+#define MIX_MAX_PITCH 8.0f
+
+//
+// Game side
+//
+
+static bool Mix_Push(Mixer_s *mixer, const MixCommand_s *command)
+{
+	const u32 head = mixer->commandHead.load(std::memory_order_relaxed);
+	if (head - mixer->commandTail.load(std::memory_order_acquire) == MIX_MAX_COMMANDS)
+	{
+		mixer->droppedCommands++;
+		return false;
+	}
+
+	mixer->commands[head & (MIX_MAX_COMMANDS - 1)] = *command;
+	mixer->commandHead.store(head + 1, std::memory_order_release);
+	return true;
+}
+
+static MixVoice_t Mix_NextVoice(Mixer_s *mixer)
+{
+	if (++mixer->lastVoice == 0)
+		mixer->lastVoice = 1;
+	return mixer->lastVoice;
+}
+
+MixVoice_t Mix_Play(Mixer_s *mixer, const MixClip_s *clip, const MixParams_s *params, bool loop)
+{
+	Assert(clip && clip->samples && clip->numFrames > 0 && clip->samplesPerSec > 0);
+	Assert(clip->channels == 1 || clip->channels == 2);
+
+	MixCommand_s command = {};
+	command.type         = MIX_CMD_PLAY;
+	command.voice        = Mix_NextVoice(mixer);
+	command.params       = *params;
+	command.clip         = *clip;
+	command.loop         = loop;
+	return Mix_Push(mixer, &command) ? command.voice : 0;
+}
+
+MixVoice_t Mix_PlayStream(Mixer_s *mixer, MixStream_s *stream, const MixParams_s *params)
+{
+	Assert(stream && stream->samples);
+
+	stream->done.store(false, std::memory_order_relaxed);
+
+	MixCommand_s command       = {};
+	command.type               = MIX_CMD_PLAY_STREAM;
+	command.voice              = Mix_NextVoice(mixer);
+	command.params             = *params;
+	command.clip.channels      = stream->channels;
+	command.clip.samplesPerSec = stream->samplesPerSec;
+	command.stream             = stream;
+	if (Mix_Push(mixer, &command))
+		return command.voice;
+
+	stream->done.store(true, std::memory_order_relaxed);
+	return 0;
+}
+
+void Mix_Stop(Mixer_s *mixer, MixVoice_t voice)
+{
+	MixCommand_s command = {};
+	command.type         = MIX_CMD_STOP;
+	command.voice        = voice;
+	Mix_Push(mixer, &command);
+}
+
+void Mix_SetParams(Mixer_s *mixer, MixVoice_t voice, const MixParams_s *params)
+{
+	MixCommand_s command = {};
+	command.type         = MIX_CMD_SET_PARAMS;
+	command.voice        = voice;
+	command.params       = *params;
+	Mix_Push(mixer, &command);
+}
+
+void Mix_StopAll(Mixer_s *mixer)
+{
+	MixCommand_s command = {};
+	command.type         = MIX_CMD_STOP_ALL;
+	Mix_Push(mixer, &command);
+}
+
+//
+// Streams
+//
+
+void Mix_InitStream(MixStream_s *stream, i16 *samples, u32 capacity, u32 channels, u32 samplesPerSec)
+{
+	Assert(samples && capacity > 0 && (capacity & (capacity - 1)) == 0);
+	Assert((channels == 1 || channels == 2) && samplesPerSec > 0);
+
+	stream->samples       = samples;
+	stream->capacity      = capacity;
+	stream->channels      = channels;
+	stream->samplesPerSec = samplesPerSec;
+	stream->writeFrame.store(0, std::memory_order_relaxed);
+	stream->readFrame.store(0, std::memory_order_relaxed);
+	stream->ended.store(false, std::memory_order_relaxed);
+	stream->done.store(true, std::memory_order_relaxed);
+	stream->underruns.store(0, std::memory_order_relaxed);
+}
+
+u32 Mix_StreamSpace(const MixStream_s *stream)
+{
+	return stream->capacity - (stream->writeFrame.load(std::memory_order_relaxed) - stream->readFrame.load(std::memory_order_acquire));
+}
+
+u32 Mix_StreamWrite(MixStream_s *stream, const i16 *samples, u32 numFrames)
+{
+	Assert(!stream->ended.load(std::memory_order_relaxed));
+
+	const u32 write = stream->writeFrame.load(std::memory_order_relaxed);
+	numFrames       = Min(numFrames, Mix_StreamSpace(stream));
+
+	// In up to two goes, around the end of the ring
+	const u32 at    = write & (stream->capacity - 1);
+	const u32 first = Min(numFrames, stream->capacity - at);
+	memcpy(stream->samples + at * stream->channels, samples, first * stream->channels * sizeof(i16));
+	memcpy(stream->samples, samples + first * stream->channels, (numFrames - first) * stream->channels * sizeof(i16));
+
+	stream->writeFrame.store(write + numFrames, std::memory_order_release);
+	return numFrames;
+}
+
+void Mix_EndStream(MixStream_s *stream)
+{
+	stream->ended.store(true, std::memory_order_release);
+}
+
+bool Mix_StreamDone(const MixStream_s *stream)
+{
+	return stream->done.load(std::memory_order_acquire);
+}
+
+//
+// Kernels
+//
+
+// i16 to stereo floats, mono going to both sides
+static void Mix_ConvertFrames(r32 *dst, const i16 *src, u32 numFrames, u32 channels)
+{
+	const u32 numSamples = numFrames * channels;
+	const r32 scale      = 1.0f / 32768.0f;
+	u32       si         = 0;
+
+#if HAS(SSE2_SIMD)
+	const __m128 vscale = _mm_set1_ps(scale);
+	for (; si + 8 <= numSamples; si += 8)
+	{
+		const __m128i s  = _mm_loadu_si128((const __m128i *)(src + si));
+		const __m128  lo = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16)), vscale);
+		const __m128  hi = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16)), vscale);
+		if (channels == 2)
+		{
+			_mm_storeu_ps(dst + si, lo);
+			_mm_storeu_ps(dst + si + 4, hi);
+		}
+		else
+		{
+			_mm_storeu_ps(dst + si * 2, _mm_unpacklo_ps(lo, lo));
+			_mm_storeu_ps(dst + si * 2 + 4, _mm_unpackhi_ps(lo, lo));
+			_mm_storeu_ps(dst + si * 2 + 8, _mm_unpacklo_ps(hi, hi));
+			_mm_storeu_ps(dst + si * 2 + 12, _mm_unpackhi_ps(hi, hi));
+		}
+	}
+#elif HAS(NEON_SIMD)
+	for (; si + 8 <= numSamples; si += 8)
+	{
+		const int16x8_t   s  = vld1q_s16(src + si);
+		const float32x4_t lo = vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(s))), scale);
+		const float32x4_t hi = vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(s))), scale);
+		if (channels == 2)
+		{
+			vst1q_f32(dst + si, lo);
+			vst1q_f32(dst + si + 4, hi);
+		}
+		else
+		{
+			const float32x4x2_t zlo = vzipq_f32(lo, lo);
+			const float32x4x2_t zhi = vzipq_f32(hi, hi);
+			vst1q_f32(dst + si * 2, zlo.val[0]);
+			vst1q_f32(dst + si * 2 + 4, zlo.val[1]);
+			vst1q_f32(dst + si * 2 + 8, zhi.val[0]);
+			vst1q_f32(dst + si * 2 + 12, zhi.val[1]);
+		}
+	}
+#endif
+
+	if (channels == 2)
+	{
+		for (; si < numSamples; si++)
+			dst[si] = src[si] * scale;
+	}
+	else
+	{
+		for (; si < numSamples; si++)
+			dst[si * 2] = dst[si * 2 + 1] = src[si] * scale;
+	}
+}
+
+// accum += samples * gains, the gains stepping by stepL and stepR each frame
+static void Mix_Accumulate(r32 *accum, const r32 *samples, u32 numFrames, r32 gainL, r32 gainR, r32 stepL, r32 stepR)
+{
+	u32 fi = 0;
+
+#if HAS(SSE2_SIMD)
+	__m128       gains = _mm_setr_ps(gainL, gainR, gainL + stepL, gainR + stepR);
+	const __m128 steps = _mm_setr_ps(stepL * 2.0f, stepR * 2.0f, stepL * 2.0f, stepR * 2.0f);
+	for (; fi + 2 <= numFrames; fi += 2)
+	{
+		const __m128 sum = _mm_add_ps(_mm_load_ps(accum + fi * 2), _mm_mul_ps(_mm_load_ps(samples + fi * 2), gains));
+		_mm_store_ps(accum + fi * 2, sum);
+		gains = _mm_add_ps(gains, steps);
+	}
+#elif HAS(NEON_SIMD)
+	const r32   start[4] = {gainL, gainR, gainL + stepL, gainR + stepR};
+	const r32   step[4]  = {stepL * 2.0f, stepR * 2.0f, stepL * 2.0f, stepR * 2.0f};
+	float32x4_t gains    = vld1q_f32(start);
+	const float32x4_t steps = vld1q_f32(step);
+	for (; fi + 2 <= numFrames; fi += 2)
+	{
+		vst1q_f32(accum + fi * 2, vmlaq_f32(vld1q_f32(accum + fi * 2), vld1q_f32(samples + fi * 2), gains));
+		gains = vaddq_f32(gains, steps);
+	}
+#endif
+
+	for (; fi < numFrames; fi++)
+	{
+		accum[fi * 2] += samples[fi * 2] * (gainL + stepL * fi);
+		accum[fi * 2 + 1] += samples[fi * 2 + 1] * (gainR + stepR * fi);
+	}
+}
+
+void Mix_ConvertOut(i16 *out, const r32 *accum, u32 numSamples)
+{
+	u32 si = 0;
+
+#if HAS(SSE2_SIMD)
+	const __m128 scale = _mm_set1_ps(32767.0f);
+	const __m128 lo    = _mm_set1_ps(-1.0f);
+	const __m128 hi    = _mm_set1_ps(1.0f);
+	for (; si + 8 <= numSamples; si += 8)
+	{
+		const __m128  a  = _mm_min_ps(_mm_max_ps(_mm_load_ps(accum + si), lo), hi);
+		const __m128  b  = _mm_min_ps(_mm_max_ps(_mm_load_ps(accum + si + 4), lo), hi);
+		const __m128i ia = _mm_cvtps_epi32(_mm_mul_ps(a, scale));
+		const __m128i ib = _mm_cvtps_epi32(_mm_mul_ps(b, scale));
+		_mm_storeu_si128((__m128i *)(out + si), _mm_packs_epi32(ia, ib));
+	}
+#elif HAS(NEON_SIMD)
+	const float32x4_t lo = vdupq_n_f32(-1.0f);
+	const float32x4_t hi = vdupq_n_f32(1.0f);
+	for (; si + 8 <= numSamples; si += 8)
+	{
+		const float32x4_t a = vmulq_n_f32(vminq_f32(vmaxq_f32(vld1q_f32(accum + si), lo), hi), 32767.0f);
+		const float32x4_t b = vmulq_n_f32(vminq_f32(vmaxq_f32(vld1q_f32(accum + si + 4), lo), hi), 32767.0f);
+#if defined(__aarch64__)
+		const int32x4_t ia = vcvtnq_s32_f32(a);
+		const int32x4_t ib = vcvtnq_s32_f32(b);
+#else
+		// No round to nearest convert before ARMv8, vcvtq truncates: push away from zero by a half first. Exact
+		// halves round away rather than to even, one off from lrintf.
+		const float32x4_t half = vdupq_n_f32(0.5f);
+		const int32x4_t   ia   = vcvtq_s32_f32(vaddq_f32(a, vbslq_f32(vcltq_f32(a, vdupq_n_f32(0.0f)), vnegq_f32(half), half)));
+		const int32x4_t   ib   = vcvtq_s32_f32(vaddq_f32(b, vbslq_f32(vcltq_f32(b, vdupq_n_f32(0.0f)), vnegq_f32(half), half)));
+#endif
+		vst1q_s16(out + si, vcombine_s16(vqmovn_s32(ia), vqmovn_s32(ib)));
+	}
+#endif
+
+	for (; si < numSamples; si++)
+		out[si] = (i16)lrintf(Min(Max(accum[si], -1.0f), 1.0f) * 32767.0f);
+}
+
+//
+// Voices
+//
+
+static void Mix_PanGains(const MixParams_s *params, u32 channels, r32 *gainL, r32 *gainR)
+{
+	const r32 pan = Min(Max(params->pan, -1.0f), 1.0f);
+	if (channels == 1)
+	{
+		const r32 angle = (pan + 1.0f) * (Q_PI / 4.0f);
+		*gainL          = params->gain * cosf(angle);
+		*gainR          = params->gain * sinf(angle);
+	}
+	else
+	{
+		*gainL = params->gain * (pan > 0.0f ? 1.0f - pan : 1.0f);
+		*gainR = params->gain * (pan < 0.0f ? 1.0f + pan : 1.0f);
+	}
+}
+
+// Source frames per output frame, 32.32
+static u64 Mix_Step(const Mixer_s *mixer, const MixVoiceState_s *voice)
+{
+	const r64 pitch = Min(Max(voice->params.pitch, 0.0f), MIX_MAX_PITCH);
+	return (u64)(pitch * voice->clip.samplesPerSec / mixer->samplesPerSec * (r64)MIX_ONE_FRAME);
+}
+
+template <u32 kChannels>
+static inline void Mix_Lerp(r32 *dst, const i16 *s0, const i16 *s1, u64 pos)
+{
+	const r32 frac = (r32)(u32)pos * (1.0f / 4294967296.0f);
+	const r32 l0 = s0[0], l1 = s1[0];
+	dst[0]       = (l0 + (l1 - l0) * frac) * (1.0f / 32768.0f);
+	if (kChannels == 2)
+	{
+		const r32 r0 = s0[1], r1 = s1[1];
+		dst[1]       = (r0 + (r1 - r0) * frac) * (1.0f / 32768.0f);
+	}
+	else
+	{
+		dst[1] = dst[0];
+	}
+}
+
+// Frames of the clip into dst, stopping early only at the end of a clip that doesn't loop
+template <u32 kChannels>
+static u32 Mix_FetchClip(MixVoiceState_s *voice, r32 *dst, u32 numFrames, u64 step)
+{
+	const MixClip_s *clip = &voice->clip;
+	const u64        end  = (u64)clip->numFrames << 32;
+
+	u32 fi = 0;
+	while (fi < numFrames)
+	{
+		if (voice->pos >= end)
+		{
+			if (!voice->loop)
+				break;
+			voice->pos %= end;
+		}
+
+		u32 idx = (u32)(voice->pos >> 32);
+		if (step == MIX_ONE_FRAME && (u32)voice->pos == 0)
+		{
+			// At the source rate on a whole frame there's nothing to interpolate
+			const u32 run = Min(numFrames - fi, clip->numFrames - idx);
+			Mix_ConvertFrames(dst + fi * 2, clip->samples + idx * kChannels, run, kChannels);
+			voice->pos += (u64)run << 32;
+			fi += run;
+			continue;
+		}
+
+		// Up to the last frame, whose next one wraps or repeats
+		for (; fi < numFrames && idx + 1 < clip->numFrames; idx = (u32)(voice->pos >> 32))
+		{
+			const i16 *s0 = clip->samples + idx * kChannels;
+			Mix_Lerp<kChannels>(dst + fi * 2, s0, s0 + kChannels, voice->pos);
+			voice->pos += step;
+			fi++;
+		}
+		if (fi < numFrames && voice->pos < end)
+		{
+			const i16 *s0 = clip->samples + idx * kChannels;
+			Mix_Lerp<kChannels>(dst + fi * 2, s0, voice->loop ? clip->samples : s0, voice->pos);
+			voice->pos += step;
+			fi++;
+		}
+	}
+	return fi;
+}
+
+// Frames from what the game has written so far. Interpolating needs the frame after as well, unless the stream has
+// ended and there's no more to come.
+template <u32 kChannels>
+static u32 Mix_FetchStream(MixVoiceState_s *voice, r32 *dst, u32 numFrames, u64 step, bool *ended)
+{
+	MixStream_s *stream = voice->stream;
+	const u32    mask   = stream->capacity - 1;
+	const u32    read   = stream->readFrame.load(std::memory_order_relaxed);
+	// Ended first, a stream seen ended has all its frames written
+	*ended              = stream->ended.load(std::memory_order_acquire);
+	const u32 available = stream->writeFrame.load(std::memory_order_acquire) - read;
+	const u32 usable    = *ended ? available : (available > 0 ? available - 1 : 0);
+	const u64 end       = (u64)usable << 32;
+
+	u32 fi = 0;
+	for (; fi < numFrames && voice->pos < end; fi++)
+	{
+		const u32  idx = (u32)(voice->pos >> 32);
+		const i16 *s0  = stream->samples + ((read + idx) & mask) * kChannels;
+		const i16 *s1  = idx + 1 < available ? stream->samples + ((read + idx + 1) & mask) * kChannels : s0;
+		Mix_Lerp<kChannels>(dst + fi * 2, s0, s1, voice->pos);
+		voice->pos += step;
+	}
+
+	const u32 consumed = Min((u32)(voice->pos >> 32), available);
+	voice->pos -= (u64)consumed << 32;
+	stream->readFrame.store(read + consumed, std::memory_order_release);
+	return fi;
+}
+
+static void Mix_FreeVoice(MixVoiceState_s *voice)
+{
+	if (voice->stream)
+		voice->stream->done.store(true, std::memory_order_release);
+	memset(voice, 0, sizeof(*voice));
+}
+
+// A free voice, or the quietest one cut off to make room
+static MixVoiceState_s *Mix_AllocVoice(Mixer_s *mixer)
+{
+	MixVoiceState_s *quietest = &mixer->voices[0];
+	for (u32 vi = 0; vi < MIX_MAX_VOICES; vi++)
+	{
+		MixVoiceState_s *voice = &mixer->voices[vi];
+		if (voice->id == 0)
+			return voice;
+		if (voice->params.gain < quietest->params.gain)
+			quietest = voice;
+	}
+
+	Mix_FreeVoice(quietest);
+	mixer->stolenVoices++;
+	return quietest;
+}
+
+static MixVoiceState_s *Mix_FindVoice(Mixer_s *mixer, MixVoice_t id)
+{
+	for (u32 vi = 0; vi < MIX_MAX_VOICES; vi++)
+		if (mixer->voices[vi].id == id)
+			return &mixer->voices[vi];
+	return nullptr;
+}
+
+static void Mix_RunCommands(Mixer_s *mixer)
+{
+	const u32 head = mixer->commandHead.load(std::memory_order_acquire);
+	u32       tail = mixer->commandTail.load(std::memory_order_relaxed);
+	for (; tail != head; tail++)
+	{
+		const MixCommand_s *command = &mixer->commands[tail & (MIX_MAX_COMMANDS - 1)];
+		MixVoiceState_s *   voice   = command->voice != 0 ? Mix_FindVoice(mixer, command->voice) : nullptr;
+		switch (command->type)
+		{
+		case MIX_CMD_PLAY:
+		case MIX_CMD_PLAY_STREAM:
+			Assert(voice == nullptr);
+			voice         = Mix_AllocVoice(mixer);
+			voice->id     = command->voice;
+			voice->clip   = command->clip;
+			voice->stream = command->stream;
+			voice->loop   = command->loop;
+			voice->params = command->params;
+			voice->pos    = 0;
+			Mix_PanGains(&voice->params, voice->clip.channels, &voice->gainL, &voice->gainR);
+			break;
+
+		case MIX_CMD_STOP:
+			if (voice)
+				Mix_FreeVoice(voice);
+			break;
+
+		case MIX_CMD_SET_PARAMS:
+			if (voice)
+				voice->params = command->params;
+			break;
+
+		case MIX_CMD_STOP_ALL:
+			for (u32 vi = 0; vi < MIX_MAX_VOICES; vi++)
+				if (mixer->voices[vi].id != 0)
+					Mix_FreeVoice(&mixer->voices[vi]);
+			break;
+		}
+	}
+	mixer->commandTail.store(tail, std::memory_order_release);
+}
+
+// Adds a block of the voice into the accumulator, false once it has finished
+static bool Mix_RenderVoice(Mixer_s *mixer, MixVoiceState_s *voice, u32 numFrames)
+{
+	const u64 step    = Mix_Step(mixer, voice);
+	r32 *     samples = mixer->voiceSamples;
+	bool      playing = true;
+	u32       fetched;
+	if (voice->stream)
+	{
+		bool ended;
+		fetched = voice->clip.channels == 2 ? Mix_FetchStream<2>(voice, samples, numFrames, step, &ended)
+		                                    : Mix_FetchStream<1>(voice, samples, numFrames, step, &ended);
+		if (fetched < numFrames)
+		{
+			if (ended)
+				playing = false;
+			else
+				voice->stream->underruns.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+	else
+	{
+		fetched = voice->clip.channels == 2 ? Mix_FetchClip<2>(voice, samples, numFrames, step)
+		                                    : Mix_FetchClip<1>(voice, samples, numFrames, step);
+		playing = fetched == numFrames;
+	}
+	memset(samples + fetched * 2, 0, (numFrames - fetched) * 2 * sizeof(r32));
+
+	r32 gainL, gainR;
+	Mix_PanGains(&voice->params, voice->clip.channels, &gainL, &gainR);
+	if (gainL != 0.0f || gainR != 0.0f || voice->gainL != 0.0f || voice->gainR != 0.0f)
+	{
+		const r32 perFrame = 1.0f / numFrames;
+		Mix_Accumulate(mixer->accum, samples, numFrames, voice->gainL, voice->gainR, (gainL - voice->gainL) * perFrame,
+		               (gainR - voice->gainR) * perFrame);
+	}
+	voice->gainL = gainL;
+	voice->gainR = gainR;
+	return playing;
+}
+
+//
+// Output side
+//
+
+void Mix_Init(Mixer_s *mixer, u32 samplesPerSec)
+{
+	Assert(samplesPerSec > 0);
+	// The atomics rule out a memset, value initialize and then set them explicitly
+	new (mixer) Mixer_s();
+	mixer->commandHead.store(0, std::memory_order_relaxed);
+	mixer->commandTail.store(0, std::memory_order_relaxed);
+	mixer->numPlaying.store(0, std::memory_order_relaxed);
+	mixer->samplesPerSec = samplesPerSec;
+}
+
+void Mix_ResetCommands(Mixer_s *mixer)
+{
+	mixer->commandHead.store(0, std::memory_order_relaxed);
+	mixer->commandTail.store(0, std::memory_order_relaxed);
+}
+
+void Mix_Render(Mixer_s *mixer, i16 *out, u32 numFrames)
+{
+	Mix_RunCommands(mixer);
+
+	u32 numPlaying = 0;
+	while (numFrames > 0)
+	{
+		const u32 blockFrames = Min(numFrames, (u32)MIX_BLOCK_FRAMES);
+		memset(mixer->accum, 0, blockFrames * 2 * sizeof(r32));
+
+		numPlaying = 0;
+		for (u32 vi = 0; vi < MIX_MAX_VOICES; vi++)
+		{
+			MixVoiceState_s *voice = &mixer->voices[vi];
+			if (voice->id == 0)
+				continue;
+			if (Mix_RenderVoice(mixer, voice, blockFrames))
+				numPlaying++;
+			else
+				Mix_FreeVoice(voice);
+		}
+
+		Mix_ConvertOut(out, mixer->accum, blockFrames * 2);
+		out += blockFrames * 2;
+		numFrames -= blockFrames;
+	}
+	mixer->numPlaying.store(numPlaying, std::memory_order_relaxed);
+}
+
+//
+// WAV files
+//
+
+static u32 Mix_ReadU32(const u8 *bytes)
+{
+	u32 value;
+	memcpy(&value, bytes, sizeof(value));
+	return value;
+}
+
+static u16 Mix_ReadU16(const u8 *bytes)
+{
+	u16 value;
+	memcpy(&value, bytes, sizeof(value));
+	return value;
+}
+
+bool Mix_ParseWav(MixClip_s *clip, const void *data, size_t size)
+{
+	const u8 *bytes = (const u8 *)data;
+	if (size < 12 || memcmp(bytes, "RIFF", 4) != 0 || memcmp(bytes + 8, "WAVE", 4) != 0)
+		return false;
+
+	u32 format = 0, channels = 0, samplesPerSec = 0, bitsPerSample = 0;
+	for (size_t at = 12; at + 8 <= size;)
+	{
+		const u8 *chunk     = bytes + at;
+		const u32 chunkSize = (u32)Min((size_t)Mix_ReadU32(chunk + 4), size - at - 8);
+		if (memcmp(chunk, "fmt ", 4) == 0 && chunkSize >= 16)
+		{
+			format        = Mix_ReadU16(chunk + 8);
+			channels      = Mix_ReadU16(chunk + 10);
+			samplesPerSec = Mix_ReadU32(chunk + 12);
+			bitsPerSample = Mix_ReadU16(chunk + 22);
+			// WAVE_FORMAT_EXTENSIBLE, the sub format GUID starts with the format it really is
+			if (format == 0xFFFE && chunkSize >= 40)
+				format = Mix_ReadU16(chunk + 32);
+		}
+		else if (memcmp(chunk, "data", 4) == 0)
+		{
+			// Plain PCM only, and the samples have to be aligned to be read in place
+			if (format != 1 || bitsPerSample != 16 || (channels != 1 && channels != 2) || samplesPerSec == 0)
+				return false;
+			if (((uintptr_t)(chunk + 8) & (sizeof(i16) - 1)) != 0)
+				return false;
+
+			clip->samples       = (const i16 *)(chunk + 8);
+			clip->numFrames     = chunkSize / (channels * sizeof(i16));
+			clip->channels      = channels;
+			clip->samplesPerSec = samplesPerSec;
+			return clip->numFrames > 0;
+		}
+		at += 8 + chunkSize + (chunkSize & 1);
+	}
+	return false;
+}
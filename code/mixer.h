@@ -0,0 +1,140 @@
+#ifndef __QI_MIXER_H
+
+//
+// Copyright 2017, Quantum Immortality Software and Jon Davis
+//
+// Software audio mixer. Voices play clips held in memory or streams fed through a ring buffer, each with its own gain,
+// pan and pitch, summed into a float accumulator that goes out as interleaved stereo i16. Sources are i16, mono or
+// stereo, at any rate: pitch and the rate difference fold into one step through the source, linearly interpolated.
+// Gain and pan changes ramp across a mix block so they don't click.
+//
+// Two sides, each meant for one thread. The game side queues commands through a lock-free single producer, single
+// consumer ring and never touches a voice; the output side runs them at the start of each Mix_Render and owns all the
+// voice state. Mix_Render doesn't allocate or lock, so it can run on whatever thread feeds the output.
+//
+
+#include "basictypes.h"
+
+#include <atomic>
+
+#define MIX_MAX_VOICES   64
+#define MIX_MAX_COMMANDS 256 // Power of 2
+#define MIX_BLOCK_FRAMES 256 // Frames mixed at a time, and the length of a gain ramp
+
+typedef u32 MixVoice_t; // 0 is never a voice
+
+struct MixParams_s
+{
+	r32 gain;  // Linear, 1 plays the source as it is
+	r32 pan;   // -1 left to 1 right. Mono sources pan at constant power, stereo ones balance.
+	r32 pitch; // Playback rate, 1 is the source's own
+};
+
+// PCM in memory, interleaved. The samples have to outlive every voice playing them.
+struct MixClip_s
+{
+	const i16 *samples;
+	u32        numFrames;
+	u32        channels; // 1 or 2
+	u32        samplesPerSec;
+};
+
+// For sources too long to hold decoded: the game decodes into the ring a little at a time and one voice plays it
+// from the other end. The game keeps the stream and its samples alive until Mix_StreamDone.
+struct MixStream_s
+{
+	i16 *samples;  // capacity frames of channels each
+	u32  capacity; // Frames, a power of 2
+	u32  channels;
+	u32  samplesPerSec;
+
+	std::atomic<u32>  writeFrame; // Free running, the game's
+	std::atomic<u32>  readFrame;  // Free running, the mixer's
+	std::atomic<bool> ended;      // No more to come, the voice stops once it has played what's there
+	std::atomic<bool> done;       // The voice let go of it
+	std::atomic<u32>  underruns;  // Blocks the voice ran dry before the end
+};
+
+enum MixCommandType_e
+{
+	MIX_CMD_PLAY,
+	MIX_CMD_PLAY_STREAM,
+	MIX_CMD_STOP,
+	MIX_CMD_SET_PARAMS,
+	MIX_CMD_STOP_ALL,
+};
+
+struct MixCommand_s
+{
+	MixCommandType_e type;
+	MixVoice_t       voice;
+	MixParams_s      params;
+	MixClip_s        clip;
+	MixStream_s *    stream;
+	bool             loop;
+};
+
+// Output side only
+struct MixVoiceState_s
+{
+	MixVoice_t   id; // 0 when free
+	MixClip_s    clip;
+	MixStream_s *stream;
+	bool         loop;
+	MixParams_s  params;
+	u64          pos;          // 32.32 frames into the clip, streams keep only the fraction past readFrame
+	r32          gainL, gainR; // Where the last ramp ended
+};
+
+struct Mixer_s
+{
+	// Game side
+	MixCommand_s     commands[MIX_MAX_COMMANDS];
+	std::atomic<u32> commandHead; // Free running, next for the game to fill
+	std::atomic<u32> commandTail; // Free running, next for the mixer to run
+	MixVoice_t       lastVoice;
+	u32              droppedCommands; // Queued with the ring full
+
+	// Output side
+	u32              samplesPerSec;
+	MixVoiceState_s  voices[MIX_MAX_VOICES];
+	std::atomic<u32> numPlaying; // For the game to show, it isn't exact by the time it's read
+	u32              stolenVoices;
+
+	alignas(16) r32 accum[MIX_BLOCK_FRAMES * 2];
+	alignas(16) r32 voiceSamples[MIX_BLOCK_FRAMES * 2];
+};
+
+void Mix_Init(Mixer_s *mixer, u32 samplesPerSec);
+
+// Empties the command ring, for when the mixer's memory has been put back from a snapshot. Neither side can be
+// running: the commands in there were queued against a game that has just been rewound.
+void Mix_ResetCommands(Mixer_s *mixer);
+
+// Game side. Plays return 0 when the command ring is full; a voice that finishes or is stolen for a newer one just
+// ignores whatever comes for it after.
+MixVoice_t Mix_Play(Mixer_s *mixer, const MixClip_s *clip, const MixParams_s *params, bool loop);
+MixVoice_t Mix_PlayStream(Mixer_s *mixer, MixStream_s *stream, const MixParams_s *params);
+void       Mix_Stop(Mixer_s *mixer, MixVoice_t voice);
+void       Mix_SetParams(Mixer_s *mixer, MixVoice_t voice, const MixParams_s *params);
+void       Mix_StopAll(Mixer_s *mixer);
+
+// Output side: runs the queued commands, then mixes numFrames of interleaved stereo
+void Mix_Render(Mixer_s *mixer, i16 *out, u32 numFrames);
+
+// Accumulated samples to i16, clipped to full scale and rounded to nearest. What Mix_Render goes out through, accum
+// 16 byte aligned.
+void Mix_ConvertOut(i16 *out, const r32 *accum, u32 numSamples);
+
+// Streams, game side
+void Mix_InitStream(MixStream_s *stream, i16 *samples, u32 capacity, u32 channels, u32 samplesPerSec);
+u32  Mix_StreamSpace(const MixStream_s *stream);
+u32  Mix_StreamWrite(MixStream_s *stream, const i16 *samples, u32 numFrames); // Frames that fit
+void Mix_EndStream(MixStream_s *stream);
+bool Mix_StreamDone(const MixStream_s *stream);
+
+// A clip of the samples in a 16 bit PCM WAV file, pointing into its data. false for anything else.
+bool Mix_ParseWav(MixClip_s *clip, const void *data, size_t size);
+
+#define __QI_MIXER_H
+#endif // #ifndef __QI_MIXER_H
@@ -0,0 +1,103 @@
+//
+// Copyright 2017, Quantum Immortality Software and Jon Davis
+//
+
+#include "basictypes.h"
+#include "game.h"
+#include "debug.h"
+#include "pack.h"
+
+#include <stdio.h>
+#include <string.h>
+
+struct PackGlobals_s
+{
+	const u8 *          base; // The mapping outlives a game dylib reload, it belongs to the platform layer
+	size_t              size;
+	const PackEntry_s * entries;
+	const char *        names;
+	u32                 numEntries;
+};
+
+static PackGlobals_s *g_pack = nullptr;
+
+static void Pack_InitSubsystem(const SubSystem *sys, bool isReinit)
+{
+	g_pack = (PackGlobals_s *)sys->globalPtr;
+	if (!isReinit)
+	{
+		memset(g_pack, 0, sys->globalSize);
+		Pack_Open(QI_PACK_FILE_NAME);
+	}
+}
+
+SubSystem PackSubSystem = {"Pack", Pack_InitSubsystem, sizeof(PackGlobals_s), nullptr};
+
+bool Pack_Open(const char *fileName)
+{
+	Assert(g_pack);
+	Pack_Close();
+
+	size_t      size = 0;
+	const void *base = plat->MapFile(nullptr, fileName, &size);
+	if (base == nullptr)
+		return false;
+
+	const PackHeader_s *header = (const PackHeader_s *)base;
+	const bool valid = size >= sizeof(PackHeader_s) && header->magic == QI_PACK_MAGIC && header->version == QI_PACK_VERSION &&
+	                   header->fileSize == size && sizeof(PackHeader_s) + (u64)header->numEntries * sizeof(PackEntry_s) <= size &&
+	                   header->namesOffset < size;
+	if (!valid)
+	{
+		fprintf(stderr, "Ignoring %s, it's damaged or from another version of qi_pack\n", fileName);
+		plat->UnmapFile(nullptr, base, size);
+		return false;
+	}
+
+	g_pack->base       = (const u8 *)base;
+	g_pack->size       = size;
+	g_pack->entries    = (const PackEntry_s *)(header + 1);
+	g_pack->names      = (const char *)base + header->namesOffset;
+	g_pack->numEntries = header->numEntries;
+
+	printf("Opened %s: %u entries\n", fileName, g_pack->numEntries);
+	return true;
+}
+
+void Pack_Close()
+{
+	if (g_pack->base != nullptr)
+		plat->UnmapFile(nullptr, g_pack->base, g_pack->size);
+	g_pack->base       = nullptr;
+	g_pack->size       = 0;
+	g_pack->entries    = nullptr;
+	g_pack->names      = nullptr;
+	g_pack->numEntries = 0;
+}
+
+const PackEntry_s *Pack_Find(const char *name, PackEntryType_e type)
+{
+	if (g_pack == nullptr || g_pack->numEntries == 0)
+		return nullptr;
+
+	// qi_pack sorted the table with strcmp
+	u32 lo = 0, hi = g_pack->numEntries;
+	while (lo < hi)
+	{
+		const u32 mid = (lo + hi) / 2;
+		const int cmp = strcmp(g_pack->names + g_pack->entries[mid].nameOffset, name);
+		if (cmp == 0)
+			return g_pack->entries[mid].type == type ? &g_pack->entries[mid] : nullptr;
+		if (cmp < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return nullptr;
+}
+
+const void *Pack_Data(const PackEntry_s *entry)
+{
+	Assert(entry && entry->offset + entry->size <= g_pack->size);
+	return g_pack->base + entry->offset;
+}
@@ -0,0 +1,59 @@
+#ifndef __QI_PACK_H
+
+//
+// Copyright 2017, Quantum Immortality Software and Jon Davis
+//
+// Asset pack: bitmaps, QED stores and shaders baked by qi_pack into one file that is mapped at startup and read in
+// place. The table of contents is sorted by name, the relative path the loose file had under the data directory, so a
+// lookup is a binary search. Anything not found in the pack is read from the loose file as before.
+//
+
+#include "basictypes.h"
+
+#define QI_PACK_MAGIC     0x4B415051 // "QPAK"
+#define QI_PACK_VERSION   2
+#define QI_PACK_ALIGN     64 // Entry data starts on a cache line
+#define QI_PACK_FILE_NAME "qi.pack"
+
+enum PackEntryType_e : u32
+{
+	PACK_BITMAP,   // The bitmap's pixels ready to upload, in the engine layout or blocks of a compressed format
+	PACK_KEYSTORE, // KS_WriteImage output
+	PACK_SHADER,   // Source text, with a terminating 0 not counted in size
+
+	PACK_TYPE_COUNT
+};
+
+struct PackHeader_s
+{
+	u32 magic;
+	u32 version;
+	u32 numEntries;  // PackEntry_s table follows the header
+	u32 namesOffset; // Entry names, 0 terminated
+	u64 fileSize;
+};
+
+struct PackEntry_s
+{
+	u32 nameOffset; // From the header's namesOffset
+	u32 type;
+	u64 offset; // From the start of the file
+	u64 size;
+	u32 width; // Bitmaps only
+	u32 height;
+	u32 format;  // Bitmap::Format
+	u32 numMips; // Levels following each other in the data, largest first
+};
+
+// Maps the pack, false if it's missing or wasn't made by this version of qi_pack. Done by the subsystem at startup.
+bool Pack_Open(const char *fileName);
+void Pack_Close();
+
+// nullptr when the pack isn't open or doesn't have the name with that type
+const PackEntry_s *Pack_Find(const char *name, PackEntryType_e type);
+
+// Straight into the mapping, good until Pack_Close
+const void *Pack_Data(const PackEntry_s *entry);
+
+#define __QI_PACK_H
+#endif // #ifndef __QI_PACK_H
@@ -0,0 +1,705 @@
+//
+// Copyright 2017, Quantum Immortality Software and Jon Davis
+//
+// Pixel span kernels. Each instruction set only supplies a handful of primitives on a vector of pixels (load, store,
+// per byte multiply and the like) and the blends are written once on top of them. Spans run through the widest set
+// compiled in, then the next, and the last few pixels go through the scalar reference in pixelops.h.
+//
+
+#include "basictypes.h"
+
+#include "pixelops.h"
+#include "debug.h"
+
+#include <string.h>
+
+#if HAS(SSE2_SIMD)
+#include <emmintrin.h>
+#endif
+
+#if HAS(AVX2_SIMD)
+#include <immintrin.h>
+#endif
+
+#if HAS(NEON_SIMD)
+#include <arm_neon.h>
+#endif
+
+#if HAS(SSE2_SIMD)
+struct PxSse2
+{
+	typedef __m128i Vec;
+	enum
+	{
+		kPixels = 4
+	};
+
+	static inline Vec Load(const u32 *p) { return _mm_loadu_si128((const __m128i *)p); }
+	static inline void Store(u32 *p, Vec v) { _mm_storeu_si128((__m128i *)p, v); }
+	static inline Vec Splat(u32 c) { return _mm_set1_epi32((int)c); }
+	static inline Vec Or(Vec a, Vec b) { return _mm_or_si128(a, b); }
+	static inline Vec And(Vec a, Vec b) { return _mm_and_si128(a, b); }
+	static inline Vec Not(Vec a) { return _mm_xor_si128(a, _mm_set1_epi32(-1)); }
+	static inline Vec AddSat(Vec a, Vec b) { return _mm_adds_epu8(a, b); }
+
+	// Each pixel's alpha in all four of its bytes
+	static inline Vec Alpha(Vec p)
+	{
+		const Vec a = _mm_srli_epi32(p, 24);
+		const Vec b = _mm_or_si128(a, _mm_slli_epi32(a, 8));
+		return _mm_or_si128(b, _mm_slli_epi32(b, 16));
+	}
+
+	// 16 bit lanes holding products of two bytes, down to bytes
+	static inline Vec Div255(Vec x)
+	{
+		x = _mm_add_epi16(x, _mm_set1_epi16(128));
+		return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+	}
+
+	static inline Vec Mul(Vec a, Vec b)
+	{
+		const Vec zero = _mm_setzero_si128();
+		const Vec lo   = _mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+		const Vec hi   = _mm_mullo_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+		return _mm_packus_epi16(Div255(lo), Div255(hi));
+	}
+
+	// (a * fa + b * fb) / 255 a byte, where fa + fb is at most 255 so nothing overflows
+	static inline Vec MulAdd(Vec a, Vec fa, Vec b, Vec fb)
+	{
+		const Vec zero = _mm_setzero_si128();
+		const Vec lo   = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(fa, zero)),
+                                     _mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(fb, zero)));
+		const Vec hi   = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(fa, zero)),
+                                     _mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(fb, zero)));
+		return _mm_packus_epi16(Div255(lo), Div255(hi));
+	}
+};
+#endif
+
+#if HAS(AVX2_SIMD)
+// Unpacks and packs work within each 128 bit half, so widening and narrowing back leaves pixels where they were
+struct PxAvx2
+{
+	typedef __m256i Vec;
+	enum
+	{
+		kPixels = 8
+	};
+
+	static inline Vec Load(const u32 *p) { return _mm256_loadu_si256((const __m256i *)p); }
+	static inline void Store(u32 *p, Vec v) { _mm256_storeu_si256((__m256i *)p, v); }
+	static inline Vec Splat(u32 c) { return _mm256_set1_epi32((int)c); }
+	static inline Vec Or(Vec a, Vec b) { return _mm256_or_si256(a, b); }
+	static inline Vec And(Vec a, Vec b) { return _mm256_and_si256(a, b); }
+	static inline Vec Not(Vec a) { return _mm256_xor_si256(a, _mm256_set1_epi32(-1)); }
+	static inline Vec AddSat(Vec a, Vec b) { return _mm256_adds_epu8(a, b); }
+
+	static inline Vec Alpha(Vec p)
+	{
+		const Vec a = _mm256_srli_epi32(p, 24);
+		const Vec b = _mm256_or_si256(a, _mm256_slli_epi32(a, 8));
+		return _mm256_or_si256(b, _mm256_slli_epi32(b, 16));
+	}
+
+	static inline Vec Div255(Vec x)
+	{
+		x = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+		return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+	}
+
+	static inline Vec Mul(Vec a, Vec b)
+	{
+		const Vec zero = _mm256_setzero_si256();
+		const Vec lo   = _mm256_mullo_epi16(_mm256_unpacklo_epi8(a, zero), _mm256_unpacklo_epi8(b, zero));
+		const Vec hi   = _mm256_mullo_epi16(_mm256_unpackhi_epi8(a, zero), _mm256_unpackhi_epi8(b, zero));
+		return _mm256_packus_epi16(Div255(lo), Div255(hi));
+	}
+
+	static inline Vec MulAdd(Vec a, Vec fa, Vec b, Vec fb)
+	{
+		const Vec zero = _mm256_setzero_si256();
+		const Vec lo   = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(a, zero), _mm256_unpacklo_epi8(fa, zero)),
+                                        _mm256_mullo_epi16(_mm256_unpacklo_epi8(b, zero), _mm256_unpacklo_epi8(fb, zero)));
+		const Vec hi   = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(a, zero), _mm256_unpackhi_epi8(fa, zero)),
+                                        _mm256_mullo_epi16(_mm256_unpackhi_epi8(b, zero), _mm256_unpackhi_epi8(fb, zero)));
+		return _mm256_packus_epi16(Div255(lo), Div255(hi));
+	}
+};
+#endif
+
+#if HAS(NEON_SIMD)
+struct PxNeon
+{
+	typedef uint32x4_t Vec;
+	enum
+	{
+		kPixels = 4
+	};
+
+	static inline Vec Load(const u32 *p) { return vld1q_u32(p); }
+	static inline void Store(u32 *p, Vec v) { vst1q_u32(p, v); }
+	static inline Vec Splat(u32 c) { return vdupq_n_u32(c); }
+	static inline Vec Or(Vec a, Vec b) { return vorrq_u32(a, b); }
+	static inline Vec And(Vec a, Vec b) { return vandq_u32(a, b); }
+	static inline Vec Not(Vec a) { return vmvnq_u32(a); }
+	static inline Vec AddSat(Vec a, Vec b) { return vreinterpretq_u32_u8(vqaddq_u8(vreinterpretq_u8_u32(a), vreinterpretq_u8_u32(b))); }
+	static inline Vec Alpha(Vec p) { return vmulq_n_u32(vshrq_n_u32(p, 24), 0x01010101); }
+
+	static inline uint8x8_t Div255(uint16x8_t x)
+	{
+		x = vaddq_u16(x, vdupq_n_u16(128));
+		return vshrn_n_u16(vaddq_u16(x, vshrq_n_u16(x, 8)), 8);
+	}
+
+	static inline Vec Mul(Vec a, Vec b)
+	{
+		const uint8x16_t a8 = vreinterpretq_u8_u32(a);
+		const uint8x16_t b8 = vreinterpretq_u8_u32(b);
+		const uint16x8_t lo = vmull_u8(vget_low_u8(a8), vget_low_u8(b8));
+		const uint16x8_t hi = vmull_u8(vget_high_u8(a8), vget_high_u8(b8));
+		return vreinterpretq_u32_u8(vcombine_u8(Div255(lo), Div255(hi)));
+	}
+
+	static inline Vec MulAdd(Vec a, Vec fa, Vec b, Vec fb)
+	{
+		const uint8x16_t a8  = vreinterpretq_u8_u32(a);
+		const uint8x16_t fa8 = vreinterpretq_u8_u32(fa);
+		const uint8x16_t b8  = vreinterpretq_u8_u32(b);
+		const uint8x16_t fb8 = vreinterpretq_u8_u32(fb);
+		const uint16x8_t lo  = vmlal_u8(vmull_u8(vget_low_u8(a8), vget_low_u8(fa8)), vget_low_u8(b8), vget_low_u8(fb8));
+		const uint16x8_t hi  = vmlal_u8(vmull_u8(vget_high_u8(a8), vget_high_u8(fa8)), vget_high_u8(b8), vget_high_u8(fb8));
+		return vreinterpretq_u32_u8(vcombine_u8(Div255(lo), Div255(hi)));
+	}
+};
+#endif
+
+//
+// Blends, written once over the primitives. Each matches its case in Px_BlendPixel.
+//
+
+struct PxOpCopy
+{
+	static const PxBlend_e kBlend = PX_BLEND_COPY;
+	template <typename V>
+	static inline typename V::Vec Apply(typename V::Vec src, typename V::Vec) { return src; }
+};
+
+struct PxOpOver
+{
+	static const PxBlend_e kBlend = PX_BLEND_OVER;
+	template <typename V>
+	static inline typename V::Vec Apply(typename V::Vec src, typename V::Vec dst)
+	{
+		// Color channels scale by alpha, the alpha channel by one
+		const typename V::Vec a = V::Alpha(src);
+		const typename V::Vec f = V::Or(V::And(a, V::Splat(0x00FFFFFF)), V::Splat(0xFF000000));
+		return V::MulAdd(src, f, dst, V::Not(a));
+	}
+};
+
+struct PxOpOverPremul
+{
+	static const PxBlend_e kBlend = PX_BLEND_OVER_PREMUL;
+	template <typename V>
+	static inline typename V::Vec Apply(typename V::Vec src, typename V::Vec dst)
+	{
+		return V::AddSat(src, V::Mul(dst, V::Not(V::Alpha(src))));
+	}
+};
+
+struct PxOpAddDstAlpha
+{
+	static const PxBlend_e kBlend = PX_BLEND_ADD_DST_ALPHA;
+	template <typename V>
+	static inline typename V::Vec Apply(typename V::Vec src, typename V::Vec dst)
+	{
+		return V::AddSat(src, V::Mul(dst, V::Alpha(dst)));
+	}
+};
+
+// Whole vectors only, returns the pixels done. Solid spans blend color everywhere and src isn't read.
+template <typename V, typename Op, bool kSolid>
+static u32 Px_SpanWide(u32 *dst, const u32 *src, u32 color, u32 count, u32 tint)
+{
+	typedef typename V::Vec Vec;
+
+	const u32  wideCount = count - count % V::kPixels;
+	const bool tinted    = tint != PX_WHITE;
+	const Vec  tintV     = V::Splat(tint);
+	const Vec  solid     = V::Splat(color);
+	for (u32 pi = 0; pi < wideCount; pi += V::kPixels)
+	{
+		Vec s = kSolid ? solid : V::Load(src + pi);
+		if (tinted)
+			s = V::Mul(s, tintV);
+		V::Store(dst + pi, Op::template Apply<V>(s, V::Load(dst + pi)));
+	}
+	return wideCount;
+}
+
+template <typename Op, bool kSolid>
+static void Px_Span(u32 *dst, const u32 *src, u32 color, u32 count, u32 tint)
+{
+	u32 done = 0;
+#if HAS(AVX2_SIMD)
+	done += Px_SpanWide<PxAvx2, Op, kSolid>(dst, src, color, count, tint);
+#endif
+#if HAS(SSE2_SIMD)
+	done += Px_SpanWide<PxSse2, Op, kSolid>(dst + done, kSolid ? src : src + done, color, count - done, tint);
+#endif
+#if HAS(NEON_SIMD)
+	done += Px_SpanWide<PxNeon, Op, kSolid>(dst + done, kSolid ? src : src + done, color, count - done, tint);
+#endif
+
+	const bool tinted = tint != PX_WHITE;
+	for (u32 pi = done; pi < count; pi++)
+	{
+		const u32 s = kSolid ? color : src[pi];
+		dst[pi]     = Px_BlendPixel(dst[pi], tinted ? Px_Mul(s, tint) : s, Op::kBlend);
+	}
+}
+
+void Px_BlendSpan(u32 *dst, const u32 *src, u32 count, u32 tint, PxBlend_e blend)
+{
+	switch (blend)
+	{
+	case PX_BLEND_COPY:
+		if (tint == PX_WHITE)
+			memmove(dst, src, count * sizeof(u32));
+		else
+			Px_Span<PxOpCopy, false>(dst, src, 0, count, tint);
+		break;
+	case PX_BLEND_OVER:
+		Px_Span<PxOpOver, false>(dst, src, 0, count, tint);
+		break;
+	case PX_BLEND_OVER_PREMUL:
+		Px_Span<PxOpOverPremul, false>(dst, src, 0, count, tint);
+		break;
+	case PX_BLEND_ADD_DST_ALPHA:
+		Px_Span<PxOpAddDstAlpha, false>(dst, src, 0, count, tint);
+		break;
+	default:
+		Assert(0);
+		break;
+	}
+}
+
+void Px_FillSpan(u32 *dst, u32 count, u32 color, PxBlend_e blend)
+{
+	switch (blend)
+	{
+	case PX_BLEND_COPY:
+		Px_Span<PxOpCopy, true>(dst, nullptr, color, count, PX_WHITE);
+		break;
+	case PX_BLEND_OVER:
+		Px_Span<PxOpOver, true>(dst, nullptr, color, count, PX_WHITE);
+		break;
+	case PX_BLEND_OVER_PREMUL:
+		Px_Span<PxOpOverPremul, true>(dst, nullptr, color, count, PX_WHITE);
+		break;
+	case PX_BLEND_ADD_DST_ALPHA:
+		Px_Span<PxOpAddDstAlpha, true>(dst, nullptr, color, count, PX_WHITE);
+		break;
+	default:
+		Assert(0);
+		break;
+	}
+}
+
+template <typename V>
+static u32 Px_PremultiplyWide(u32 *dst, const u32 *src, u32 count)
+{
+	typedef typename V::Vec Vec;
+
+	const u32 wideCount = count - count % V::kPixels;
+	for (u32 pi = 0; pi < wideCount; pi += V::kPixels)
+	{
+		const Vec p = V::Load(src + pi);
+		const Vec f = V::Or(V::And(V::Alpha(p), V::Splat(0x00FFFFFF)), V::Splat(0xFF000000));
+		V::Store(dst + pi, V::Mul(p, f));
+	}
+	return wideCount;
+}
+
+void Px_Premultiply(u32 *dst, const u32 *src, u32 count)
+{
+	u32 done = 0;
+#if HAS(AVX2_SIMD)
+	done += Px_PremultiplyWide<PxAvx2>(dst, src, count);
+#endif
+#if HAS(SSE2_SIMD)
+	done += Px_PremultiplyWide<PxSse2>(dst + done, src + done, count - done);
+#endif
+#if HAS(NEON_SIMD)
+	done += Px_PremultiplyWide<PxNeon>(dst + done, src + done, count - done);
+#endif
+
+	for (u32 pi = done; pi < count; pi++)
+	{
+		const u32 a = src[pi] >> 24;
+		dst[pi]     = Px_Mul(src[pi], (a * 0x00010101) | 0xFF000000);
+	}
+}
+
+//
+// Format conversion. The wide paths cover what each instruction set does cheaply and return how many pixels they
+// did, the rest is scalar.
+//
+
+static u32 Px_ToRGBA8Wide(u32 *dst, const u8 *src, u32 count, Bitmap::Format srcFormat, bool forceOpaque)
+{
+	u32 done = 0;
+#if HAS(NEON_SIMD)
+	const uint8x16_t zero   = vdupq_n_u8(0);
+	const uint8x16_t opaque = vdupq_n_u8(0xFF);
+	for (; done + 16 <= count; done += 16)
+	{
+		uint8x16x4_t out;
+		switch (srcFormat)
+		{
+		case Bitmap::RGBA8:
+			out = vld4q_u8(src + done * 4);
+			break;
+		case Bitmap::RGBA16:
+		{
+			// High byte of each channel
+			const uint16x8x4_t lo = vld4q_u16((const u16 *)src + done * 4);
+			const uint16x8x4_t hi = vld4q_u16((const u16 *)src + done * 4 + 32);
+			for (u32 ci = 0; ci < 4; ci++)
+				out.val[ci] = vcombine_u8(vshrn_n_u16(lo.val[ci], 8), vshrn_n_u16(hi.val[ci], 8));
+			break;
+		}
+		case Bitmap::R8:
+			out.val[0] = vld1q_u8(src + done);
+			out.val[1] = zero;
+			out.val[2] = zero;
+			out.val[3] = opaque;
+			break;
+		case Bitmap::RG8:
+		{
+			const uint8x16x2_t rg = vld2q_u8(src + done * 2);
+			out.val[0]            = rg.val[0];
+			out.val[1]            = rg.val[1];
+			out.val[2]            = zero;
+			out.val[3]            = opaque;
+			break;
+		}
+		case Bitmap::RGB8:
+		{
+			const uint8x16x3_t rgb = vld3q_u8(src + done * 3);
+			out.val[0]             = rgb.val[0];
+			out.val[1]             = rgb.val[1];
+			out.val[2]             = rgb.val[2];
+			out.val[3]             = opaque;
+			break;
+		}
+		default:
+			break;
+		}
+		if (forceOpaque)
+			out.val[3] = opaque;
+		vst4q_u8((u8 *)(dst + done), out);
+	}
+#elif HAS(SSE2_SIMD)
+	const __m128i zero   = _mm_setzero_si128();
+	const __m128i opaque = _mm_set1_epi32((int)0xFF000000);
+	const __m128i alpha  = (forceOpaque || srcFormat == Bitmap::R8 || srcFormat == Bitmap::RG8) ? opaque : zero;
+	switch (srcFormat)
+	{
+	case Bitmap::RGBA8:
+		for (; done + 4 <= count; done += 4)
+			_mm_storeu_si128((__m128i *)(dst + done), _mm_or_si128(_mm_loadu_si128((const __m128i *)(src + done * 4)), alpha));
+		break;
+
+	case Bitmap::RGBA16:
+		for (; done + 4 <= count; done += 4)
+		{
+			const __m128i lo = _mm_srli_epi16(_mm_loadu_si128((const __m128i *)(src + done * 8)), 8);
+			const __m128i hi = _mm_srli_epi16(_mm_loadu_si128((const __m128i *)(src + done * 8 + 16)), 8);
+			_mm_storeu_si128((__m128i *)(dst + done), _mm_or_si128(_mm_packus_epi16(lo, hi), alpha));
+		}
+		break;
+
+	case Bitmap::R8:
+		for (; done + 16 <= count; done += 16)
+		{
+			const __m128i r   = _mm_loadu_si128((const __m128i *)(src + done));
+			const __m128i rLo = _mm_unpacklo_epi8(r, zero);
+			const __m128i rHi = _mm_unpackhi_epi8(r, zero);
+			_mm_storeu_si128((__m128i *)(dst + done), _mm_or_si128(_mm_unpacklo_epi16(rLo, zero), alpha));
+			_mm_storeu_si128((__m128i *)(dst + done + 4), _mm_or_si128(_mm_unpackhi_epi16(rLo, zero), alpha));
+			_mm_storeu_si128((__m128i *)(dst + done + 8), _mm_or_si128(_mm_unpacklo_epi16(rHi, zero), alpha));
+			_mm_storeu_si128((__m128i *)(dst + done + 12), _mm_or_si128(_mm_unpackhi_epi16(rHi, zero), alpha));
+		}
+		break;
+
+	case Bitmap::RG8:
+		for (; done + 8 <= count; done += 8)
+		{
+			const __m128i rg = _mm_loadu_si128((const __m128i *)(src + done * 2));
+			_mm_storeu_si128((__m128i *)(dst + done), _mm_or_si128(_mm_unpacklo_epi16(rg, zero), alpha));
+			_mm_storeu_si128((__m128i *)(dst + done + 4), _mm_or_si128(_mm_unpackhi_epi16(rg, zero), alpha));
+		}
+		break;
+
+	default:
+		break;
+	}
+#endif
+	return done;
+}
+
+void Px_ConvertToRGBA8(u32 *dst, const void *src, u32 count, Bitmap::Format srcFormat, bool forceOpaque)
+{
+	Assert(!Bm_IsCompressed(srcFormat));
+	const u8 *srcBytes = (const u8 *)src;
+	if (srcFormat == Bitmap::RGBA8 && !forceOpaque)
+	{
+		memmove(dst, src, count * sizeof(u32));
+		return;
+	}
+
+	const u32 alpha = forceOpaque ? 0xFF000000 : 0;
+	for (u32 pi = Px_ToRGBA8Wide(dst, srcBytes, count, srcFormat, forceOpaque); pi < count; pi++)
+	{
+		switch (srcFormat)
+		{
+		case Bitmap::RGBA8:
+			dst[pi] = ((const u32 *)src)[pi] | alpha;
+			break;
+		case Bitmap::RGBA16:
+		{
+			const u16 *c = (const u16 *)src + pi * 4;
+			dst[pi]      = ((u32)(c[3] >> 8) << 24 | (u32)(c[2] >> 8) << 16 | (u32)(c[1] >> 8) << 8 | (u32)(c[0] >> 8)) | alpha;
+			break;
+		}
+		case Bitmap::R8:
+			dst[pi] = 0xFF000000 | srcBytes[pi];
+			break;
+		case Bitmap::RG8:
+			dst[pi] = 0xFF000000 | (u32)srcBytes[pi * 2 + 1] << 8 | srcBytes[pi * 2];
+			break;
+		case Bitmap::RGB8:
+			dst[pi] = 0xFF000000 | (u32)srcBytes[pi * 3 + 2] << 16 | (u32)srcBytes[pi * 3 + 1] << 8 | srcBytes[pi * 3];
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+static u32 Px_FromRGBA8Wide(u8 *dst, const u32 *src, u32 count, Bitmap::Format dstFormat)
+{
+	u32 done = 0;
+#if HAS(NEON_SIMD)
+	for (; done + 16 <= count; done += 16)
+	{
+		const uint8x16x4_t in = vld4q_u8((const u8 *)(src + done));
+		switch (dstFormat)
+		{
+		case Bitmap::RGBA8:
+			vst4q_u8(dst + done * 4, in);
+			break;
+		case Bitmap::RGBA16:
+		{
+			// x * 257 is the byte twice over
+			uint16x8x4_t lo, hi;
+			for (u32 ci = 0; ci < 4; ci++)
+			{
+				lo.val[ci] = vmulq_n_u16(vmovl_u8(vget_low_u8(in.val[ci])), 257);
+				hi.val[ci] = vmulq_n_u16(vmovl_u8(vget_high_u8(in.val[ci])), 257);
+			}
+			vst4q_u16((u16 *)dst + done * 4, lo);
+			vst4q_u16((u16 *)dst + done * 4 + 32, hi);
+			break;
+		}
+		case Bitmap::R8:
+			vst1q_u8(dst + done, in.val[0]);
+			break;
+		case Bitmap::RG8:
+		{
+			uint8x16x2_t rg;
+			rg.val[0] = in.val[0];
+			rg.val[1] = in.val[1];
+			vst2q_u8(dst + done * 2, rg);
+			break;
+		}
+		case Bitmap::RGB8:
+		{
+			uint8x16x3_t rgb;
+			rgb.val[0] = in.val[0];
+			rgb.val[1] = in.val[1];
+			rgb.val[2] = in.val[2];
+			vst3q_u8(dst + done * 3, rgb);
+			break;
+		}
+		default:
+			break;
+		}
+	}
+#elif HAS(SSE2_SIMD)
+	switch (dstFormat)
+	{
+	case Bitmap::RGBA16:
+		for (; done + 4 <= count; done += 4)
+		{
+			const __m128i p = _mm_loadu_si128((const __m128i *)(src + done));
+			_mm_storeu_si128((__m128i *)(dst + done * 8), _mm_unpacklo_epi8(p, p));
+			_mm_storeu_si128((__m128i *)(dst + done * 8 + 16), _mm_unpackhi_epi8(p, p));
+		}
+		break;
+
+	case Bitmap::R8:
+		for (; done + 16 <= count; done += 16)
+		{
+			// Red alone in each pixel, then narrowed twice. Values fit the signed saturation of the first pack.
+			const __m128i red = _mm_set1_epi32(0xFF);
+			const __m128i p0  = _mm_and_si128(_mm_loadu_si128((const __m128i *)(src + done)), red);
+			const __m128i p1  = _mm_and_si128(_mm_loadu_si128((const __m128i *)(src + done + 4)), red);
+			const __m128i p2  = _mm_and_si128(_mm_loadu_si128((const __m128i *)(src + done + 8)), red);
+			const __m128i p3  = _mm_and_si128(_mm_loadu_si128((const __m128i *)(src + done + 12)), red);
+			_mm_storeu_si128((__m128i *)(dst + done), _mm_packus_epi16(_mm_packs_epi32(p0, p1), _mm_packs_epi32(p2, p3)));
+		}
+		break;
+
+	default:
+		break;
+	}
+#endif
+	return done;
+}
+
+void Px_ConvertFromRGBA8(void *dst, const u32 *src, u32 count, Bitmap::Format dstFormat)
+{
+	Assert(!Bm_IsCompressed(dstFormat));
+	u8 *dstBytes = (u8 *)dst;
+	if (dstFormat == Bitmap::RGBA8)
+	{
+		memmove(dst, src, count * sizeof(u32));
+		return;
+	}
+
+	for (u32 pi = Px_FromRGBA8Wide(dstBytes, src, count, dstFormat); pi < count; pi++)
+	{
+		const u32 p = src[pi];
+		switch (dstFormat)
+		{
+		case Bitmap::RGBA16:
+			for (u32 ci = 0; ci < 4; ci++)
+				((u16 *)dst)[pi * 4 + ci] = (u16)(((p >> (ci * 8)) & 0xFF) * 257);
+			break;
+		case Bitmap::R8:
+			dstBytes[pi] = (u8)p;
+			break;
+		case Bitmap::RG8:
+			dstBytes[pi * 2]     = (u8)p;
+			dstBytes[pi * 2 + 1] = (u8)(p >> 8);
+			break;
+		case Bitmap::RGB8:
+			dstBytes[pi * 3]     = (u8)p;
+			dstBytes[pi * 3 + 1] = (u8)(p >> 8);
+			dstBytes[pi * 3 + 2] = (u8)(p >> 16);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+//
+// Mip downsampling. The wide paths do count quads of two rows, four at a time, and return how many. Same sums as
+// Px_AverageQuad, with the color divide done in single precision floats like it, so they match it bit for bit.
+//
+
+static u32 Px_DownsampleRowWide(u32 *dst, const u32 *row0, const u32 *row1, u32 count)
+{
+	u32 done = 0;
+#if HAS(NEON_SIMD) && defined(__aarch64__)
+	const uint32x4_t byteMask = vdupq_n_u32(0xFF);
+	const uint32x4_t two      = vdupq_n_u32(2);
+	for (; done + 4 <= count; done += 4)
+	{
+		// Even and odd columns of each row
+		const uint32x4x2_t top    = vld2q_u32(row0 + done * 2);
+		const uint32x4x2_t bottom = vld2q_u32(row1 + done * 2);
+		const uint32x4_t   p0 = top.val[0], p1 = top.val[1], p2 = bottom.val[0], p3 = bottom.val[1];
+		const uint32x4_t   a0 = vshrq_n_u32(p0, 24), a1 = vshrq_n_u32(p1, 24), a2 = vshrq_n_u32(p2, 24), a3 = vshrq_n_u32(p3, 24);
+
+		const uint32x4_t   sumA        = vaddq_u32(vaddq_u32(a0, a1), vaddq_u32(a2, a3));
+		const uint32x4_t   transparent = vceqq_u32(sumA, vdupq_n_u32(0));
+		const float32x4_t  sumAF       = vcvtq_f32_u32(sumA);
+		uint32x4_t         result      = vshlq_n_u32(vshrq_n_u32(vaddq_u32(sumA, two), 2), 24);
+		for (i32 shift = 0; shift < 24; shift += 8)
+		{
+			const int32x4_t  down = vdupq_n_s32(-shift);
+			const uint32x4_t c0 = vandq_u32(vshlq_u32(p0, down), byteMask), c1 = vandq_u32(vshlq_u32(p1, down), byteMask);
+			const uint32x4_t c2 = vandq_u32(vshlq_u32(p2, down), byteMask), c3 = vandq_u32(vshlq_u32(p3, down), byteMask);
+
+			const uint32x4_t weighted = vmlaq_u32(vmlaq_u32(vmlaq_u32(vmulq_u32(c0, a0), c1, a1), c2, a2), c3, a3);
+			const uint32x4_t divided  = vcvtq_u32_f32(vaddq_f32(vdivq_f32(vcvtq_f32_u32(weighted), sumAF), vdupq_n_f32(0.5f)));
+			const uint32x4_t plain    = vshrq_n_u32(vaddq_u32(vaddq_u32(vaddq_u32(c0, c1), vaddq_u32(c2, c3)), two), 2);
+			result                    = vorrq_u32(result, vshlq_u32(vbslq_u32(transparent, plain, divided), vdupq_n_s32(shift)));
+		}
+		vst1q_u32(dst + done, result);
+	}
+#elif HAS(SSE2_SIMD)
+	const __m128i byteMask = _mm_set1_epi32(0xFF);
+	const __m128i two      = _mm_set1_epi32(2);
+	const __m128  half     = _mm_set1_ps(0.5f);
+	for (; done + 4 <= count; done += 4)
+	{
+		// Even and odd columns of each row
+		const __m128 top0    = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *)(row0 + done * 2)));
+		const __m128 top1    = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *)(row0 + done * 2 + 4)));
+		const __m128 bottom0 = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *)(row1 + done * 2)));
+		const __m128 bottom1 = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *)(row1 + done * 2 + 4)));
+		const __m128i p0     = _mm_castps_si128(_mm_shuffle_ps(top0, top1, _MM_SHUFFLE(2, 0, 2, 0)));
+		const __m128i p1     = _mm_castps_si128(_mm_shuffle_ps(top0, top1, _MM_SHUFFLE(3, 1, 3, 1)));
+		const __m128i p2     = _mm_castps_si128(_mm_shuffle_ps(bottom0, bottom1, _MM_SHUFFLE(2, 0, 2, 0)));
+		const __m128i p3     = _mm_castps_si128(_mm_shuffle_ps(bottom0, bottom1, _MM_SHUFFLE(3, 1, 3, 1)));
+		const __m128i a0 = _mm_srli_epi32(p0, 24), a1 = _mm_srli_epi32(p1, 24), a2 = _mm_srli_epi32(p2, 24), a3 = _mm_srli_epi32(p3, 24);
+
+		const __m128i sumA        = _mm_add_epi32(_mm_add_epi32(a0, a1), _mm_add_epi32(a2, a3));
+		const __m128i transparent = _mm_cmpeq_epi32(sumA, _mm_setzero_si128());
+		const __m128  sumAF       = _mm_cvtepi32_ps(sumA);
+		__m128i       result      = _mm_slli_epi32(_mm_srli_epi32(_mm_add_epi32(sumA, two), 2), 24);
+		for (int shift = 0; shift < 24; shift += 8)
+		{
+			const __m128i down = _mm_cvtsi32_si128(shift);
+			const __m128i c0 = _mm_and_si128(_mm_srl_epi32(p0, down), byteMask), c1 = _mm_and_si128(_mm_srl_epi32(p1, down), byteMask);
+			const __m128i c2 = _mm_and_si128(_mm_srl_epi32(p2, down), byteMask), c3 = _mm_and_si128(_mm_srl_epi32(p3, down), byteMask);
+
+			// Bytes in the low half of each lane, so the 16 bit multiply's low half is the whole product
+			const __m128i weighted = _mm_add_epi32(_mm_add_epi32(_mm_mullo_epi16(c0, a0), _mm_mullo_epi16(c1, a1)),
+			                                       _mm_add_epi32(_mm_mullo_epi16(c2, a2), _mm_mullo_epi16(c3, a3)));
+			const __m128i divided  = _mm_cvttps_epi32(_mm_add_ps(_mm_div_ps(_mm_cvtepi32_ps(weighted), sumAF), half));
+			const __m128i plain    = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(_mm_add_epi32(c0, c1), _mm_add_epi32(c2, c3)), two), 2);
+			const __m128i c        = _mm_or_si128(_mm_and_si128(transparent, plain), _mm_andnot_si128(transparent, divided));
+			result                 = _mm_or_si128(result, _mm_sll_epi32(c, down));
+		}
+		_mm_storeu_si128((__m128i *)(dst + done), result);
+	}
+#endif
+	return done;
+}
+
+void Px_Downsample2x(u32 *dst, const u32 *src, u32 srcWidth, u32 srcHeight, u32 srcPitch)
+{
+	const u32 dstWidth  = Bm_MipSize(srcWidth, 1);
+	const u32 dstHeight = Bm_MipSize(srcHeight, 1);
+	for (u32 y = 0; y < dstHeight; y++)
+	{
+		const u32 *row0   = src + (size_t)(y * 2) * srcPitch;
+		const u32 *row1   = y * 2 + 1 < srcHeight ? row0 + srcPitch : row0;
+		u32 *      dstRow = dst + (size_t)y * dstWidth;
+
+		// Whole vectors of quads, then the rest one at a time
+		for (u32 x = Px_DownsampleRowWide(dstRow, row0, row1, srcWidth / 2); x < dstWidth; x++)
+		{
+			const u32 x0 = x * 2, x1 = x * 2 + 1 < srcWidth ? x * 2 + 1 : x * 2;
+			dstRow[x]    = Px_AverageQuad(row0[x0], row0[x1], row1[x0], row1[x1]);
+		}
+	}
+}
@@ -0,0 +1,117 @@
+#ifndef __QI_PIXELOPS_H
+
+//
+// Copyright 2017, Quantum Immortality Software and Jon Davis
+//
+// Pixel span kernels: blends, tinted copies, fills and format conversion. Pixels are the engine layout, R G B A bytes
+// in memory. Each op runs as wide as the build allows (AVX2, SSE2 or NEON) and finishes the tail in scalar code, and
+// every path rounds products of two 8 bit values the same way, so results match to the bit whichever ran.
+//
+
+#include "basictypes.h"
+#include "bitmap.h"
+
+#define PX_WHITE 0xFFFFFFFFu
+
+enum PxBlend_e
+{
+	PX_BLEND_COPY,          // src
+	PX_BLEND_OVER,          // Straight alpha: color src * a + dst * (1 - a), alpha a + dst alpha * (1 - a)
+	PX_BLEND_OVER_PREMUL,   // Premultiplied alpha: src + dst * (1 - a)
+	PX_BLEND_ADD_DST_ALPHA, // src + dst * dst alpha
+
+	PX_BLEND_COUNT
+};
+
+// a * b / 255 rounded, for a and b up to 255
+static inline u32 Px_Div255(u32 x)
+{
+	x += 128;
+	return (x + (x >> 8)) >> 8;
+}
+
+// Channel by channel a * b / 255
+static inline u32 Px_Mul(u32 a, u32 b)
+{
+	u32 result = 0;
+	for (u32 shift = 0; shift < 32; shift += 8)
+		result |= Px_Div255(((a >> shift) & 0xFF) * ((b >> shift) & 0xFF)) << shift;
+	return result;
+}
+
+// Reference for the span ops, and what they use on their tails. src is already tinted.
+static inline u32 Px_BlendPixel(u32 dst, u32 src, PxBlend_e blend)
+{
+	switch (blend)
+	{
+	case PX_BLEND_COPY:
+		return src;
+
+	case PX_BLEND_OVER:
+	{
+		const u32 a      = src >> 24;
+		const u32 inv    = 255 - a;
+		u32       result = Px_Div255(255 * a + (dst >> 24) * inv) << 24;
+		for (u32 shift = 0; shift < 24; shift += 8)
+			result |= Px_Div255(((src >> shift) & 0xFF) * a + ((dst >> shift) & 0xFF) * inv) << shift;
+		return result;
+	}
+
+	case PX_BLEND_OVER_PREMUL:
+	case PX_BLEND_ADD_DST_ALPHA:
+	{
+		// Both add a scaled dst, saturating: by one minus src alpha, or by dst alpha
+		const u32 scale  = blend == PX_BLEND_OVER_PREMUL ? 255 - (src >> 24) : dst >> 24;
+		u32       result = 0;
+		for (u32 shift = 0; shift < 32; shift += 8)
+		{
+			const u32 c = ((src >> shift) & 0xFF) + Px_Div255(((dst >> shift) & 0xFF) * scale);
+			result |= (c > 255 ? 255 : c) << shift;
+		}
+		return result;
+	}
+
+	default:
+		break;
+	}
+	return src;
+}
+
+// One pixel of a 2x2 box downsample. Color is weighted by alpha, so what's under transparent pixels doesn't bleed into
+// their neighbours; a quad that's transparent throughout keeps its plain average.
+static inline u32 Px_AverageQuad(u32 p0, u32 p1, u32 p2, u32 p3)
+{
+	const u32 a0 = p0 >> 24, a1 = p1 >> 24, a2 = p2 >> 24, a3 = p3 >> 24;
+	const u32 sumA   = a0 + a1 + a2 + a3;
+	u32       result = ((sumA + 2) >> 2) << 24;
+	for (u32 shift = 0; shift < 24; shift += 8)
+	{
+		const u32 c0 = (p0 >> shift) & 0xFF, c1 = (p1 >> shift) & 0xFF, c2 = (p2 >> shift) & 0xFF, c3 = (p3 >> shift) & 0xFF;
+		const u32 c  = sumA ? (u32)((r32)(c0 * a0 + c1 * a1 + c2 * a2 + c3 * a3) / (r32)sumA + 0.5f) : (c0 + c1 + c2 + c3 + 2) >> 2;
+		result |= c << shift;
+	}
+	return result;
+}
+
+// dst = blend(dst, src * tint). Pass PX_WHITE to leave src as it is.
+void Px_BlendSpan(u32 *dst, const u32 *src, u32 count, u32 tint, PxBlend_e blend);
+
+// dst = blend(dst, color)
+void Px_FillSpan(u32 *dst, u32 count, u32 color, PxBlend_e blend);
+
+// Straight alpha to premultiplied, in place is fine
+void Px_Premultiply(u32 *dst, const u32 *src, u32 count);
+
+// From count pixels of another, uncompressed, format to the engine layout. Missing channels come out the way GL samples them: zero
+// color, opaque alpha. Also makes every pixel opaque when asked, whatever the source.
+void Px_ConvertToRGBA8(u32 *dst, const void *src, u32 count, Bitmap::Format srcFormat, bool forceOpaque = false);
+
+// And back, dropping channels the format doesn't have
+void Px_ConvertFromRGBA8(void *dst, const u32 *src, u32 count, Bitmap::Format dstFormat);
+
+// The next mip level down: Bm_MipSize of each dimension, packed tight in dst. Odd sizes lose their last row or column,
+// a size of 1 stays 1.
+void Px_Downsample2x(u32 *dst, const u32 *src, u32 srcWidth, u32 srcHeight, u32 srcPitch);
+
+#define __QI_PIXELOPS_H
+#endif // #ifndef __QI_PIXELOPS_H
@@ -16,6 +16,7 @@
 #include "debug.h"
 #include "stringtable.h"
 #include "qed_parse.h"
+#include "pack.h"
 
 #define PEEK(n) (gpc.s + n < gpc.end ? gpc.s[n] : 0)
 #define NEXT()  PEEK(0)
@@ -619,10 +620,24 @@ const char *QED_LoadBuffer(KeyStore **ksp, const char *ksName, const char *buffe
 		Assert(*ksp);
 		KS_SetRoot(*ksp, result);
 	}
-	return nullptr;
+	return parseError;
 }
 const char *QED_LoadFile(KeyStore **ksp, const char *ksName, const char *fileName)
 {
+	// Baked into the pack already parsed
+	const PackEntry_s *packed = Pack_Find(fileName, PACK_KEYSTORE);
+	if (packed != nullptr)
+	{
+		KeyStore *ks = KS_CreateFromImage(ksName ? ksName : "Unnamed", Pack_Data(packed), packed->size);
+		if (ks != nullptr)
+		{
+			if (*ksp != nullptr)
+				KS_Free(ksp);
+			*ksp = ks;
+			return nullptr;
+		}
+	}
+
 	size_t fileSize = 0;
 	void * fileBuf  = plat->ReadEntireFile(nullptr, fileName, &fileSize);
 	if (fileBuf == nullptr)
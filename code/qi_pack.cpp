@@ -0,0 +1,345 @@
+//
+// Copyright 2017, Quantum Immortality Software and Jon Davis
+//
+// qi_pack [-t none|auto|bc1|bc3|bc7] <data dir> <pack file>
+//
+// Bakes everything the game loads from the data directory into one pack (see pack.h): bitmaps decoded and in the
+// engine pixel layout, QED files parsed into keystore images and shaders as they are. Anything else is left out.
+//
+// -t block compresses bitmaps, each with its full mip chain, which can't be made from the blocks at runtime. auto, the
+// default, only does sprite sheet sized ones: BC1 when every pixel is either opaque or transparent, else BC3. BC7 is
+// only mode 6 here, which suits opaque or smooth images better than sprites with soft edges.
+//
+
+// Ahead of basictypes.h, whose 'internal' trips up the standard library headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "basictypes.h"
+#include "game.h"
+#include "debug.h"
+#include "util.h"
+#include "keystore.h"
+#include "qed_parse.h"
+#include "pixelops.h"
+#include "bitmap.h"
+#include "bcn.h"
+#include "pack.h"
+
+#define STBI_ASSERT Assert
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+namespace fs = std::filesystem;
+
+// The tool has no platform layer, nothing it links calls through this
+const PlatFuncs_s *plat = nullptr;
+
+extern SubSystem KeyStoreSubsystem;
+
+void Qi_Assert_Handler(const char *msg, const char *file, const int line)
+{
+	fprintf(stderr, "%s(%d): Assert failed: %s\n", file, line, msg);
+	abort();
+}
+
+#define PACK_AUTO_COMPRESS_PIXELS (256 * 256) // Smallest bitmap auto compresses, anything less isn't worth the loss
+
+enum PackTextures_e
+{
+	PACK_TEXTURES_NONE,
+	PACK_TEXTURES_AUTO,
+	PACK_TEXTURES_BC1,
+	PACK_TEXTURES_BC3,
+	PACK_TEXTURES_BC7,
+};
+
+struct PackSource_s
+{
+	std::string     name; // Relative to the data dir, '/' separated: what the game asks for
+	PackEntryType_e type;
+	std::vector<u8> data;
+	u32             width;
+	u32             height;
+	Bitmap::Format  format;
+	u32             numMips;
+};
+
+static PackTextures_e s_textures = PACK_TEXTURES_AUTO;
+
+static bool Pack_HasExtension(const fs::path &path, const char *const *extensions)
+{
+	std::string ext = path.extension().string();
+	std::transform(ext.begin(), ext.end(), ext.begin(), [](char c) { return (char)tolower(c); });
+	for (const char *const *e = extensions; *e != nullptr; e++)
+		if (ext == *e)
+			return true;
+	return false;
+}
+
+static bool Pack_ReadFile(const fs::path &path, std::vector<u8> *data)
+{
+	FILE *f = fopen(path.string().c_str(), "rb");
+	if (f == nullptr)
+		return false;
+	fseek(f, 0, SEEK_END);
+	data->resize((size_t)ftell(f));
+	fseek(f, 0, SEEK_SET);
+	const bool ok = fread(data->data(), 1, data->size(), f) == data->size();
+	fclose(f);
+	return ok;
+}
+
+static Bitmap::Format Pack_BitmapFormat(const u32 *pixels, u32 width, u32 height)
+{
+	switch (s_textures)
+	{
+	case PACK_TEXTURES_BC1:
+		return Bitmap::BC1;
+	case PACK_TEXTURES_BC3:
+		return Bitmap::BC3;
+	case PACK_TEXTURES_BC7:
+		return Bitmap::BC7;
+	case PACK_TEXTURES_AUTO:
+		break;
+	default:
+		return Bitmap::RGBA8;
+	}
+
+	if (width * height < PACK_AUTO_COMPRESS_PIXELS)
+		return Bitmap::RGBA8;
+	for (u32 pi = 0; pi < width * height; pi++)
+		if ((pixels[pi] >> 24) != 0 && (pixels[pi] >> 24) != 0xFF)
+			return Bitmap::BC3;
+	return Bitmap::BC1;
+}
+
+// Encodes every level, each downsampled from the last
+static void Pack_CompressBitmap(PackSource_s *src, Bitmap::Format format)
+{
+	const u32 numMips = Bm_NumMips(src->width, src->height);
+	std::vector<u8>  blocks(Bm_ChainBytes(format, src->width, src->height, numMips));
+	std::vector<u32> level((const u32 *)src->data.data(), (const u32 *)src->data.data() + src->width * src->height);
+	std::vector<u32> next;
+
+	u8 *out = blocks.data();
+	for (u32 mip = 0; mip < numMips; mip++)
+	{
+		const u32 width  = Bm_MipSize(src->width, mip);
+		const u32 height = Bm_MipSize(src->height, mip);
+		Bc_Encode(format, out, level.data(), width, height, width);
+		out += Bm_LevelBytes(format, width, height);
+
+		if (mip + 1 < numMips)
+		{
+			next.resize((size_t)Bm_MipSize(width, 1) * Bm_MipSize(height, 1));
+			Px_Downsample2x(next.data(), level.data(), width, height, width);
+			level.swap(next);
+		}
+	}
+	Assert(out == blocks.data() + blocks.size());
+
+	src->data.swap(blocks);
+	src->format  = format;
+	src->numMips = numMips;
+}
+
+static bool Pack_BakeBitmap(const fs::path &path, PackSource_s *src)
+{
+	int wid, hgt, components;
+	u8 *decoded = stbi_load(path.string().c_str(), &wid, &hgt, &components, 4);
+	if (decoded == nullptr)
+		return false;
+
+	src->width   = (u32)wid;
+	src->height  = (u32)hgt;
+	src->format  = Bitmap::RGBA8;
+	src->numMips = 1;
+	src->data.resize((size_t)wid * hgt * sizeof(u32));
+	Px_ConvertToRGBA8((u32 *)src->data.data(), decoded, (u32)(wid * hgt), Bitmap::RGBA8);
+	stbi_image_free(decoded);
+
+	const Bitmap::Format format = Pack_BitmapFormat((const u32 *)src->data.data(), src->width, src->height);
+	if (Bm_IsCompressed(format))
+		Pack_CompressBitmap(src, format);
+	return true;
+}
+
+static bool Pack_BakeQed(const fs::path &path, PackSource_s *src)
+{
+	std::vector<u8> text;
+	if (!Pack_ReadFile(path, &text))
+		return false;
+
+	// The parser looks past the end for a terminating 0, the same as the game's file reads leave
+	const size_t textSize = text.size();
+	text.push_back(0);
+
+	KeyStore *  parsed = nullptr;
+	const char *error  = QED_LoadBuffer(&parsed, src->name.c_str(), (const char *)text.data(), textSize);
+	if (error != nullptr || parsed == nullptr)
+	{
+		fprintf(stderr, "%s: %s\n", src->name.c_str(), error ? error : "parse failed");
+		return false;
+	}
+
+	// The image is the store plus its symbol names, grow until that fits
+	u32 written = 0;
+	for (size_t room = textSize * 2 + 4096; written == 0; room *= 2)
+	{
+		src->data.resize(room);
+		written = KS_WriteImage(parsed, src->data.data(), (u32)room);
+	}
+	src->data.resize(written);
+	KS_Free(&parsed);
+	return true;
+}
+
+static bool Pack_BakeShader(const fs::path &path, PackSource_s *src)
+{
+	return Pack_ReadFile(path, &src->data);
+}
+
+int main(int argc, const char *argv[])
+{
+	static const char *const textureNames[] = {"none", "auto", "bc1", "bc3", "bc7"};
+
+	int argi = 1;
+	if (argc == 5 && strcmp(argv[1], "-t") == 0)
+	{
+		u32 ti = 0;
+		while (ti < countof(textureNames) && strcmp(argv[2], textureNames[ti]) != 0)
+			ti++;
+		if (ti == countof(textureNames))
+			argc = 0;
+		s_textures = (PackTextures_e)ti;
+		argi       = 3;
+	}
+	if (argc != argi + 2)
+	{
+		fprintf(stderr, "usage: qi_pack [-t none|auto|bc1|bc3|bc7] <data dir> <pack file>\n");
+		return EXIT_FAILURE;
+	}
+
+	const fs::path dataDir  = argv[argi];
+	const char *   packName = argv[argi + 1];
+
+	SubSystem keyStores = KeyStoreSubsystem;
+	keyStores.globalPtr = calloc(1, keyStores.globalSize);
+	keyStores.initFunc(&keyStores, false);
+
+	static const char *const bitmapExts[] = {".bmp", ".png", ".tga", ".jpg", ".jpeg", ".gif", ".psd", nullptr};
+	static const char *const qedExts[]    = {".qed", nullptr};
+	static const char *const shaderExts[] = {".glsl", nullptr};
+
+	std::vector<PackSource_s> sources;
+	bool                      failed = false;
+	for (const fs::directory_entry &entry : fs::recursive_directory_iterator(dataDir))
+	{
+		if (!entry.is_regular_file())
+			continue;
+
+		PackSource_s src = {};
+		src.name         = entry.path().lexically_relative(dataDir).generic_string();
+
+		bool baked;
+		if (Pack_HasExtension(entry.path(), bitmapExts))
+		{
+			src.type = PACK_BITMAP;
+			baked    = Pack_BakeBitmap(entry.path(), &src);
+		}
+		else if (Pack_HasExtension(entry.path(), qedExts))
+		{
+			src.type = PACK_KEYSTORE;
+			baked    = Pack_BakeQed(entry.path(), &src);
+		}
+		else if (Pack_HasExtension(entry.path(), shaderExts))
+		{
+			src.type = PACK_SHADER;
+			baked    = Pack_BakeShader(entry.path(), &src);
+		}
+		else
+		{
+			continue;
+		}
+
+		if (!baked)
+		{
+			fprintf(stderr, "Couldn't bake %s\n", src.name.c_str());
+			failed = true;
+			continue;
+		}
+		sources.push_back(std::move(src));
+	}
+	if (failed)
+		return EXIT_FAILURE;
+
+	// Same order Pack_Find searches in
+	std::sort(sources.begin(), sources.end(), [](const PackSource_s &a, const PackSource_s &b) { return strcmp(a.name.c_str(), b.name.c_str()) < 0; });
+
+	// Header, table, names, then each entry's data on its own alignment boundary
+	std::vector<PackEntry_s> entries(sources.size());
+	std::string              names;
+	for (size_t si = 0; si < sources.size(); si++)
+	{
+		entries[si].nameOffset = (u32)names.size();
+		entries[si].type       = sources[si].type;
+		entries[si].size       = sources[si].data.size();
+		entries[si].width      = sources[si].width;
+		entries[si].height     = sources[si].height;
+		entries[si].format     = sources[si].format;
+		entries[si].numMips    = sources[si].numMips;
+		names.append(sources[si].name).push_back(0);
+	}
+
+	PackHeader_s header = {};
+	header.magic        = QI_PACK_MAGIC;
+	header.version      = QI_PACK_VERSION;
+	header.numEntries   = (u32)entries.size();
+	header.namesOffset  = (u32)(sizeof(PackHeader_s) + entries.size() * sizeof(PackEntry_s));
+
+	u64 offset = header.namesOffset + names.size();
+	for (size_t si = 0; si < sources.size(); si++)
+	{
+		offset             = (offset + QI_PACK_ALIGN - 1) & ~(u64)(QI_PACK_ALIGN - 1);
+		entries[si].offset = offset;
+		// Shaders keep a terminating 0 past their size
+		offset += entries[si].size + (sources[si].type == PACK_SHADER ? 1 : 0);
+	}
+	header.fileSize = offset;
+
+	FILE *out = fopen(packName, "wb");
+	if (out == nullptr)
+	{
+		fprintf(stderr, "Couldn't write %s\n", packName);
+		return EXIT_FAILURE;
+	}
+
+	static const u8 zeros[QI_PACK_ALIGN] = {};
+	fwrite(&header, sizeof(header), 1, out);
+	fwrite(entries.data(), sizeof(PackEntry_s), entries.size(), out);
+	fwrite(names.data(), 1, names.size(), out);
+	for (size_t si = 0; si < sources.size(); si++)
+	{
+		fwrite(zeros, 1, (size_t)(entries[si].offset - (u64)ftell(out)), out);
+		fwrite(sources[si].data.data(), 1, sources[si].data.size(), out);
+		if (sources[si].type == PACK_SHADER)
+			fwrite(zeros, 1, 1, out);
+	}
+	const bool wroteAll = (u64)ftell(out) == header.fileSize;
+	fclose(out);
+
+	if (!wroteAll)
+	{
+		fprintf(stderr, "Short write to %s\n", packName);
+		return EXIT_FAILURE;
+	}
+
+	printf("Packed %u entries, %llu bytes into %s\n", header.numEntries, (unsigned long long)header.fileSize, packName);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,197 @@
+//
+// Copyright 2017, Quantum Immortality Software and Jon Davis
+//
+// Fixed step body simulation
+//
+
+#include "basictypes.h"
+
+#include "game.h"
+#include "tile.h"
+#include "gjk.h"
+#include "collision.h"
+#include "entity.h"
+#include "sim.h"
+#include "util.h"
+
+#define SIM_WANDER_ACCEL 6.0f
+#define SIM_WANDER_TICKS 45
+#define SIM_DRAG         2.0f
+#define SIM_MAX_SLIDES   3
+#define SIM_PAIR_BATCH   256
+
+// Systems only get a span and dT, the rest of the step they need is set here before Ent_RunSystems
+struct SimStepParams_s
+{
+	World_s* world;
+	u32      tick;
+};
+
+internal SimStepParams_s s_stepParams;
+
+Ent Sim_AddBody(SimState_s* sim, const v2& pos, const v2& radii, u32 seed)
+{
+	Assert(sim->numBodies < SIM_MAX_BODIES);
+	sim->numBodies++;
+
+	const Ent ent = EntManager::create(SIM_BODY_COMPS);
+
+	TransformComp_s* xform = EntManager::get<TransformComp_s>(ent);
+	xform->pos             = pos;
+	xform->prevPos         = pos;
+
+	EntManager::get<ColliderComp_s>(ent)->radii = radii;
+	EntManager::get<WanderComp_s>(ent)->seed    = seed;
+	return ent;
+}
+
+u32 Sim_QueryBodies(EntSpan_s* spans)
+{
+	EntQuery_s query;
+	query.all  = SIM_BODY_COMPS;
+	query.none = 0;
+	return Ent_Query(&query, spans, QI_ENT_MAX_CHUNKS);
+}
+
+// Unobstructed move for this step. A pure function of the body and tick so the prepare pass and the jobs agree.
+internal v2 BodyMove(const v2& vel, u32 seed, u32 tick, r32 dT, v2* newVel)
+{
+	// Wander: head somewhere new every SIM_WANDER_TICKS, picked from the seed so replays match
+	const u32 heading = HashU32(seed ^ HashU32(tick / SIM_WANDER_TICKS));
+	const r32 angle   = (r32)(heading & 0xFFFF) * (2.0f * Q_PI / 65536.0f);
+	const v2  accel   = V2(cosf(angle), sinf(angle)) * SIM_WANDER_ACCEL + vel * -SIM_DRAG;
+
+	*newVel = vel + accel * dT;
+	return vel * dT + accel * (0.5f * dT * dT);
+}
+
+internal void BodyBox(const v2& pos, const v2& radii, Aabb_s* box)
+{
+	box->min = pos - radii;
+	box->max = pos + radii;
+}
+
+// Each body only reads its own components and the static world, so chunks can run in any order on any thread
+internal void SimMoveBodies(const EntSpan_s* span, r32 dT)
+{
+	TransformComp_s*      xforms    = span->Get<TransformComp_s>();
+	VelocityComp_s*       vels      = span->Get<VelocityComp_s>();
+	const ColliderComp_s* colliders = span->Get<ColliderComp_s>();
+	const WanderComp_s*   wanders   = span->Get<WanderComp_s>();
+
+	for (u32 ei = 0; ei < span->count; ei++)
+	{
+		TransformComp_s* xform = &xforms[ei];
+		VelocityComp_s*  vel   = &vels[ei];
+		xform->prevPos         = xform->pos;
+
+		v2       newVel;
+		const v2 move = BodyMove(vel->vel, wanders[ei].seed, s_stepParams.tick, dT, &newVel);
+		vel->vel      = newVel;
+
+		Aabb_s bodyBox;
+		BodyBox(xform->pos, colliders[ei].radii, &bodyBox);
+		xform->pos += Col_SweepAndSlideWorld(nullptr, s_stepParams.world, &bodyBox, move, &vel->vel, SIM_MAX_SLIDES);
+	}
+}
+
+// Bodies pushed out of each other after they've all moved, half each. Serial and in the sweep's pair order, so the
+// result doesn't depend on how the moves were split into jobs.
+internal void SeparateBodies(SimState_s* sim, const EntSpan_s* spans, u32 numSpans)
+{
+	TransformComp_s* xforms[SIM_MAX_BODIES];
+	VelocityComp_s*  vels[SIM_MAX_BODIES];
+
+	u32 numBodies = 0;
+	for (u32 si = 0; si < numSpans; si++)
+	{
+		const EntSpan_s*      span      = &spans[si];
+		const ColliderComp_s* colliders = span->Get<ColliderComp_s>();
+		for (u32 ei = 0; ei < span->count; ei++, numBodies++)
+		{
+			Assert(numBodies < SIM_MAX_BODIES);
+			xforms[numBodies] = &span->Get<TransformComp_s>()[ei];
+			vels[numBodies]   = &span->Get<VelocityComp_s>()[ei];
+			BodyBox(xforms[numBodies]->pos, colliders[ei].radii, &sim->boxes[numBodies]);
+			sim->contacts[numBodies] = {};
+		}
+	}
+
+	// Chunks keep their order while nothing is created or destroyed, so last step's sweep order still fits
+	if (sim->numOrdered != numBodies)
+	{
+		Col_InitSweepOrder(sim->order, numBodies);
+		sim->numOrdered = numBodies;
+	}
+
+	ColPair_s pairs[SIM_PAIR_BATCH];
+	for (u32 firstPair = 0;; firstPair += SIM_PAIR_BATCH)
+	{
+		const u32 numPairs = Col_FindOverlapPairs(sim->boxes, numBodies, sim->order, pairs, SIM_PAIR_BATCH, firstPair);
+		for (u32 pi = 0; pi < numPairs; pi++)
+		{
+			const ColPair_s* pair = &pairs[pi];
+
+			GjkResult_s result;
+			if (Qi_AabbOverlap(&result, &sim->boxes[pair->a], &sim->boxes[pair->b]))
+			{
+				const r32 halfDepth = result.penetrationDepth * 0.5f;
+				Col_AddAxisContact(&sim->contacts[pair->a], result.penetrationNormal, halfDepth);
+				Col_AddAxisContact(&sim->contacts[pair->b], -result.penetrationNormal, halfDepth);
+			}
+		}
+
+		if (numPairs < SIM_PAIR_BATCH)
+			break;
+	}
+
+	for (u32 bodyIdx = 0; bodyIdx < numBodies; bodyIdx++)
+		xforms[bodyIdx]->pos += Col_ResolveAxisContacts(&sim->contacts[bodyIdx], &vels[bodyIdx]->vel);
+}
+
+void Sim_Step(SimState_s* sim, MemoryArena* tileArena, World_s* world, r32 dT)
+{
+	EntSpan_s spans[QI_ENT_MAX_CHUNKS];
+	const u32 numSpans = Sim_QueryBodies(spans);
+
+	// Tile rect caches get rebuilt here, single threaded, so the jobs only ever read them
+	for (u32 si = 0; si < numSpans; si++)
+	{
+		const EntSpan_s*       span      = &spans[si];
+		const TransformComp_s* xforms    = span->Get<TransformComp_s>();
+		const VelocityComp_s*  vels      = span->Get<VelocityComp_s>();
+		const ColliderComp_s*  colliders = span->Get<ColliderComp_s>();
+		const WanderComp_s*    wanders   = span->Get<WanderComp_s>();
+		for (u32 ei = 0; ei < span->count; ei++)
+		{
+			v2       newVel;
+			const v2 move = BodyMove(vels[ei].vel, wanders[ei].seed, sim->tick, dT, &newVel);
+
+			Aabb_s bodyBox;
+			BodyBox(xforms[ei].pos, colliders[ei].radii, &bodyBox);
+
+			Aabb_s moveBounds;
+			Col_MoveBounds(&bodyBox, move, &moveBounds);
+			Col_PrepareWorldBoxes(tileArena, world, &moveBounds);
+		}
+	}
+
+	s_stepParams.world = world;
+	s_stepParams.tick  = sim->tick;
+
+	const u32 moveReads  = ENT_COMP_BIT(ENT_COMP_COLLIDER) | ENT_COMP_BIT(ENT_COMP_WANDER);
+	const u32 moveWrites = ENT_COMP_BIT(ENT_COMP_TRANSFORM) | ENT_COMP_BIT(ENT_COMP_VELOCITY);
+	const EntSystem_s systems[] = {
+		{"SimMove", SimMoveBodies, moveReads, moveWrites, 0},
+	};
+	Ent_RunSystems(systems, countof(systems), dT);
+
+	SeparateBodies(sim, spans, numSpans);
+
+	sim->tick++;
+}
+
+v2 Sim_RenderPos(const TransformComp_s* xform, r32 alpha)
+{
+	return xform->prevPos + (xform->pos - xform->prevPos) * alpha;
+}
@@ -0,0 +1,46 @@
+#ifndef __QI_SIM_H
+
+//
+// Copyright 2017, Quantum Immortality Software and Jon Davis
+//
+// Fixed step simulation of free moving bodies. Bodies are entities; each step moves every one through the world
+// on its own, a chunk per job, then pushes them apart in one serial pass, so the result is the same however the
+// chunks were split across threads.
+//
+
+#include "basictypes.h"
+#include "math_util.h"
+#include "collision.h"
+#include "entity.h"
+
+struct World_s;
+struct MemoryArena;
+
+#define SIM_MAX_BODIES 1024
+#define SIM_BODY_COMPS                                                                                                 \
+	(ENT_COMP_BIT(ENT_COMP_TRANSFORM) | ENT_COMP_BIT(ENT_COMP_VELOCITY) | ENT_COMP_BIT(ENT_COMP_COLLIDER) |          \
+	 ENT_COMP_BIT(ENT_COMP_WANDER))
+
+struct SimState_s
+{
+	u32 numBodies;
+	u32 tick;
+
+	// Body vs body broadphase. The sweep order carries over between steps, the boxes and contacts are per step.
+	u32               order[SIM_MAX_BODIES];
+	u32               numOrdered;
+	Aabb_s            boxes[SIM_MAX_BODIES];
+	ColAxisContacts_s contacts[SIM_MAX_BODIES];
+};
+
+Ent  Sim_AddBody(SimState_s* sim, const v2& pos, const v2& radii, u32 seed);
+void Sim_Step(SimState_s* sim, MemoryArena* tileArena, World_s* world, r32 dT);
+
+// Every chunk of bodies, spans having room for QI_ENT_MAX_CHUNKS. Valid until the next structural change.
+u32 Sim_QueryBodies(EntSpan_s* spans);
+
+// Position blended between the last two steps, alpha being how far into the next step the frame is
+v2 Sim_RenderPos(const TransformComp_s* xform, r32 alpha);
+
+#define __QI_SIM_H
+#endif // #ifndef __QI_SIM_H
@@ -8,42 +8,16 @@
 
 #include "sound.h"
 #include "game.h"
-#include "math_util.h"
 #include "memory.h"
 
-#include <math_util.h>
 #include <string.h>
-#if HAS(WIN32_BUILD)
-#include <malloc.h>
-#else
-#include <sys/malloc.h>
-#endif
 
 struct SoundGlobals_s
 {
-	r32 toneHz;
-	int toneVolume;
+	Mixer_s mixer;
 };
 static SoundGlobals_s* g_sound;
 
-internal void
-GenTone(SoundBuffer_s* outputBuf, const u32 samplesToWrite, const r32 toneHz, const r32 toneVolume)
-{
-	const r32 sampleCycles = outputBuf->samplesPerSec / toneHz;
-	const r32 dtPerSample  = Q_2PI * (1.0f / sampleCycles);
-
-	i16* curSubSample = outputBuf->samples;
-	for (u32 sampleIdx = 0; sampleIdx < samplesToWrite; sampleIdx++)
-	{
-		i16 sample = (i16)(sinf(outputBuf->theta) * toneVolume);
-		outputBuf->theta += dtPerSample;
-		if (outputBuf->theta > Q_2PI)
-			outputBuf->theta -= Q_2PI;
-		for (u32 channel = 0; channel < outputBuf->channels; channel++)
-			*curSubSample++ = sample;
-	}
-}
-
 SoundBuffer_s*
 Qis_MakeSoundBuffer(Memory* memory, const int numSamples, const int channels, const int sampsPerSec)
 {
@@ -52,7 +26,7 @@ Qis_MakeSoundBuffer(Memory* memory, const int numSamples, const int channels, co
 
 	u8* mem = (u8*)M_AllocRaw(memory, totalBytes);
 
-	SoundBuffer_s* buffer  = (SoundBuffer_s*)M_AllocRaw(memory, totalBytes);
+	SoundBuffer_s* buffer  = (SoundBuffer_s*)mem;
 	buffer->numSamples     = numSamples;
 	buffer->channels       = channels;
 	buffer->bytesPerSample = channels * sizeof(i16);
@@ -66,11 +40,45 @@ Qis_MakeSoundBuffer(Memory* memory, const int numSamples, const int channels, co
 void
 Qis_UpdateSound(SoundBuffer_s* soundBuffer, const u32 samplesToWrite)
 {
-#if 0
-	GenTone(soundBuffer, samplesToWrite, (r32)g_sound->toneHz, (r32)g_sound->toneVolume);
-#else
-	memset(soundBuffer->samples, 0, samplesToWrite * soundBuffer->bytesPerSample);
-#endif
+	Assert(soundBuffer->channels == QI_SOUND_CHANNELS && soundBuffer->samplesPerSec == g_sound->mixer.samplesPerSec);
+	Assert(samplesToWrite <= soundBuffer->numSamples);
+	Mix_Render(&g_sound->mixer, soundBuffer->samples, samplesToWrite);
+}
+
+void
+Qis_SoundRestored()
+{
+	Mix_ResetCommands(&g_sound->mixer);
+}
+
+MixVoice_t
+Qis_Play(const MixClip_s* clip, const MixParams_s* params, bool loop)
+{
+	return Mix_Play(&g_sound->mixer, clip, params, loop);
+}
+
+MixVoice_t
+Qis_PlayStream(MixStream_s* stream, const MixParams_s* params)
+{
+	return Mix_PlayStream(&g_sound->mixer, stream, params);
+}
+
+void
+Qis_Stop(MixVoice_t voice)
+{
+	Mix_Stop(&g_sound->mixer, voice);
+}
+
+void
+Qis_SetParams(MixVoice_t voice, const MixParams_s* params)
+{
+	Mix_SetParams(&g_sound->mixer, voice, params);
+}
+
+void
+Qis_StopAll()
+{
+	Mix_StopAll(&g_sound->mixer);
 }
 
 static void Qis_Init(const SubSystem*, bool);
@@ -88,15 +96,12 @@ Qis_Init(const SubSystem* sys, bool isReinit)
     Assert(sys->globalPtr);
 	g_sound = (SoundGlobals_s*)sys->globalPtr;
 
+	// Voices play on through a reload, their clips are in game memory too
 	if (!isReinit)
-	{
-		memset(g_sound, 0, sizeof(*g_sound));
-		g_sound->toneHz     = 261.2f;
-		g_sound->toneVolume = 25000;
-	}
+		Mix_Init(&g_sound->mixer, QI_SOUND_SAMPLES_PER_SECOND);
 }
 
 static SoundFuncs_s s_sound = {
-    Qis_MakeSoundBuffer, Qis_UpdateSound,
+    Qis_MakeSoundBuffer, Qis_UpdateSound, Qis_SoundRestored,
 };
 const SoundFuncs_s* sound = &s_sound;
@@ -3,10 +3,13 @@
 //
 // Copyright 2017, Quantum Immortality Software and Jon Davis
 //
-// Sound API for QI engine
+// Sound API for QI engine. The game plays voices through the mixer (see mixer.h) and the platform pulls mixed
+// samples out with Update, on its audio thread as the device asks. Plays and the rest only queue commands, so they're
+// cheap, but the queue has a single producer: call them from the game's main thread only.
 //
 
 #include "basictypes.h"
+#include "mixer.h"
 
 #define QI_SOUND_SAMPLES_PER_SECOND 48000
 #define QI_SOUND_BYTES_PER_CHANNEL sizeof(i16)
@@ -33,13 +36,20 @@ static_assert(sizeof(SoundBuffer_s) == 32, "Wrong size for SoundBuffer_s");
 struct Memory;
 typedef SoundBuffer_s* Qis_MakeSoundBuffer_f(Memory* memory, const int numSamples, const int channels, const int sampsPerSec);
 typedef void Qis_UpdateSound_f(SoundBuffer_s* soundBuffer, const u32 samplesToWrite);
+typedef void Qis_SoundRestored_f();
 
-void Qis_Init();
+// Game side, all return or take 0 for a voice that couldn't be queued
+MixVoice_t Qis_Play(const MixClip_s* clip, const MixParams_s* params, bool loop = false);
+MixVoice_t Qis_PlayStream(MixStream_s* stream, const MixParams_s* params);
+void       Qis_Stop(MixVoice_t voice);
+void       Qis_SetParams(MixVoice_t voice, const MixParams_s* params);
+void       Qis_StopAll();
 
 struct SoundFuncs_s
 {
     Qis_MakeSoundBuffer_f* MakeBuffer;
     Qis_UpdateSound_f* Update;
+    Qis_SoundRestored_f* Restored; // Game memory was put back from a loop snapshot, with Update detached
 };
 
 #define __QI_SOUND_H
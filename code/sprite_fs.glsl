@@ -0,0 +1,20 @@
+#version 410 core
+
+uniform sampler2D tex;
+uniform sampler2DArray pages;
+
+in vec2 uv_frag;
+in vec4 color_frag;
+flat in int layer_frag;
+
+out vec4 fragColor;
+
+void main()
+{
+    vec4 texel;
+    if (layer_frag < 0)
+        texel = texture(tex, uv_frag.st);
+    else
+        texel = texture(pages, vec3(uv_frag.st, float(layer_frag)));
+    fragColor = color_frag * texel;
+}
@@ -0,0 +1,25 @@
+#version 410 core
+
+layout(location = 0) in vec2 corner;
+layout(location = 1) in vec4 destRect;
+layout(location = 2) in vec4 uvRect;
+layout(location = 3) in vec4 color;
+layout(location = 4) in uint texSlot;
+uniform mat4 projMtx;
+uniform vec2 offset;
+
+// Two texels per slot: uv offset and scale into its page, then the page layer (-1 for a standalone texture)
+uniform samplerBuffer slotRects;
+
+out vec2 uv_frag;
+out vec4 color_frag;
+flat out int layer_frag;
+
+void main()
+{
+    vec4 slotRect = texelFetch(slotRects, int(texSlot) * 2);
+    layer_frag = int(texelFetch(slotRects, int(texSlot) * 2 + 1).x);
+    uv_frag = slotRect.xy + mix(uvRect.xy, uvRect.zw, corner) * slotRect.zw;
+    color_frag = color;
+    gl_Position = projMtx * vec4(offset + destRect.xy + corner * destRect.zw, 0.0, 1.0);
+}
@@ -4,13 +4,36 @@
 // Test stuff
 //
 
+// Ahead of basictypes.h, whose 'internal' trips up the standard library headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <atomic>
+#include <thread>
+
 #include "basictypes.h"
 
 #include "vector.h"
 #include "noise.h"
 #include "lexer.h"
+#include "gjk.h"
+#include "collision.h"
+#include "game.h"
+#include "util.h"
+#include "entity.h"
+#include "pixelops.h"
+#include "bcn.h"
+#include "mixer.h"
+#include "bitmap.h"
+#include "hwi.h"
+#include "hw_soft.h"
+#include "imgui.h"
 
-#include <stdio.h>
+#include "stb_image.h"
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
 
 static_assert(sizeof(Vector4) == sizeof(r32) * 4, "Bad size");
 static_assert(GetVectorType<Vector4>::Type::Rank == 4, "Rank test fail");
@@ -20,6 +43,21 @@ static_assert(GetVectorRank<Vector2>::Value == 2, "Rank test fail");
 static_assert(GetVectorRank<float>::Value == 1, "Rank test fail");
 static_assert(HasType<RemoveReferenceCV<GetVectorType<Vector4>>>::Value == true, "HasType fail");
 
+// Checks keep going after a failure so one run reports everything; main returns nonzero if any failed
+static u32 s_testFailures = 0;
+
+#define TEST_CHECK(cond)                                                           \
+    do                                                                             \
+    {                                                                              \
+        if (!(cond))                                                               \
+        {                                                                          \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);        \
+            s_testFailures++;                                                      \
+        }                                                                          \
+    } while (0)
+
+#define TEST_NEAR(a, b, tol) TEST_CHECK(fabsf((a) - (b)) <= (tol))
+
 void
 Qi_Assert_Handler(const char* msg, const char* file, const int line)
 {
@@ -82,8 +120,926 @@ void testLex()
     } while(t != TOK_EOF);
 }
 
+// Manifolds with known answers: normal moves A out of B, points sit halfway across the overlap
+void testContacts()
+{
+    // Box vs box through GJK rather than the AABB path, overlapping by 0.5 across a full face
+    {
+        BoxShape_s  a(V2(0.0f, 0.0f), V2(1.0f, 1.0f));
+        BoxShape_s  b(V2(1.5f, 0.0f), V2(1.0f, 1.0f));
+        GjkResult_s result;
+        TEST_CHECK(Qi_Gjk(&result, &a, &b));
+        TEST_NEAR(result.penetrationNormal.x, -1.0f, 1.0e-3f);
+        TEST_NEAR(result.penetrationNormal.y, 0.0f, 1.0e-3f);
+        TEST_NEAR(result.penetrationDepth, 0.5f, 1.0e-3f);
+        TEST_CHECK(result.numContacts == 2);
+        if (result.numContacts == 2)
+        {
+            TEST_NEAR(result.contacts[0].point.x, 0.75f, 1.0e-3f);
+            TEST_NEAR(result.contacts[1].point.x, 0.75f, 1.0e-3f);
+            TEST_NEAR(fabsf(result.contacts[0].point.y), 1.0f, 1.0e-3f);
+            TEST_NEAR(result.contacts[0].point.y + result.contacts[1].point.y, 0.0f, 1.0e-3f);
+            TEST_NEAR(result.contacts[0].depth, 0.5f, 1.0e-3f);
+        }
+    }
+
+    // Square vs diamond, the diamond's tip 0.2 into the square's right face, so one point
+    {
+        const v2 squarePts[]  = {V2(-1.0f, -1.0f), V2(-1.0f, 1.0f), V2(1.0f, 1.0f), V2(1.0f, -1.0f)};
+        const v2 diamondPts[] = {V2(0.8f, 0.0f), V2(1.8f, 1.0f), V2(2.8f, 0.0f), V2(1.8f, -1.0f)};
+        PolyShape_s a(squarePts, countof(squarePts));
+        PolyShape_s b(diamondPts, countof(diamondPts));
+        GjkResult_s result;
+        TEST_CHECK(Qi_Gjk(&result, &a, &b));
+        TEST_NEAR(result.penetrationNormal.x, -1.0f, 1.0e-3f);
+        TEST_NEAR(result.penetrationNormal.y, 0.0f, 1.0e-3f);
+        TEST_NEAR(result.penetrationDepth, 0.2f, 1.0e-3f);
+        TEST_CHECK(result.numContacts == 1);
+        TEST_NEAR(result.contacts[0].point.x, 0.9f, 1.0e-3f);
+        TEST_NEAR(result.contacts[0].point.y, 0.0f, 1.0e-3f);
+    }
+
+    // Curved against flat still reports a point. EPA on a circle stops at a tolerance, so looser checks.
+    {
+        CircleShape_s a(V2(0.0f, 0.0f), 1.0f);
+        BoxShape_s    b(V2(1.5f, 0.0f), V2(1.0f, 1.0f));
+        GjkResult_s   result;
+        TEST_CHECK(Qi_Gjk(&result, &a, &b));
+        TEST_NEAR(result.penetrationNormal.x, -1.0f, 2.0e-2f);
+        TEST_NEAR(result.penetrationDepth, 0.5f, 1.0e-3f);
+        TEST_CHECK(result.numContacts == 1);
+        TEST_NEAR(result.contacts[0].point.x, 0.75f, 2.0e-2f);
+    }
+
+    // Separated shapes report nothing
+    {
+        BoxShape_s  a(V2(0.0f, 0.0f), V2(1.0f, 1.0f));
+        BoxShape_s  b(V2(3.0f, 0.0f), V2(1.0f, 1.0f));
+        GjkResult_s result;
+        TEST_CHECK(!Qi_Gjk(&result, &a, &b));
+    }
+}
+
+// Distance and time of impact with known answers
+void testGjkQueries()
+{
+    {
+        CircleShape_s a(V2(0.0f, 0.0f), 1.0f);
+        CircleShape_s b(V2(5.0f, 0.0f), 1.0f);
+        GjkDistance_s dist;
+        TEST_CHECK(Qi_GjkDistance(&dist, &a, &b));
+        TEST_NEAR(dist.distance, 3.0f, 1.0e-3f);
+        TEST_NEAR(dist.normal.x, -1.0f, 1.0e-3f);
+        TEST_NEAR(dist.normal.y, 0.0f, 1.0e-3f);
+        TEST_NEAR(dist.pointA.x, 1.0f, 1.0e-3f);
+        TEST_NEAR(dist.pointB.x, 4.0f, 1.0e-3f);
+    }
+
+    {
+        BoxShape_s    a(V2(0.0f, 0.0f), V2(1.0f, 1.0f));
+        BoxShape_s    b(V2(4.0f, 1.0f), V2(1.0f, 1.0f));
+        GjkDistance_s dist;
+        TEST_CHECK(Qi_GjkDistance(&dist, &a, &b));
+        TEST_NEAR(dist.distance, 2.0f, 1.0e-4f);
+        TEST_NEAR(dist.normal.x, -1.0f, 1.0e-4f);
+        TEST_NEAR(dist.normal.y, 0.0f, 1.0e-4f);
+
+        // Overlapping shapes have no distance
+        BoxShape_s c(V2(1.5f, 0.0f), V2(1.0f, 1.0f));
+        TEST_CHECK(!Qi_GjkDistance(&dist, &a, &c));
+    }
+
+    // Circle into a box face: touches after 3 of the 10 units, less the half tolerance gap
+    {
+        CircleShape_s  a(V2(0.0f, 0.0f), 1.0f);
+        BoxShape_s     b(V2(5.0f, 0.0f), V2(1.0f, 1.0f));
+        GjkToiResult_s toi;
+        TEST_CHECK(Qi_TimeOfImpact(&toi, &a, V2(10.0f, 0.0f), &b));
+        TEST_NEAR(toi.time, 0.3f, 1.0e-3f);
+        TEST_CHECK(toi.time <= 0.3f);
+        TEST_NEAR(toi.normal.x, -1.0f, 1.0e-3f);
+        TEST_NEAR(toi.point.x, 4.0f, 1.0e-3f);
+
+        // Moving past misses
+        TEST_CHECK(!Qi_TimeOfImpact(&toi, &a, V2(0.0f, 10.0f), &b));
+    }
+
+    // Already overlapping: time 0 and the way out
+    {
+        CircleShape_s  a(V2(3.5f, 0.0f), 1.0f);
+        BoxShape_s     b(V2(5.0f, 0.0f), V2(1.0f, 1.0f));
+        GjkToiResult_s toi;
+        TEST_CHECK(Qi_TimeOfImpact(&toi, &a, V2(10.0f, 0.0f), &b));
+        TEST_CHECK(toi.time == 0.0f);
+        TEST_NEAR(toi.normal.x, -1.0f, 2.0e-2f);
+    }
+
+    // Box pairs take the analytic sweep, which is exact
+    {
+        BoxShape_s     a(V2(0.0f, 0.0f), V2(1.0f, 1.0f));
+        BoxShape_s     b(V2(5.0f, 0.5f), V2(1.0f, 1.0f));
+        GjkToiResult_s toi;
+        TEST_CHECK(Qi_TimeOfImpact(&toi, &a, V2(10.0f, 0.0f), &b));
+        TEST_NEAR(toi.time, 0.3f, 1.0e-5f);
+        TEST_NEAR(toi.normal.x, -1.0f, 1.0e-5f);
+    }
+}
+
+// Wedged into a corner: two planes solved together, duplicates along a wall merge, and input order doesn't matter
+void testResolveContacts()
+{
+    GjkResult_s results[3] = {};
+    results[0].penetrationNormal = V2(1.0f, 0.0f);
+    results[0].penetrationDepth  = 0.3f;
+    results[0].intersected       = true;
+    results[1].penetrationNormal = V2(0.0f, 1.0f);
+    results[1].penetrationDepth  = 0.2f;
+    results[1].intersected       = true;
+    results[2].penetrationNormal = V2(1.0f, 0.0f);
+    results[2].penetrationDepth  = 0.1f;
+    results[2].intersected       = true;
+
+    v2       velocity   = V2(-1.0f, 2.0f);
+    const v2 correction = Col_ResolveContacts(results, countof(results), &velocity);
+    TEST_NEAR(correction.x, 0.3f, 1.0e-5f);
+    TEST_NEAR(correction.y, 0.2f, 1.0e-5f);
+    TEST_NEAR(velocity.x, 0.0f, 1.0e-5f);
+    TEST_NEAR(velocity.y, 2.0f, 1.0e-5f);
+
+    GjkResult_s reversed[countof(results)];
+    for (i32 ri = 0; ri < countof(results); ri++)
+        reversed[ri] = results[countof(results) - 1 - ri];
+
+    const v2 reversedCorrection = Col_ResolveContacts(reversed, countof(reversed), nullptr);
+    TEST_CHECK(reversedCorrection.x == correction.x && reversedCorrection.y == correction.y);
+
+    // Nothing intersecting, nothing to do
+    results[0].intersected = results[1].intersected = results[2].intersected = false;
+    velocity                                         = V2(-1.0f, -1.0f);
+    const v2 none                                    = Col_ResolveContacts(results, countof(results), &velocity);
+    TEST_CHECK(none.x == 0.0f && none.y == 0.0f && velocity.x == -1.0f && velocity.y == -1.0f);
+
+    // Axis contacts folded from overlapping boxes match resolving the overlaps themselves
+    const Aabb_s body    = {V2(0.0f, 0.0f), V2(1.0f, 1.0f)};
+    const Aabb_s walls[] = {{V2(-1.0f, -0.5f), V2(0.25f, 2.0f)}, {V2(-1.0f, -1.0f), V2(2.0f, 0.1f)}};
+
+    GjkResult_s       wallResults[countof(walls)];
+    ColAxisContacts_s axisContacts = {};
+    for (i32 wi = 0; wi < countof(walls); wi++)
+    {
+        TEST_CHECK(Qi_AabbOverlap(&wallResults[wi], &body, &walls[wi]));
+        Col_AddAxisContact(&axisContacts, wallResults[wi].penetrationNormal, wallResults[wi].penetrationDepth);
+    }
+
+    const v2 direct = Col_ResolveContacts(wallResults, countof(wallResults), nullptr);
+    const v2 folded = Col_ResolveAxisContacts(&axisContacts, nullptr);
+    TEST_NEAR(direct.x, 0.25f, 1.0e-5f);
+    TEST_NEAR(direct.y, 0.1f, 1.0e-5f);
+    TEST_CHECK(folded.x == direct.x && folded.y == direct.y);
+}
+
+// Narrow phase throughput: mixed circles and 16 point polys, run pair by pair and through the batch entry point
+#define GJK_BENCH_SHAPES 1024
+#define GJK_BENCH_PAIRS  65536
+#define GJK_BENCH_ROUNDS 16
+
+static r32 BenchRand(r32 lo, r32 hi)
+{
+    return lo + (hi - lo) * ((r32)rand() / (r32)RAND_MAX);
+}
+
+void testGjkBench()
+{
+    static PolyShape_s polys[GJK_BENCH_SHAPES];
+    static CircleShape_s* circles[GJK_BENCH_SHAPES];
+    static GjkPair_s pairs[GJK_BENCH_PAIRS];
+    static GjkResult_s results[GJK_BENCH_PAIRS];
+
+    srand(1234);
+    for (u32 i = 0; i < GJK_BENCH_SHAPES; i++)
+    {
+        const v2 center = V2(BenchRand(0.0f, 20.0f), BenchRand(0.0f, 20.0f));
+        const r32 radius = BenchRand(0.5f, 1.5f);
+        v2 pts[16];
+        for (u32 p = 0; p < 16; p++)
+        {
+            const r32 ang = (r32)p * (2.0f * 3.14159265f / 16.0f);
+            pts[p] = center + V2(cosf(ang), sinf(ang)) * radius;
+        }
+        polys[i] = PolyShape_s(pts, 16);
+        circles[i] = new CircleShape_s(V2(BenchRand(0.0f, 20.0f), BenchRand(0.0f, 20.0f)), BenchRand(0.5f, 1.5f));
+    }
+
+    // Sorted by type the way a broad phase would emit them: poly/poly first, then poly/circle
+    for (u32 i = 0; i < GJK_BENCH_PAIRS; i++)
+    {
+        pairs[i].a = &polys[rand() % GJK_BENCH_SHAPES];
+        if (i < GJK_BENCH_PAIRS / 2)
+            pairs[i].b = &polys[rand() % GJK_BENCH_SHAPES];
+        else
+            pairs[i].b = circles[rand() % GJK_BENCH_SHAPES];
+    }
+
+    typedef std::chrono::high_resolution_clock Clock;
+    u32 hits = 0;
+
+    auto start = Clock::now();
+    for (u32 round = 0; round < GJK_BENCH_ROUNDS; round++)
+        for (u32 i = 0; i < GJK_BENCH_PAIRS; i++)
+            hits += Qi_Gjk(&results[i], pairs[i].a, pairs[i].b) ? 1 : 0;
+    const double singleSecs = std::chrono::duration<double>(Clock::now() - start).count();
+
+    start = Clock::now();
+    for (u32 round = 0; round < GJK_BENCH_ROUNDS; round++)
+        hits += Qi_GjkBatch(results, pairs, GJK_BENCH_PAIRS);
+    const double batchSecs = std::chrono::duration<double>(Clock::now() - start).count();
+
+    const double numPairs = (double)GJK_BENCH_PAIRS * GJK_BENCH_ROUNDS;
+    printf("gjk: %.2f Mpairs/s single, %.2f Mpairs/s batched (%u hits)\n", numPairs / singleSecs * 1e-6, numPairs / batchSecs * 1e-6, hits);
+
+    for (u32 i = 0; i < GJK_BENCH_SHAPES; i++)
+        delete circles[i];
+}
+
+// Minimal stand in for the platform job pool: workers spin on a batch counter so fork / join costs stay small
+// next to the work being measured
+#define BENCH_MAX_THREADS 16
+
+struct BenchPool_s
+{
+    std::thread      threads[BENCH_MAX_THREADS];
+    u32              numThreads; // Counting the caller
+    std::atomic<u32> batch;
+    std::atomic<u32> nextJob;
+    std::atomic<u32> numDone;
+    std::atomic<bool> quit;
+    QiJob_f*         job;
+    void*            userData;
+    u32              numJobs;
+};
+
+static BenchPool_s s_benchPool;
+
+static void BenchRunJobs()
+{
+    for (u32 jobIdx; (jobIdx = s_benchPool.nextJob++) < s_benchPool.numJobs;)
+        s_benchPool.job(s_benchPool.userData, jobIdx);
+}
+
+static void BenchWorker()
+{
+    u32 seen = 0;
+    for (;;)
+    {
+        while (s_benchPool.batch.load() == seen && !s_benchPool.quit.load())
+            std::this_thread::yield();
+        if (s_benchPool.quit.load())
+            return;
+        seen = s_benchPool.batch.load();
+        BenchRunJobs();
+        s_benchPool.numDone++;
+    }
+}
+
+static void BenchParallelFor(QiJob_f* job, void* userData, u32 numJobs)
+{
+    s_benchPool.job      = job;
+    s_benchPool.userData = userData;
+    s_benchPool.numJobs  = numJobs;
+    s_benchPool.nextJob  = 0;
+    s_benchPool.numDone  = 0;
+    s_benchPool.batch++;
+
+    BenchRunJobs();
+    while (s_benchPool.numDone.load() < s_benchPool.numThreads - 1)
+        std::this_thread::yield();
+}
+
+static u32 BenchNumThreads()
+{
+    return s_benchPool.numThreads;
+}
+
+static void BenchStartPool(u32 numThreads)
+{
+    s_benchPool.quit       = false;
+    s_benchPool.numThreads = numThreads;
+    for (u32 ti = 0; ti + 1 < numThreads; ti++)
+        s_benchPool.threads[ti] = std::thread(BenchWorker);
+}
+
+static void BenchStopPool()
+{
+    s_benchPool.quit = true;
+    for (u32 ti = 0; ti + 1 < s_benchPool.numThreads; ti++)
+        s_benchPool.threads[ti].join();
+}
+
+// Only the job pool is stood in for, main fills it in and everything else stays null
+static PlatFuncs_s s_benchPlat = {};
+const PlatFuncs_s* plat        = &s_benchPlat;
+
+extern SubSystem EntitySubSystem;
+
+// A fresh entity manager in its own memory, free the pointer returned when done
+static void* InitTestEnts()
+{
+    SubSystem sys = EntitySubSystem;
+    sys.globalPtr = malloc(sys.globalSize);
+    sys.initFunc(&sys, false);
+    return sys.globalPtr;
+}
+
+// Handles, index reuse and moving between archetypes
+#define ENT_TEST_CHURN 5000
+
+void testEntities()
+{
+    void* ents = InitTestEnts();
+
+    const Ent a = EntManager::create(ENT_COMP_BIT(ENT_COMP_TRANSFORM));
+    const Ent b = EntManager::create(ENT_COMP_BIT(ENT_COMP_TRANSFORM));
+    TEST_CHECK(a != b && EntManager::isAlive(a) && EntManager::isAlive(b));
+    TEST_CHECK(a.generation() == 0);
+    TEST_CHECK(EntManager::numAlive() == 2);
+    TEST_CHECK(!EntManager::isAlive(Ent::null()));
+
+    // Destroying a moves b into its row; b's handle still finds b's data and a's finds nothing
+    EntManager::get<TransformComp_s>(b)->pos = V2(3.0f, 4.0f);
+    EntManager::destroy(a);
+    TEST_CHECK(!EntManager::isAlive(a));
+    TEST_CHECK(EntManager::get<TransformComp_s>(a) == nullptr);
+    TEST_CHECK(EntManager::get<TransformComp_s>(b)->pos.x == 3.0f && EntManager::get<TransformComp_s>(b)->pos.y == 4.0f);
+    EntManager::destroy(a);
+    TEST_CHECK(EntManager::numAlive() == 1);
+
+    // A freed index isn't handed out again straight away...
+    const Ent c = EntManager::create();
+    TEST_CHECK(c.index() != a.index());
+
+    // ...only once plenty more are free, and then with the next generation so the old handle stays dead
+    static Ent churn[ENT_TEST_CHURN];
+    for (u32 i = 0; i < ENT_TEST_CHURN; i++)
+        churn[i] = EntManager::create();
+    for (u32 i = 0; i < ENT_TEST_CHURN; i++)
+        EntManager::destroy(churn[i]);
+
+    const Ent reused = EntManager::create();
+    TEST_CHECK(reused.index() == a.index());
+    TEST_CHECK(reused.generation() == a.generation() + 1);
+    TEST_CHECK(EntManager::isAlive(reused) && !EntManager::isAlive(a));
+    TEST_CHECK(EntManager::numAlive() == 3);
+
+    // Adding and removing components moves the entity, keeping the components it still has
+    const Ent d = EntManager::create(ENT_COMP_BIT(ENT_COMP_TRANSFORM));
+    EntManager::get<TransformComp_s>(d)->pos = V2(1.0f, 2.0f);
+    TEST_CHECK(EntManager::get<VelocityComp_s>(d) == nullptr);
+
+    VelocityComp_s vel = {};
+    vel.vel            = V2(5.0f, 6.0f);
+    EntManager::add(d, vel);
+    TEST_CHECK(EntManager::get<TransformComp_s>(d)->pos.x == 1.0f && EntManager::get<TransformComp_s>(d)->pos.y == 2.0f);
+    TEST_CHECK(EntManager::get<VelocityComp_s>(d)->vel.x == 5.0f && EntManager::get<VelocityComp_s>(d)->vel.y == 6.0f);
+
+    EntManager::remove<TransformComp_s>(d);
+    TEST_CHECK(EntManager::get<TransformComp_s>(d) == nullptr);
+    TEST_CHECK(EntManager::get<VelocityComp_s>(d)->vel.x == 5.0f);
+
+    // d is the only thing with a velocity
+    EntQuery_s query;
+    query.all  = ENT_COMP_BIT(ENT_COMP_VELOCITY);
+    query.none = 0;
+
+    EntSpan_s spans[4];
+    const u32 numSpans = Ent_Query(&query, spans, countof(spans));
+    TEST_CHECK(numSpans == 1 && spans[0].count == 1 && spans[0].ents[0] == d);
+    TEST_CHECK(numSpans == 1 && spans[0].Get<TransformComp_s>() == nullptr);
+
+    free(ents);
+}
+
+// Archetype storage + scheduler: integrate and sprite animation share a phase, damping has to wait for integrate
+#define ECS_BENCH_ENTS   60000
+#define ECS_BENCH_ROUNDS 200
+
+static void BenchDamp(const EntSpan_s* span, r32 dT)
+{
+    VelocityComp_s* vels = span->Get<VelocityComp_s>();
+    for (u32 ei = 0; ei < span->count; ei++)
+        vels[ei].vel *= 1.0f - 0.1f * dT;
+}
+
+static void BenchAnimate(const EntSpan_s* span, r32)
+{
+    SpriteComp_s* sprites = span->Get<SpriteComp_s>();
+    for (u32 ei = 0; ei < span->count; ei++)
+        sprites[ei].frame = (u16)((sprites[ei].frame + 1) & 7);
+}
+
+// Integrate and animate share a phase and damping waits for integrate, so every position moves by the velocity from
+// before damping. Run on a couple of threads so chunks really do go out at once.
+#define ENT_TEST_SYSTEM_ENTS 3000
+
+void testEntitySystems()
+{
+    void* ents = InitTestEnts();
+
+    for (u32 i = 0; i < ENT_TEST_SYSTEM_ENTS; i++)
+    {
+        u32 mask = ENT_COMP_BIT(ENT_COMP_TRANSFORM) | ENT_COMP_BIT(ENT_COMP_VELOCITY);
+        if (i & 1)
+            mask |= ENT_COMP_BIT(ENT_COMP_SPRITE);
+
+        const Ent ent = EntManager::create(mask);
+        EntManager::get<TransformComp_s>(ent)->pos = V2((r32)i, 0.0f);
+        EntManager::get<VelocityComp_s>(ent)->vel  = V2(1.0f, 2.0f);
+    }
+
+    const EntSystem_s systems[] = {
+        {"Integrate", Ent_Integrate, ENT_COMP_BIT(ENT_COMP_VELOCITY), ENT_COMP_BIT(ENT_COMP_TRANSFORM), 0},
+        {"Animate", BenchAnimate, 0, ENT_COMP_BIT(ENT_COMP_SPRITE), 0},
+        {"Damp", BenchDamp, 0, ENT_COMP_BIT(ENT_COMP_VELOCITY), 0},
+    };
+    const r32 dT = 0.5f;
+
+    BenchStartPool(2);
+    Ent_RunSystems(systems, countof(systems), dT);
+    BenchStopPool();
+
+    const r32 damping = 1.0f - 0.1f * dT;
+
+    EntQuery_s query;
+    query.all  = ENT_COMP_BIT(ENT_COMP_TRANSFORM) | ENT_COMP_BIT(ENT_COMP_VELOCITY);
+    query.none = 0;
+
+    EntSpan_s spans[QI_ENT_MAX_CHUNKS];
+    const u32 numSpans  = Ent_Query(&query, spans, countof(spans));
+    u32       numSeen   = 0;
+    u32       numWrong  = 0;
+    u32       numFrames = 0;
+    for (u32 si = 0; si < numSpans; si++)
+    {
+        const EntSpan_s*       span    = &spans[si];
+        const TransformComp_s* xforms  = span->Get<TransformComp_s>();
+        const VelocityComp_s*  vels    = span->Get<VelocityComp_s>();
+        const SpriteComp_s*    sprites = span->Get<SpriteComp_s>();
+        for (u32 ei = 0; ei < span->count; ei++)
+        {
+            const r32 startX = (r32)span->ents[ei].index();
+            numWrong += fabsf(xforms[ei].pos.x - (startX + 1.0f * dT)) > 1.0e-4f || fabsf(xforms[ei].pos.y - 2.0f * dT) > 1.0e-6f ? 1 : 0;
+            numWrong += fabsf(vels[ei].vel.x - 1.0f * damping) > 1.0e-6f || fabsf(vels[ei].vel.y - 2.0f * damping) > 1.0e-6f ? 1 : 0;
+            if (sprites)
+                numFrames += sprites[ei].frame;
+        }
+        numSeen += span->count;
+    }
+
+    TEST_CHECK(numSeen == ENT_TEST_SYSTEM_ENTS);
+    TEST_CHECK(numWrong == 0);
+    TEST_CHECK(numFrames == ENT_TEST_SYSTEM_ENTS / 2);
+
+    free(ents);
+}
+
+void testEcsBench()
+{
+    void* ents = InitTestEnts();
+
+    srand(4321);
+    for (u32 i = 0; i < ECS_BENCH_ENTS; i++)
+    {
+        u32 mask = ENT_COMP_BIT(ENT_COMP_TRANSFORM) | ENT_COMP_BIT(ENT_COMP_VELOCITY);
+        if (i & 1)
+            mask |= ENT_COMP_BIT(ENT_COMP_SPRITE);
+        if ((i & 3) == 0)
+            mask |= ENT_COMP_BIT(ENT_COMP_COLLIDER);
+
+        const Ent ent = EntManager::create(mask);
+        EntManager::get<TransformComp_s>(ent)->pos = V2(BenchRand(0.0f, 100.0f), BenchRand(0.0f, 100.0f));
+        EntManager::get<VelocityComp_s>(ent)->vel  = V2(BenchRand(-1.0f, 1.0f), BenchRand(-1.0f, 1.0f));
+    }
+
+    const EntSystem_s systems[] = {
+        {"Integrate", Ent_Integrate, ENT_COMP_BIT(ENT_COMP_VELOCITY), ENT_COMP_BIT(ENT_COMP_TRANSFORM), 0},
+        {"Animate", BenchAnimate, 0, ENT_COMP_BIT(ENT_COMP_SPRITE), 0},
+        {"Damp", BenchDamp, 0, ENT_COMP_BIT(ENT_COMP_VELOCITY), 0},
+    };
+    const double updatesPerRound = ECS_BENCH_ENTS * 2.0 + ECS_BENCH_ENTS / 2.0;
+
+    typedef std::chrono::high_resolution_clock Clock;
+    const u32 hwThreads  = std::thread::hardware_concurrency();
+    const u32 maxThreads = hwThreads < 1 ? 1 : (hwThreads > BENCH_MAX_THREADS ? BENCH_MAX_THREADS : hwThreads);
+    u32 numRounds = 0;
+    for (u32 numThreads = 1; numThreads <= maxThreads; numThreads *= 2)
+    {
+        BenchStartPool(numThreads);
+        auto start = Clock::now();
+        for (u32 round = 0; round < ECS_BENCH_ROUNDS; round++)
+            Ent_RunSystems(systems, countof(systems), 1.0f / 60.0f);
+        numRounds += ECS_BENCH_ROUNDS;
+        const double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        BenchStopPool();
+
+        printf("ecs: %u threads, %.0f entity updates/ms\n", numThreads, updatesPerRound * ECS_BENCH_ROUNDS / ms);
+    }
+
+    // Every sprite went through every round exactly once, whatever the thread count
+    EntQuery_s query;
+    query.all  = ENT_COMP_BIT(ENT_COMP_SPRITE);
+    query.none = 0;
+
+    EntSpan_s spans[QI_ENT_MAX_CHUNKS];
+    const u32 numSpans   = Ent_Query(&query, spans, countof(spans));
+    u32       numSprites = 0;
+    u32       numWrong   = 0;
+    for (u32 si = 0; si < numSpans; si++)
+    {
+        const SpriteComp_s* sprites = spans[si].Get<SpriteComp_s>();
+        for (u32 ei = 0; ei < spans[si].count; ei++)
+            numWrong += sprites[ei].frame != (numRounds & 7) ? 1 : 0;
+        numSprites += spans[si].count;
+    }
+    TEST_CHECK(EntManager::numAlive() == ECS_BENCH_ENTS);
+    TEST_CHECK(numSprites == ECS_BENCH_ENTS / 2);
+    TEST_CHECK(numWrong == 0);
+
+    free(ents);
+}
+
+#define PX_BENCH_PIXELS 4096
+#define PX_BENCH_ROUNDS 4000
+
+void testPixelOpsBench()
+{
+    static u32 src[PX_BENCH_PIXELS];
+    static u32 dst[PX_BENCH_PIXELS];
+    static u32 ref[PX_BENCH_PIXELS];
+    static u8  rgb[PX_BENCH_PIXELS * 3];
+
+    srand(5678);
+    for (u32 i = 0; i < PX_BENCH_PIXELS; i++)
+    {
+        src[i] = ((u32)rand() << 16) ^ (u32)rand();
+        dst[i] = ((u32)rand() << 16) ^ (u32)rand();
+    }
+    for (i32 i = 0; i < countof(rgb); i++)
+        rgb[i] = (u8)rand();
+
+    typedef std::chrono::high_resolution_clock Clock;
+    const double numPixels = (double)PX_BENCH_PIXELS * PX_BENCH_ROUNDS;
+    const char *blendNames[PX_BLEND_COUNT] = {"copy", "over", "over premul", "add dst alpha"};
+    const u32 tint = 0xC0FF80FF;
+
+    for (u32 blend = 0; blend < PX_BLEND_COUNT; blend++)
+    {
+        // The wide paths have to match the scalar reference exactly, including the tail
+        u32 mismatches = 0;
+        memcpy(ref, dst, sizeof(dst));
+        Px_BlendSpan(ref, src, PX_BENCH_PIXELS - 3, tint, (PxBlend_e)blend);
+        for (u32 i = 0; i < PX_BENCH_PIXELS; i++)
+        {
+            const u32 expected = i < PX_BENCH_PIXELS - 3 ? Px_BlendPixel(dst[i], Px_Mul(src[i], tint), (PxBlend_e)blend) : dst[i];
+            mismatches += ref[i] != expected ? 1 : 0;
+        }
+
+        auto start = Clock::now();
+        for (u32 round = 0; round < PX_BENCH_ROUNDS; round++)
+            Px_BlendSpan(ref, src, PX_BENCH_PIXELS, PX_WHITE, (PxBlend_e)blend);
+        const double plainSecs = std::chrono::duration<double>(Clock::now() - start).count();
+
+        start = Clock::now();
+        for (u32 round = 0; round < PX_BENCH_ROUNDS; round++)
+            Px_BlendSpan(ref, src, PX_BENCH_PIXELS, tint, (PxBlend_e)blend);
+        const double tintSecs = std::chrono::duration<double>(Clock::now() - start).count();
+
+        start = Clock::now();
+        for (u32 round = 0; round < PX_BENCH_ROUNDS; round++)
+            Px_FillSpan(ref, PX_BENCH_PIXELS, tint, (PxBlend_e)blend);
+        const double fillSecs = std::chrono::duration<double>(Clock::now() - start).count();
+
+        // Same again for fills
+        memcpy(ref, dst, sizeof(dst));
+        Px_FillSpan(ref, PX_BENCH_PIXELS - 3, tint, (PxBlend_e)blend);
+        for (u32 i = 0; i < PX_BENCH_PIXELS; i++)
+        {
+            const u32 expected = i < PX_BENCH_PIXELS - 3 ? Px_BlendPixel(dst[i], tint, (PxBlend_e)blend) : dst[i];
+            mismatches += ref[i] != expected ? 1 : 0;
+        }
+
+        printf("pixelops %s: %.0f Mpx/s, %.0f Mpx/s tinted, %.0f Mpx/s fill (%u mismatches)\n", blendNames[blend],
+               numPixels / plainSecs * 1e-6, numPixels / tintSecs * 1e-6, numPixels / fillSecs * 1e-6, mismatches);
+        TEST_CHECK(mismatches == 0);
+    }
+
+    // Conversions against what the scalar tails do
+    u32 convertMismatches = 0;
+    Px_ConvertToRGBA8(ref, src, PX_BENCH_PIXELS, Bitmap::RGBA8, true);
+    for (u32 i = 0; i < PX_BENCH_PIXELS; i++)
+        convertMismatches += ref[i] != (src[i] | 0xFF000000) ? 1 : 0;
+    Px_ConvertToRGBA8(ref, rgb, PX_BENCH_PIXELS, Bitmap::RGB8);
+    for (u32 i = 0; i < PX_BENCH_PIXELS; i++)
+        convertMismatches += ref[i] != (0xFF000000 | (u32)rgb[i * 3 + 2] << 16 | (u32)rgb[i * 3 + 1] << 8 | rgb[i * 3]) ? 1 : 0;
+    Px_Premultiply(ref, src, PX_BENCH_PIXELS);
+    for (u32 i = 0; i < PX_BENCH_PIXELS; i++)
+        convertMismatches += ref[i] != Px_Mul(src[i], ((src[i] >> 24) * 0x00010101) | 0xFF000000) ? 1 : 0;
+    TEST_CHECK(convertMismatches == 0);
+
+    auto start = Clock::now();
+    for (u32 round = 0; round < PX_BENCH_ROUNDS; round++)
+        Px_ConvertToRGBA8(ref, src, PX_BENCH_PIXELS, Bitmap::RGBA8, true);
+    const double opaqueSecs = std::chrono::duration<double>(Clock::now() - start).count();
+
+    start = Clock::now();
+    for (u32 round = 0; round < PX_BENCH_ROUNDS; round++)
+        Px_ConvertToRGBA8(ref, rgb, PX_BENCH_PIXELS, Bitmap::RGB8);
+    const double rgbSecs = std::chrono::duration<double>(Clock::now() - start).count();
+
+    start = Clock::now();
+    for (u32 round = 0; round < PX_BENCH_ROUNDS; round++)
+        Px_Premultiply(ref, src, PX_BENCH_PIXELS);
+    const double premulSecs = std::chrono::duration<double>(Clock::now() - start).count();
+
+    printf("pixelops convert: %.0f Mpx/s RGBA8 opaque, %.0f Mpx/s RGB8, %.0f Mpx/s premultiply\n", numPixels / opaqueSecs * 1e-6,
+           numPixels / rgbSecs * 1e-6, numPixels / premulSecs * 1e-6);
+
+    // src as 64 x 64, down to 32 x 32 in ref. Transparent quads too, which take the plain average.
+    for (u32 i = 0; i < PX_BENCH_PIXELS; i += 7)
+        src[i] &= 0x00FFFFFF;
+    u32 downMismatches = 0;
+    Px_Downsample2x(ref, src, 64, 64, 64);
+    for (u32 y = 0; y < 32; y++)
+        for (u32 x = 0; x < 32; x++)
+        {
+            const u32 *quad = src + y * 2 * 64 + x * 2;
+            downMismatches += ref[y * 32 + x] != Px_AverageQuad(quad[0], quad[1], quad[64], quad[65]) ? 1 : 0;
+        }
+
+    start = Clock::now();
+    for (u32 round = 0; round < PX_BENCH_ROUNDS; round++)
+        Px_Downsample2x(ref, src, 64, 64, 64);
+    const double downSecs = std::chrono::duration<double>(Clock::now() - start).count();
+
+    printf("pixelops downsample: %.0f Mpx/s (%u mismatches)\n", numPixels / downSecs * 1e-6, downMismatches);
+    TEST_CHECK(downMismatches == 0);
+}
+
+#define BC_BENCH_SIZE   256
+#define BC_BENCH_ROUNDS 4
+
+void testBlockCompressionBench()
+{
+    static u32 src[BC_BENCH_SIZE * BC_BENCH_SIZE];
+    static u32 dst[BC_BENCH_SIZE * BC_BENCH_SIZE];
+    static u8  blocks[BC_BENCH_SIZE * BC_BENCH_SIZE];
+
+    // Smooth color with some noise on top and a soft edged disc of alpha, roughly what the sprite sheets hold
+    srand(9012);
+    for (u32 y = 0; y < BC_BENCH_SIZE; y++)
+    {
+        for (u32 x = 0; x < BC_BENCH_SIZE; x++)
+        {
+            const int dx = (int)x % 64 - 32, dy = (int)y % 64 - 32;
+            const int alpha = Min(Max(255 - (dx * dx + dy * dy - 600) / 2, 0), 255);
+            const u32 r = (x + rand() % 8) & 0xFF, g = (y + rand() % 8) & 0xFF, b = ((x + y) / 2) & 0xFF;
+            src[y * BC_BENCH_SIZE + x] = (u32)alpha << 24 | b << 16 | g << 8 | r;
+        }
+    }
+
+    typedef std::chrono::high_resolution_clock Clock;
+    const double numPixels = (double)BC_BENCH_SIZE * BC_BENCH_SIZE * BC_BENCH_ROUNDS;
+    const Bitmap::Format formats[] = {Bitmap::BC1, Bitmap::BC3, Bitmap::BC7};
+    const char *formatNames[] = {"BC1", "BC3", "BC7"};
+
+    // Quality floors, well under what the encoders manage, so a broken encode or decode fails rather than just
+    // printing a low number. BC1's alpha is a single bit and isn't held to anything.
+    const double minColorDb[] = {30.0, 30.0, 35.0};
+    const double minAlphaDb[] = {0.0, 30.0, 30.0};
+
+    for (i32 fi = 0; fi < countof(formats); fi++)
+    {
+        auto start = Clock::now();
+        for (u32 round = 0; round < BC_BENCH_ROUNDS; round++)
+            Bc_Encode(formats[fi], blocks, src, BC_BENCH_SIZE, BC_BENCH_SIZE, BC_BENCH_SIZE);
+        const double encodeSecs = std::chrono::duration<double>(Clock::now() - start).count();
+
+        start = Clock::now();
+        for (u32 round = 0; round < BC_BENCH_ROUNDS; round++)
+            Bc_Decode(formats[fi], dst, BC_BENCH_SIZE, blocks, BC_BENCH_SIZE, BC_BENCH_SIZE);
+        const double decodeSecs = std::chrono::duration<double>(Clock::now() - start).count();
+
+        // Color error only where it's visible, BC1 makes no attempt at partial alpha
+        double colorErr = 0.0, alphaErr = 0.0;
+        for (u32 i = 0; i < BC_BENCH_SIZE * BC_BENCH_SIZE; i++)
+        {
+            const u32 a = src[i] >> 24;
+            for (u32 c = 0; c < 24; c += 8)
+            {
+                const double d = (double)((src[i] >> c) & 0xFF) - (double)((dst[i] >> c) & 0xFF);
+                colorErr += d * d * a / 255.0;
+            }
+            const double d = (double)a - (double)(dst[i] >> 24);
+            alphaErr += d * d;
+        }
+        const double count   = (double)BC_BENCH_SIZE * BC_BENCH_SIZE;
+        const double colorDb = 10.0 * log10(255.0 * 255.0 * 3.0 * count / Max(colorErr, 1e-9));
+        const double alphaDb = 10.0 * log10(255.0 * 255.0 * count / Max(alphaErr, 1e-9));
+        printf("bcn %s: %.1f dB color, %.1f dB alpha, encode %.1f Mpx/s, decode %.0f Mpx/s\n", formatNames[fi], colorDb, alphaDb,
+               numPixels / encodeSecs * 1e-6, numPixels / decodeSecs * 1e-6);
+        TEST_CHECK(colorDb >= minColorDb[fi]);
+        TEST_CHECK(alphaDb >= minAlphaDb[fi]);
+    }
+}
+
+#define MIX_BENCH_CLIP_FRAMES 48000
+#define MIX_BENCH_OUT_FRAMES  512 // A device callback's worth
+#define MIX_BENCH_SECONDS     4
+
+void testMixerBench()
+{
+    static i16 stereo[MIX_BENCH_CLIP_FRAMES * 2];
+    static i16 mono[MIX_BENCH_CLIP_FRAMES];
+    static i16 out[MIX_BENCH_OUT_FRAMES * 2];
+    static i16 streamSamples[4096 * 2];
+    static Mixer_s mixer;
+    static MixStream_s stream;
+
+    srand(3456);
+    for (u32 i = 0; i < MIX_BENCH_CLIP_FRAMES; i++)
+    {
+        mono[i] = (i16)(sinf(i * 0.05f) * 20000.0f);
+        stereo[i * 2] = (i16)(rand() % 32768 - 16384);
+        stereo[i * 2 + 1] = (i16)(rand() % 32768 - 16384);
+    }
+    const MixClip_s stereoClip = {stereo, MIX_BENCH_CLIP_FRAMES, 2, 48000};
+    const MixClip_s monoClip = {mono, MIX_BENCH_CLIP_FRAMES, 1, 44100};
+
+    // One stereo voice at its own rate, full gain and centered, has to come out as it went in
+    Mix_Init(&mixer, 48000);
+    const MixParams_s unity = {1.0f, 0.0f, 1.0f};
+    Mix_Play(&mixer, &stereoClip, &unity, false);
+    u32 mismatches = 0;
+    for (u32 at = 0; at + MIX_BENCH_OUT_FRAMES <= MIX_BENCH_CLIP_FRAMES; at += MIX_BENCH_OUT_FRAMES)
+    {
+        Mix_Render(&mixer, out, MIX_BENCH_OUT_FRAMES);
+        for (u32 i = 0; i < MIX_BENCH_OUT_FRAMES * 2; i++)
+            mismatches += abs(out[i] - stereo[at * 2 + i]) > 1 ? 1 : 0;
+    }
+
+    // The wide convert-out has to round and clip as the scalar tail does. An odd count runs both; past full scale and
+    // values near a rounding edge are in the mix.
+    alignas(16) static r32 accum[MIX_BENCH_OUT_FRAMES * 2 + 5];
+    static i16 converted[countof(accum)];
+    for (i32 i = 0; i < countof(accum); i++)
+        accum[i] = i & 1 ? BenchRand(-1.5f, 1.5f) : ((i / 2 - countof(accum) / 4) + 0.49f) / 32767.0f;
+    Mix_ConvertOut(converted, accum, countof(accum));
+    u32 convertMismatches = 0;
+    for (i32 i = 0; i < countof(accum); i++)
+        convertMismatches += converted[i] != (i16)lrintf(Min(Max(accum[i], -1.0f), 1.0f) * 32767.0f) ? 1 : 0;
+    TEST_CHECK(convertMismatches == 0);
+
+    // Nothing is listening, so this is only the cost of the mix. Half the voices play at their own rate, the rest
+    // resample: the mono clip is 44.1k and pitched.
+    typedef std::chrono::high_resolution_clock Clock;
+    const u32 numRenders = MIX_BENCH_SECONDS * 48000 / MIX_BENCH_OUT_FRAMES;
+    const u32 voiceCounts[] = {1, 8, 32, MIX_MAX_VOICES};
+    for (i32 ci = 0; ci < countof(voiceCounts); ci++)
+    {
+        Mix_Init(&mixer, 48000);
+        for (u32 vi = 0; vi < voiceCounts[ci]; vi++)
+        {
+            const MixParams_s params = {0.1f, BenchRand(-1.0f, 1.0f), vi & 1 ? BenchRand(0.5f, 2.0f) : 1.0f};
+            Mix_Play(&mixer, vi & 1 ? &monoClip : &stereoClip, &params, true);
+        }
+
+        auto start = Clock::now();
+        for (u32 ri = 0; ri < numRenders; ri++)
+            Mix_Render(&mixer, out, MIX_BENCH_OUT_FRAMES);
+        const double secs = std::chrono::duration<double>(Clock::now() - start).count();
+
+        const double outFrames = (double)numRenders * MIX_BENCH_OUT_FRAMES;
+        printf("mixer %u voices: %.1f ns per voice per frame, %.0fx real time\n", voiceCounts[ci],
+               secs * 1e9 / (outFrames * voiceCounts[ci]), MIX_BENCH_SECONDS / secs);
+    }
+
+    // A stream fed a callback's worth at a time, as the game would between renders
+    Mix_Init(&mixer, 48000);
+    Mix_InitStream(&stream, streamSamples, 4096, 2, 48000);
+    const MixParams_s params = {0.5f, 0.0f, 1.0f};
+    Mix_PlayStream(&mixer, &stream, &params);
+    u32 fed = 0;
+    auto start = Clock::now();
+    for (u32 ri = 0; ri < numRenders; ri++)
+    {
+        while (Mix_StreamSpace(&stream) >= MIX_BENCH_OUT_FRAMES)
+            fed += Mix_StreamWrite(&stream, stereo + (fed % (MIX_BENCH_CLIP_FRAMES - MIX_BENCH_OUT_FRAMES)) * 2, MIX_BENCH_OUT_FRAMES);
+        Mix_Render(&mixer, out, MIX_BENCH_OUT_FRAMES);
+    }
+    Mix_EndStream(&stream);
+    while (!Mix_StreamDone(&stream))
+        Mix_Render(&mixer, out, MIX_BENCH_OUT_FRAMES);
+    const double streamSecs = std::chrono::duration<double>(Clock::now() - start).count();
+
+    printf("mixer stream: %.1f ns per frame, %u underruns (%u mismatches)\n",
+           streamSecs * 1e9 / ((double)numRenders * MIX_BENCH_OUT_FRAMES), stream.underruns.load(), mismatches);
+}
+
+// The soft renderer stands in for the GL one here
+Hwi* gHwi = nullptr;
+
+extern SubSystem SoftHardwareSubSystem;
+
+// name relative to the directory this file is in
+static void TestFilePath(char* path, size_t size, const char* name)
+{
+    int dirLen = 0;
+    for (int i = 0; __FILE__[i] != 0; i++)
+        if (__FILE__[i] == '/' || __FILE__[i] == '\\')
+            dirLen = i + 1;
+    snprintf(path, size, "%.*s%s", dirLen, __FILE__, name);
+}
+
+#define SOFT_GOLDEN_W 64
+#define SOFT_GOLDEN_H 48
+
+// A frame of fills, blits and a line through the soft renderer, compared to the bit against golden/soft_scene.png
+// beside this file. Run with QI_BLESS_GOLDEN set to write the golden from what's drawn, after checking it by eye.
+void testSoftRenderGolden()
+{
+    // NewFrame won't run without a context, nothing else of ImGui's is drawn
+    ImGui::CreateContext();
+    ImGuiIO& io = ImGui::GetIO();
+    io.DisplaySize = ImVec2((r32)SOFT_GOLDEN_W, (r32)SOFT_GOLDEN_H);
+    io.DeltaTime = 1.0f / 60.0f;
+    io.IniFilename = nullptr;
+
+    SubSystem sys = SoftHardwareSubSystem;
+    sys.globalPtr = calloc(1, sys.globalSize);
+    sys.initFunc(&sys, false);
+
+    static u32 screenPixels[SOFT_GOLDEN_W * SOFT_GOLDEN_H];
+    Bitmap screen = {};
+    Bm_CreateBitmapFromBuffer(screenPixels, &screen, SOFT_GOLDEN_W, SOFT_GOLDEN_H);
+    gHwi->SetScreenTarget(&screen);
+
+    // White and blue checks, R G B A bytes
+    static u32 checkerPixels[4 * 4];
+    for (u32 i = 0; i < 16; i++)
+        checkerPixels[i] = ((i & 3) + (i >> 2)) & 1 ? 0xFFFF0000u : 0xFFFFFFFFu;
+    Bitmap checker = {};
+    Bm_CreateBitmapFromBuffer(checkerPixels, &checker, 4, 4);
+    gHwi->RegisterBitmap(&checker, false);
+    gHwi->UploadBitmap(&checker);
+
+    BenchStartPool(2);
+    gHwi->BeginFrame();
+    const Rect opaque = {4.0f, 4.0f, 20.0f, 12.0f};
+    const Rect translucent = {12.0f, 8.0f, 24.0f, 16.0f};
+    gHwi->FillRect(&opaque, ColorU(255, 0, 0, 255));
+    gHwi->FillRect(&translucent, ColorU(0, 255, 0, 128));
+    gHwi->Blit(&checker, V2(0.0f, 0.0f), V2(40.0f, 4.0f), V2(4.0f, 4.0f));
+    const Rect checkerRect = {0.0f, 0.0f, 4.0f, 4.0f};
+    const Rect doubled = {40.0f, 12.0f, 8.0f, 8.0f};
+    gHwi->BlitStretched(&checker, &checkerRect, &doubled, ColorU(255, 255, 255, 255));
+    gHwi->Blit(&checker, V2(0.0f, 0.0f), V2(48.0f, 4.0f), V2(4.0f, 4.0f), ColorU(255, 128, 0, 255));
+    gHwi->DrawLine(V2(2.0f, 40.0f), V2(60.0f, 40.0f), ColorU(255, 255, 0, 255));
+    gHwi->EndFrame();
+    BenchStopPool();
+
+    char goldenPath[1024];
+    TestFilePath(goldenPath, sizeof(goldenPath), "golden/soft_scene.png");
+    if (getenv("QI_BLESS_GOLDEN"))
+        TEST_CHECK(QiSoft_WritePng(&screen, goldenPath));
+
+    int goldenW = 0, goldenH = 0, goldenChannels = 0;
+    u8* golden = stbi_load(goldenPath, &goldenW, &goldenH, &goldenChannels, 4);
+    TEST_CHECK(golden != nullptr && goldenW == SOFT_GOLDEN_W && goldenH == SOFT_GOLDEN_H);
+
+    u32 mismatches = 0;
+    if (golden != nullptr && goldenW == SOFT_GOLDEN_W && goldenH == SOFT_GOLDEN_H)
+    {
+        for (u32 y = 0; y < SOFT_GOLDEN_H; y++)
+        {
+            const u8* goldenRow = golden + y * SOFT_GOLDEN_W * 4;
+            for (u32 x = 0; x < SOFT_GOLDEN_W; x++)
+                mismatches += memcmp(&screen.pixels[y * screen.pitch + x], goldenRow + x * 4, 4) != 0 ? 1 : 0;
+        }
+    }
+    TEST_CHECK(mismatches == 0);
+    if (mismatches != 0 && QiSoft_WritePng(&screen, "soft_scene_actual.png"))
+        printf("soft render: %u pixels differ from %s, drawn frame in soft_scene_actual.png\n", mismatches, goldenPath);
+    stbi_image_free(golden);
+
+    gHwi->UnregisterBitmap(&checker);
+    free(sys.globalPtr);
+    gHwi = nullptr;
+    ImGui::DestroyContext();
+}
+
 int main(int, char**)
 {
+    s_benchPlat.ParallelFor   = BenchParallelFor;
+    s_benchPlat.NumJobThreads = BenchNumThreads;
+
 	Vector4 ta(1.0f, 0.0f, 0.0f, 4.0f);
     Vector4 tb(ta.wzyx);
     Vector2 ba(ta.xy);
@@ -114,4 +1070,19 @@ int main(int, char**)
     IVector4 ia(8, 9, 10, 11);
 
     testLex();
+    testContacts();
+    testGjkQueries();
+    testResolveContacts();
+    testGjkBench();
+    testEntities();
+    testEntitySystems();
+    testEcsBench();
+    testPixelOpsBench();
+    testBlockCompressionBench();
+    testMixerBench();
+    testSoftRenderGolden();
+
+    if (s_testFailures)
+        printf("%u checks failed\n", s_testFailures);
+    return s_testFailures == 0 ? 0 : 1;
 }
@@ -9,8 +9,11 @@
 #include "game.h"
 #include "memory.h"
 #include "tile.h"
+#include "util.h"
 #include <stdio.h>
 
+static_assert(TILE_CHUNK_DIM == 64, "Solid rect merge uses a u64 per chunk row");
+
 TileChunk_s*
 GetChunk(World_s* world, const i32 tileX, const i32 tileY)
 {
@@ -19,7 +22,7 @@ GetChunk(World_s* world, const i32 tileX, const i32 tileY)
 	const u32 absIdxX = chunkX + WORLD_CHUNKS_DIM / 2;
 	const u32 absIdxY = chunkY + WORLD_CHUNKS_DIM / 2;
 
-	if (absIdxX >= WORLD_CHUNKS_DIM || absIdxY > WORLD_CHUNKS_DIM)
+	if (absIdxX >= WORLD_CHUNKS_DIM || absIdxY >= WORLD_CHUNKS_DIM)
 		return nullptr;
 
 	return &world->chunks[absIdxX + WORLD_CHUNKS_DIM * absIdxY];
@@ -45,7 +48,15 @@ SetTileValue(MemoryArena* tileArena, World_s* world, const WorldPos_s* pos, cons
 	const u32 tileX = pos->x.tile & TILE_CHUNK_MASK;
 	const u32 tileY = pos->y.tile & TILE_CHUNK_MASK;
 	Assert(tileX < TILE_CHUNK_DIM && tileY < TILE_CHUNK_DIM);
-	chunk->tiles[tileX + tileY * TILE_CHUNK_DIM] = value;
+
+	u32* tile = &chunk->tiles[tileX + tileY * TILE_CHUNK_DIM];
+	if (*tile == value)
+		return;
+
+	if (IsTileSolid(*tile) != IsTileSolid(value))
+		chunk->solidRectsValid = false;
+	chunk->version++;
+	*tile = value;
 }
 
 u32
@@ -53,7 +64,7 @@ GetTileValue(World_s* world, const i32 iTileX, const i32 iTileY)
 {
 	TileChunk_s* chunk = GetChunk(world, iTileX, iTileY);
 
-	if (chunk->tiles == nullptr)
+	if (chunk == nullptr || chunk->tiles == nullptr)
 		return TILE_INVALID;
 
 	const u32 tileX = iTileX & TILE_CHUNK_MASK;
@@ -68,6 +79,157 @@ GetTileValue(World_s* world, const WorldPos_s* pos)
 	return GetTileValue(world, pos->x.tile, pos->y.tile);
 }
 
+// Greedy merge of solid tiles into rectangles: take the leftmost run in a row, then extend it down while the
+// rows below contain the whole run.
+internal void
+BuildSolidRects(MemoryArena* tileArena, TileChunk_s* chunk)
+{
+	Assert(chunk->tiles);
+
+	u64 solidRows[TILE_CHUNK_DIM];
+	for (u32 y = 0; y < TILE_CHUNK_DIM; y++)
+	{
+		const u32* row  = chunk->tiles + y * TILE_CHUNK_DIM;
+		u64        bits = 0;
+		for (u32 x = 0; x < TILE_CHUNK_DIM; x++)
+			bits |= (u64)IsTileSolid(row[x]) << x;
+		solidRows[y] = bits;
+	}
+
+	ChunkRect_s rects[TILE_CHUNK_DIM * TILE_CHUNK_DIM / 2];
+	u32         numRects = 0;
+
+	for (u32 y = 0; y < TILE_CHUNK_DIM; y++)
+	{
+		while (solidRows[y] != 0)
+		{
+			const u32 x0      = CountTrailingZeros64(solidRows[y]);
+			const u64 clear   = ~(solidRows[y] >> x0);
+			const u32 width   = clear == 0 ? TILE_CHUNK_DIM - x0 : CountTrailingZeros64(clear);
+			const u64 runMask = (width == 64 ? ~0ull : ((1ull << width) - 1)) << x0;
+
+			u32 height = 1;
+			while (y + height < TILE_CHUNK_DIM && (solidRows[y + height] & runMask) == runMask)
+			{
+				solidRows[y + height] &= ~runMask;
+				height++;
+			}
+			solidRows[y] &= ~runMask;
+
+			Assert(numRects < (u32)countof(rects));
+			ChunkRect_s* rect = &rects[numRects++];
+			rect->x           = (u8)x0;
+			rect->y           = (u8)y;
+			rect->width       = (u8)width;
+			rect->height      = (u8)height;
+		}
+	}
+
+	// Arena memory can't be freed, so only grow when a rebuild doesn't fit the previous block
+	if (numRects > chunk->solidRectCapacity)
+	{
+		chunk->solidRectCapacity = (numRects + 31) & ~31u;
+		chunk->solidRects        = (ChunkRect_s*)MA_Alloc(tileArena, chunk->solidRectCapacity * sizeof(ChunkRect_s));
+	}
+
+	memcpy(chunk->solidRects, rects, numRects * sizeof(ChunkRect_s));
+	chunk->numSolidRects   = numRects;
+	chunk->solidRectsValid = true;
+}
+
+u32
+GetSolidTileRects(MemoryArena* tileArena, World_s* world, i32 minTileX, i32 minTileY, i32 maxTileX, i32 maxTileY, TileRect_s* rects, u32 maxRects,
+                  u32 firstRect)
+{
+	Assert(minTileX <= maxTileX && minTileY <= maxTileY);
+
+	const i32 minChunkX = minTileX >> TILE_CHUNK_BITS;
+	const i32 minChunkY = minTileY >> TILE_CHUNK_BITS;
+	const i32 maxChunkX = maxTileX >> TILE_CHUNK_BITS;
+	const i32 maxChunkY = maxTileY >> TILE_CHUNK_BITS;
+
+	u32 numRects   = 0;
+	u32 numSkipped = 0;
+	for (i32 chunkY = minChunkY; chunkY <= maxChunkY; chunkY++)
+	{
+		for (i32 chunkX = minChunkX; chunkX <= maxChunkX; chunkX++)
+		{
+			const i32    baseX = chunkX << TILE_CHUNK_BITS;
+			const i32    baseY = chunkY << TILE_CHUNK_BITS;
+			TileChunk_s* chunk = GetChunk(world, baseX, baseY);
+
+			// Missing chunks read as TILE_INVALID everywhere, which is solid
+			if (chunk == nullptr || chunk->tiles == nullptr)
+			{
+				if (numSkipped < firstRect)
+				{
+					numSkipped++;
+					continue;
+				}
+				if (numRects == maxRects)
+					return numRects;
+
+				TileRect_s* out = &rects[numRects++];
+				out->minX       = baseX;
+				out->minY       = baseY;
+				out->maxX       = baseX + TILE_CHUNK_DIM - 1;
+				out->maxY       = baseY + TILE_CHUNK_DIM - 1;
+				continue;
+			}
+
+			if (!chunk->solidRectsValid)
+			{
+				AssertMsg(tileArena != nullptr, "Chunk %d %d read before its rects were prepared", chunkX, chunkY);
+				BuildSolidRects(tileArena, chunk);
+			}
+
+			for (u32 ri = 0; ri < chunk->numSolidRects; ri++)
+			{
+				const ChunkRect_s* cr = &chunk->solidRects[ri];
+				const i32          x0 = baseX + cr->x;
+				const i32          y0 = baseY + cr->y;
+				const i32          x1 = x0 + cr->width - 1;
+				const i32          y1 = y0 + cr->height - 1;
+
+				if (x1 < minTileX || x0 > maxTileX || y1 < minTileY || y0 > maxTileY)
+					continue;
+
+				if (numSkipped < firstRect)
+				{
+					numSkipped++;
+					continue;
+				}
+				if (numRects == maxRects)
+					return numRects;
+
+				TileRect_s* out = &rects[numRects++];
+				out->minX       = x0;
+				out->minY       = y0;
+				out->maxX       = x1;
+				out->maxY       = y1;
+			}
+		}
+	}
+
+	return numRects;
+}
+
+void
+PrepareSolidTileRects(MemoryArena* tileArena, World_s* world, i32 minTileX, i32 minTileY, i32 maxTileX, i32 maxTileY)
+{
+	Assert(tileArena && minTileX <= maxTileX && minTileY <= maxTileY);
+
+	for (i32 chunkY = minTileY >> TILE_CHUNK_BITS; chunkY <= maxTileY >> TILE_CHUNK_BITS; chunkY++)
+	{
+		for (i32 chunkX = minTileX >> TILE_CHUNK_BITS; chunkX <= maxTileX >> TILE_CHUNK_BITS; chunkX++)
+		{
+			TileChunk_s* chunk = GetChunk(world, chunkX << TILE_CHUNK_BITS, chunkY << TILE_CHUNK_BITS);
+			if (chunk && chunk->tiles && !chunk->solidRectsValid)
+				BuildSolidRects(tileArena, chunk);
+		}
+	}
+}
+
 void
 NormalizePos(WorldPos_s* pos)
 {
@@ -88,6 +250,12 @@ AddSubtileOffset(WorldPos_s* pos, const v2 offset)
 	NormalizePos(pos);
 }
 
+void
+AddMetersOffset(WorldPos_s* pos, const v2 meters)
+{
+	AddSubtileOffset(pos, V2(meters.x / TILE_SIZE_METERS_X, meters.y / TILE_SIZE_METERS_Y));
+}
+
 void
 WorldPosSub(WorldPos_s* dest, const WorldPos_s* a, const WorldPos_s* b)
 {
@@ -60,9 +60,30 @@ struct WorldPos_s
 	};
 };
 
+// Solid tile run merged into a rectangle, in chunk local tile coordinates
+struct ChunkRect_s
+{
+	u8 x, y;
+	u8 width, height;
+};
+
 struct TileChunk_s
 {
 	u32* tiles;
+	u32  version; // Bumped on every tile change, so render caches built from the chunk can tell they're stale
+
+	// Broadphase cache, rebuilt lazily after SetTileValue changes solidity
+	ChunkRect_s* solidRects;
+	u32          numSolidRects;
+	u32          solidRectCapacity;
+	bool         solidRectsValid;
+};
+
+// Inclusive rectangle of solid tiles in world tile coordinates
+struct TileRect_s
+{
+	i32 minX, minY;
+	i32 maxX, maxY;
 };
 
 struct World_s
@@ -70,10 +91,28 @@ struct World_s
 	TileChunk_s chunks[WORLD_CHUNKS_DIM * WORLD_CHUNKS_DIM];
 };
 
+TileChunk_s* GetChunk(World_s* world, i32 tileX, i32 tileY);
+
 void SetTileValue(MemoryArena* tileArena, World_s* world, const WorldPos_s* pos, const u32 value);
 u32  GetTileValue(World_s* world, const WorldPos_s* pos);
 u32  GetTileValue(World_s* world, i32 tileX, i32 tileY);
 void AddSubtileOffset(WorldPos_s* pos, const v2 offset);
+void AddMetersOffset(WorldPos_s* pos, const v2 meters);
+
+inline bool IsTileSolid(const u32 value)
+{
+	return value != TILE_EMPTY;
+}
+
+// Returns the merged solid rects of every chunk touching the given tile range. Rects are not clipped to the range.
+// A null tileArena makes this read only, for worker threads; the chunks must have been prepared beforehand.
+// The first firstRect found are skipped, so a range with more than maxRects can be read in batches; fewer than
+// maxRects back means there are no more.
+u32 GetSolidTileRects(MemoryArena* tileArena, World_s* world, i32 minTileX, i32 minTileY, i32 maxTileX, i32 maxTileY, TileRect_s* rects, u32 maxRects,
+                      u32 firstRect);
+
+// Rebuild any stale rect caches for chunks touching the tile range
+void PrepareSolidTileRects(MemoryArena* tileArena, World_s* world, i32 minTileX, i32 minTileY, i32 maxTileX, i32 maxTileY);
 void WorldPosSub(WorldPos_s* dest, const WorldPos_s* a, const WorldPos_s* b);
 
 v2 WorldPosToMeters(WorldPos_s* worldPos);
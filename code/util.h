@@ -87,6 +87,29 @@ BitScanRight<u64>(const u64 v)
 #endif
 }
 
+// Zero based index of the lowest set bit, v must be non zero
+inline u32
+CountTrailingZeros64(const u64 v)
+{
+#if HAS(IS_CLANG)
+    return (u32)__builtin_ctzll(v);
+#else
+    return (u32)_tzcnt_u64(v);
+#endif
+}
+
+// Cheap integer mix, good enough to turn a seed and counter into well spread bits
+inline u32
+HashU32(u32 v)
+{
+    v ^= v >> 16;
+    v *= 0x7feb352d;
+    v ^= v >> 15;
+    v *= 0x846ca68b;
+    v ^= v >> 16;
+    return v;
+}
+
 extern const char* VS(const char* msg, ...)
 #if HAS(IS_CLANG)
     __attribute__ ((format (printf, 1, 2)))